@@ -0,0 +1,52 @@
+// The light set of clustered forward lighting, shared by the binning pass and the lit shaders; the layouts
+// must match src/lights.c.
+
+#ifndef LIGHT_SET
+#define LIGHT_SET 0
+#endif
+
+// readonly where the clusters are only looked up
+#ifndef LIGHT_GRID_ACCESS
+#define LIGHT_GRID_ACCESS
+#endif
+
+// match src/lights.h
+const uint CLUSTERS_X = 16;
+const uint CLUSTERS_Y = 9;
+const uint CLUSTERS_Z = 24;
+const uint MAX_PER_CLUSTER = 256;
+const uint MAX_INDICES = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z * 128;
+
+struct Light {
+    // view space
+    vec4 position_radius;
+    // w is the index of the light's shadow in shadows.glsl, negative without one
+    vec4 color;
+};
+
+layout(std430, set = LIGHT_SET, binding = 0) readonly buffer LightFrame {
+    mat4 light_view;
+    float slice_scale;
+    float slice_bias;
+    float near_plane;
+    float far_plane;
+    // P00 and P11
+    vec2 light_projection;
+    vec2 render_size;
+    uint light_count;
+    Light lights[];
+};
+
+// how many indices are taken, then the offset and count of every cluster's range of them
+layout(std430, set = LIGHT_SET, binding = 1) LIGHT_GRID_ACCESS buffer LightGrid {
+    uint index_count;
+    uvec2 clusters[];
+};
+
+layout(std430, set = LIGHT_SET, binding = 2) LIGHT_GRID_ACCESS buffer LightIndices {
+    uint light_indices[];
+};
+
+uint cluster_index(uvec3 cluster) {
+    return (cluster.z * CLUSTERS_Y + cluster.y) * CLUSTERS_X + cluster.x;
+}
@@ -0,0 +1,59 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define LIGHT_SET 1
+#define LIGHT_GRID_ACCESS readonly
+#include "lights.glsl"
+
+#define SHADOW_SET 2
+#include "shadows.glsl"
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec3 fragPosition;
+
+layout(location = 0) out vec4 outColor;
+
+const vec3 light_direction = normalize(vec3(0.4, 1.0, 0.6));
+const vec3 albedo = vec3(0.8);
+
+// inverse square, windowed to reach zero at the radius
+float attenuation(float distance, float radius) {
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    return window * window / (distance * distance + 1.0);
+}
+
+void main() {
+    vec3 normal = normalize(fragNormal);
+    float diffuse = max(dot(normal, light_direction), 0.0);
+    vec3 color = albedo * (0.15 + 0.85 * diffuse);
+
+    if (light_count > 0) {
+        vec3 position = (light_view * vec4(fragPosition, 1.0)).xyz;
+        vec3 view_normal = normalize(mat3(light_view) * normal);
+
+        // only the lights binned into this fragment's cluster
+        uvec2 tile = min(uvec2(gl_FragCoord.xy / render_size * vec2(CLUSTERS_X, CLUSTERS_Y)), uvec2(CLUSTERS_X, CLUSTERS_Y) - 1);
+        uint slice = uint(clamp(log(max(-position.z, near_plane)) * slice_scale + slice_bias, 0.0, float(CLUSTERS_Z - 1)));
+        uvec2 range = clusters[cluster_index(uvec3(tile, slice))];
+
+        for (uint i = 0; i < range.y; ++i) {
+            Light light = lights[light_indices[range.x + i]];
+
+            vec3 to_light = light.position_radius.xyz - position;
+            float distance = length(to_light);
+            if (distance >= light.position_radius.w)
+                continue;
+
+            float lambert = max(dot(view_normal, to_light / max(distance, 1e-4)), 0.0);
+            if (lambert <= 0.0)
+                continue;
+
+            // color.w is the index of the light's shadow, negative without one
+            float visibility = light.color.w >= 0.0 ? shadow_visibility(uint(light.color.w), fragPosition) : 1.0;
+
+            color += albedo * light.color.rgb * lambert * visibility * attenuation(distance, light.position_radius.w);
+        }
+    }
+
+    outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 450
+
+layout(push_constant) uniform Push {
+    mat4 view_projection;
+} push;
+
+// indexed by gl_InstanceIndex; every draw's firstInstance is the slot of its instance
+layout(std430, set = 0, binding = 0) readonly buffer Transforms {
+    mat4 transforms[];
+};
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec3 fragPosition;
+
+void main() {
+    mat4 transform = transforms[gl_InstanceIndex];
+
+    vec4 world = transform * vec4(position, 1.0);
+
+    gl_Position = push.view_projection * world;
+    fragPosition = world.xyz;
+    // good enough without non-uniform scale
+    fragNormal = mat3(transform) * normal;
+}
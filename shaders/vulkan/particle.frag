@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) in vec2 fragOffset;
+layout(location = 1) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float falloff = max(1.0 - dot(fragOffset, fragOffset), 0.0);
+    // blended additively; alpha only scales the color
+    outColor = vec4(fragColor.rgb * fragColor.a * falloff, 0.0);
+}
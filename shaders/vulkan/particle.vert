@@ -0,0 +1,40 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define PARTICLE_BUFFER_ACCESS readonly
+#define PARTICLE_DRAW
+#include "particles.glsl"
+
+layout(push_constant) uniform Push {
+    mat4 view_projection;
+    // xyz: camera right, w: particle size
+    vec4 right_size;
+    // xyz: camera up, w: emitter lifetime
+    vec4 up_lifetime;
+    // where the alive list being drawn starts
+    uint list_offset;
+} push;
+
+layout(location = 0) out vec2 fragOffset;
+layout(location = 1) out vec4 fragColor;
+
+vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0),
+    vec2(1.0, -1.0),
+    vec2(1.0, 1.0),
+    vec2(-1.0, -1.0),
+    vec2(1.0, 1.0),
+    vec2(-1.0, 1.0)
+);
+
+void main() {
+    Particle particle = particles[alive[push.list_offset + gl_InstanceIndex]];
+    vec2 corner = corners[gl_VertexIndex];
+
+    vec3 position = particle.position + (push.right_size.xyz * corner.x + push.up_lifetime.xyz * corner.y) * push.right_size.w * 0.5;
+    gl_Position = push.view_projection * vec4(position, 1.0);
+
+    fragOffset = corner;
+    fragColor = unpackUnorm4x8(particle.color);
+    fragColor.a *= clamp(particle.life / push.up_lifetime.w, 0.0, 1.0);
+}
@@ -0,0 +1,55 @@
+// Shared by the particle shaders; the layouts must match src/particles.c.
+
+#ifndef PARTICLE_BUFFER_ACCESS
+#define PARTICLE_BUFFER_ACCESS
+#endif
+
+struct Particle {
+    vec3 position;
+    // seconds left; dead at 0
+    float life;
+    vec3 velocity;
+    uint color;
+};
+
+struct DrawIndirectCommand {
+    uint vertex_count;
+    uint instance_count;
+    uint first_vertex;
+    uint first_instance;
+};
+
+layout(set = 0, binding = 0, std430) PARTICLE_BUFFER_ACCESS buffer Particles {
+    Particle particles[];
+};
+
+// two lists of `capacity` indices: the live particles, and the ones that survive this step
+layout(set = 0, binding = 1, std430) PARTICLE_BUFFER_ACCESS buffer AliveLists {
+    uint alive[];
+};
+
+layout(set = 0, binding = 2, std430) PARTICLE_BUFFER_ACCESS buffer DeadList {
+    uint dead[];
+};
+
+layout(set = 0, binding = 3, std430) PARTICLE_BUFFER_ACCESS buffer Counters {
+    // draws[i].instance_count is the length of alive list i
+    DrawIndirectCommand draws[2];
+    uvec3 simulate_groups;
+    int dead_count;
+} counters;
+
+#ifndef PARTICLE_DRAW
+layout(push_constant) uniform Push {
+    vec4 emitter_position_spread;
+    vec4 emitter_velocity_lifetime;
+    float gravity;
+    float dt;
+    uint emit_count;
+    uint seed;
+    // the alive list holding the live particles
+    uint current;
+    uint capacity;
+    uint color;
+} push;
+#endif
@@ -0,0 +1,50 @@
+// The shadow set of the shadow atlas, read by the lit shaders; the layouts must match src/shadows.c.
+
+#ifndef SHADOW_SET
+#define SHADOW_SET 0
+#endif
+
+// match src/shadows.h
+const float SHADOW_ATLAS_SIZE = 4096.0;
+
+struct Shadow {
+    // world space to the clip space of each cube face: +x, -x, +y, -y, +z and -z
+    mat4 faces[6];
+    // where each face is in the atlas, as uv offset and scale
+    vec4 rects[6];
+    // world space position and radius of the light
+    vec4 position;
+    uint layer;
+};
+
+layout(std430, set = SHADOW_SET, binding = 0) readonly buffer Shadows {
+    Shadow shadows[];
+};
+
+// compares against the depth, with 2x2 PCF where the format can be filtered
+layout(set = SHADOW_SET, binding = 1) uniform sampler2DArrayShadow shadow_atlas;
+
+// the face of the cube `direction` from the light goes through, by its major axis
+uint shadow_face(vec3 direction) {
+    vec3 a = abs(direction);
+    if (a.x >= a.y && a.x >= a.z)
+        return direction.x >= 0.0 ? 0u : 1u;
+    if (a.y >= a.z)
+        return direction.y >= 0.0 ? 2u : 3u;
+    return direction.z >= 0.0 ? 4u : 5u;
+}
+
+// 1 where `position` sees the light of shadow `index`, 0 where a caster is in between
+float shadow_visibility(uint index, vec3 position) {
+    uint face = shadow_face(position - shadows[index].position.xyz);
+
+    vec4 clip = shadows[index].faces[face] * vec4(position, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    vec4 rect = shadows[index].rects[face];
+
+    // half a texel in, so filtering never reaches into the neighbouring tile
+    float margin = 0.5 / SHADOW_ATLAS_SIZE;
+    vec2 uv = clamp(rect.xy + (ndc.xy * 0.5 + 0.5) * rect.zw, rect.xy + margin, rect.xy + rect.zw - margin);
+
+    return texture(shadow_atlas, vec4(uv, float(shadows[index].layer), ndc.z));
+}
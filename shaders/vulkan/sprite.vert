@@ -0,0 +1,37 @@
+#version 450
+
+layout(push_constant) uniform Push {
+    // 2 / target size; pixels to [0, 2]
+    vec2 pixel_to_ndc;
+} push;
+
+// one sprite per instance
+layout(location = 0) in vec4 rect;
+layout(location = 1) in vec4 uv_rect;
+layout(location = 2) in vec4 color;
+layout(location = 3) in float rotation;
+
+layout(location = 0) out vec2 fragUv;
+layout(location = 1) out vec4 fragColor;
+
+vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0),
+    vec2(1.0, 0.0),
+    vec2(1.0, 1.0),
+    vec2(0.0, 0.0),
+    vec2(1.0, 1.0),
+    vec2(0.0, 1.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+
+    vec2 local = (corner - 0.5) * rect.zw;
+    float s = sin(rotation);
+    float c = cos(rotation);
+    vec2 position = rect.xy + rect.zw * 0.5 + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+
+    gl_Position = vec4(position * push.pixel_to_ndc - 1.0, 0.0, 1.0);
+    fragUv = mix(uv_rect.xy, uv_rect.zw, corner);
+    fragColor = color;
+}
@@ -1,8 +1,16 @@
 #version 450
 
+layout(constant_id = 0) const bool FLAT_COLOR = false;
+layout(constant_id = 1) const bool GRAYSCALE = false;
+
 layout(location = 0) out vec4 outColor;
 layout(location = 0) in vec3 fragColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = FLAT_COLOR ? vec3(1.0) : fragColor;
+
+    if (GRAYSCALE)
+        color = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+
+    outColor = vec4(color, 1.0);
 }
@@ -0,0 +1,174 @@
+#include "archive.h"
+#include "lz4.h"
+#include "arena.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+typedef struct ArchiveUnpack {
+    Archive* archive;
+    atomic_uint next;
+    atomic_bool failed;
+} ArchiveUnpack;
+
+static u64 archive_align(u64 offset) {
+    return (offset + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+}
+
+static bool archive_validate(const FileView* view) {
+    if (view->length < sizeof(ArchiveHeader))
+        return false;
+
+    const ArchiveHeader* header = (const ArchiveHeader*)view->data;
+    if (header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION)
+        return false;
+
+    if (header->entry_count > (view->length - sizeof(ArchiveHeader)) / sizeof(ArchiveEntry))
+        return false;
+
+    const ArchiveEntry* entries = (const ArchiveEntry*)(view->data + sizeof(ArchiveHeader));
+    for (u32 i = 0; i < header->entry_count; ++i) {
+        const ArchiveEntry* entry = &entries[i];
+
+        if (entry->offset % ARCHIVE_ALIGNMENT != 0 || entry->offset > view->length || entry->stored_size > view->length - entry->offset)
+            return false;
+
+        if (!(entry->flags & ARCHIVE_ENTRY_LZ4) && entry->stored_size != entry->size)
+            return false;
+
+        /* lookups binary search, so the order is part of the format */
+        if (i > 0 && entries[i - 1].hash >= entry->hash)
+            return false;
+    }
+
+    return true;
+}
+
+bool archive_open(Archive* archive, const char* path) {
+    *archive = (Archive) { 0 };
+
+    archive->view = file_view_open(path);
+    if (archive->view.data == NULL)
+        return false;
+
+    if (!archive_validate(&archive->view)) {
+        fprintf(stderr, "%s isn't a valid archive (version %u expected)\n", path, ARCHIVE_VERSION);
+        file_view_close(&archive->view);
+        return false;
+    }
+
+    archive->header = (const ArchiveHeader*)archive->view.data;
+    archive->entries = (const ArchiveEntry*)(archive->view.data + sizeof(ArchiveHeader));
+
+    return true;
+}
+
+void archive_close(Archive* archive) {
+    if (archive->data)
+        heap_free(archive->data);
+    if (archive->unpacked)
+        heap_free(archive->unpacked);
+
+    file_view_close(&archive->view);
+    *archive = (Archive) { 0 };
+}
+
+/* one per worker; blobs differ a lot in size, so each takes the next one until none are left */
+static void archive_unpack_worker(void* data, u32 first, u32 count) {
+    (void)first;
+    (void)count;
+    ArchiveUnpack* unpack = data;
+    Archive* archive = unpack->archive;
+
+    for (u32 i = atomic_fetch_add(&unpack->next, 1); i < archive->header->entry_count; i = atomic_fetch_add(&unpack->next, 1)) {
+        const ArchiveEntry* entry = &archive->entries[i];
+        if (!(entry->flags & ARCHIVE_ENTRY_LZ4))
+            continue;
+
+        const u8* src = (const u8*)archive->view.data + entry->offset;
+        if (!lz4_decompress(src, entry->stored_size, (u8*)archive->data[i], entry->size))
+            atomic_store(&unpack->failed, true);
+    }
+}
+
+bool archive_unpack(Archive* archive, JobSystem* jobs) {
+    TRACE_ZONE("archive_unpack");
+
+    u32 count = archive->header->entry_count;
+    if (archive->data || count == 0)
+        return true;
+
+    u64 unpacked_size = 0;
+    u32 compressed = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (archive->entries[i].flags & ARCHIVE_ENTRY_LZ4) {
+            unpacked_size += archive_align(archive->entries[i].size);
+            ++compressed;
+        }
+    }
+
+    /* the workers would otherwise fault the blobs in a page at a time */
+    file_view_advise(&archive->view, 0, archive->view.length, FILE_ADVICE_WILLNEED);
+
+    archive->data = heap_alloc(sizeof(byte*) * count);
+    archive->unpacked = unpacked_size ? heap_alloc(unpacked_size) : NULL;
+
+    u64 offset = 0;
+    for (u32 i = 0; i < count; ++i) {
+        const ArchiveEntry* entry = &archive->entries[i];
+
+        if (entry->flags & ARCHIVE_ENTRY_LZ4) {
+            archive->data[i] = archive->unpacked + offset;
+            offset += archive_align(entry->size);
+        } else {
+            archive->data[i] = archive->view.data + entry->offset;
+        }
+    }
+
+    ArchiveUnpack unpack = { .archive = archive };
+    atomic_init(&unpack.next, 0);
+    atomic_init(&unpack.failed, false);
+
+    u32 workers = jobs_workers_count(jobs);
+    workers = workers < compressed ? workers : compressed;
+
+    JobCounter counter;
+    atomic_init(&counter, 0);
+
+    jobs_run(jobs, archive_unpack_worker, &unpack, workers, &counter);
+    jobs_wait(jobs, &counter);
+
+    return !atomic_load(&unpack.failed);
+}
+
+u32 archive_find(const Archive* archive, const char* name) {
+    u64 hash = archive_hash(name);
+
+    u32 low = 0;
+    u32 high = archive->header->entry_count;
+    while (low < high) {
+        u32 middle = low + (high - low) / 2;
+        u64 middle_hash = archive->entries[middle].hash;
+
+        if (middle_hash == hash)
+            return middle;
+
+        if (middle_hash < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return UINT32_MAX;
+}
+
+const byte* archive_entry_data(const Archive* archive, u32 entry, u64* size) {
+    const ArchiveEntry* e = &archive->entries[entry];
+    *size = e->size;
+
+    if (archive->data)
+        return archive->data[entry];
+
+    return e->flags & ARCHIVE_ENTRY_LZ4 ? NULL : archive->view.data + e->offset;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "types.h"
+#include "io.h"
+#include "archive_format.h"
+#include "jobs.h"
+
+#include <stdbool.h>
+
+/*
+ * Reads the archives of archive_format.h.
+ *
+ * The file is mapped once, and names are found by binary search over the hashed table of contents. Stored
+ * blobs are used straight out of the mapping; archive_unpack() decompresses all LZ4 blobs up front, spread
+ * over the job system's workers, so loading many assets costs memory bandwidth rather than a syscall and seek each.
+ */
+
+typedef struct Archive {
+    FileView view;
+    const ArchiveHeader* header;
+    const ArchiveEntry* entries;
+
+    /* after archive_unpack(): where every entry's bytes are, in the mapping or in `unpacked` */
+    const byte** data;
+    byte* unpacked;
+} Archive;
+
+/* returns false if the file can't be mapped or isn't a valid archive. */
+bool archive_open(Archive* archive, const char* path);
+void archive_close(Archive* archive);
+
+/* returns false if a blob is corrupt, which leaves the archive to be closed. */
+bool archive_unpack(Archive* archive, JobSystem* jobs);
+
+/* the index of the entry called `name`, or UINT32_MAX. */
+u32 archive_find(const Archive* archive, const char* name);
+
+/* the unpacked bytes of an entry; NULL for LZ4 blobs before archive_unpack(). */
+const byte* archive_entry_data(const Archive* archive, u32 entry, u64* size);
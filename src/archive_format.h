@@ -0,0 +1,50 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Packed asset archive, written by tools/pack and memory mapped once by the renderer (see archive.h).
+ *
+ * An ArchiveHeader, the table of contents right after it: `entry_count` ArchiveEntries sorted by the hash of
+ * their names, then the blobs, each starting on an ARCHIVE_ALIGNMENT boundary. Blobs are LZ4 blocks, or stored
+ * as is when compressing doesn't make them smaller. Names themselves aren't stored; the packer refuses
+ * names whose hashes collide.
+ *
+ * Everything is little endian, in the layout of the structs below.
+ */
+
+#define ARCHIVE_MAGIC (u32)0x4b41505a /* "ZPAK" */
+#define ARCHIVE_VERSION (u32)1
+#define ARCHIVE_ALIGNMENT (u64)64
+
+enum ArchiveEntryFlags {
+    ARCHIVE_ENTRY_LZ4 = 1 << 0,
+};
+
+typedef struct ArchiveHeader {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 reserved;
+} ArchiveHeader;
+
+typedef struct ArchiveEntry {
+    u64 hash;
+    u64 offset;
+    /* bytes in the archive, and once decompressed */
+    u32 stored_size;
+    u32 size;
+    u32 flags;
+    u32 reserved;
+} ArchiveEntry;
+
+/* 64 bit FNV-1a of the name, with backslashes read as forward slashes so paths hash the same everywhere. */
+static inline u64 archive_hash(const char* name) {
+    u64 hash = 0xcbf29ce484222325ull;
+    for (; *name; ++name) {
+        hash ^= (u8)(*name == '\\' ? '/' : *name);
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
@@ -0,0 +1,78 @@
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#if defined(ZULK_DEBUG)
+static _Atomic(u64) heap_allocations;
+#endif
+
+void arena_init(Arena* arena, const char* name, usize capacity) {
+    arena->name = name;
+    arena->base = heap_alloc(capacity);
+    arena->capacity = capacity;
+    arena->offset = 0;
+    arena->high_water = 0;
+
+    if (arena->base == NULL) {
+        fprintf(stderr, "couldn't allocate %zu bytes for arena %s\n", capacity, name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void arena_destroy(Arena* arena) {
+    heap_free(arena->base);
+    *arena = (Arena) { 0 };
+}
+
+void* arena_alloc(Arena* arena, usize size, usize alignment) {
+    usize offset = (arena->offset + alignment - 1) & ~(alignment - 1);
+
+    if (offset + size > arena->capacity) {
+        fprintf(stderr, "arena %s is out of space: %zu bytes asked, %zu of %zu used\n", arena->name, size, arena->offset, arena->capacity);
+        exit(EXIT_FAILURE);
+    }
+
+    arena->offset = offset + size;
+    if (arena->offset > arena->high_water)
+        arena->high_water = arena->offset;
+
+    return arena->base + offset;
+}
+
+void* arena_calloc(Arena* arena, usize size, usize alignment) {
+    void* memory = arena_alloc(arena, size, alignment);
+    memset(memory, 0, size);
+
+    return memory;
+}
+
+void* heap_alloc(usize size) {
+#if defined(ZULK_DEBUG)
+    atomic_fetch_add_explicit(&heap_allocations, 1, memory_order_relaxed);
+#endif
+
+    return malloc(size);
+}
+
+void* heap_calloc(usize count, usize size) {
+#if defined(ZULK_DEBUG)
+    atomic_fetch_add_explicit(&heap_allocations, 1, memory_order_relaxed);
+#endif
+
+    return calloc(count, size);
+}
+
+void heap_free(void* memory) {
+    free(memory);
+}
+
+u64 heap_allocations_count(void) {
+#if defined(ZULK_DEBUG)
+    return atomic_load_explicit(&heap_allocations, memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Linear arena allocator.
+ *
+ * Allocating is a pointer bump and freeing is resetting the whole arena (or rewinding it to an earlier mark),
+ * so nothing allocated from an arena is freed individually. The renderer keeps one arena per frame in flight,
+ * reset once that frame's fence has signaled, and a persistent one for data that lives as long as it does.
+ */
+
+typedef struct Arena {
+    const char* name;
+
+    byte* base;
+    usize capacity;
+    usize offset;
+
+    /* the most that was ever in use, to size the capacity with */
+    usize high_water;
+} Arena;
+
+/* the backing memory is allocated once, here. */
+void arena_init(Arena* arena, const char* name, usize capacity);
+void arena_destroy(Arena* arena);
+
+/* never returns NULL; running out of space is fatal. the memory is not zeroed. */
+void* arena_alloc(Arena* arena, usize size, usize alignment);
+/* zeroed */
+void* arena_calloc(Arena* arena, usize size, usize alignment);
+
+#define ARENA_PUSH(arena, type, count) ((type*)arena_alloc((arena), sizeof(type) * (count), _Alignof(type)))
+#define ARENA_PUSH_ZERO(arena, type, count) ((type*)arena_calloc((arena), sizeof(type) * (count), _Alignof(type)))
+
+static inline usize arena_mark(Arena* arena) {
+    return arena->offset;
+}
+
+/* frees everything allocated after `mark` was taken. */
+static inline void arena_rewind(Arena* arena, usize mark) {
+    arena->offset = mark;
+}
+
+static inline void arena_reset(Arena* arena) {
+    arena->offset = 0;
+}
+
+/*
+ * General heap allocations. Renderer code goes through these instead of malloc()/free() so debug builds can
+ * count them; the frame loop asserts it makes none.
+ */
+void* heap_alloc(usize size);
+void* heap_calloc(usize count, usize size);
+void heap_free(void* memory);
+
+/* allocations made through heap_alloc()/heap_calloc() so far; always 0 in release builds. */
+u64 heap_allocations_count(void);
@@ -0,0 +1,623 @@
+#include "async_io.h"
+#include "thread.h"
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ZULK_LINUX)
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ZULK_IO_URING 1
+#endif
+#endif
+#endif
+
+#if !defined(ZULK_WIN32)
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#if defined(ZULK_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#endif
+
+/* the most one read is split into; the kernel caps a single read below 2 GiB anyway */
+#define ASYNC_IO_MAX_READ ((u64)1 << 30)
+#define ASYNC_IO_NO_SLOT UINT32_MAX
+
+typedef struct AsyncSlot {
+    AsyncRead read;
+    /* bytes read so far; a short read is submitted again for the rest */
+    u64 done;
+    s64 result;
+    /* the registered buffer the read goes into, or ASYNC_IO_NO_SLOT */
+    u32 registered;
+    /* the next free slot */
+    u32 next;
+} AsyncSlot;
+
+#if defined(ZULK_IO_URING)
+typedef struct IoUring {
+    int fd;
+
+    void* sq_ring;
+    usize sq_ring_size;
+    void* cq_ring;
+    usize cq_ring_size;
+    struct io_uring_sqe* sqes;
+    usize sqes_size;
+
+    u32* sq_head;
+    u32* sq_tail;
+    u32* sq_array;
+    u32 sq_mask;
+    u32 sq_entries;
+
+    u32* cq_head;
+    u32* cq_tail;
+    struct io_uring_cqe* cqes;
+    u32 cq_mask;
+
+    /* sqes written since the last io_uring_enter() */
+    u32 to_submit;
+} IoUring;
+#endif
+
+struct AsyncIo {
+    AsyncIoBackend backend;
+
+    u32 depth;
+    AsyncSlot* slots;
+    u32 free_slot;
+    u32 in_flight;
+
+    u32 registered_count;
+    byte* registered[ASYNC_IO_MAX_REGISTERED_BUFFERS];
+    u64 registered_sizes[ASYNC_IO_MAX_REGISTERED_BUFFERS];
+
+#if defined(ZULK_IO_URING)
+    IoUring ring;
+#endif
+
+    /* the threads: slots queued for them in `queue`, a ring of `depth`, and the ones they've read in `done` */
+    u32 thread_count;
+    Thread threads[ASYNC_IO_FALLBACK_THREADS];
+    Mutex mutex;
+    CondVar queued;
+    CondVar completed;
+    u32* queue;
+    u32 queue_first;
+    u32 queue_count;
+    u32* done;
+    u32 done_count;
+    bool quit;
+};
+
+#if defined(ZULK_WIN32)
+bool async_file_open(AsyncFile* file, const char* path) {
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(handle, &length)) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    file->handle = handle;
+    file->length = (u64)length.QuadPart;
+    return true;
+}
+
+void async_file_close(AsyncFile* file) {
+    CloseHandle(file->handle);
+}
+
+/* positional, so the threads can share a handle */
+static s64 async_read_at(const AsyncFile* file, byte* buffer, u64 size, u64 offset) {
+    u32 chunk = size < ASYNC_IO_MAX_READ ? (u32)size : (u32)ASYNC_IO_MAX_READ;
+
+    OVERLAPPED overlapped = { 0 };
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD read;
+    if (!ReadFile(file->handle, buffer, chunk, &read, &overlapped))
+        return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+
+    return read;
+}
+#else
+bool async_file_open(AsyncFile* file, const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        return false;
+    }
+
+    file->fd = fd;
+    file->length = info.st_size;
+    return true;
+}
+
+void async_file_close(AsyncFile* file) {
+    close(file->fd);
+}
+
+static s64 async_read_at(const AsyncFile* file, byte* buffer, u64 size, u64 offset) {
+    u64 chunk = size < ASYNC_IO_MAX_READ ? size : ASYNC_IO_MAX_READ;
+
+    ssize_t read;
+    do {
+        read = pread(file->fd, buffer, chunk, (off_t)offset);
+    } while (read == -1 && errno == EINTR);
+
+    return read;
+}
+#endif
+
+/* a read in the threads, until it's all there or the file ends */
+static s64 async_read_fully(const AsyncRead* read) {
+    u64 done = 0;
+    while (done < read->size) {
+        s64 result = async_read_at(read->file, (byte*)read->buffer + done, read->size - done, read->offset + done);
+        if (result < 0)
+            return -1;
+        if (result == 0)
+            break;
+
+        done += (u64)result;
+    }
+
+    return (s64)done;
+}
+
+static void async_io_thread(void* data) {
+    AsyncIo* io = data;
+
+    mutex_lock(&io->mutex);
+    for (;;) {
+        while (io->queue_count == 0 && !io->quit)
+            cond_wait(&io->queued, &io->mutex);
+        if (io->queue_count == 0)
+            break;
+
+        u32 index = io->queue[io->queue_first];
+        io->queue_first = (io->queue_first + 1) % io->depth;
+        --io->queue_count;
+        mutex_unlock(&io->mutex);
+
+        AsyncSlot* slot = &io->slots[index];
+        slot->result = async_read_fully(&slot->read);
+
+        mutex_lock(&io->mutex);
+        io->done[io->done_count++] = index;
+        cond_signal(&io->completed);
+    }
+    mutex_unlock(&io->mutex);
+}
+
+static void async_io_start_threads(AsyncIo* io) {
+    io->backend = ASYNC_IO_BACKEND_THREADS;
+
+    io->queue = heap_alloc(sizeof(u32) * io->depth);
+    io->done = heap_alloc(sizeof(u32) * io->depth);
+    io->queue_first = 0;
+    io->queue_count = 0;
+    io->done_count = 0;
+    io->quit = false;
+
+    mutex_init(&io->mutex);
+    cond_init(&io->queued);
+    cond_init(&io->completed);
+
+    io->thread_count = 0;
+    for (u32 i = 0; i < ASYNC_IO_FALLBACK_THREADS; ++i) {
+        if (!thread_create(&io->threads[io->thread_count], async_io_thread, io))
+            break;
+        ++io->thread_count;
+    }
+
+    if (io->thread_count == 0) {
+        fprintf(stderr, "couldn't start any I/O thread\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+#if defined(ZULK_IO_URING)
+static bool ring_create(IoUring* ring, u32 depth) {
+    struct io_uring_params params = { 0 };
+    int fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+    if (fd < 0)
+        return false;
+
+    /* IORING_OP_READ is 5.6, as is the probe; kernels without either get the threads */
+    usize probe_size = sizeof(struct io_uring_probe) + sizeof(struct io_uring_probe_op) * 256;
+    struct io_uring_probe* probe = heap_calloc(1, probe_size);
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) >= 0
+        && probe->last_op >= IORING_OP_READ
+        && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+        && (probe->ops[IORING_OP_READ_FIXED].flags & IO_URING_OP_SUPPORTED);
+    heap_free(probe);
+
+    if (!supported) {
+        close(fd);
+        return false;
+    }
+
+    *ring = (IoUring) { .fd = fd };
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    /* one mapping for both rings since 5.4 */
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = single_mmap ? ring->sq_ring : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->sqes != MAP_FAILED)
+            munmap(ring->sqes, ring->sqes_size);
+        if (!single_mmap && ring->cq_ring != MAP_FAILED)
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        if (ring->sq_ring != MAP_FAILED)
+            munmap(ring->sq_ring, ring->sq_ring_size);
+
+        close(fd);
+        return false;
+    }
+
+    byte* sq = ring->sq_ring;
+    ring->sq_head = (u32*)(sq + params.sq_off.head);
+    ring->sq_tail = (u32*)(sq + params.sq_off.tail);
+    ring->sq_array = (u32*)(sq + params.sq_off.array);
+    ring->sq_mask = *(u32*)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+
+    byte* cq = ring->cq_ring;
+    ring->cq_head = (u32*)(cq + params.cq_off.head);
+    ring->cq_tail = (u32*)(cq + params.cq_off.tail);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->cq_mask = *(u32*)(cq + params.cq_off.ring_mask);
+
+    return true;
+}
+
+static void ring_destroy(IoUring* ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+
+    close(ring->fd);
+}
+
+/* submits the sqes written so far and waits for `wait` completions. */
+static void ring_enter(IoUring* ring, u32 wait) {
+    for (;;) {
+        long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (submitted >= 0) {
+            /* the kernel takes the rest at the next enter */
+            ring->to_submit -= (u32)submitted;
+            return;
+        }
+
+        if (errno != EINTR && errno != EAGAIN) {
+            fprintf(stderr, "io_uring_enter failed (%s)\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/* writes an sqe for the rest of a slot's read. */
+static void ring_push(AsyncIo* io, u32 index) {
+    IoUring* ring = &io->ring;
+
+    /* every slot has an sqe to spare, so only resubmitted ones can find the ring full */
+    u32 tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == ring->sq_entries)
+        ring_enter(ring, 0);
+
+    const AsyncSlot* slot = &io->slots[index];
+    u64 rest = slot->read.size - slot->done;
+
+    u32 entry = tail & ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[entry];
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->opcode = slot->registered != ASYNC_IO_NO_SLOT ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = slot->read.file->fd;
+    sqe->off = slot->read.offset + slot->done;
+    sqe->addr = (u64)(uintptr_t)((byte*)slot->read.buffer + slot->done);
+    sqe->len = (u32)(rest < ASYNC_IO_MAX_READ ? rest : ASYNC_IO_MAX_READ);
+    sqe->buf_index = slot->registered != ASYNC_IO_NO_SLOT ? (u16)slot->registered : 0;
+    sqe->user_data = index;
+
+    ring->sq_array[entry] = entry;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++ring->to_submit;
+}
+
+/* takes a cqe; returns the slot it finished, or ASYNC_IO_NO_SLOT if there was none or the read continues. */
+static u32 ring_reap(AsyncIo* io) {
+    IoUring* ring = &io->ring;
+
+    u32 head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return ASYNC_IO_NO_SLOT;
+
+    struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    u32 index = (u32)cqe.user_data;
+    AsyncSlot* slot = &io->slots[index];
+
+    if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+        ring_push(io, index);
+        return ASYNC_IO_NO_SLOT;
+    }
+
+    if (cqe.res < 0) {
+        slot->result = -1;
+        return index;
+    }
+
+    slot->done += (u64)cqe.res;
+    if (cqe.res > 0 && slot->done < slot->read.size) {
+        ring_push(io, index);
+        return ASYNC_IO_NO_SLOT;
+    }
+
+    slot->result = (s64)slot->done;
+    return index;
+}
+#endif
+
+/* frees the slot before calling back, so the callback can submit more. */
+static void async_io_complete(AsyncIo* io, u32 index) {
+    AsyncSlot* slot = &io->slots[index];
+    AsyncRead read = slot->read;
+    s64 result = slot->result;
+
+    slot->next = io->free_slot;
+    io->free_slot = index;
+    --io->in_flight;
+
+    if (read.callback)
+        read.callback(read.user, &read, result);
+}
+
+/* hands what was queued over to the kernel or the threads. */
+static void async_io_flush(AsyncIo* io) {
+#if defined(ZULK_IO_URING)
+    if (io->backend == ASYNC_IO_BACKEND_IO_URING) {
+        if (io->ring.to_submit > 0)
+            ring_enter(&io->ring, 0);
+        return;
+    }
+#endif
+
+    mutex_lock(&io->mutex);
+    cond_broadcast(&io->queued);
+    mutex_unlock(&io->mutex);
+}
+
+/* calls back one read that has completed; if none has, waits for one with `block`, or returns false. */
+static bool async_io_next(AsyncIo* io, bool block) {
+#if defined(ZULK_IO_URING)
+    if (io->backend == ASYNC_IO_BACKEND_IO_URING) {
+        for (;;) {
+            u32 index = ring_reap(io);
+            if (index != ASYNC_IO_NO_SLOT) {
+                async_io_complete(io, index);
+                return true;
+            }
+
+            /* reaping can have resubmitted something */
+            if (*io->ring.cq_head != __atomic_load_n(io->ring.cq_tail, __ATOMIC_ACQUIRE))
+                continue;
+
+            if (!block) {
+                async_io_flush(io);
+                return false;
+            }
+
+            ring_enter(&io->ring, 1);
+        }
+    }
+#endif
+
+    if (block)
+        async_io_flush(io);
+
+    mutex_lock(&io->mutex);
+    while (block && io->done_count == 0)
+        cond_wait(&io->completed, &io->mutex);
+
+    if (io->done_count == 0) {
+        mutex_unlock(&io->mutex);
+        return false;
+    }
+
+    u32 index = io->done[--io->done_count];
+    mutex_unlock(&io->mutex);
+
+    async_io_complete(io, index);
+    return true;
+}
+
+AsyncIo* async_io_create(u32 depth, bool threads_only) {
+    if (depth == 0)
+        depth = ASYNC_IO_DEFAULT_DEPTH;
+    if (depth > ASYNC_IO_MAX_DEPTH)
+        depth = ASYNC_IO_MAX_DEPTH;
+
+    AsyncIo* io = heap_calloc(1, sizeof(AsyncIo));
+    io->depth = depth;
+    io->slots = heap_alloc(sizeof(AsyncSlot) * depth);
+
+    for (u32 i = 0; i < depth; ++i)
+        io->slots[i].next = i + 1 < depth ? i + 1 : ASYNC_IO_NO_SLOT;
+    io->free_slot = 0;
+
+#if defined(ZULK_IO_URING)
+    if (!threads_only && ring_create(&io->ring, depth)) {
+        io->backend = ASYNC_IO_BACKEND_IO_URING;
+        return io;
+    }
+#endif
+
+    async_io_start_threads(io);
+    return io;
+}
+
+void async_io_destroy(AsyncIo* io) {
+    async_io_wait(io);
+
+#if defined(ZULK_IO_URING)
+    if (io->backend == ASYNC_IO_BACKEND_IO_URING)
+        ring_destroy(&io->ring);
+#endif
+
+    if (io->backend == ASYNC_IO_BACKEND_THREADS) {
+        mutex_lock(&io->mutex);
+        io->quit = true;
+        cond_broadcast(&io->queued);
+        mutex_unlock(&io->mutex);
+
+        for (u32 i = 0; i < io->thread_count; ++i)
+            thread_join(io->threads[i]);
+
+        cond_destroy(&io->completed);
+        cond_destroy(&io->queued);
+        mutex_destroy(&io->mutex);
+
+        heap_free(io->done);
+        heap_free(io->queue);
+    }
+
+    heap_free(io->slots);
+    heap_free(io);
+}
+
+AsyncIoBackend async_io_backend(const AsyncIo* io) {
+    return io->backend;
+}
+
+bool async_io_register_buffers(AsyncIo* io, void* const* buffers, const u64* sizes, u32 count) {
+    async_io_wait(io);
+
+    /* the threads read into any memory the same */
+    if (io->backend != ASYNC_IO_BACKEND_IO_URING)
+        return true;
+
+#if defined(ZULK_IO_URING)
+    if (io->registered_count > 0)
+        syscall(__NR_io_uring_register, io->ring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    io->registered_count = 0;
+
+    if (count == 0)
+        return true;
+    if (count > ASYNC_IO_MAX_REGISTERED_BUFFERS)
+        return false;
+
+    struct iovec iovecs[ASYNC_IO_MAX_REGISTERED_BUFFERS];
+    for (u32 i = 0; i < count; ++i) {
+        /* the kernel refuses larger ones */
+        if (sizes[i] > ASYNC_IO_MAX_READ)
+            return false;
+
+        iovecs[i] = (struct iovec) { .iov_base = buffers[i], .iov_len = sizes[i] };
+    }
+
+    if (syscall(__NR_io_uring_register, io->ring.fd, IORING_REGISTER_BUFFERS, iovecs, count) < 0)
+        return false;
+
+    for (u32 i = 0; i < count; ++i) {
+        io->registered[i] = buffers[i];
+        io->registered_sizes[i] = sizes[i];
+    }
+    io->registered_count = count;
+#endif
+
+    return true;
+}
+
+/* the registered buffer the whole read goes into, or ASYNC_IO_NO_SLOT. */
+static u32 async_io_find_registered(const AsyncIo* io, const AsyncRead* read) {
+    const byte* buffer = read->buffer;
+    for (u32 i = 0; i < io->registered_count; ++i) {
+        if (buffer >= io->registered[i] && read->size <= io->registered_sizes[i] - (u64)(buffer - io->registered[i]))
+            return i;
+    }
+
+    return ASYNC_IO_NO_SLOT;
+}
+
+void async_io_submit(AsyncIo* io, const AsyncRead* reads, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        while (io->free_slot == ASYNC_IO_NO_SLOT)
+            async_io_next(io, true);
+
+        u32 index = io->free_slot;
+        AsyncSlot* slot = &io->slots[index];
+        io->free_slot = slot->next;
+        ++io->in_flight;
+
+        *slot = (AsyncSlot) {
+            .read = reads[i],
+            .registered = async_io_find_registered(io, &reads[i]),
+            .next = ASYNC_IO_NO_SLOT,
+        };
+
+#if defined(ZULK_IO_URING)
+        if (io->backend == ASYNC_IO_BACKEND_IO_URING) {
+            ring_push(io, index);
+            continue;
+        }
+#endif
+
+        mutex_lock(&io->mutex);
+        io->queue[(io->queue_first + io->queue_count) % io->depth] = index;
+        ++io->queue_count;
+        mutex_unlock(&io->mutex);
+    }
+
+    async_io_flush(io);
+}
+
+u32 async_io_poll(AsyncIo* io) {
+    u32 completed = 0;
+    while (async_io_next(io, false))
+        ++completed;
+
+    return completed;
+}
+
+void async_io_wait(AsyncIo* io) {
+    while (io->in_flight > 0)
+        async_io_next(io, true);
+}
+
+u32 async_io_in_flight(const AsyncIo* io) {
+    return io->in_flight;
+}
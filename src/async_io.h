@@ -0,0 +1,88 @@
+#pragma once
+
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ * Asynchronous file reads.
+ *
+ * Where file_view_open() maps a file and leaves the calling thread to fault its pages in one at a time, this
+ * queues positional reads into the caller's memory and keeps many of them in flight at once, which is what it
+ * takes for an NVMe drive to reach its bandwidth. On Linux the reads go through an io_uring: a batch of them is
+ * one system call, and reads into buffers registered up front skip pinning the pages on every read. Elsewhere,
+ * or where io_uring is unavailable (old kernels, seccomp filters), a few threads make blocking reads instead.
+ *
+ * Completion callbacks always run on the thread calling async_io_poll(), async_io_wait() or async_io_submit(),
+ * never on another one, so an AsyncIo belongs to one thread.
+ */
+
+/* reads in flight at most, when created with 0 */
+#define ASYNC_IO_DEFAULT_DEPTH (u32)64
+#define ASYNC_IO_MAX_DEPTH (u32)4096
+#define ASYNC_IO_MAX_REGISTERED_BUFFERS (u32)16
+/* threads of the fallback */
+#define ASYNC_IO_FALLBACK_THREADS (u32)4
+
+typedef enum AsyncIoBackend {
+    ASYNC_IO_BACKEND_IO_URING,
+    ASYNC_IO_BACKEND_THREADS,
+} AsyncIoBackend;
+
+typedef struct AsyncIo AsyncIo;
+
+typedef struct AsyncFile {
+    u64 length;
+#if defined(ZULK_WIN32)
+    void* handle;
+#else
+    int fd;
+#endif
+} AsyncFile;
+
+typedef struct AsyncRead AsyncRead;
+
+/* `result` is the number of bytes read, less than asked for only at the end of the file, or -1 on an error. */
+typedef void (*AsyncIoCallback)(void* user, const AsyncRead* read, s64 result);
+
+typedef struct AsyncRead {
+    const AsyncFile* file;
+    u64 offset;
+    u64 size;
+    /* the caller's memory, which must stay alive until the callback; if it lies inside a registered buffer, the
+     * read uses the registration */
+    void* buffer;
+
+    AsyncIoCallback callback;
+    void* user;
+} AsyncRead;
+
+/* returns false if the file can't be opened. */
+bool async_file_open(AsyncFile* file, const char* path);
+/* no reads of the file may be in flight. */
+void async_file_close(AsyncFile* file);
+
+/* `depth` reads in flight at most, 0 for ASYNC_IO_DEFAULT_DEPTH; `threads_only` skips io_uring. never returns
+ * NULL, falling back to threads if the io_uring can't be made. */
+AsyncIo* async_io_create(u32 depth, bool threads_only);
+/* waits for the reads still in flight, running their callbacks. */
+void async_io_destroy(AsyncIo* io);
+
+AsyncIoBackend async_io_backend(const AsyncIo* io);
+
+/* registers memory that reads go into many times, such as a staging buffer, replacing what was registered
+ * before; waits for the reads in flight first. returns false if it can't be, reads into it still work then. */
+bool async_io_register_buffers(AsyncIo* io, void* const* buffers, const u64* sizes, u32 count);
+
+/* queues the reads, submitting them together. if more are queued than fit in flight, this waits for earlier
+ * ones to complete, so callbacks can run in here. the AsyncReads are copied and needn't outlive the call. */
+void async_io_submit(AsyncIo* io, const AsyncRead* reads, u32 count);
+
+/* runs the callbacks of the reads that have completed, without waiting; returns how many. */
+u32 async_io_poll(AsyncIo* io);
+
+/* runs callbacks until every read submitted so far has completed. */
+void async_io_wait(AsyncIo* io);
+
+/* reads submitted and not yet called back. */
+u32 async_io_in_flight(const AsyncIo* io);
@@ -0,0 +1,60 @@
+#include "atlas.h"
+
+/* shelves taller than this many times the rectangle aren't reused for it, too much would go to waste */
+#define ATLAS_MAX_SHELF_WASTE 2
+
+void atlas_init(AtlasPacker* packer, u16 width, u16 height, u16 padding) {
+    packer->width = width;
+    packer->height = height;
+    packer->padding = padding;
+    packer->shelves_count = 0;
+}
+
+void atlas_clear(AtlasPacker* packer) {
+    packer->shelves_count = 0;
+}
+
+bool atlas_pack(AtlasPacker* packer, u16 width, u16 height, AtlasRect* rect) {
+    u32 padded_width = (u32)width + packer->padding;
+    u32 padded_height = (u32)height + packer->padding;
+
+    if (padded_width > packer->width || padded_height > packer->height)
+        return false;
+
+    AtlasShelf* best = NULL;
+    for (u32 i = 0; i < packer->shelves_count; ++i) {
+        AtlasShelf* shelf = &packer->shelves[i];
+
+        if (shelf->height < padded_height || shelf->height > padded_height * ATLAS_MAX_SHELF_WASTE)
+            continue;
+        if (shelf->cursor + padded_width > packer->width)
+            continue;
+
+        if (best == NULL || shelf->height < best->height)
+            best = shelf;
+    }
+
+    if (best == NULL) {
+        u32 y = 0;
+        if (packer->shelves_count > 0) {
+            AtlasShelf* last = &packer->shelves[packer->shelves_count - 1];
+            y = last->y + last->height;
+        }
+
+        if (y + padded_height > packer->height || packer->shelves_count == ATLAS_MAX_SHELVES)
+            return false;
+
+        best = &packer->shelves[packer->shelves_count++];
+        best->y = (u16)y;
+        best->height = (u16)padded_height;
+        best->cursor = 0;
+    }
+
+    rect->x = best->cursor;
+    rect->y = best->y;
+    rect->width = width;
+    rect->height = height;
+
+    best->cursor += (u16)padded_width;
+    return true;
+}
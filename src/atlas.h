@@ -0,0 +1,47 @@
+#pragma once
+
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ * Shelf rectangle packer.
+ *
+ * The page is cut into horizontal shelves as tall as the first rectangle put on them. A rectangle goes onto
+ * the shelf that wastes the least height while still having room left on its right, or opens a new shelf
+ * below the last one. Packing is O(shelves) and nothing is ever freed individually, which suits sprite
+ * sheets and glyphs: images of similar heights that live as long as the atlas does.
+ */
+
+#define ATLAS_MAX_SHELVES (u32)256
+
+typedef struct AtlasRect {
+    u16 x, y;
+    u16 width, height;
+} AtlasRect;
+
+typedef struct AtlasShelf {
+    u16 y;
+    u16 height;
+    /* where the next rectangle on the shelf goes */
+    u16 cursor;
+} AtlasShelf;
+
+typedef struct AtlasPacker {
+    u16 width;
+    u16 height;
+
+    /* pixels left empty around every rectangle, so filtering doesn't bleed neighbours in */
+    u16 padding;
+
+    u32 shelves_count;
+    AtlasShelf shelves[ATLAS_MAX_SHELVES];
+} AtlasPacker;
+
+void atlas_init(AtlasPacker* packer, u16 width, u16 height, u16 padding);
+
+/* returns false if the rectangle doesn't fit anymore. */
+bool atlas_pack(AtlasPacker* packer, u16 width, u16 height, AtlasRect* rect);
+
+/* forgets every rectangle. */
+void atlas_clear(AtlasPacker* packer);
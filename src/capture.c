@@ -0,0 +1,476 @@
+#include "capture.h"
+#include "renderer_internal.h"
+#include "gpu_memory.h"
+#include "arena.h"
+#include "thread.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the worker encodes into this and flushes it to the file whenever it fills up */
+#define CAPTURE_CHUNK_SIZE ((usize)64 << 10)
+
+#define CAPTURE_MAX_PATH (u32)512
+
+enum CaptureSlotState {
+    CAPTURE_SLOT_FREE,
+    /* a copy into it is recorded, the GPU may not have run it yet */
+    CAPTURE_SLOT_RECORDED,
+    /* owned by the worker */
+    CAPTURE_SLOT_QUEUED,
+};
+
+typedef struct CaptureSlot {
+    VkBuffer buffer;
+    GpuAllocation memory;
+    const u8* mapped;
+
+    enum CaptureSlotState state;
+    u32 frame_in_flight;
+    u64 frame_number;
+} CaptureSlot;
+
+/* buffered output the encoders write through */
+typedef struct CaptureOutput {
+    FILE* file;
+    usize length;
+    u8 chunk[CAPTURE_CHUNK_SIZE];
+} CaptureOutput;
+
+struct Capture {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_props;
+
+    enum GraphicsCaptureFormat format;
+    char path[CAPTURE_MAX_PATH];
+    /* raw frames all go into this one, which may as well be a pipe */
+    FILE* raw_file;
+
+    u32 frames_requested;
+    u64 frames_recorded;
+    u32 frames_dropped;
+
+    VkExtent2D extent;
+    bool bgra;
+    bool coherent;
+
+    CaptureSlot slots[CAPTURE_SLOTS];
+
+    /* guards the slot states and the queue */
+    Mutex mutex;
+    CondVar work_cond;
+    CondVar idle_cond;
+
+    u32 queue[CAPTURE_SLOTS];
+    u32 queue_head;
+    u32 queue_count;
+    bool writing;
+    bool quit;
+
+    Thread worker;
+    CaptureOutput output;
+};
+
+static void capture_output_flush(CaptureOutput* out) {
+    if (out->length > 0)
+        fwrite(out->chunk, 1, out->length, out->file);
+
+    out->length = 0;
+}
+
+static inline void capture_output_byte(CaptureOutput* out, u8 value) {
+    if (out->length == CAPTURE_CHUNK_SIZE)
+        capture_output_flush(out);
+
+    out->chunk[out->length++] = value;
+}
+
+static void capture_output_u32_be(CaptureOutput* out, u32 value) {
+    capture_output_byte(out, value >> 24);
+    capture_output_byte(out, value >> 16);
+    capture_output_byte(out, value >> 8);
+    capture_output_byte(out, value);
+}
+
+typedef union CapturePixel {
+    struct { u8 r, g, b, a; };
+    u32 value;
+} CapturePixel;
+
+static inline CapturePixel capture_read_pixel(const Capture* capture, const u8* p) {
+    /* alpha is forced opaque, the swapchain is composited that way anyway */
+    if (capture->bgra)
+        return (CapturePixel) { .r = p[2], .g = p[1], .b = p[0], .a = 255 };
+
+    return (CapturePixel) { .r = p[0], .g = p[1], .b = p[2], .a = 255 };
+}
+
+static void capture_write_raw(Capture* capture, const u8* pixels) {
+    CaptureOutput* out = &capture->output;
+    out->file = capture->raw_file;
+
+    usize count = (usize)capture->extent.width * capture->extent.height;
+    for (usize i = 0; i < count; ++i) {
+        CapturePixel px = capture_read_pixel(capture, pixels + i * 4);
+
+        capture_output_byte(out, px.r);
+        capture_output_byte(out, px.g);
+        capture_output_byte(out, px.b);
+        capture_output_byte(out, px.a);
+    }
+
+    capture_output_flush(out);
+    fflush(out->file);
+}
+
+/* see https://qoiformat.org/qoi-specification.pdf */
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+
+static inline u32 qoi_hash(CapturePixel px) {
+    return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+}
+
+static void capture_write_qoi(Capture* capture, const u8* pixels, const char* path) {
+    CaptureOutput* out = &capture->output;
+    out->file = fopen(path, "wb");
+    if (out->file == NULL) {
+        fprintf(stderr, "capture: couldn't open %s\n", path);
+        return;
+    }
+
+    capture_output_byte(out, 'q');
+    capture_output_byte(out, 'o');
+    capture_output_byte(out, 'i');
+    capture_output_byte(out, 'f');
+    capture_output_u32_be(out, capture->extent.width);
+    capture_output_u32_be(out, capture->extent.height);
+    capture_output_byte(out, 3);
+    capture_output_byte(out, 0);
+
+    CapturePixel index[64] = { 0 };
+    CapturePixel prev = { .a = 255 };
+    u32 run = 0;
+
+    usize count = (usize)capture->extent.width * capture->extent.height;
+    for (usize i = 0; i < count; ++i) {
+        CapturePixel px = capture_read_pixel(capture, pixels + i * 4);
+
+        if (px.value == prev.value) {
+            run++;
+            if (run == 62 || i == count - 1) {
+                capture_output_byte(out, QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            continue;
+        }
+
+        if (run > 0) {
+            capture_output_byte(out, QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        u32 hash = qoi_hash(px);
+        if (index[hash].value == px.value) {
+            capture_output_byte(out, QOI_OP_INDEX | hash);
+        } else {
+            index[hash] = px;
+
+            s32 dr = (s8)(px.r - prev.r);
+            s32 dg = (s8)(px.g - prev.g);
+            s32 db = (s8)(px.b - prev.b);
+            s32 dr_dg = dr - dg;
+            s32 db_dg = db - dg;
+
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                capture_output_byte(out, QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+            } else if (dr_dg >= -8 && dr_dg <= 7 && dg >= -32 && dg <= 31 && db_dg >= -8 && db_dg <= 7) {
+                capture_output_byte(out, QOI_OP_LUMA | (dg + 32));
+                capture_output_byte(out, (dr_dg + 8) << 4 | (db_dg + 8));
+            } else {
+                capture_output_byte(out, QOI_OP_RGB);
+                capture_output_byte(out, px.r);
+                capture_output_byte(out, px.g);
+                capture_output_byte(out, px.b);
+            }
+        }
+
+        prev = px;
+    }
+
+    for (u32 i = 0; i < 7; ++i)
+        capture_output_byte(out, 0);
+    capture_output_byte(out, 1);
+
+    capture_output_flush(out);
+    fclose(out->file);
+}
+
+static void capture_write(Capture* capture, CaptureSlot* slot) {
+    TRACE_FUNCTION();
+
+    if (capture->format == GRAPHICS_CAPTURE_RAW) {
+        capture_write_raw(capture, slot->mapped);
+        return;
+    }
+
+    /* a single frame goes exactly where asked, a sequence gets numbered */
+    char path[CAPTURE_MAX_PATH + 32];
+    if (capture->frames_requested == 1)
+        snprintf(path, sizeof(path), "%s", capture->path);
+    else
+        snprintf(path, sizeof(path), "%s%06llu.qoi", capture->path, (unsigned long long)slot->frame_number);
+
+    capture_write_qoi(capture, slot->mapped, path);
+}
+
+static void capture_worker(void* data) {
+    Capture* capture = data;
+    TRACE_THREAD_NAME("capture");
+
+    mutex_lock(&capture->mutex);
+    for (;;) {
+        while (capture->queue_count == 0 && !capture->quit)
+            cond_wait(&capture->work_cond, &capture->mutex);
+
+        if (capture->queue_count == 0)
+            break;
+
+        CaptureSlot* slot = &capture->slots[capture->queue[capture->queue_head]];
+        capture->queue_head = (capture->queue_head + 1) % CAPTURE_SLOTS;
+        capture->queue_count--;
+        capture->writing = true;
+
+        mutex_unlock(&capture->mutex);
+        capture_write(capture, slot);
+        mutex_lock(&capture->mutex);
+
+        slot->state = CAPTURE_SLOT_FREE;
+        capture->writing = false;
+        cond_broadcast(&capture->idle_cond);
+    }
+    mutex_unlock(&capture->mutex);
+}
+
+/* hands every recorded slot to the worker and waits until it has written them all. */
+static void capture_drain(Capture* capture) {
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        capture_frame_done(capture, i);
+
+    mutex_lock(&capture->mutex);
+    while (capture->queue_count > 0 || capture->writing)
+        cond_wait(&capture->idle_cond, &capture->mutex);
+    mutex_unlock(&capture->mutex);
+}
+
+static void capture_free_slots(Capture* capture) {
+    for (u32 i = 0; i < CAPTURE_SLOTS; ++i) {
+        CaptureSlot* slot = &capture->slots[i];
+        if (slot->buffer == VK_NULL_HANDLE)
+            continue;
+
+        vkUnmapMemory(capture->device, slot->memory.memory);
+        vkDestroyBuffer(capture->device, slot->buffer, NULL);
+        gpu_memory_free(capture->device, &slot->memory);
+
+        *slot = (CaptureSlot) { 0 };
+    }
+}
+
+Capture* capture_create(VkDevice device, const VkPhysicalDeviceMemoryProperties* memory_props, const char* path, enum GraphicsCaptureFormat format, u32 frames) {
+    Capture* capture = heap_calloc(1, sizeof(Capture));
+    capture->device = device;
+    capture->memory_props = *memory_props;
+    capture->format = format;
+    capture->frames_requested = frames;
+    snprintf(capture->path, sizeof(capture->path), "%s", path);
+
+    if (format == GRAPHICS_CAPTURE_RAW) {
+        capture->raw_file = fopen(path, "wb");
+        if (capture->raw_file == NULL) {
+            fprintf(stderr, "capture: couldn't open %s\n", path);
+            heap_free(capture);
+            return NULL;
+        }
+    }
+
+    mutex_init(&capture->mutex);
+    cond_init(&capture->work_cond);
+    cond_init(&capture->idle_cond);
+
+    if (!thread_create(&capture->worker, capture_worker, capture)) {
+        fprintf(stderr, "capture: couldn't start the worker thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return capture;
+}
+
+void capture_destroy(Capture* capture) {
+    capture_drain(capture);
+
+    mutex_lock(&capture->mutex);
+    capture->quit = true;
+    cond_signal(&capture->work_cond);
+    mutex_unlock(&capture->mutex);
+
+    thread_join(capture->worker);
+
+    capture_free_slots(capture);
+
+    if (capture->raw_file)
+        fclose(capture->raw_file);
+
+    if (capture->frames_dropped > 0)
+        printf("capture: dropped %u of %llu frames\n", capture->frames_dropped, (unsigned long long)(capture->frames_recorded + capture->frames_dropped));
+
+    cond_destroy(&capture->idle_cond);
+    cond_destroy(&capture->work_cond);
+    mutex_destroy(&capture->mutex);
+    heap_free(capture);
+}
+
+bool capture_resize(Capture* capture, VkExtent2D extent, VkFormat format) {
+    capture_drain(capture);
+    capture_free_slots(capture);
+
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            capture->bgra = false;
+            break;
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            capture->bgra = true;
+            break;
+        default:
+            fprintf(stderr, "capture: can't capture images of format %d\n", format);
+            return false;
+    }
+
+    capture->extent = extent;
+
+    for (u32 i = 0; i < CAPTURE_SLOTS; ++i) {
+        CaptureSlot* slot = &capture->slots[i];
+
+        VkBufferCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = (VkDeviceSize)extent.width * extent.height * 4,
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+
+        ERR_CHECK(vkCreateBuffer(capture->device, &info, NULL, &slot->buffer), "capture readback buffer");
+
+        VkMemoryRequirements reqs;
+        vkGetBufferMemoryRequirements(capture->device, slot->buffer, &reqs);
+
+        /* the worker reads every byte, so cached memory is worth a lot here */
+        slot->memory = gpu_memory_allocate(capture->device, &capture->memory_props, &reqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, GRAPHICS_MEMORY_STAGING);
+        if (slot->memory.memory == VK_NULL_HANDLE) {
+            fprintf(stderr, "capture: couldn't allocate readback memory\n");
+            vkDestroyBuffer(capture->device, slot->buffer, NULL);
+            slot->buffer = VK_NULL_HANDLE;
+            capture_free_slots(capture);
+            return false;
+        }
+
+        ERR_CHECK(vkBindBufferMemory(capture->device, slot->buffer, slot->memory.memory, 0), "capture readback buffer binding");
+
+        void* mapped;
+        ERR_CHECK(vkMapMemory(capture->device, slot->memory.memory, 0, VK_WHOLE_SIZE, 0, &mapped), "capture readback mapping");
+        slot->mapped = mapped;
+    }
+
+    capture->coherent = capture->memory_props.memoryTypes[capture->slots[0].memory.type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    return true;
+}
+
+bool capture_record(Capture* capture, VkCommandBuffer command_buffer, VkImage image, u32 frame_in_flight) {
+    if (capture->slots[0].buffer == VK_NULL_HANDLE || capture_is_complete(capture))
+        return false;
+
+    CaptureSlot* slot = NULL;
+
+    mutex_lock(&capture->mutex);
+    for (u32 i = 0; i < CAPTURE_SLOTS && slot == NULL; ++i) {
+        if (capture->slots[i].state == CAPTURE_SLOT_FREE)
+            slot = &capture->slots[i];
+    }
+
+    if (slot)
+        slot->state = CAPTURE_SLOT_RECORDED;
+    mutex_unlock(&capture->mutex);
+
+    if (slot == NULL) {
+        capture->frames_dropped++;
+        return false;
+    }
+
+    slot->frame_in_flight = frame_in_flight;
+    slot->frame_number = capture->frames_recorded++;
+
+    VkBufferImageCopy region = {
+        .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .imageExtent = { capture->extent.width, capture->extent.height, 1 },
+    };
+
+    vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+    /* a fence wait alone doesn't make device writes visible to the host */
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    });
+
+    return true;
+}
+
+void capture_frame_done(Capture* capture, u32 frame_in_flight) {
+    mutex_lock(&capture->mutex);
+
+    for (u32 i = 0; i < CAPTURE_SLOTS; ++i) {
+        CaptureSlot* slot = &capture->slots[i];
+        if (slot->state != CAPTURE_SLOT_RECORDED || slot->frame_in_flight != frame_in_flight)
+            continue;
+
+        if (!capture->coherent) {
+            VkMappedMemoryRange range = {
+                .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                .memory = slot->memory.memory,
+                .size = VK_WHOLE_SIZE,
+            };
+            vkInvalidateMappedMemoryRanges(capture->device, 1, &range);
+        }
+
+        slot->state = CAPTURE_SLOT_QUEUED;
+        capture->queue[(capture->queue_head + capture->queue_count) % CAPTURE_SLOTS] = i;
+        capture->queue_count++;
+    }
+
+    cond_signal(&capture->work_cond);
+    mutex_unlock(&capture->mutex);
+}
+
+bool capture_is_complete(Capture* capture) {
+    return capture->frames_requested > 0 && capture->frames_recorded >= capture->frames_requested;
+}
+
+u32 capture_dropped_frames(Capture* capture) {
+    return capture->frames_dropped;
+}
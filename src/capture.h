@@ -0,0 +1,39 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+
+#include <stdbool.h>
+#include <volk.h>
+
+/*
+ * Frame capture.
+ *
+ * Rendered images are copied into a small ring of host visible readback buffers. Once the frame that copied
+ * into a buffer has finished on the GPU, the buffer goes to a worker thread that writes or encodes it and
+ * then gives it back. Nothing ever waits for the GPU; when every buffer is busy the frame just isn't captured.
+ */
+
+#define CAPTURE_SLOTS (u32)4
+
+typedef struct Capture Capture;
+
+/* `frames` is how many frames to capture, 0 meaning until destroyed. returns NULL if the output can't be opened. */
+Capture* capture_create(VkDevice device, const VkPhysicalDeviceMemoryProperties* memory_props, const char* path, enum GraphicsCaptureFormat format, u32 frames);
+/* writes out everything already captured first. the device must be idle. */
+void capture_destroy(Capture* capture);
+
+/* (re)creates the readback buffers for images of this size and format. the device must be idle.
+ * returns false if the format can't be captured (only 8 bit RGBA/BGRA can). */
+bool capture_resize(Capture* capture, VkExtent2D extent, VkFormat format);
+
+/* records a copy of `image`, which must be in TRANSFER_SRC_OPTIMAL layout. returns false if the frame was dropped. */
+bool capture_record(Capture* capture, VkCommandBuffer command_buffer, VkImage image, u32 frame_in_flight);
+
+/* call once the fence of `frame_in_flight` has signaled; its copies go to the worker. */
+void capture_frame_done(Capture* capture, u32 frame_in_flight);
+
+/* every requested frame has been recorded and handed to the worker */
+bool capture_is_complete(Capture* capture);
+
+u32 capture_dropped_frames(Capture* capture);
@@ -0,0 +1,145 @@
+#include "command_stream.h"
+#include "thread.h"
+#include "arena.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct CommandStream {
+    byte* buffers[2];
+    usize sizes[2];
+
+    /* writer state: the buffer being written, and whether it overflowed since the stream was created */
+    u32 writing;
+    bool overflowed;
+
+    Mutex mutex;
+    CondVar changed;
+    /* the buffer submitted and not taken yet and the one being played back, -1 for none */
+    s32 submitted;
+    s32 playing;
+    bool closed;
+};
+
+static inline u32 command_stream_padded(u32 size) {
+    return (size + 7) & ~(u32)7;
+}
+
+CommandStream* command_stream_create(void) {
+    CommandStream* stream = heap_calloc(1, sizeof(CommandStream));
+
+    for (u32 i = 0; i < 2; ++i)
+        stream->buffers[i] = heap_alloc(COMMAND_STREAM_SIZE);
+
+    stream->submitted = -1;
+    stream->playing = -1;
+    mutex_init(&stream->mutex);
+    cond_init(&stream->changed);
+
+    return stream;
+}
+
+void command_stream_destroy(CommandStream* stream) {
+    cond_destroy(&stream->changed);
+    mutex_destroy(&stream->mutex);
+
+    for (u32 i = 0; i < 2; ++i)
+        heap_free(stream->buffers[i]);
+
+    heap_free(stream);
+}
+
+void command_stream_write(CommandStream* stream, enum RecordingCommandType type, const void* payload, u32 size) {
+    usize length = sizeof(RecordingCommand) + command_stream_padded(size);
+    usize offset = stream->sizes[stream->writing];
+
+    if (offset + length > COMMAND_STREAM_SIZE) {
+        if (!stream->overflowed)
+            fprintf(stderr, "command stream: a frame's commands don't fit in %zu bytes, dropping the rest\n", COMMAND_STREAM_SIZE);
+
+        stream->overflowed = true;
+        return;
+    }
+
+    byte* at = stream->buffers[stream->writing] + offset;
+
+    RecordingCommand command = { .type = type, .size = size };
+    memcpy(at, &command, sizeof(command));
+    memcpy(at + sizeof(command), payload, size);
+
+    stream->sizes[stream->writing] = offset + length;
+}
+
+void command_stream_submit(CommandStream* stream) {
+    TRACE_FUNCTION();
+
+    u32 next = stream->writing ^ 1;
+
+    mutex_lock(&stream->mutex);
+
+    /* the render thread is a frame behind; it hasn't taken the last buffer yet */
+    while (stream->submitted != -1 && !stream->closed)
+        cond_wait(&stream->changed, &stream->mutex);
+
+    stream->submitted = (s32)stream->writing;
+    cond_broadcast(&stream->changed);
+
+    while (stream->playing == (s32)next && !stream->closed)
+        cond_wait(&stream->changed, &stream->mutex);
+
+    mutex_unlock(&stream->mutex);
+
+    stream->writing = next;
+    stream->sizes[next] = 0;
+}
+
+bool command_stream_acquire(CommandStream* stream, const byte** commands, usize* size) {
+    TRACE_FUNCTION();
+
+    mutex_lock(&stream->mutex);
+
+    while (stream->submitted == -1 && !stream->closed)
+        cond_wait(&stream->changed, &stream->mutex);
+
+    /* closed, and everything submitted before was played back */
+    if (stream->submitted == -1) {
+        mutex_unlock(&stream->mutex);
+        return false;
+    }
+
+    stream->playing = stream->submitted;
+    stream->submitted = -1;
+    cond_broadcast(&stream->changed);
+
+    mutex_unlock(&stream->mutex);
+
+    *commands = stream->buffers[stream->playing];
+    *size = stream->sizes[stream->playing];
+    return true;
+}
+
+void command_stream_release(CommandStream* stream) {
+    mutex_lock(&stream->mutex);
+    stream->playing = -1;
+    cond_broadcast(&stream->changed);
+    mutex_unlock(&stream->mutex);
+}
+
+void command_stream_close(CommandStream* stream) {
+    mutex_lock(&stream->mutex);
+    stream->closed = true;
+    cond_broadcast(&stream->changed);
+    mutex_unlock(&stream->mutex);
+}
+
+const RecordingCommand* command_stream_next(const byte* commands, usize size, usize* offset, const void** payload) {
+    if (*offset + sizeof(RecordingCommand) > size)
+        return NULL;
+
+    const RecordingCommand* command = (const RecordingCommand*)(commands + *offset);
+    *payload = command + 1;
+    *offset += sizeof(RecordingCommand) + command_stream_padded(command->size);
+
+    return command;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h"
+#include "recording.h"
+
+#include <stdbool.h>
+
+/*
+ * Double-buffered render command stream.
+ *
+ * With GraphicsConfiguration.render_thread, the public API doesn't touch the renderer from the simulation thread
+ * but writes what it was asked for into one buffer of this stream, as packets in the recording format (a
+ * RecordingCommand and its payload, 8 byte aligned), while the render thread plays the other buffer back through
+ * graphics_replay_command() and renders it. Writing a packet is a copy into memory only the writer owns; the two
+ * threads synchronize once a frame, when command_stream_submit() swaps the buffers, and only wait there if one
+ * of them is a whole frame ahead.
+ */
+
+/* per buffer; packets that don't fit are dropped until the next frame */
+#define COMMAND_STREAM_SIZE ((usize)8 << 20)
+
+typedef struct CommandStream CommandStream;
+
+CommandStream* command_stream_create(void);
+void command_stream_destroy(CommandStream* stream);
+
+/* writer side. */
+void command_stream_write(CommandStream* stream, enum RecordingCommandType type, const void* payload, u32 size);
+
+/* hands the written buffer to the render thread, after it has taken the one before; then waits until the
+ * other buffer has been played back, to write the next frame into it. */
+void command_stream_submit(CommandStream* stream);
+
+/* render thread side: waits for a submitted buffer, returns false once the stream is closed and played back. */
+bool command_stream_acquire(CommandStream* stream, const byte** commands, usize* size);
+/* the buffer from command_stream_acquire() can be written again. */
+void command_stream_release(CommandStream* stream);
+
+/* the render thread plays back what was submitted already, then command_stream_acquire() returns false. */
+void command_stream_close(CommandStream* stream);
+
+/* walks the packets of an acquired buffer; returns NULL at the end. */
+const RecordingCommand* command_stream_next(const byte* commands, usize size, usize* offset, const void** payload);
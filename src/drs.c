@@ -0,0 +1,82 @@
+#include "drs.h"
+
+#include <math.h>
+
+/* fraction of the budget we aim for when changing the scale; leaves room for spikes. */
+#define DRS_HEADROOM 0.9f
+
+/* above budget * this for DRS_FRAMES_TO_DOWNSCALE frames: scale down */
+#define DRS_DOWNSCALE_THRESHOLD 0.95f
+#define DRS_FRAMES_TO_DOWNSCALE (u32)4
+
+/* below budget * this for DRS_FRAMES_TO_UPSCALE frames: scale up */
+#define DRS_UPSCALE_THRESHOLD 0.75f
+#define DRS_FRAMES_TO_UPSCALE (u32)30
+
+#define DRS_COOLDOWN_FRAMES (u32)4
+
+/* scales are snapped to multiples of this so tiny corrections don't count as changes */
+#define DRS_SCALE_STEP (1.0f / 32.0f)
+
+void drs_init(DynamicResolution* drs, float target_ms, float min_scale, float max_scale) {
+    drs->scale = max_scale;
+    drs->min_scale = min_scale;
+    drs->max_scale = max_scale;
+
+    drs->target_ms = target_ms;
+    drs->smoothed_ms = 0;
+
+    drs->frames_over = 0;
+    drs->frames_under = 0;
+    drs->cooldown = 0;
+}
+
+static float drs_clamp(float x, float low, float high) {
+    return x < low ? low : (x > high ? high : x);
+}
+
+float drs_update(DynamicResolution* drs, float gpu_ms) {
+    if (drs->cooldown > 0) {
+        drs->cooldown--;
+        return drs->scale;
+    }
+
+    drs->smoothed_ms = drs->smoothed_ms == 0 ? gpu_ms : drs->smoothed_ms * 0.8f + gpu_ms * 0.2f;
+
+    if (drs->smoothed_ms > drs->target_ms * DRS_DOWNSCALE_THRESHOLD) {
+        drs->frames_over++;
+        drs->frames_under = 0;
+    } else if (drs->smoothed_ms < drs->target_ms * DRS_UPSCALE_THRESHOLD) {
+        drs->frames_under++;
+        drs->frames_over = 0;
+    } else {
+        drs->frames_over = 0;
+        drs->frames_under = 0;
+    }
+
+    float scale = drs->scale;
+
+    /* GPU time is roughly proportional to the pixel count, i.e. to scale^2. */
+    if (drs->frames_over >= DRS_FRAMES_TO_DOWNSCALE) {
+        scale *= drs_clamp(sqrtf(drs->target_ms * DRS_HEADROOM / drs->smoothed_ms), 0.75f, 1.0f);
+        scale = floorf(scale / DRS_SCALE_STEP) * DRS_SCALE_STEP;
+    } else if (drs->frames_under >= DRS_FRAMES_TO_UPSCALE) {
+        /* grow slowly, overshooting costs dropped frames */
+        scale *= drs_clamp(sqrtf(drs->target_ms * DRS_HEADROOM / drs->smoothed_ms), 1.0f, 1.1f);
+        scale = ceilf(scale / DRS_SCALE_STEP) * DRS_SCALE_STEP;
+    }
+
+    scale = drs_clamp(scale, drs->min_scale, drs->max_scale);
+
+    if (scale != drs->scale) {
+        /* the smoothed time was measured at the old scale; rescale it so the next decision starts from a sane guess */
+        drs->smoothed_ms *= (scale * scale) / (drs->scale * drs->scale);
+        drs->scale = scale;
+
+        drs->frames_over = 0;
+        drs->frames_under = 0;
+        drs->cooldown = DRS_COOLDOWN_FRAMES;
+    }
+
+    return drs->scale;
+}
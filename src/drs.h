@@ -0,0 +1,31 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Dynamic resolution controller.
+ *
+ * Fed the measured GPU time of every frame, it picks the render scale (applied to both axes) that keeps
+ * the GPU inside the frame budget. It only reacts to sustained trends: the scale drops after a few frames
+ * above the budget and grows again only after a longer stretch well below it, so it doesn't oscillate.
+ */
+
+typedef struct DynamicResolution {
+    float scale;
+    float min_scale;
+    float max_scale;
+
+    float target_ms;
+    float smoothed_ms;
+
+    u32 frames_over;
+    u32 frames_under;
+
+    /* frames to ignore after a change; the measurements in flight are still from the old scale. */
+    u32 cooldown;
+} DynamicResolution;
+
+void drs_init(DynamicResolution* drs, float target_ms, float min_scale, float max_scale);
+
+/* returns the scale to render the next frame with. */
+float drs_update(DynamicResolution* drs, float gpu_ms);
@@ -0,0 +1,82 @@
+#include "gpu_memory.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+/* allocations may come from loader threads too. */
+static _Atomic(VkDeviceSize) heap_usage[VK_MAX_MEMORY_HEAPS];
+static _Atomic(VkDeviceSize) category_usage[GRAPHICS_MEMORY_CATEGORY_COUNT];
+
+u32 gpu_memory_find_type(const VkPhysicalDeviceMemoryProperties* props, u32 type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) {
+    u32 fallback = UINT32_MAX;
+
+    for (u32 i = 0; i < props->memoryTypeCount; ++i) {
+        if (!(type_bits & (1u << i)))
+            continue;
+
+        VkMemoryPropertyFlags flags = props->memoryTypes[i].propertyFlags;
+        if ((flags & required) != required)
+            continue;
+
+        if ((flags & preferred) == preferred)
+            return i;
+
+        if (fallback == UINT32_MAX)
+            fallback = i;
+    }
+
+    return fallback;
+}
+
+GpuAllocation gpu_memory_allocate(VkDevice device, const VkPhysicalDeviceMemoryProperties* props, const VkMemoryRequirements* reqs, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, enum GraphicsMemoryCategory category) {
+    u32 type = gpu_memory_find_type(props, reqs->memoryTypeBits, required, preferred);
+    if (type == UINT32_MAX) {
+        fprintf(stderr, "no memory type for bits 0x%x with flags 0x%x\n", reqs->memoryTypeBits, required);
+        return (GpuAllocation) { VK_NULL_HANDLE };
+    }
+
+    return gpu_memory_allocate_type(device, props, type, reqs->size, category);
+}
+
+GpuAllocation gpu_memory_allocate_type(VkDevice device, const VkPhysicalDeviceMemoryProperties* props, u32 type, VkDeviceSize size, enum GraphicsMemoryCategory category) {
+    VkMemoryAllocateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = type,
+    };
+
+    GpuAllocation allocation = {
+        .size = size,
+        .type = type,
+        .heap = props->memoryTypes[type].heapIndex,
+        .category = category,
+    };
+
+    if (vkAllocateMemory(device, &info, NULL, &allocation.memory) != VK_SUCCESS)
+        return (GpuAllocation) { VK_NULL_HANDLE };
+
+    atomic_fetch_add(&heap_usage[allocation.heap], size);
+    atomic_fetch_add(&category_usage[category], size);
+
+    return allocation;
+}
+
+void gpu_memory_free(VkDevice device, GpuAllocation* allocation) {
+    if (allocation->memory == VK_NULL_HANDLE)
+        return;
+
+    vkFreeMemory(device, allocation->memory, NULL);
+
+    atomic_fetch_sub(&heap_usage[allocation->heap], allocation->size);
+    atomic_fetch_sub(&category_usage[allocation->category], allocation->size);
+
+    *allocation = (GpuAllocation) { VK_NULL_HANDLE };
+}
+
+void gpu_memory_get_usage(VkDeviceSize heaps[VK_MAX_MEMORY_HEAPS], VkDeviceSize categories[GRAPHICS_MEMORY_CATEGORY_COUNT]) {
+    for (u32 i = 0; heaps && i < VK_MAX_MEMORY_HEAPS; ++i)
+        heaps[i] = atomic_load(&heap_usage[i]);
+
+    for (u32 i = 0; categories && i < GRAPHICS_MEMORY_CATEGORY_COUNT; ++i)
+        categories[i] = atomic_load(&category_usage[i]);
+}
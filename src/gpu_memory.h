@@ -0,0 +1,26 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+
+#include <volk.h>
+
+/* a device memory allocation, with what it takes to account for it when it's freed. */
+typedef struct GpuAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    u32 type;
+    u32 heap;
+    enum GraphicsMemoryCategory category;
+} GpuAllocation;
+
+/* returns UINT32_MAX if no memory type has all `required` flags. prefers types that also have `preferred`. */
+u32 gpu_memory_find_type(const VkPhysicalDeviceMemoryProperties* props, u32 type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+
+/* allocation.memory is VK_NULL_HANDLE on failure. */
+GpuAllocation gpu_memory_allocate(VkDevice device, const VkPhysicalDeviceMemoryProperties* props, const VkMemoryRequirements* reqs, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, enum GraphicsMemoryCategory category);
+GpuAllocation gpu_memory_allocate_type(VkDevice device, const VkPhysicalDeviceMemoryProperties* props, u32 type, VkDeviceSize size, enum GraphicsMemoryCategory category);
+void gpu_memory_free(VkDevice device, GpuAllocation* allocation);
+
+/* bytes currently allocated through gpu_memory_allocate*(), process wide. either array may be NULL. */
+void gpu_memory_get_usage(VkDeviceSize heaps[VK_MAX_MEMORY_HEAPS], VkDeviceSize categories[GRAPHICS_MEMORY_CATEGORY_COUNT]);
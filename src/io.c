@@ -43,14 +43,31 @@ void file_view_close(FileView* view) {
 
     VirtualFree(internal, 0, MEM_RELEASE);
 }
+
+void file_view_advise(const FileView* view, u64 offset, u64 length, FileAdvice advice) {
+    if (offset >= view->length)
+        return;
+    if (length > view->length - offset)
+        length = view->length - offset;
+
+    /* windows only has the one hint for views (8 and up) */
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+    if (advice == FILE_ADVICE_WILLNEED) {
+        WIN32_MEMORY_RANGE_ENTRY range = { view->data + offset, (SIZE_T)length };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#endif
+}
 #else 
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 FileView file_view_open(const char* path) {
     FileView view;
 
-    int fd = open(file_name.data(), O_RDONLY);
+    int fd = open(path, O_RDONLY);
     if (fd == -1) {
         view.data = NULL;
         return view;
@@ -64,16 +81,38 @@ FileView file_view_open(const char* path) {
     }
 
     view.length = file.st_size;
-    view.data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    view.data = mmap(NULL, view.length, PROT_READ, MAP_PRIVATE, fd, 0);
     if (view.data == MAP_FAILED) {
         view.data = NULL;
-        close(fd);
-        return view.data;
     }
 
+    /* the mapping keeps the file alive */
     close(fd);
+    return view;
 }
+
 void file_view_close(FileView* view) {
-    munmap(view.data, view.length);
+    munmap(view->data, view->length);
+}
+
+void file_view_advise(const FileView* view, u64 offset, u64 length, FileAdvice advice) {
+    if (offset >= view->length)
+        return;
+    if (length > view->length - offset)
+        length = view->length - offset;
+
+    /* the mapping starts on a page, so rounding the offset down keeps it inside */
+    u64 page = (u64)sysconf(_SC_PAGESIZE);
+    u64 start = offset & ~(page - 1);
+
+    static const int advices[] = {
+        [FILE_ADVICE_NORMAL] = MADV_NORMAL,
+        [FILE_ADVICE_SEQUENTIAL] = MADV_SEQUENTIAL,
+        [FILE_ADVICE_RANDOM] = MADV_RANDOM,
+        [FILE_ADVICE_WILLNEED] = MADV_WILLNEED,
+    };
+
+    /* only a hint, so failing doesn't matter */
+    madvise(view->data + start, offset + length - start, advices[advice]);
 }
 #endif
@@ -13,5 +13,18 @@ typedef struct FileView {
 #endif
 } FileView;
 
+typedef enum FileAdvice {
+    FILE_ADVICE_NORMAL,
+    /* read front to back once: read ahead further, and drop pages behind */
+    FILE_ADVICE_SEQUENTIAL,
+    /* read here and there: don't read ahead */
+    FILE_ADVICE_RANDOM,
+    /* about to be read: start reading it in now, in large requests */
+    FILE_ADVICE_WILLNEED,
+} FileAdvice;
+
 FileView file_view_open(const char* path);
 void file_view_close(FileView* view);
+
+/* a hint of how `length` bytes of the view from `offset` are about to be read, rounded out to whole pages. */
+void file_view_advise(const FileView* view, u64 offset, u64 length, FileAdvice advice);
@@ -0,0 +1,345 @@
+#include "jobs.h"
+#include "thread.h"
+#include "arena.h"
+#include "trace.h"
+
+/* jobs_parallel_for() makes at most this many jobs per worker, so stealing can even out uneven ranges */
+#define JOBS_PER_WORKER (u32)4
+
+typedef struct Job {
+    JobFunc function;
+    void* data;
+    JobCounter* counter;
+    u32 first;
+    u32 count;
+} Job;
+
+/* Chase-Lev deque (in the C11 formulation of Le et al.): the owner works at `bottom`, thieves at `top`. the two
+ * only race for the last job, which a compare-exchange on `top` settles. */
+typedef struct JobQueue {
+    _Alignas(64) atomic_llong top;
+    _Alignas(64) atomic_llong bottom;
+    Job jobs[JOBS_QUEUE_SIZE];
+} JobQueue;
+
+typedef struct JobWorker {
+    JobQueue queue;
+
+    JobSystem* system;
+    u32 index;
+    /* picks the workers to steal from */
+    u32 random;
+    Thread thread;
+
+    /* written by the worker, read and reset by jobs_get_stats() */
+    atomic_uint peak_depth;
+    atomic_ullong jobs;
+    atomic_ullong steals;
+    atomic_ullong idle_ns;
+} JobWorker;
+
+struct JobSystem {
+    u32 workers_count;
+    JobWorker* workers;
+
+    /* queued jobs nobody has taken yet; workers sleep while there are none */
+    atomic_int pending;
+    atomic_uint sleepers;
+    atomic_bool running;
+
+    Mutex mutex;
+    CondVar wake;
+};
+
+static _Thread_local u32 jobs_current_worker = 0;
+
+static bool jobs_push(JobQueue* queue, const Job* job, u32* depth) {
+    s64 bottom = atomic_load_explicit(&queue->bottom, memory_order_relaxed);
+    s64 top = atomic_load_explicit(&queue->top, memory_order_acquire);
+    if (bottom - top >= (s64)JOBS_QUEUE_SIZE)
+        return false;
+
+    queue->jobs[bottom & (JOBS_QUEUE_SIZE - 1)] = *job;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+
+    *depth = (u32)(bottom + 1 - top);
+    return true;
+}
+
+static bool jobs_pop(JobQueue* queue, Job* job) {
+    s64 bottom = atomic_load_explicit(&queue->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&queue->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    s64 top = atomic_load_explicit(&queue->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+
+    *job = queue->jobs[bottom & (JOBS_QUEUE_SIZE - 1)];
+    if (top != bottom)
+        return true;
+
+    /* the last one, which a thief may be taking at the same time */
+    bool won = atomic_compare_exchange_strong_explicit(&queue->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+    return won;
+}
+
+static bool jobs_steal(JobQueue* queue, Job* job) {
+    s64 top = atomic_load_explicit(&queue->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    s64 bottom = atomic_load_explicit(&queue->bottom, memory_order_acquire);
+
+    if (top >= bottom)
+        return false;
+
+    /* read before claiming it; if another thread claims it first the copy is thrown away */
+    *job = queue->jobs[top & (JOBS_QUEUE_SIZE - 1)];
+    return atomic_compare_exchange_strong_explicit(&queue->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+static u32 jobs_random(JobWorker* worker) {
+    /* xorshift32 */
+    u32 x = worker->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    worker->random = x;
+    return x;
+}
+
+/* the worker's own jobs first, newest first; then one round over the others, starting at a random one. */
+static bool jobs_find(JobSystem* system, JobWorker* worker, Job* job) {
+    if (jobs_pop(&worker->queue, job)) {
+        atomic_fetch_sub(&system->pending, 1);
+        return true;
+    }
+
+    u32 start = jobs_random(worker);
+    for (u32 i = 0; i < system->workers_count; ++i) {
+        JobWorker* victim = &system->workers[(start + i) % system->workers_count];
+        if (victim == worker)
+            continue;
+
+        if (jobs_steal(&victim->queue, job)) {
+            atomic_fetch_sub(&system->pending, 1);
+            atomic_fetch_add_explicit(&worker->steals, 1, memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void jobs_execute(JobWorker* worker, const Job* job) {
+    job->function(job->data, job->first, job->count);
+
+    atomic_fetch_add_explicit(&worker->jobs, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(job->counter, 1, memory_order_release);
+}
+
+static void jobs_worker_main(void* data) {
+    JobWorker* worker = data;
+    JobSystem* system = worker->system;
+
+    jobs_current_worker = worker->index;
+    TRACE_THREAD_NAME("job worker");
+
+    while (atomic_load_explicit(&system->running, memory_order_relaxed)) {
+        Job job;
+        if (jobs_find(system, worker, &job)) {
+            jobs_execute(worker, &job);
+            continue;
+        }
+
+        u64 idle_start = thread_now_ns();
+
+        /* queued but not stolen yet, or being popped by its owner; worth another look soon */
+        if (atomic_load(&system->pending) > 0) {
+            thread_yield();
+        } else {
+            /* sleepers is raised before pending is checked and jobs_run() raises pending before it checks
+             * sleepers, so one of the two always sees the other */
+            mutex_lock(&system->mutex);
+            atomic_fetch_add(&system->sleepers, 1);
+            while (atomic_load(&system->pending) <= 0 && atomic_load(&system->running))
+                cond_wait(&system->wake, &system->mutex);
+            atomic_fetch_sub(&system->sleepers, 1);
+            mutex_unlock(&system->mutex);
+        }
+
+        atomic_fetch_add_explicit(&worker->idle_ns, thread_now_ns() - idle_start, memory_order_relaxed);
+    }
+}
+
+JobSystem* jobs_create(u32 workers) {
+    if (workers == 0)
+        workers = thread_hardware_concurrency();
+    workers = workers < JOBS_MAX_WORKERS ? workers : JOBS_MAX_WORKERS;
+
+    JobSystem* system = heap_calloc(1, sizeof(JobSystem));
+    system->workers = heap_calloc(workers, sizeof(JobWorker));
+    system->workers_count = workers;
+
+    atomic_init(&system->pending, 0);
+    atomic_init(&system->sleepers, 0);
+    atomic_init(&system->running, true);
+    mutex_init(&system->mutex);
+    cond_init(&system->wake);
+
+    /* worker 0 is the calling thread; if a thread can't be started, its slot goes to the next one */
+    u32 started = 0;
+    for (u32 i = 0; i < workers; ++i) {
+        JobWorker* worker = &system->workers[started];
+        worker->system = system;
+        worker->index = started;
+        worker->random = 0x9e3779b9u * (started + 1);
+
+        if (started == 0 || thread_create(&worker->thread, jobs_worker_main, worker))
+            ++started;
+    }
+
+    system->workers_count = started;
+    return system;
+}
+
+void jobs_destroy(JobSystem* system) {
+    mutex_lock(&system->mutex);
+    atomic_store(&system->running, false);
+    cond_broadcast(&system->wake);
+    mutex_unlock(&system->mutex);
+
+    for (u32 i = 1; i < system->workers_count; ++i)
+        thread_join(system->workers[i].thread);
+
+    cond_destroy(&system->wake);
+    mutex_destroy(&system->mutex);
+
+    heap_free(system->workers);
+    heap_free(system);
+}
+
+u32 jobs_workers_count(const JobSystem* system) {
+    return system->workers_count;
+}
+
+u32 jobs_worker_index(void) {
+    return jobs_current_worker;
+}
+
+void jobs_run(JobSystem* system, JobFunc function, void* data, u32 count, JobCounter* counter) {
+    JobWorker* worker = &system->workers[jobs_current_worker];
+    atomic_fetch_add(counter, count);
+
+    for (u32 i = 0; i < count; ++i) {
+        Job job = { function, data, counter, i, 1 };
+
+        /* raised first, so it never drops below the jobs actually queued */
+        atomic_fetch_add(&system->pending, 1);
+
+        u32 depth;
+        if (!jobs_push(&worker->queue, &job, &depth)) {
+            atomic_fetch_sub(&system->pending, 1);
+            jobs_execute(worker, &job);
+            continue;
+        }
+
+        if (depth > atomic_load_explicit(&worker->peak_depth, memory_order_relaxed))
+            atomic_store_explicit(&worker->peak_depth, depth, memory_order_relaxed);
+    }
+
+    if (atomic_load(&system->sleepers) > 0) {
+        mutex_lock(&system->mutex);
+        cond_broadcast(&system->wake);
+        mutex_unlock(&system->mutex);
+    }
+}
+
+void jobs_wait(JobSystem* system, JobCounter* counter) {
+    JobWorker* worker = &system->workers[jobs_current_worker];
+    u64 idle_start = 0;
+
+    while (atomic_load_explicit(counter, memory_order_acquire) > 0) {
+        Job job;
+        if (jobs_find(system, worker, &job)) {
+            if (idle_start) {
+                atomic_fetch_add_explicit(&worker->idle_ns, thread_now_ns() - idle_start, memory_order_relaxed);
+                idle_start = 0;
+            }
+
+            jobs_execute(worker, &job);
+            continue;
+        }
+
+        /* the last jobs are running elsewhere */
+        if (!idle_start)
+            idle_start = thread_now_ns();
+        thread_yield();
+    }
+
+    if (idle_start)
+        atomic_fetch_add_explicit(&worker->idle_ns, thread_now_ns() - idle_start, memory_order_relaxed);
+}
+
+typedef struct JobRange {
+    JobFunc function;
+    void* data;
+    u32 items;
+    u32 per_job;
+} JobRange;
+
+/* run through jobs_run(), so `count` is always 1 */
+static void jobs_range(void* data, u32 index, u32 count) {
+    (void)count;
+    JobRange* range = data;
+
+    u32 first = index * range->per_job;
+    u32 left = range->items - first;
+    range->function(range->data, first, left < range->per_job ? left : range->per_job);
+}
+
+void jobs_parallel_for(JobSystem* system, JobFunc function, void* data, u32 items, u32 batch) {
+    if (items == 0)
+        return;
+
+    batch = batch > 0 ? batch : 1;
+
+    /* not worth queuing, or nobody to share with */
+    if (items <= batch || system->workers_count == 1) {
+        function(data, 0, items);
+        return;
+    }
+
+    u32 max_jobs = system->workers_count * JOBS_PER_WORKER;
+    u32 per_job = (items + max_jobs - 1) / max_jobs;
+    per_job = per_job > batch ? per_job : batch;
+
+    JobRange range = { function, data, items, per_job };
+
+    JobCounter counter;
+    atomic_init(&counter, 0);
+
+    jobs_run(system, jobs_range, &range, (items + per_job - 1) / per_job, &counter);
+    jobs_wait(system, &counter);
+}
+
+void jobs_get_stats(JobSystem* system, GraphicsJobStats* stats) {
+    stats->workers_count = system->workers_count;
+
+    for (u32 i = 0; i < system->workers_count; ++i) {
+        JobWorker* worker = &system->workers[i];
+
+        s64 top = atomic_load_explicit(&worker->queue.top, memory_order_relaxed);
+        s64 bottom = atomic_load_explicit(&worker->queue.bottom, memory_order_relaxed);
+        u32 depth = bottom > top ? (u32)(bottom - top) : 0;
+
+        stats->workers[i].queue_depth = depth;
+        stats->workers[i].peak_queue_depth = atomic_exchange_explicit(&worker->peak_depth, depth, memory_order_relaxed);
+        stats->workers[i].jobs = atomic_exchange_explicit(&worker->jobs, 0, memory_order_relaxed);
+        stats->workers[i].steals = atomic_exchange_explicit(&worker->steals, 0, memory_order_relaxed);
+        stats->workers[i].idle_ms = (float)((double)atomic_exchange_explicit(&worker->idle_ns, 0, memory_order_relaxed) / 1000000.0);
+    }
+}
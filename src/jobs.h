@@ -0,0 +1,56 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+
+#include <stdatomic.h>
+
+/*
+ * Work-stealing job system.
+ *
+ * One worker per hardware thread (JOBS_MAX_WORKERS at most), each with a Chase-Lev deque: a worker pushes and
+ * pops the jobs it queues at the bottom of its own deque without locks, and a worker that runs out steals from
+ * the top of a random other one. Worker 0 is the thread that created the system; it has no thread of its own
+ * and runs jobs only inside jobs_wait().
+ *
+ * Jobs are counted down on a JobCounter, which is what dependencies are expressed with: jobs_wait() doesn't
+ * block the thread but runs other jobs until the counter reaches zero, so a job may queue more jobs and wait
+ * for them without tying up its worker.
+ *
+ * Queuing is for the creating thread and for jobs only, every other thread would share worker 0's deque.
+ */
+
+#define JOBS_MAX_WORKERS GRAPHICS_MAX_WORKERS
+/* per worker, a power of two; a job that doesn't fit is run right away by the thread queuing it */
+#define JOBS_QUEUE_SIZE (u32)1024
+
+typedef struct JobSystem JobSystem;
+
+/* jobs of a batch that haven't finished yet; starts at zero, and is zero again once they all have. */
+typedef atomic_uint JobCounter;
+
+/* `first` and `count` are the range of items of a jobs_parallel_for() job, the job's index and 1 otherwise. */
+typedef void (*JobFunc)(void* data, u32 first, u32 count);
+
+/* 0 workers means one per hardware thread. */
+JobSystem* jobs_create(u32 workers);
+/* every job queued must have been waited for. */
+void jobs_destroy(JobSystem* system);
+
+u32 jobs_workers_count(const JobSystem* system);
+
+/* the calling thread's worker, for per-thread state such as command pools; 0 outside of jobs. */
+u32 jobs_worker_index(void);
+
+/* queues `count` jobs running `function(data, i, 1)` for i = 0 .. count - 1, adding them to `counter`. */
+void jobs_run(JobSystem* system, JobFunc function, void* data, u32 count, JobCounter* counter);
+
+/* runs queued jobs until `counter` reaches zero. */
+void jobs_wait(JobSystem* system, JobCounter* counter);
+
+/* calls `function` over ranges of [0, items) of at least `batch` items, spread over the workers, and waits for
+ * all of them. */
+void jobs_parallel_for(JobSystem* system, JobFunc function, void* data, u32 items, u32 batch);
+
+/* queue depths are read as they are; everything else is since the last call. */
+void jobs_get_stats(JobSystem* system, GraphicsJobStats* stats);
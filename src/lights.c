@@ -0,0 +1,319 @@
+#include "lights.h"
+#include "shadows.h"
+#include "renderer_internal.h"
+#include "gpu_memory.h"
+#include "arena.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the layout of the LightFrame buffer in lights.glsl */
+typedef struct LightFrame {
+    Mat4 view;
+    /* slice = log(depth) * slice_scale + slice_bias */
+    float slice_scale;
+    float slice_bias;
+    float near_plane;
+    float far_plane;
+    /* P00 and P11 */
+    float projection[2];
+    float render_size[2];
+    u32 light_count;
+    u32 reserved[3];
+} LightFrame;
+
+/* view space position and radius, then color and the index of the light's shadow, negative without one */
+typedef struct GpuLight {
+    float position_radius[4];
+    float color[4];
+} GpuLight;
+
+/* a frame's slice of the stream, padded to any minStorageBufferOffsetAlignment */
+#define LIGHT_FRAME_SIZE ((sizeof(LightFrame) + sizeof(GpuLight) * LIGHT_MAX_LIGHTS + 255) & ~(VkDeviceSize)255)
+
+/* the LightGrid buffer: how many indices are taken, then the offset and count of every cluster's range */
+#define LIGHT_GRID_SIZE ((VkDeviceSize)sizeof(u32) * 2 * (1 + LIGHT_CLUSTERS_COUNT))
+
+struct LightClusters {
+    VulkanGraphics* graphics;
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+
+    /* a LIGHT_FRAME_SIZE slice per frame in flight */
+    VkBuffer stream;
+    GpuAllocation stream_memory;
+    byte* stream_mapped;
+
+    /* written by the compute pass and read while drawing, so only one frame is in them at a time */
+    VkBuffer grid;
+    GpuAllocation grid_memory;
+    VkBuffer indices;
+    GpuAllocation indices_memory;
+
+    u32 prepared_count;
+
+    u32 queued_count;
+    GraphicsLight queued[LIGHT_MAX_LIGHTS];
+};
+
+static void light_clusters_create_buffer(LightClusters* clusters, VkBufferUsageFlags usage, VkDeviceSize size, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkBuffer* buffer, GpuAllocation* memory) {
+    VulkanGraphics* graphics = clusters->graphics;
+
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    ERR_CHECK(vkCreateBuffer(graphics->device, &info, NULL, buffer), "light buffer");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(graphics->device, *buffer, &reqs);
+
+    *memory = gpu_memory_allocate(graphics->device, &graphics->memory_props, &reqs, required, preferred, GRAPHICS_MEMORY_BUFFERS);
+    if (memory->memory == VK_NULL_HANDLE) {
+        fprintf(stderr, "couldn't allocate a light buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ERR_CHECK(vkBindBufferMemory(graphics->device, *buffer, memory->memory, 0), "light buffer binding");
+}
+
+static void light_clusters_create_descriptors(LightClusters* clusters) {
+    VkDevice device = clusters->graphics->device;
+
+    /* frame and lights, grid, indices */
+    VkDescriptorSetLayoutBinding bindings[3];
+    for (u32 i = 0; i < ZARRSIZ(bindings); ++i) {
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = ZARRSIZ(bindings),
+        .pBindings = bindings,
+    };
+
+    ERR_CHECK(vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &clusters->set_layout), "light descriptor set layout");
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = ZARRSIZ(bindings) * MAX_FRAMES_IN_FLIGHT,
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+
+    ERR_CHECK(vkCreateDescriptorPool(device, &pool_info, NULL, &clusters->descriptor_pool), "light descriptor pool");
+
+    VkDescriptorSetLayout set_layouts[MAX_FRAMES_IN_FLIGHT];
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        set_layouts[i] = clusters->set_layout;
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = clusters->descriptor_pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = set_layouts,
+    };
+
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, clusters->sets), "light descriptor sets");
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorBufferInfo buffer_infos[] = {
+            { clusters->stream, LIGHT_FRAME_SIZE * i, LIGHT_FRAME_SIZE },
+            { clusters->grid, 0, VK_WHOLE_SIZE },
+            { clusters->indices, 0, VK_WHOLE_SIZE },
+        };
+
+        VkWriteDescriptorSet writes[ZARRSIZ(buffer_infos)];
+        for (u32 j = 0; j < ZARRSIZ(buffer_infos); ++j) {
+            writes[j] = (VkWriteDescriptorSet) {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = clusters->sets[i],
+                .dstBinding = j,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &buffer_infos[j],
+            };
+        }
+
+        vkUpdateDescriptorSets(device, ZARRSIZ(writes), writes, 0, NULL);
+    }
+
+    VkPipelineLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &clusters->set_layout,
+    };
+
+    ERR_CHECK(vkCreatePipelineLayout(device, &layout_info, NULL, &clusters->pipeline_layout), "light pipeline layout");
+}
+
+LightClusters* light_clusters_create(VulkanGraphics* graphics) {
+    LightClusters* clusters = heap_calloc(1, sizeof(LightClusters));
+    clusters->graphics = graphics;
+
+    light_clusters_create_buffer(clusters, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, LIGHT_FRAME_SIZE * MAX_FRAMES_IN_FLIGHT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &clusters->stream, &clusters->stream_memory);
+    light_clusters_create_buffer(clusters, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, LIGHT_GRID_SIZE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &clusters->grid, &clusters->grid_memory);
+    light_clusters_create_buffer(clusters, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, (VkDeviceSize)sizeof(u32) * LIGHT_MAX_INDICES, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &clusters->indices, &clusters->indices_memory);
+
+    void* mapped;
+    ERR_CHECK(vkMapMemory(graphics->device, clusters->stream_memory.memory, 0, VK_WHOLE_SIZE, 0, &mapped), "light stream mapping");
+    clusters->stream_mapped = mapped;
+
+    /* shaders see no lights until a frame is prepared */
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        memset(clusters->stream_mapped + LIGHT_FRAME_SIZE * i, 0, sizeof(LightFrame));
+
+    light_clusters_create_descriptors(clusters);
+    clusters->pipeline = vk_create_compute_pipeline(graphics, "shaders/bin/vulkan_light_cluster.comp.spv", clusters->pipeline_layout, 0);
+
+    return clusters;
+}
+
+void light_clusters_destroy(LightClusters* clusters) {
+    VkDevice device = clusters->graphics->device;
+
+    vkDestroyPipeline(device, clusters->pipeline, NULL);
+    vkDestroyPipelineLayout(device, clusters->pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, clusters->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, clusters->set_layout, NULL);
+
+    vkUnmapMemory(device, clusters->stream_memory.memory);
+    vkDestroyBuffer(device, clusters->stream, NULL);
+    gpu_memory_free(device, &clusters->stream_memory);
+
+    vkDestroyBuffer(device, clusters->grid, NULL);
+    gpu_memory_free(device, &clusters->grid_memory);
+    vkDestroyBuffer(device, clusters->indices, NULL);
+    gpu_memory_free(device, &clusters->indices_memory);
+
+    heap_free(clusters);
+}
+
+void light_clusters_push(LightClusters* clusters, const GraphicsLight* lights, u32 count) {
+    u32 room = LIGHT_MAX_LIGHTS - clusters->queued_count;
+    if (count > room)
+        count = room;
+
+    memcpy(clusters->queued + clusters->queued_count, lights, count * sizeof(GraphicsLight));
+    clusters->queued_count += count;
+}
+
+const GraphicsLight* light_clusters_queued(const LightClusters* clusters, u32* count) {
+    *count = clusters->queued_count;
+    return clusters->queued;
+}
+
+void light_clusters_prepare(LightClusters* clusters, u32 frame, const Mat4* view, const Mat4* projection, float near_plane, float far_plane, VkExtent2D render_extent) {
+    TRACE_ZONE("light_clusters_prepare");
+
+    LightFrame* header = (LightFrame*)(clusters->stream_mapped + LIGHT_FRAME_SIZE * frame);
+    GpuLight* lights = (GpuLight*)(header + 1);
+
+    float log_range = logf(far_plane / near_plane);
+    *header = (LightFrame) {
+        .view = *view,
+        .slice_scale = (float)LIGHT_CLUSTERS_Z / log_range,
+        .slice_bias = -(float)LIGHT_CLUSTERS_Z * logf(near_plane) / log_range,
+        .near_plane = near_plane,
+        .far_plane = far_plane,
+        .projection = { projection->m[0], fabsf(projection->m[5]) },
+        .render_size = { (float)render_extent.width, (float)render_extent.height },
+        .light_count = clusters->queued_count,
+    };
+
+    for (u32 i = 0; i < clusters->queued_count; ++i) {
+        const GraphicsLight* light = &clusters->queued[i];
+        Vec3 position = mat4_transform_point(view, vec3(light->position[0], light->position[1], light->position[2]));
+
+        lights[i] = (GpuLight) {
+            .position_radius = { position.x, position.y, position.z, light->radius },
+            .color = { light->color[0] * light->intensity, light->color[1] * light->intensity, light->color[2] * light->intensity, (float)shadow_atlas_find(clusters->graphics->shadows, light->shadow_id) },
+        };
+    }
+
+    clusters->prepared_count = clusters->queued_count;
+    clusters->queued_count = 0;
+}
+
+void light_clusters_record(LightClusters* clusters, VkCommandBuffer command_buffer, u32 frame) {
+    if (clusters->prepared_count == 0)
+        return;
+
+    /* the last frame's fragments are done reading the clusters before they are rebuilt */
+    VkMemoryBarrier2 reuse = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &reuse,
+    });
+
+    vkCmdFillBuffer(command_buffer, clusters->grid, 0, sizeof(u32), 0);
+
+    VkMemoryBarrier2 cleared = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &cleared,
+    });
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusters->pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusters->pipeline_layout, 0, 1, &clusters->sets[frame], 0, NULL);
+    vkCmdDispatch(command_buffer, LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z);
+
+    VkMemoryBarrier2 binned = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &binned,
+    });
+}
+
+VkDescriptorSetLayout light_clusters_set_layout(const LightClusters* clusters) {
+    return clusters->set_layout;
+}
+
+VkDescriptorSet light_clusters_set(const LightClusters* clusters, u32 frame) {
+    return clusters->sets[frame];
+}
+
+u32 light_clusters_count(const LightClusters* clusters) {
+    return clusters->prepared_count;
+}
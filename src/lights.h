@@ -0,0 +1,54 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+#include "zmath.h"
+
+#include <volk.h>
+
+/*
+ * Clustered forward lighting.
+ *
+ * The view frustum is cut into a grid of LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y screen tiles and LIGHT_CLUSTERS_Z
+ * depth slices, exponentially spaced between the near and far planes. Every frame the queued point lights are
+ * moved into view space on the CPU, and a compute pass (light_cluster.comp, one workgroup per cluster) tests
+ * them against the bounding box of each cluster, writing the lights touching it as a compact range of a shared
+ * index list. Forward shaders then find their cluster from the fragment position and loop over that range
+ * only, so the cost per pixel depends on the lights around it rather than on how many there are.
+ *
+ * The light set (light_clusters_set()) is set 1 of the shaders lit this way; see mesh.frag. Lights with a shadow
+ * in the shadow atlas carry its index, so shadow_atlas_prepare() must run before light_clusters_prepare().
+ */
+
+/* lights queued per frame; more are dropped */
+#define LIGHT_MAX_LIGHTS (u32)8192
+#define LIGHT_CLUSTERS_X (u32)16
+#define LIGHT_CLUSTERS_Y (u32)9
+#define LIGHT_CLUSTERS_Z (u32)24
+#define LIGHT_CLUSTERS_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+/* lights of one cluster past this are dropped, and so are clusters once the index list is full */
+#define LIGHT_MAX_PER_CLUSTER (u32)256
+#define LIGHT_MAX_INDICES (LIGHT_CLUSTERS_COUNT * 128)
+
+typedef struct LightClusters LightClusters;
+
+LightClusters* light_clusters_create(VulkanGraphics* graphics);
+void light_clusters_destroy(LightClusters* clusters);
+
+void light_clusters_push(LightClusters* clusters, const GraphicsLight* lights, u32 count);
+
+/* the lights queued for the next frame, until it's prepared. */
+const GraphicsLight* light_clusters_queued(const LightClusters* clusters, u32* count);
+
+/* writes the queued lights into the stream slice of `frame`, in view space. the queue is empty afterwards. */
+void light_clusters_prepare(LightClusters* clusters, u32 frame, const Mat4* view, const Mat4* projection, float near_plane, float far_plane, VkExtent2D render_extent);
+
+/* bins the lights of `frame` into the clusters; outside of any rendering, before the passes reading them. */
+void light_clusters_record(LightClusters* clusters, VkCommandBuffer command_buffer, u32 frame);
+
+/* for the pipeline layouts and draws of lit shaders, which read it from the fragment stage. */
+VkDescriptorSetLayout light_clusters_set_layout(const LightClusters* clusters);
+VkDescriptorSet light_clusters_set(const LightClusters* clusters, u32 frame);
+
+/* lights of the last prepared frame. */
+u32 light_clusters_count(const LightClusters* clusters);
@@ -0,0 +1,167 @@
+#include "lz4.h"
+
+#include <string.h>
+
+#define LZ4_MIN_MATCH (usize)4
+/* the last match has to start this far before the end, and the last 5 bytes are always literals */
+#define LZ4_MF_LIMIT (usize)12
+#define LZ4_LAST_LITERALS (usize)5
+#define LZ4_MAX_OFFSET (usize)65535
+
+#define LZ4_HASH_BITS 12
+
+static inline u32 lz4_read32(const u8* p) {
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline u32 lz4_hash(u32 sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/* writes the 255 continued part of a length whose 4 bit field is saturated. */
+static u8* lz4_write_length(u8* op, usize length) {
+    for (; length >= 255; length -= 255)
+        *op++ = 255;
+
+    *op++ = (u8)length;
+    return op;
+}
+
+/* returns NULL if it doesn't fit before `oend`. */
+static u8* lz4_write_sequence(u8* op, u8* oend, const u8* literals, usize literals_length, usize offset, usize match_length) {
+    /* token, length bytes, literals and offset, generously */
+    if ((usize)(oend - op) < 1 + literals_length + literals_length / 255 + 1 + 2 + match_length / 255 + 1)
+        return NULL;
+
+    u8* token = op++;
+    *token = (u8)((literals_length >= 15 ? 15 : literals_length) << 4);
+    if (literals_length >= 15)
+        op = lz4_write_length(op, literals_length - 15);
+
+    memcpy(op, literals, literals_length);
+    op += literals_length;
+
+    if (match_length == 0)
+        return op;
+
+    *op++ = (u8)(offset & 0xff);
+    *op++ = (u8)(offset >> 8);
+
+    match_length -= LZ4_MIN_MATCH;
+    *token |= (u8)(match_length >= 15 ? 15 : match_length);
+    if (match_length >= 15)
+        op = lz4_write_length(op, match_length - 15);
+
+    return op;
+}
+
+usize lz4_compress(const u8* src, usize size, u8* dst, usize capacity) {
+    u32 table[1 << LZ4_HASH_BITS] = { 0 };
+
+    u8* op = dst;
+    u8* oend = dst + capacity;
+    usize anchor = 0;
+
+    if (size > LZ4_MF_LIMIT) {
+        usize limit = size - LZ4_MF_LIMIT;
+        usize match_limit = size - LZ4_LAST_LITERALS;
+
+        for (usize i = 1; i < limit; ) {
+            u32 sequence = lz4_read32(src + i);
+            u32 hash = lz4_hash(sequence);
+            usize candidate = table[hash];
+            table[hash] = (u32)i;
+
+            if (candidate >= i || i - candidate > LZ4_MAX_OFFSET || lz4_read32(src + candidate) != sequence) {
+                /* skip ahead faster the longer nothing matched, incompressible data isn't worth the time */
+                i += 1 + ((i - anchor) >> 6);
+                continue;
+            }
+
+            usize length = LZ4_MIN_MATCH;
+            while (i + length < match_limit && src[candidate + length] == src[i + length])
+                ++length;
+
+            op = lz4_write_sequence(op, oend, src + anchor, i - anchor, i - candidate, length);
+            if (op == NULL)
+                return 0;
+
+            i += length;
+            anchor = i;
+        }
+    }
+
+    op = lz4_write_sequence(op, oend, src + anchor, size - anchor, 0, 0);
+    return op ? (usize)(op - dst) : 0;
+}
+
+/* reads the 255 continued part of a length; returns false past the end. */
+static bool lz4_read_length(const u8** ip, const u8* iend, usize* length) {
+    u8 b;
+    do {
+        if (*ip >= iend)
+            return false;
+
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+
+    return true;
+}
+
+bool lz4_decompress(const u8* src, usize src_size, u8* dst, usize dst_size) {
+    const u8* ip = src;
+    const u8* iend = src + src_size;
+    u8* op = dst;
+    u8* oend = dst + dst_size;
+
+    while (ip < iend) {
+        u8 token = *ip++;
+
+        usize literals = token >> 4;
+        if (literals == 15 && !lz4_read_length(&ip, iend, &literals))
+            return false;
+
+        if (literals > (usize)(iend - ip) || literals > (usize)(oend - op))
+            return false;
+
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+
+        /* the last sequence has no match */
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return false;
+
+        usize offset = (usize)ip[0] | (usize)ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (usize)(op - dst))
+            return false;
+
+        usize length = token & 15;
+        if (length == 15 && !lz4_read_length(&ip, iend, &length))
+            return false;
+
+        length += LZ4_MIN_MATCH;
+        if (length > (usize)(oend - op))
+            return false;
+
+        const u8* match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+        } else {
+            /* overlapping: repeats the last `offset` bytes */
+            for (usize i = 0; i < length; ++i)
+                op[i] = match[i];
+        }
+
+        op += length;
+    }
+
+    return op == oend;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ * LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), without the frame format
+ * around it: the sizes are stored elsewhere, see archive_format.h.
+ *
+ * The compressor is a plain greedy one, for offline packing; the decompressor is what matters at runtime and
+ * checks every length against both buffers, so corrupt input fails instead of reading or writing out of bounds.
+ */
+
+/* the most lz4_compress() can write for `size` bytes of input. */
+static inline usize lz4_compress_bound(usize size) {
+    return size + size / 255 + 16;
+}
+
+/* returns the compressed size, 0 if it doesn't fit into `capacity`. */
+usize lz4_compress(const u8* src, usize size, u8* dst, usize capacity);
+
+/* returns false unless `src` decompresses into exactly `dst_size` bytes. */
+bool lz4_decompress(const u8* src, usize src_size, u8* dst, usize dst_size);
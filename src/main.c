@@ -1,18 +1,32 @@
 #include "renderer.h"
 #include "surface.h"
+#include "trace.h"
 
 // TODO: abstract
 #include <SDL3/SDL.h>
 #include <time.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 int main() {
+    TRACE_THREAD_NAME("main");
+    TRACE_DUMP_AT_EXIT("zulk_trace.json");
+
     Surface* surface = surface_create(1024, 768, "test");
 
     clock_t start = clock() / (CLOCKS_PER_SEC / 1000);
     Graphics* graphics = graphics_initialize(&(GraphicsConfiguration) {
         .app_name = surface_get_title(surface),
         .power_preference = GRAPHICS_HIGH_PERFORMANCE,
+        .msaa_samples = 4,
+        .dynamic_resolution = true,
+        .post_processing = true,
+        .max_particles = 1 << 20,
+        // see tools/pack
+        .asset_archive = getenv("ZULK_ASSETS"),
+        // the loop below only writes commands; rendering them overlaps with the next iteration
+        .render_thread = true,
 
         .version.major = 0,
         .version.minor = 1,
@@ -24,11 +38,107 @@ int main() {
 
     printf("took %ldms to init\n", end - start);
 
+    // replay it with tools/replay
+    const char* recording = getenv("ZULK_RECORD");
+    if (recording != NULL)
+        graphics_start_recording(graphics, recording);
+
+    // a mesh cooked with tools/mesh_cooker, drawn as a grid of instances that stretches into the distance
+    const char* mesh_path = getenv("ZULK_MESH");
+    GraphicsMesh mesh = mesh_path ? graphics_load_mesh(graphics, mesh_path) : GRAPHICS_INVALID_MESH;
+
+    // a fountain of about a million live particles
+    GraphicsParticleEmitter fountain = {
+        .position = { 0, 0, 0 },
+        .rate = 250000,
+        .velocity = { 0, 5, 0 },
+        .spread = 0.3f,
+        .lifetime = 4,
+        .size = 0.02f,
+        .gravity = 3,
+        .color = 0xff40a0ff,
+    };
+
+    // a 64x64 field of small lights bobbing over the meshes
+    static GraphicsLight lights[64 * 64];
+    for (int i = 0; i < 64 * 64; ++i) {
+        lights[i] = (GraphicsLight) {
+            .position = { (i % 64) * 0.35f - 11.2f, 0, -(i / 64) * 0.65f },
+            .radius = 1.5f,
+            .color = { (i * 7 % 13) / 12.0f, (i * 5 % 11) / 10.0f, (i * 3 % 7) / 6.0f },
+            .intensity = 2,
+        };
+    }
+
+    // a few larger ones that stay put and cast shadows, which are only rendered again where the orbiting mesh is
+    GraphicsLight shadowed_lights[4];
+    for (int i = 0; i < 4; ++i) {
+        shadowed_lights[i] = (GraphicsLight) {
+            .position = { (i % 2) * 10.0f - 5.0f, 4, -(i / 2) * 20.0f - 8.0f },
+            .radius = 12,
+            .color = { 1, 0.9f, 0.75f },
+            .intensity = 20,
+            .shadow_id = i + 1,
+        };
+    }
+
+    // a second window showing the same frames, presented together with the first one
+    Surface* mirror_surface = NULL;
+    GraphicsWindow mirror = GRAPHICS_INVALID_WINDOW;
+    if (getenv("ZULK_MIRROR") != NULL) {
+        mirror_surface = surface_create(640, 360, "mirror");
+        mirror = graphics_attach_surface(graphics, mirror_surface);
+    }
+
+    u64 last_frame = SDL_GetTicksNS();
     while (!surface_should_close(surface)) {
+        u64 now = SDL_GetTicksNS();
+        graphics_update_particles(graphics, &fountain, (float)(now - last_frame) / 1e9f);
+        last_frame = now;
+
+        if (mesh != GRAPHICS_INVALID_MESH) {
+            for (int z = 0; z < 16; ++z) {
+                for (int x = -4; x < 4; ++x) {
+                    float transform[16] = {
+                        1, 0, 0, 0,
+                        0, 1, 0, 0,
+                        0, 0, 1, 0,
+                        x * 2.5f + 1.25f, 1, -z * 2.5f - 2, 1,
+                    };
+                    graphics_draw_static_mesh(graphics, mesh, transform);
+                }
+            }
+
+            float t = (float)now / 1e9f;
+            float orbit[16] = {
+                1, 0, 0, 0,
+                0, 1, 0, 0,
+                0, 0, 1, 0,
+                cosf(t) * 6.0f - 5.0f, 2.5f, sinf(t) * 6.0f - 8.0f, 1,
+            };
+            graphics_draw_mesh(graphics, mesh, orbit);
+            graphics_add_lights(graphics, shadowed_lights, 4);
+
+            for (int i = 0; i < 64 * 64; ++i)
+                lights[i].position[1] = 1.25f + 0.75f * sinf(t + i * 0.37f);
+            graphics_add_lights(graphics, lights, 64 * 64);
+        }
+
         graphics_draw_frame(graphics);
         surface_poll_events(surface);
+
+        if (mirror_surface != NULL && surface_should_close(mirror_surface)) {
+            graphics_detach_surface(graphics, mirror);
+            surface_destroy(mirror_surface);
+            mirror_surface = NULL;
+        }
     }
 
+    if (mirror_surface != NULL)
+        graphics_detach_surface(graphics, mirror);
+
     graphics_deinitialize(graphics);
+    if (mirror_surface != NULL)
+        surface_destroy(mirror_surface);
     surface_destroy(surface);
 }
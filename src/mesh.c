@@ -0,0 +1,1698 @@
+#include "mesh.h"
+#include "mesh_format.h"
+#include "lights.h"
+#include "shadows.h"
+#include "renderer_internal.h"
+#include "gpu_memory.h"
+#include "arena.h"
+#include "io.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#define MESH_MAX_PATH (u32)260
+/* below everything else the residency manager holds: an evicted mesh comes back from its mapping */
+#define MESH_RESIDENCY_PRIORITY (u32)0
+/* buffers of evicted meshes and staging buffers of re-uploaded ones waiting for the frames in flight; more
+ * than this waits for the device. a frame stages two per mesh at most, which always fit after that. */
+#define MESH_MAX_RETIRED (MESH_MAX_MESHES * 4)
+
+/* per draw call; maxDrawIndirectCount is at least this much with multiDrawIndirect */
+#define MESH_MAX_INDIRECT_COUNT (u32)65535
+
+/* with occlusion culling: meshlets queued per frame, each becoming at most one draw, so a whole frame fits in a
+ * single draw call per mesh. and the chunks of up to MESH_CULL_GROUP_SIZE meshlets of one instance they are
+ * queued in, one workgroup each */
+#define MESH_MAX_CULL_MESHLETS MESH_MAX_INDIRECT_COUNT
+#define MESH_MAX_CULL_CHUNKS (u32)16384
+#define MESH_CULL_GROUP_SIZE (u32)64
+#define MESH_HIZ_GROUP_SIZE (u32)8
+#define MESH_SCATTER_GROUP_SIZE (u32)64
+
+/* one workgroup of mesh_cull.comp */
+typedef struct MeshCullChunk {
+    u32 slot;
+    u32 mesh;
+    /* into the meshlets of all meshes */
+    u32 first_meshlet;
+    u32 meshlet_count;
+    u32 first_visibility;
+    /* the region of the mesh's draws */
+    u32 first_command;
+    u32 reserved[2];
+} MeshCullChunk;
+
+/* the layout of the Frame buffer in mesh_cull.comp */
+typedef struct MeshCullFrame {
+    Mat4 view;
+    Vec4 planes[6];
+    float camera_position[4];
+    /* P00, P11, near and far */
+    float projection[4];
+    float render_size[2];
+    u32 hiz_levels;
+    u32 chunk_count;
+    MeshCullChunk chunks[];
+} MeshCullFrame;
+
+/* a frame's slice of the cull stream, padded to any minStorageBufferOffsetAlignment */
+#define MESH_CULL_FRAME_SIZE ((sizeof(MeshCullFrame) + sizeof(MeshCullChunk) * MESH_MAX_CULL_CHUNKS + 255) & ~(VkDeviceSize)255)
+
+/* a slot whose transform changed, as mesh_scatter.comp reads it */
+typedef struct MeshInstanceUpdate {
+    Mat4 transform;
+    u32 slot;
+    u32 reserved[3];
+} MeshInstanceUpdate;
+
+typedef struct MeshHizConstants {
+    s32 src_size[2];
+    s32 dst_size[2];
+    u32 level;
+} MeshHizConstants;
+
+/* the draws of one mesh: a range of the per frame commands without occlusion culling, a region of the GPU
+ * written ones with it */
+typedef struct MeshDrawRange {
+    u32 first;
+    u32 count;
+} MeshDrawRange;
+
+typedef struct Mesh {
+    char path[MESH_MAX_PATH];
+    MeshRenderer* renderer;
+
+    /* stays mapped while the mesh is loaded; header and meshlets point into it */
+    FileView view;
+    const MeshFileHeader* header;
+    const MeshMeshlet* meshlets;
+
+    VkBuffer vertices;
+    GpuAllocation vertex_memory;
+    VkBuffer indices;
+    GpuAllocation index_memory;
+
+    /* where its meshlets start in MeshRenderer.meshlets */
+    u32 first_cull_meshlet;
+
+    /* the buffers are VK_NULL_HANDLE while evicted, until a frame queues the mesh again. each buffer is
+     * registered on the heap its memory is in, which needn't be the same for both. */
+    ResidencyHandle vertex_residency;
+    ResidencyHandle index_residency;
+} Mesh;
+
+/* a buffer of an evicted mesh or a staging buffer, freed once the frames that could still use it are done. */
+typedef struct MeshRetired {
+    VkBuffer buffer;
+    GpuAllocation memory;
+    /* the residency frame it was retired in */
+    u64 frame;
+} MeshRetired;
+
+/* a copy from a staging buffer into a re-uploaded mesh's buffer, recorded by the frame that queued it. */
+typedef struct MeshCopy {
+    VkBuffer staging;
+    VkBuffer buffer;
+    VkDeviceSize size;
+} MeshCopy;
+
+typedef struct MeshInstance {
+    GraphicsMesh mesh;
+    Mat4 transform;
+    bool is_static;
+} MeshInstance;
+
+enum MeshPipelineKind {
+    MESH_PIPELINE_LIT,
+    /* without color, into the single sampled occlusion depth buffer */
+    MESH_PIPELINE_OCCLUDERS,
+    /* without color, into the shadow atlas; biased, and not culled since lights see casters from any side */
+    MESH_PIPELINE_SHADOWS,
+};
+
+struct MeshRenderer {
+    VulkanGraphics* graphics;
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+    VkPipeline shadow_pipeline;
+
+    /* a MESH_MAX_DRAWS slice of commands per frame in flight */
+    VkBuffer commands;
+    GpuAllocation commands_memory;
+    VkDrawIndexedIndirectCommand* commands_mapped;
+
+    /* the transform of every slot, resident on the GPU; a frame uploads the slots that changed into its
+     * MESH_MAX_INSTANCES slice of updates, which mesh_scatter.comp writes into place */
+    VkBuffer transforms;
+    GpuAllocation transforms_memory;
+    VkBuffer updates;
+    GpuAllocation updates_memory;
+    MeshInstanceUpdate* updates_mapped;
+    u32 updates_count;
+
+    VkDescriptorSetLayout scatter_set_layout;
+    VkDescriptorSet scatter_sets[MAX_FRAMES_IN_FLIGHT];
+    VkPipelineLayout scatter_layout;
+    VkPipeline scatter_pipeline;
+
+    /* what the resident transforms hold, as far as the slots that have been uploaded go */
+    u32 resident_count;
+    Mat4 resident[MESH_MAX_INSTANCES];
+
+    u32 meshes_count;
+    Mesh meshes[MESH_MAX_MESHES];
+
+    u32 retired_count;
+    MeshRetired retired[MESH_MAX_RETIRED];
+
+    /* left by mesh_renderer_prepare() for mesh_renderer_upload() */
+    u32 copies_count;
+    MeshCopy copies[MESH_MAX_MESHES * 2];
+
+    u32 instances_count;
+    MeshInstance instances[MESH_MAX_INSTANCES];
+
+    /* the instances of the last prepared frame, for the shadow atlas */
+    u32 casters_count;
+    MeshCaster casters[MESH_MAX_INSTANCES];
+    /* the LOD each instance is drawn at, NULL out of view; picked on the job system, see mesh_prepare_instances() */
+    const MeshLod* lods[MESH_MAX_INSTANCES];
+
+    /* what mesh_renderer_prepare() left for the passes */
+    Mat4 view_projection;
+    MeshDrawRange draws[MESH_MAX_MESHES];
+    u32 chunk_count;
+    VkExtent2D render_extent;
+    u32 hiz_levels;
+
+    /* everything below is for occlusion culling only */
+    bool occlusion_culling;
+
+    VkPipeline depth_pipeline;
+    VkSampler sampler;
+    VkDescriptorPool cull_descriptor_pool;
+
+    VkDescriptorSetLayout cull_set_layout;
+    VkDescriptorSet cull_sets[MAX_FRAMES_IN_FLIGHT];
+    VkPipelineLayout cull_layout;
+    VkPipeline cull_pipeline;
+
+    /* one set per level, reading the level before */
+    VkDescriptorSetLayout hiz_set_layout;
+    VkDescriptorSet hiz_sets[MESH_HIZ_MAX_LEVELS];
+    VkPipelineLayout hiz_layout;
+    VkPipeline hiz_pipeline;
+
+    VkImage hiz;
+    VkImageView hiz_views[MESH_HIZ_MAX_LEVELS];
+    u32 hiz_mip_levels;
+
+    /* the meshlets of every mesh, back to back */
+    VkBuffer meshlets;
+    GpuAllocation meshlets_memory;
+    u32 meshlets_count;
+
+    /* a MESH_CULL_FRAME_SIZE slice per frame in flight */
+    VkBuffer cull_frames;
+    GpuAllocation cull_frames_memory;
+    byte* cull_frames_mapped;
+
+    /* MESH_MAX_CULL_MESHLETS draws per phase, and a draw count per phase and mesh followed by the triangles
+     * drawn in the main phase; they only live on the GPU */
+    VkBuffer cull_commands;
+    GpuAllocation cull_commands_memory;
+    VkBuffer cull_counts;
+    GpuAllocation cull_counts_memory;
+
+    /* a u32 per queued meshlet, nonzero where it was visible in the last main phase */
+    VkBuffer visibility;
+    GpuAllocation visibility_memory;
+    bool visibility_cleared;
+
+    /* the main phase's triangle count, a u32 per frame in flight */
+    VkBuffer readback;
+    GpuAllocation readback_memory;
+    u32* readback_mapped;
+
+    u64 triangles;
+    u64 triangles_drawn;
+};
+
+static VkPipeline mesh_renderer_create_pipeline(MeshRenderer* renderer, enum MeshPipelineKind kind) {
+    VulkanGraphics* graphics = renderer->graphics;
+    bool depth_only = kind != MESH_PIPELINE_LIT;
+
+    const char* vertex_path = "shaders/bin/vulkan_mesh.vert.spv";
+    VkShaderModule vertex = vk_load_shader_module(graphics, vertex_path);
+    VkShaderModule fragment = vk_load_shader_module(graphics, "shaders/bin/vulkan_mesh.frag.spv");
+
+    /* the fragment stage goes last so depth only pipelines can leave it out */
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertex,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragment,
+            .pName = "main",
+        },
+    };
+
+    VkDynamicState dynamic_states[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = ZARRSIZ(dynamic_states),
+        .pDynamicStates = dynamic_states,
+    };
+
+    VkVertexInputBindingDescription binding = {
+        .binding = 0,
+        .stride = sizeof(MeshVertex),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    };
+
+    /* the formats are the shader's, by location; only where they are in a MeshVertex is up to us */
+    ShaderReflection reflection;
+    vk_reflect_shaders(graphics, &vertex_path, 1, &reflection);
+
+    const u32 offsets[] = { offsetof(MeshVertex, position), offsetof(MeshVertex, normal) };
+    VkVertexInputAttributeDescription attributes[REFLECT_MAX_INPUTS];
+    u32 attribute_count = shader_reflect_vertex_attributes(&reflection, 0, offsets, ZARRSIZ(offsets), attributes);
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding,
+        .vertexAttributeDescriptionCount = attribute_count,
+        .pVertexAttributeDescriptions = attributes,
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    };
+
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    /* counter clockwise in the mesh stays counter clockwise, the projection flips y */
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1,
+        .cullMode = kind == MESH_PIPELINE_SHADOWS ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        /* in units of the atlas' 16 bit depth, plus more on slopes where texels cover a long stretch of depth */
+        .depthBiasEnable = kind == MESH_PIPELINE_SHADOWS,
+        .depthBiasConstantFactor = 2.0f,
+        .depthBiasSlopeFactor = 2.0f,
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = depth_only ? VK_SAMPLE_COUNT_1_BIT : graphics->msaa_samples,
+    };
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+    };
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = depth_only ? 0 : 1,
+        .pAttachments = &color_blend_attachment,
+    };
+
+    VkPipelineRenderingCreateInfo rendering_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = depth_only ? 0 : 1,
+        .pColorAttachmentFormats = &graphics->scene_format,
+        .depthAttachmentFormat = kind == MESH_PIPELINE_SHADOWS ? SHADOW_ATLAS_FORMAT : graphics->depth_format,
+    };
+
+    VkGraphicsPipelineCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = &rendering_info,
+        .stageCount = depth_only ? 1 : ZARRSIZ(stages),
+        .pStages = stages,
+
+        .pVertexInputState = &vertex_input,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisample,
+        .pDepthStencilState = &depth_stencil,
+        .pColorBlendState = &color_blending,
+        .pDynamicState = &dynamic_state,
+
+        .layout = renderer->pipeline_layout,
+    };
+
+    VkPipeline pipeline;
+    ERR_CHECK(vkCreateGraphicsPipelines(graphics->device, VK_NULL_HANDLE, 1, &info, NULL, &pipeline), "mesh pipeline");
+
+    vkDestroyShaderModule(graphics->device, vertex, NULL);
+    vkDestroyShaderModule(graphics->device, fragment, NULL);
+
+    return pipeline;
+}
+
+/* a host visible buffer covering every frame in flight, mapped for good. */
+static void* mesh_renderer_create_stream(MeshRenderer* renderer, VkBufferUsageFlags usage, VkDeviceSize size, VkBuffer* buffer, GpuAllocation* memory) {
+    VulkanGraphics* graphics = renderer->graphics;
+
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size * MAX_FRAMES_IN_FLIGHT,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    ERR_CHECK(vkCreateBuffer(graphics->device, &info, NULL, buffer), "mesh stream buffer");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(graphics->device, *buffer, &reqs);
+
+    *memory = gpu_memory_allocate(graphics->device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GRAPHICS_MEMORY_BUFFERS);
+    if (memory->memory == VK_NULL_HANDLE) {
+        fprintf(stderr, "couldn't allocate a mesh stream!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ERR_CHECK(vkBindBufferMemory(graphics->device, *buffer, memory->memory, 0), "mesh stream binding");
+
+    void* mapped;
+    ERR_CHECK(vkMapMemory(graphics->device, memory->memory, 0, VK_WHOLE_SIZE, 0, &mapped), "mesh stream mapping");
+    return mapped;
+}
+
+static void mesh_renderer_create_descriptors(MeshRenderer* renderer) {
+    VkDevice device = renderer->graphics->device;
+
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+    };
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+
+    ERR_CHECK(vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &renderer->set_layout), "mesh descriptor set layout");
+
+    /* and the sets of mesh_scatter.comp, with two buffers each */
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT,
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 2 * MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+
+    ERR_CHECK(vkCreateDescriptorPool(device, &pool_info, NULL, &renderer->descriptor_pool), "mesh descriptor pool");
+
+    VkDescriptorSetLayout set_layouts[MAX_FRAMES_IN_FLIGHT];
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        set_layouts[i] = renderer->set_layout;
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = renderer->descriptor_pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = set_layouts,
+    };
+
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, renderer->sets), "mesh descriptor sets");
+
+    /* the transforms are resident, every set sees the same ones */
+    VkDescriptorBufferInfo buffer_infos[MAX_FRAMES_IN_FLIGHT];
+    VkWriteDescriptorSet writes[MAX_FRAMES_IN_FLIGHT];
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        buffer_infos[i] = (VkDescriptorBufferInfo) { renderer->transforms, 0, VK_WHOLE_SIZE };
+        writes[i] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = renderer->sets[i],
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &buffer_infos[i],
+        };
+    }
+
+    vkUpdateDescriptorSets(device, ZARRSIZ(writes), writes, 0, NULL);
+
+    /* the fragment shader is lit by the light clusters and shadowed by the atlas */
+    VkDescriptorSetLayout pipeline_set_layouts[] = { renderer->set_layout, light_clusters_set_layout(renderer->graphics->lights), shadow_atlas_set_layout(renderer->graphics->shadows) };
+
+    VkPipelineLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = ZARRSIZ(pipeline_set_layouts),
+        .pSetLayouts = pipeline_set_layouts,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Mat4) },
+    };
+
+    ERR_CHECK(vkCreatePipelineLayout(device, &layout_info, NULL, &renderer->pipeline_layout), "mesh pipeline layout");
+}
+
+/* a device local buffer only the GPU writes to. */
+static void mesh_renderer_create_gpu_buffer(MeshRenderer* renderer, VkBufferUsageFlags usage, VkDeviceSize size, VkBuffer* buffer, GpuAllocation* memory) {
+    VulkanGraphics* graphics = renderer->graphics;
+
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    ERR_CHECK(vkCreateBuffer(graphics->device, &info, NULL, buffer), "mesh culling buffer");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(graphics->device, *buffer, &reqs);
+
+    *memory = gpu_memory_allocate(graphics->device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, GRAPHICS_MEMORY_BUFFERS);
+    if (memory->memory == VK_NULL_HANDLE) {
+        fprintf(stderr, "couldn't allocate a mesh culling buffer!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ERR_CHECK(vkBindBufferMemory(graphics->device, *buffer, memory->memory, 0), "mesh culling buffer binding");
+}
+
+static VkDescriptorSetLayout mesh_create_set_layout(VkDevice device, const VkDescriptorType* types, u32 count) {
+    VkDescriptorSetLayoutBinding bindings[8];
+    for (u32 i = 0; i < count; ++i) {
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = types[i],
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = count,
+        .pBindings = bindings,
+    };
+
+    VkDescriptorSetLayout layout;
+    ERR_CHECK(vkCreateDescriptorSetLayout(device, &info, NULL, &layout), "mesh culling descriptor set layout");
+    return layout;
+}
+
+static VkPipelineLayout mesh_create_compute_layout(VkDevice device, VkDescriptorSetLayout set_layout, u32 push_constants_size) {
+    VkPipelineLayoutCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) { VK_SHADER_STAGE_COMPUTE_BIT, 0, push_constants_size },
+    };
+
+    VkPipelineLayout layout;
+    ERR_CHECK(vkCreatePipelineLayout(device, &info, NULL, &layout), "mesh culling pipeline layout");
+    return layout;
+}
+
+static void mesh_renderer_create_scatter(MeshRenderer* renderer) {
+    VulkanGraphics* graphics = renderer->graphics;
+    VkDevice device = graphics->device;
+
+    renderer->updates_mapped = mesh_renderer_create_stream(renderer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, (VkDeviceSize)sizeof(MeshInstanceUpdate) * MESH_MAX_INSTANCES, &renderer->updates, &renderer->updates_memory);
+
+    /* the frame's updates and the transforms; see mesh_scatter.comp */
+    const VkDescriptorType types[] = {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    };
+
+    renderer->scatter_set_layout = mesh_create_set_layout(device, types, ZARRSIZ(types));
+
+    VkDescriptorSetLayout set_layouts[MAX_FRAMES_IN_FLIGHT];
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        set_layouts[i] = renderer->scatter_set_layout;
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = renderer->descriptor_pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = set_layouts,
+    };
+
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, renderer->scatter_sets), "mesh scatter descriptor sets");
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorBufferInfo buffer_infos[] = {
+            { renderer->updates, (VkDeviceSize)sizeof(MeshInstanceUpdate) * MESH_MAX_INSTANCES * i, (VkDeviceSize)sizeof(MeshInstanceUpdate) * MESH_MAX_INSTANCES },
+            { renderer->transforms, 0, VK_WHOLE_SIZE },
+        };
+
+        VkWriteDescriptorSet writes[ZARRSIZ(buffer_infos)];
+        for (u32 j = 0; j < ZARRSIZ(buffer_infos); ++j) {
+            writes[j] = (VkWriteDescriptorSet) {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = renderer->scatter_sets[i],
+                .dstBinding = j,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &buffer_infos[j],
+            };
+        }
+
+        vkUpdateDescriptorSets(device, ZARRSIZ(writes), writes, 0, NULL);
+    }
+
+    renderer->scatter_layout = mesh_create_compute_layout(device, renderer->scatter_set_layout, sizeof(u32));
+    renderer->scatter_pipeline = vk_create_compute_pipeline(graphics, "shaders/bin/vulkan_mesh_scatter.comp.spv", renderer->scatter_layout, 0);
+
+    /* nothing has been uploaded yet, so the first frame uploads every slot it uses */
+    renderer->resident_count = 0;
+    renderer->updates_count = 0;
+}
+
+static void mesh_renderer_create_culling(MeshRenderer* renderer) {
+    VulkanGraphics* graphics = renderer->graphics;
+    VkDevice device = graphics->device;
+
+    mesh_renderer_create_gpu_buffer(renderer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, (VkDeviceSize)sizeof(MeshMeshlet) * MESH_MAX_MESHLETS, &renderer->meshlets, &renderer->meshlets_memory);
+    mesh_renderer_create_gpu_buffer(renderer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, (VkDeviceSize)sizeof(VkDrawIndexedIndirectCommand) * MESH_MAX_CULL_MESHLETS * 2, &renderer->cull_commands, &renderer->cull_commands_memory);
+    mesh_renderer_create_gpu_buffer(renderer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, (VkDeviceSize)sizeof(u32) * (MESH_MAX_MESHES * 2 + 1), &renderer->cull_counts, &renderer->cull_counts_memory);
+    mesh_renderer_create_gpu_buffer(renderer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, (VkDeviceSize)sizeof(u32) * MESH_MAX_CULL_MESHLETS, &renderer->visibility, &renderer->visibility_memory);
+
+    renderer->cull_frames_mapped = mesh_renderer_create_stream(renderer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MESH_CULL_FRAME_SIZE, &renderer->cull_frames, &renderer->cull_frames_memory);
+    renderer->readback_mapped = mesh_renderer_create_stream(renderer, VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(u32), &renderer->readback, &renderer->readback_memory);
+    memset(renderer->readback_mapped, 0, sizeof(u32) * MAX_FRAMES_IN_FLIGHT);
+
+    /* only ever fetched from, texel by texel */
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = VK_LOD_CLAMP_NONE,
+    };
+
+    ERR_CHECK(vkCreateSampler(device, &sampler_info, NULL, &renderer->sampler), "mesh culling sampler");
+
+    /* frame, meshlets, transforms, visibility, commands, counts and the pyramid; see mesh_cull.comp */
+    const VkDescriptorType cull_types[] = {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    };
+
+    /* depth, the level before and the level written; see hiz_reduce.comp */
+    const VkDescriptorType hiz_types[] = {
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+    };
+
+    renderer->cull_set_layout = mesh_create_set_layout(device, cull_types, ZARRSIZ(cull_types));
+    renderer->hiz_set_layout = mesh_create_set_layout(device, hiz_types, ZARRSIZ(hiz_types));
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 * MAX_FRAMES_IN_FLIGHT },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT + MESH_HIZ_MAX_LEVELS },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 * MESH_HIZ_MAX_LEVELS },
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = MAX_FRAMES_IN_FLIGHT + MESH_HIZ_MAX_LEVELS,
+        .poolSizeCount = ZARRSIZ(pool_sizes),
+        .pPoolSizes = pool_sizes,
+    };
+
+    ERR_CHECK(vkCreateDescriptorPool(device, &pool_info, NULL, &renderer->cull_descriptor_pool), "mesh culling descriptor pool");
+
+    VkDescriptorSetLayout set_layouts[MESH_HIZ_MAX_LEVELS];
+    for (u32 i = 0; i < MESH_HIZ_MAX_LEVELS; ++i)
+        set_layouts[i] = renderer->cull_set_layout;
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = renderer->cull_descriptor_pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = set_layouts,
+    };
+
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, renderer->cull_sets), "mesh culling descriptor sets");
+
+    for (u32 i = 0; i < MESH_HIZ_MAX_LEVELS; ++i)
+        set_layouts[i] = renderer->hiz_set_layout;
+
+    set_info.descriptorSetCount = MESH_HIZ_MAX_LEVELS;
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, renderer->hiz_sets), "hiz descriptor sets");
+
+    /* the buffers never change; the pyramid is written by mesh_renderer_set_targets() */
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorBufferInfo buffer_infos[] = {
+            { renderer->cull_frames, MESH_CULL_FRAME_SIZE * i, MESH_CULL_FRAME_SIZE },
+            { renderer->meshlets, 0, VK_WHOLE_SIZE },
+            { renderer->transforms, 0, VK_WHOLE_SIZE },
+            { renderer->visibility, 0, VK_WHOLE_SIZE },
+            { renderer->cull_commands, 0, VK_WHOLE_SIZE },
+            { renderer->cull_counts, 0, VK_WHOLE_SIZE },
+        };
+
+        VkWriteDescriptorSet writes[ZARRSIZ(buffer_infos)];
+        for (u32 j = 0; j < ZARRSIZ(buffer_infos); ++j) {
+            writes[j] = (VkWriteDescriptorSet) {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = renderer->cull_sets[i],
+                .dstBinding = j,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &buffer_infos[j],
+            };
+        }
+
+        vkUpdateDescriptorSets(device, ZARRSIZ(writes), writes, 0, NULL);
+    }
+
+    renderer->cull_layout = mesh_create_compute_layout(device, renderer->cull_set_layout, sizeof(u32));
+    renderer->hiz_layout = mesh_create_compute_layout(device, renderer->hiz_set_layout, sizeof(MeshHizConstants));
+
+    renderer->cull_pipeline = vk_create_compute_pipeline(graphics, "shaders/bin/vulkan_mesh_cull.comp.spv", renderer->cull_layout, 0);
+    renderer->hiz_pipeline = vk_create_compute_pipeline(graphics, "shaders/bin/vulkan_hiz_reduce.comp.spv", renderer->hiz_layout, 0);
+    renderer->depth_pipeline = mesh_renderer_create_pipeline(renderer, MESH_PIPELINE_OCCLUDERS);
+}
+
+static void mesh_renderer_destroy_hiz_views(MeshRenderer* renderer) {
+    for (u32 i = 0; i < renderer->hiz_mip_levels; ++i)
+        vkDestroyImageView(renderer->graphics->device, renderer->hiz_views[i], NULL);
+
+    renderer->hiz_mip_levels = 0;
+}
+
+static void mesh_renderer_destroy_culling(MeshRenderer* renderer) {
+    VkDevice device = renderer->graphics->device;
+
+    mesh_renderer_destroy_hiz_views(renderer);
+
+    vkDestroyPipeline(device, renderer->depth_pipeline, NULL);
+    vkDestroyPipeline(device, renderer->cull_pipeline, NULL);
+    vkDestroyPipeline(device, renderer->hiz_pipeline, NULL);
+    vkDestroyPipelineLayout(device, renderer->cull_layout, NULL);
+    vkDestroyPipelineLayout(device, renderer->hiz_layout, NULL);
+    vkDestroyDescriptorPool(device, renderer->cull_descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, renderer->cull_set_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, renderer->hiz_set_layout, NULL);
+    vkDestroySampler(device, renderer->sampler, NULL);
+
+    VkBuffer buffers[] = { renderer->meshlets, renderer->cull_commands, renderer->cull_counts, renderer->visibility };
+    GpuAllocation* allocations[] = { &renderer->meshlets_memory, &renderer->cull_commands_memory, &renderer->cull_counts_memory, &renderer->visibility_memory };
+    for (u32 i = 0; i < ZARRSIZ(buffers); ++i) {
+        vkDestroyBuffer(device, buffers[i], NULL);
+        gpu_memory_free(device, allocations[i]);
+    }
+
+    vkUnmapMemory(device, renderer->cull_frames_memory.memory);
+    vkDestroyBuffer(device, renderer->cull_frames, NULL);
+    gpu_memory_free(device, &renderer->cull_frames_memory);
+
+    vkUnmapMemory(device, renderer->readback_memory.memory);
+    vkDestroyBuffer(device, renderer->readback, NULL);
+    gpu_memory_free(device, &renderer->readback_memory);
+}
+
+MeshRenderer* mesh_renderer_create(VulkanGraphics* graphics) {
+    MeshRenderer* renderer = heap_calloc(1, sizeof(MeshRenderer));
+    renderer->graphics = graphics;
+
+    renderer->commands_mapped = mesh_renderer_create_stream(renderer, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, (VkDeviceSize)sizeof(VkDrawIndexedIndirectCommand) * MESH_MAX_DRAWS, &renderer->commands, &renderer->commands_memory);
+
+    mesh_renderer_create_gpu_buffer(renderer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, (VkDeviceSize)sizeof(Mat4) * MESH_MAX_INSTANCES, &renderer->transforms, &renderer->transforms_memory);
+    mesh_renderer_create_descriptors(renderer);
+    mesh_renderer_create_scatter(renderer);
+    renderer->pipeline = mesh_renderer_create_pipeline(renderer, MESH_PIPELINE_LIT);
+    renderer->shadow_pipeline = mesh_renderer_create_pipeline(renderer, MESH_PIPELINE_SHADOWS);
+
+    renderer->occlusion_culling = graphics->occlusion_culling;
+    if (renderer->occlusion_culling)
+        mesh_renderer_create_culling(renderer);
+
+    return renderer;
+}
+
+static void mesh_release_buffers(VulkanGraphics* graphics, Mesh* mesh) {
+    if (mesh->vertices) {
+        vkDestroyBuffer(graphics->device, mesh->vertices, NULL);
+        gpu_memory_free(graphics->device, &mesh->vertex_memory);
+        mesh->vertices = VK_NULL_HANDLE;
+    }
+
+    if (mesh->indices) {
+        vkDestroyBuffer(graphics->device, mesh->indices, NULL);
+        gpu_memory_free(graphics->device, &mesh->index_memory);
+        mesh->indices = VK_NULL_HANDLE;
+    }
+}
+
+/* frees the retired buffers evicted before residency frame `done`, which the GPU has finished with. */
+static void mesh_free_retired(MeshRenderer* renderer, u64 done) {
+    VkDevice device = renderer->graphics->device;
+
+    u32 kept = 0;
+    for (u32 i = 0; i < renderer->retired_count; ++i) {
+        MeshRetired* retired = &renderer->retired[i];
+        if (retired->frame < done) {
+            vkDestroyBuffer(device, retired->buffer, NULL);
+            gpu_memory_free(device, &retired->memory);
+        } else {
+            renderer->retired[kept++] = *retired;
+        }
+    }
+
+    renderer->retired_count = kept;
+}
+
+/* hands a buffer to the GPU's frames in flight, which may still use it. */
+static void mesh_retire(MeshRenderer* renderer, VkBuffer buffer, GpuAllocation memory) {
+    u64 frame = renderer->graphics->residency.frame;
+
+    /* what earlier frames retired is done once the device is idle; this frame's copies aren't submitted yet */
+    if (renderer->retired_count >= MESH_MAX_RETIRED) {
+        vkDeviceWaitIdle(renderer->graphics->device);
+        mesh_free_retired(renderer, frame);
+    }
+
+    renderer->retired[renderer->retired_count++] = (MeshRetired) { buffer, memory, frame };
+}
+
+void mesh_renderer_destroy(MeshRenderer* renderer) {
+    VkDevice device = renderer->graphics->device;
+
+    for (u32 i = 0; i < renderer->meshes_count; ++i) {
+        Mesh* mesh = &renderer->meshes[i];
+
+        residency_unregister(&renderer->graphics->residency, mesh->vertex_residency);
+        residency_unregister(&renderer->graphics->residency, mesh->index_residency);
+        vkDestroyBuffer(device, mesh->vertices, NULL);
+        gpu_memory_free(device, &mesh->vertex_memory);
+        vkDestroyBuffer(device, mesh->indices, NULL);
+        gpu_memory_free(device, &mesh->index_memory);
+        file_view_close(&mesh->view);
+    }
+
+    for (u32 i = 0; i < renderer->retired_count; ++i) {
+        vkDestroyBuffer(device, renderer->retired[i].buffer, NULL);
+        gpu_memory_free(device, &renderer->retired[i].memory);
+    }
+
+    if (renderer->occlusion_culling)
+        mesh_renderer_destroy_culling(renderer);
+
+    vkDestroyPipeline(device, renderer->pipeline, NULL);
+    vkDestroyPipeline(device, renderer->shadow_pipeline, NULL);
+    vkDestroyPipelineLayout(device, renderer->pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, renderer->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, renderer->set_layout, NULL);
+
+    vkUnmapMemory(device, renderer->commands_memory.memory);
+    vkDestroyBuffer(device, renderer->commands, NULL);
+    gpu_memory_free(device, &renderer->commands_memory);
+
+    vkDestroyPipeline(device, renderer->scatter_pipeline, NULL);
+    vkDestroyPipelineLayout(device, renderer->scatter_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, renderer->scatter_set_layout, NULL);
+
+    vkDestroyBuffer(device, renderer->transforms, NULL);
+    gpu_memory_free(device, &renderer->transforms_memory);
+
+    vkUnmapMemory(device, renderer->updates_memory.memory);
+    vkDestroyBuffer(device, renderer->updates, NULL);
+    gpu_memory_free(device, &renderer->updates_memory);
+
+    heap_free(renderer);
+}
+
+static bool mesh_section_fits(const FileView* view, u64 offset, u64 count, u64 element_size) {
+    return offset % 16 == 0 && offset <= view->length && count <= (view->length - offset) / element_size;
+}
+
+/* the file is trusted only as far as nothing in it points outside of it. */
+static bool mesh_validate(const FileView* view) {
+    if (view->length < sizeof(MeshFileHeader))
+        return false;
+
+    const MeshFileHeader* header = (const MeshFileHeader*)view->data;
+    if (header->magic != MESH_MAGIC || header->version != MESH_VERSION)
+        return false;
+
+    if (header->lod_count == 0 || header->lod_count > MESH_MAX_LODS || header->vertex_count == 0 || header->index_count == 0)
+        return false;
+
+    if (!mesh_section_fits(view, header->meshlets_offset, header->meshlet_count, sizeof(MeshMeshlet))
+        || !mesh_section_fits(view, header->vertices_offset, header->vertex_count, sizeof(MeshVertex))
+        || !mesh_section_fits(view, header->indices_offset, header->index_count, sizeof(u32)))
+        return false;
+
+    for (u32 i = 0; i < header->lod_count; ++i) {
+        const MeshLod* lod = &header->lods[i];
+        if (lod->first_meshlet > header->meshlet_count || lod->meshlet_count > header->meshlet_count - lod->first_meshlet)
+            return false;
+    }
+
+    const MeshMeshlet* meshlets = (const MeshMeshlet*)(view->data + header->meshlets_offset);
+    for (u32 i = 0; i < header->meshlet_count; ++i) {
+        if (meshlets[i].first_index > header->index_count || meshlets[i].index_count > header->index_count - meshlets[i].first_index)
+            return false;
+    }
+
+    /* vertex indices are checked by robustBufferAccess at best, so they're the cooker's responsibility */
+    return true;
+}
+
+/* uploads the vertices and indices out of the mapping; both buffers or neither. */
+static bool mesh_upload_buffers(VulkanGraphics* graphics, Mesh* mesh) {
+    const MeshFileHeader* header = mesh->header;
+
+    mesh->vertices = vk_create_buffer_with_data(graphics, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, mesh->view.data + header->vertices_offset, (VkDeviceSize)header->vertex_count * sizeof(MeshVertex), &mesh->vertex_memory);
+    mesh->indices = vk_create_buffer_with_data(graphics, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, mesh->view.data + header->indices_offset, (VkDeviceSize)header->index_count * sizeof(u32), &mesh->index_memory);
+
+    if (mesh->vertices == VK_NULL_HANDLE || mesh->indices == VK_NULL_HANDLE) {
+        mesh_release_buffers(graphics, mesh);
+        return false;
+    }
+
+    return true;
+}
+
+/* creates the buffer and queues the copy of its contents into this frame. */
+static VkBuffer mesh_stage_buffer(MeshRenderer* renderer, VkBufferUsageFlags usage, const void* data, VkDeviceSize size, GpuAllocation* memory) {
+    VulkanGraphics* graphics = renderer->graphics;
+
+    VkBuffer buffer = vk_create_buffer(graphics, usage, size, memory);
+    if (buffer == VK_NULL_HANDLE)
+        return VK_NULL_HANDLE;
+
+    GpuAllocation staging_memory;
+    VkBuffer staging = vk_create_staging_buffer(graphics, data, size, &staging_memory);
+    if (staging == VK_NULL_HANDLE) {
+        vkDestroyBuffer(graphics->device, buffer, NULL);
+        gpu_memory_free(graphics->device, memory);
+        return VK_NULL_HANDLE;
+    }
+
+    mesh_retire(renderer, staging, staging_memory);
+    renderer->copies[renderer->copies_count++] = (MeshCopy) { staging, buffer, size };
+
+    return buffer;
+}
+
+/* mesh_upload_buffers() for a frame being prepared: the copies go into its command buffer, by
+ * mesh_renderer_upload(), rather than being waited for. */
+static bool mesh_stage_buffers(MeshRenderer* renderer, Mesh* mesh) {
+    const MeshFileHeader* header = mesh->header;
+    u32 copies_count = renderer->copies_count;
+
+    mesh->vertices = mesh_stage_buffer(renderer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, mesh->view.data + header->vertices_offset, (VkDeviceSize)header->vertex_count * sizeof(MeshVertex), &mesh->vertex_memory);
+    mesh->indices = mesh_stage_buffer(renderer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, mesh->view.data + header->indices_offset, (VkDeviceSize)header->index_count * sizeof(u32), &mesh->index_memory);
+
+    if (mesh->vertices == VK_NULL_HANDLE || mesh->indices == VK_NULL_HANDLE) {
+        /* the staging buffers are retired already */
+        renderer->copies_count = copies_count;
+        mesh_release_buffers(renderer->graphics, mesh);
+        return false;
+    }
+
+    return true;
+}
+
+/* the residency manager shrinking a mesh: the buffers go, and the GPU may still be drawing from them. */
+static VkDeviceSize mesh_evict(void* data) {
+    Mesh* mesh = data;
+    MeshRenderer* renderer = mesh->renderer;
+    VulkanGraphics* graphics = renderer->graphics;
+
+    if (mesh->vertices == VK_NULL_HANDLE)
+        return 0;
+
+    mesh_retire(renderer, mesh->vertices, mesh->vertex_memory);
+    mesh_retire(renderer, mesh->indices, mesh->index_memory);
+
+    mesh->vertices = VK_NULL_HANDLE;
+    mesh->vertex_memory = (GpuAllocation) { VK_NULL_HANDLE };
+    mesh->indices = VK_NULL_HANDLE;
+    mesh->index_memory = (GpuAllocation) { VK_NULL_HANDLE };
+
+    /* whichever buffer was picked, the other one went with it */
+    residency_set_size(&graphics->residency, mesh->vertex_residency, 0);
+    residency_set_size(&graphics->residency, mesh->index_residency, 0);
+
+    return 0;
+}
+
+/* registers the buffers just uploaded, on the heaps they landed in. */
+static void mesh_register_residency(VulkanGraphics* graphics, Mesh* mesh) {
+    mesh->vertex_residency = residency_register(&graphics->residency, mesh->path, mesh->vertex_memory.heap, mesh->vertex_memory.size, MESH_RESIDENCY_PRIORITY, mesh_evict, mesh);
+    mesh->index_residency = residency_register(&graphics->residency, mesh->path, mesh->index_memory.heap, mesh->index_memory.size, MESH_RESIDENCY_PRIORITY, mesh_evict, mesh);
+}
+
+GraphicsMesh mesh_renderer_load(MeshRenderer* renderer, const char* path) {
+    TRACE_ZONE("mesh_renderer_load");
+
+    if (renderer->meshes_count >= MESH_MAX_MESHES) {
+        fprintf(stderr, "too many meshes (max %u), can't load %s\n", MESH_MAX_MESHES, path);
+        return GRAPHICS_INVALID_MESH;
+    }
+
+    if (strlen(path) >= MESH_MAX_PATH) {
+        fprintf(stderr, "mesh path too long: %s\n", path);
+        return GRAPHICS_INVALID_MESH;
+    }
+
+    Mesh* mesh = &renderer->meshes[renderer->meshes_count];
+    mesh->view = file_view_open(path);
+    if (mesh->view.data == NULL) {
+        fprintf(stderr, "couldn't open mesh %s\n", path);
+        return GRAPHICS_INVALID_MESH;
+    }
+
+    /* all of it is uploaded right away */
+    file_view_advise(&mesh->view, 0, mesh->view.length, FILE_ADVICE_WILLNEED);
+
+    if (!mesh_validate(&mesh->view)) {
+        fprintf(stderr, "%s isn't a valid mesh (version %u expected)\n", path, MESH_VERSION);
+        file_view_close(&mesh->view);
+        return GRAPHICS_INVALID_MESH;
+    }
+
+    mesh->header = (const MeshFileHeader*)mesh->view.data;
+    mesh->meshlets = (const MeshMeshlet*)(mesh->view.data + mesh->header->meshlets_offset);
+
+    VulkanGraphics* graphics = renderer->graphics;
+    const MeshFileHeader* header = mesh->header;
+
+    if (renderer->occlusion_culling && header->meshlet_count > MESH_MAX_MESHLETS - renderer->meshlets_count) {
+        fprintf(stderr, "too many meshlets (max %u), can't load %s\n", MESH_MAX_MESHLETS, path);
+        file_view_close(&mesh->view);
+        return GRAPHICS_INVALID_MESH;
+    }
+
+    bool uploaded = mesh_upload_buffers(graphics, mesh);
+
+    /* the culling shader reads the meshlets in the layout of the file */
+    if (uploaded && renderer->occlusion_culling && header->meshlet_count > 0) {
+        mesh->first_cull_meshlet = renderer->meshlets_count;
+        if (!vk_upload_buffer(graphics, renderer->meshlets, (VkDeviceSize)sizeof(MeshMeshlet) * mesh->first_cull_meshlet, mesh->meshlets, (VkDeviceSize)sizeof(MeshMeshlet) * header->meshlet_count)) {
+            mesh_release_buffers(graphics, mesh);
+            uploaded = false;
+        }
+    }
+
+    if (!uploaded) {
+        fprintf(stderr, "couldn't allocate memory for mesh %s\n", path);
+        file_view_close(&mesh->view);
+        return GRAPHICS_INVALID_MESH;
+    }
+
+    if (renderer->occlusion_culling)
+        renderer->meshlets_count += header->meshlet_count;
+
+    strcpy(mesh->path, path);
+    mesh->renderer = renderer;
+    mesh_register_residency(graphics, mesh);
+
+    return renderer->meshes_count++;
+}
+
+void mesh_renderer_record_meshes(MeshRenderer* renderer, Recorder* recorder) {
+    for (u32 i = 0; i < renderer->meshes_count; ++i)
+        recorder_write(recorder, RECORDING_CMD_MESH, renderer->meshes[i].path, (u32)strlen(renderer->meshes[i].path) + 1);
+}
+
+void mesh_renderer_push(MeshRenderer* renderer, GraphicsMesh mesh, const float transform[16], bool is_static) {
+    if (mesh >= renderer->meshes_count || renderer->instances_count >= MESH_MAX_INSTANCES)
+        return;
+
+    MeshInstance* instance = &renderer->instances[renderer->instances_count++];
+    instance->mesh = mesh;
+    memcpy(instance->transform.m, transform, sizeof(instance->transform.m));
+    instance->is_static = is_static;
+}
+
+/* FNV-1a of what a static caster looks like to a light. */
+static u32 mesh_instance_hash(const MeshInstance* instance) {
+    u32 hash = 2166136261u;
+
+    const byte* bytes = (const byte*)instance->transform.m;
+    for (u32 i = 0; i < sizeof(instance->transform.m); ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    hash = (hash ^ instance->mesh) * 16777619u;
+
+    /* 0 is left for dynamic instances */
+    return hash ? hash : 1;
+}
+
+/* the coarsest LOD whose error, projected at the closest point of the mesh, stays below MESH_LOD_PIXEL_ERROR. */
+static u32 mesh_select_lod(const MeshFileHeader* header, float scale, float distance, float pixels_per_unit) {
+    if (distance <= 0)
+        return 0;
+
+    u32 lod = 0;
+    for (u32 i = 1; i < header->lod_count; ++i) {
+        if (header->lods[i].error * scale * pixels_per_unit / distance > MESH_LOD_PIXEL_ERROR)
+            break;
+
+        lod = i;
+    }
+
+    return lod;
+}
+
+/* the LOD an instance is drawn at, NULL when it's entirely outside the frustum. */
+static const MeshLod* mesh_instance_lod(const Mesh* mesh, const MeshInstance* instance, const Vec4 planes[6], Vec3 camera_position, float pixels_per_unit) {
+    const MeshFileHeader* header = mesh->header;
+    const Mat4* transform = &instance->transform;
+    float scale = mat4_max_scale(transform);
+
+    Vec3 center = mat4_transform_point(transform, vec3(header->center[0], header->center[1], header->center[2]));
+    float radius = header->radius * scale;
+    if (!frustum_sphere_visible(planes, center, radius))
+        return NULL;
+
+    float distance = vec3_length(vec3_sub(center, camera_position)) - radius;
+    return &header->lods[mesh_select_lod(header, scale, distance, pixels_per_unit)];
+}
+
+/* appends the visible meshlets of one instance; returns the new command count. */
+static u32 mesh_cull_instance(const Mesh* mesh, const MeshInstance* instance, const MeshLod* lod, u32 slot, const Vec4 planes[6], Vec3 camera_position, VkDrawIndexedIndirectCommand* commands, u32 count, u64* triangles_drawn) {
+    const Mat4* transform = &instance->transform;
+    float scale = mat4_max_scale(transform);
+
+    for (u32 i = 0; i < lod->meshlet_count; ++i) {
+        const MeshMeshlet* meshlet = &mesh->meshlets[lod->first_meshlet + i];
+
+        Vec3 meshlet_center = mat4_transform_point(transform, vec3(meshlet->center[0], meshlet->center[1], meshlet->center[2]));
+        float meshlet_radius = meshlet->radius * scale;
+        if (!frustum_sphere_visible(planes, meshlet_center, meshlet_radius))
+            continue;
+
+        /* the cone is only approximately right under non-uniform scale, like the normals */
+        if (meshlet->cone_cutoff < 1.0f) {
+            Vec3 axis = vec3_normalize(mat4_transform_direction(transform, vec3(meshlet->cone_axis[0], meshlet->cone_axis[1], meshlet->cone_axis[2])));
+            Vec3 view = vec3_sub(meshlet_center, camera_position);
+
+            if (vec3_dot(view, axis) >= meshlet->cone_cutoff * vec3_length(view) + meshlet_radius)
+                continue;
+        }
+
+        /* meshlets of a LOD are stored back to back, so visible neighbours make one draw */
+        VkDrawIndexedIndirectCommand* last = count > 0 ? &commands[count - 1] : NULL;
+        if (last && last->firstInstance == slot && last->firstIndex + last->indexCount == meshlet->first_index) {
+            last->indexCount += meshlet->index_count;
+        } else if (count < MESH_MAX_DRAWS) {
+            commands[count++] = (VkDrawIndexedIndirectCommand) {
+                .indexCount = meshlet->index_count,
+                .instanceCount = 1,
+                .firstIndex = meshlet->first_index,
+                .vertexOffset = 0,
+                .firstInstance = slot,
+            };
+        } else {
+            break;
+        }
+
+        *triangles_drawn += meshlet->index_count / 3;
+    }
+
+    return count;
+}
+
+/* splits the LOD of every visible instance into chunks for mesh_cull.comp, giving each mesh a region of draws
+ * as large as the meshlets queued for it. */
+static void mesh_renderer_queue_chunks(MeshRenderer* renderer, MeshCullFrame* cull_frame) {
+    u32 meshlets = 0;
+    u32 chunks = 0;
+
+    for (u32 m = 0; m < renderer->meshes_count; ++m) {
+        const Mesh* mesh = &renderer->meshes[m];
+        renderer->draws[m].first = meshlets;
+
+        for (u32 i = 0; i < renderer->instances_count; ++i) {
+            if (renderer->instances[i].mesh != m)
+                continue;
+
+            const MeshLod* lod = renderer->lods[i];
+            if (lod == NULL)
+                continue;
+
+            u32 lod_chunks = (lod->meshlet_count + MESH_CULL_GROUP_SIZE - 1) / MESH_CULL_GROUP_SIZE;
+            if (lod->meshlet_count > MESH_MAX_CULL_MESHLETS - meshlets || lod_chunks > MESH_MAX_CULL_CHUNKS - chunks)
+                continue;
+
+            for (u32 c = 0; c < lod->meshlet_count; c += MESH_CULL_GROUP_SIZE) {
+                u32 count = lod->meshlet_count - c;
+                cull_frame->chunks[chunks++] = (MeshCullChunk) {
+                    .slot = i,
+                    .mesh = m,
+                    .first_meshlet = mesh->first_cull_meshlet + lod->first_meshlet + c,
+                    .meshlet_count = count < MESH_CULL_GROUP_SIZE ? count : MESH_CULL_GROUP_SIZE,
+                    .first_visibility = meshlets + c,
+                    .first_command = renderer->draws[m].first,
+                };
+            }
+
+            meshlets += lod->meshlet_count;
+        }
+
+        renderer->draws[m].count = meshlets - renderer->draws[m].first;
+    }
+
+    renderer->chunk_count = chunks;
+    cull_frame->chunk_count = chunks;
+}
+
+/* instances per job of mesh_prepare_instances() */
+#define MESH_PREPARE_BATCH (u32)64
+
+typedef struct MeshPrepareJob {
+    MeshRenderer* renderer;
+    MeshInstanceUpdate* updates;
+    u32 resident_count;
+    Vec4 planes[6];
+    Vec3 camera_position;
+    float pixels_per_unit;
+
+    atomic_ullong triangles;
+    atomic_uint updates_count;
+} MeshPrepareJob;
+
+/* everything about an instance that doesn't depend on the others: its transform if it changed, its bounds for
+ * the shadows, and its LOD. */
+static void mesh_prepare_instances(void* data, u32 first, u32 count) {
+    MeshPrepareJob* job = data;
+    MeshRenderer* renderer = job->renderer;
+    u64 triangles = 0;
+
+    for (u32 i = first; i < first + count; ++i) {
+        const MeshInstance* instance = &renderer->instances[i];
+        const Mesh* mesh = &renderer->meshes[instance->mesh];
+
+        /* a slot keeps its transform on the GPU for as long as the same one is queued into it */
+        if (i >= job->resident_count || memcmp(&renderer->resident[i], &instance->transform, sizeof(Mat4)) != 0) {
+            renderer->resident[i] = instance->transform;
+
+            u32 update = atomic_fetch_add_explicit(&job->updates_count, 1, memory_order_relaxed);
+            job->updates[update] = (MeshInstanceUpdate) { .transform = instance->transform, .slot = i };
+        }
+
+        const MeshFileHeader* header = mesh->header;
+        triangles += header->lods[0].index_count / 3;
+
+        float scale = mat4_max_scale(&instance->transform);
+        renderer->casters[i] = (MeshCaster) {
+            .center = mat4_transform_point(&instance->transform, vec3(header->center[0], header->center[1], header->center[2])),
+            .radius = header->radius * scale,
+            .scale = scale,
+            .mesh = instance->mesh,
+            .hash = instance->is_static ? mesh_instance_hash(instance) : 0,
+            .is_static = instance->is_static,
+        };
+
+        renderer->lods[i] = mesh_instance_lod(mesh, instance, job->planes, job->camera_position, job->pixels_per_unit);
+    }
+
+    atomic_fetch_add_explicit(&job->triangles, triangles, memory_order_relaxed);
+}
+
+/* uploads the evicted meshes that are queued again, dropping their instances if that fails, and marks every
+ * queued mesh as used by this frame so it isn't evicted from under it. */
+static void mesh_renderer_make_resident(MeshRenderer* renderer) {
+    VulkanGraphics* graphics = renderer->graphics;
+    ResidencyManager* residency = &graphics->residency;
+
+    /* the frames in flight before this one are done once the frame's fence has signaled */
+    u64 frame = residency->frame;
+    mesh_free_retired(renderer, frame + 1 >= MAX_FRAMES_IN_FLIGHT ? frame + 1 - MAX_FRAMES_IN_FLIGHT : 0);
+
+    u32 kept = 0;
+    for (u32 i = 0; i < renderer->instances_count; ++i) {
+        Mesh* mesh = &renderer->meshes[renderer->instances[i].mesh];
+
+        if (mesh->vertices == VK_NULL_HANDLE) {
+            if (!mesh_stage_buffers(renderer, mesh))
+                continue;
+
+            /* the memory may be on other heaps than before */
+            residency_unregister(residency, mesh->vertex_residency);
+            residency_unregister(residency, mesh->index_residency);
+            mesh_register_residency(graphics, mesh);
+        }
+
+        residency_touch(residency, mesh->vertex_residency);
+        residency_touch(residency, mesh->index_residency);
+        renderer->instances[kept++] = renderer->instances[i];
+    }
+
+    renderer->instances_count = kept;
+}
+
+void mesh_renderer_prepare(MeshRenderer* renderer, u32 frame, const Mat4* view, const Mat4* projection, Vec3 camera_position, VkExtent2D render_extent) {
+    TRACE_ZONE("mesh_renderer_prepare");
+
+    mesh_renderer_make_resident(renderer);
+
+    renderer->view_projection = mat4_mul(*projection, *view);
+    renderer->render_extent = render_extent;
+    renderer->chunk_count = 0;
+    renderer->casters_count = renderer->instances_count;
+    renderer->triangles = 0;
+    renderer->triangles_drawn = 0;
+    renderer->updates_count = 0;
+    for (u32 m = 0; m < renderer->meshes_count; ++m)
+        renderer->draws[m] = (MeshDrawRange) { 0, 0 };
+
+    if (renderer->instances_count == 0)
+        return;
+
+    Vec4 planes[6];
+    frustum_planes(&renderer->view_projection, planes);
+
+    /* how many pixels one world unit covers at distance 1 */
+    float pixels_per_unit = (float)render_extent.height * fabsf(projection->m[5]) * 0.5f;
+
+    MeshPrepareJob job = {
+        .renderer = renderer,
+        .updates = renderer->updates_mapped + (usize)MESH_MAX_INSTANCES * frame,
+        .resident_count = renderer->resident_count,
+        .camera_position = camera_position,
+        .pixels_per_unit = pixels_per_unit,
+    };
+    memcpy(job.planes, planes, sizeof(job.planes));
+    atomic_init(&job.triangles, 0);
+    atomic_init(&job.updates_count, 0);
+
+    jobs_parallel_for(renderer->graphics->jobs, mesh_prepare_instances, &job, renderer->instances_count, MESH_PREPARE_BATCH);
+    renderer->triangles = atomic_load(&job.triangles);
+    renderer->updates_count = atomic_load(&job.updates_count);
+    if (renderer->instances_count > renderer->resident_count)
+        renderer->resident_count = renderer->instances_count;
+
+    if (renderer->occlusion_culling) {
+        /* the fence of this frame was waited on, so its count is complete */
+        renderer->triangles_drawn = renderer->readback_mapped[frame];
+
+        MeshCullFrame* cull_frame = (MeshCullFrame*)(renderer->cull_frames_mapped + MESH_CULL_FRAME_SIZE * frame);
+        cull_frame->view = *view;
+        memcpy(cull_frame->planes, planes, sizeof(cull_frame->planes));
+        memcpy(cull_frame->camera_position, &camera_position, sizeof(camera_position));
+
+        /* the far plane, from depth = range + range * near / z */
+        float range = projection->m[10];
+        float near_plane = projection->m[14] / range;
+        float far_plane = range * near_plane / (range + 1.0f);
+        cull_frame->projection[0] = projection->m[0];
+        cull_frame->projection[1] = fabsf(projection->m[5]);
+        cull_frame->projection[2] = near_plane;
+        cull_frame->projection[3] = far_plane;
+
+        cull_frame->render_size[0] = (float)render_extent.width;
+        cull_frame->render_size[1] = (float)render_extent.height;
+
+        /* down to a single texel, which the first level already is for one pixel */
+        u32 largest = render_extent.width > render_extent.height ? render_extent.width : render_extent.height;
+        u32 levels = 1;
+        while (levels < renderer->hiz_mip_levels && (1u << levels) < largest)
+            ++levels;
+
+        renderer->hiz_levels = levels;
+        cull_frame->hiz_levels = levels;
+
+        mesh_renderer_queue_chunks(renderer, cull_frame);
+    } else {
+        VkDrawIndexedIndirectCommand* commands = renderer->commands_mapped + (usize)MESH_MAX_DRAWS * frame;
+        u32 count = 0;
+
+        for (u32 m = 0; m < renderer->meshes_count; ++m) {
+            const Mesh* mesh = &renderer->meshes[m];
+            renderer->draws[m].first = count;
+
+            for (u32 i = 0; i < renderer->instances_count; ++i) {
+                const MeshInstance* instance = &renderer->instances[i];
+                if (instance->mesh != m)
+                    continue;
+
+                const MeshLod* lod = renderer->lods[i];
+                if (lod != NULL)
+                    count = mesh_cull_instance(mesh, instance, lod, i, planes, camera_position, commands, count, &renderer->triangles_drawn);
+            }
+
+            renderer->draws[m].count = count - renderer->draws[m].first;
+        }
+    }
+
+    renderer->instances_count = 0;
+}
+
+/* makes the compute and transfer writes so far visible to the given stages. */
+static void mesh_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags2 src_stages, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access) {
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = src_stages,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = dst_stages,
+        .dstAccessMask = dst_access,
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    });
+}
+
+void mesh_renderer_upload(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame) {
+    /* the meshes made resident again for this frame */
+    if (renderer->copies_count > 0) {
+        for (u32 i = 0; i < renderer->copies_count; ++i) {
+            const MeshCopy* copy = &renderer->copies[i];
+            vkCmdCopyBuffer(command_buffer, copy->staging, copy->buffer, 1, &(VkBufferCopy) { 0, 0, copy->size });
+        }
+
+        renderer->copies_count = 0;
+        mesh_barrier(command_buffer, VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT);
+    }
+
+    if (renderer->updates_count == 0)
+        return;
+
+    /* the frames before are done reading the slots about to be overwritten */
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    });
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->scatter_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->scatter_layout, 0, 1, &renderer->scatter_sets[frame], 0, NULL);
+    vkCmdPushConstants(command_buffer, renderer->scatter_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(u32), &renderer->updates_count);
+    vkCmdDispatch(command_buffer, (renderer->updates_count + MESH_SCATTER_GROUP_SIZE - 1) / MESH_SCATTER_GROUP_SIZE, 1, 1);
+
+    mesh_barrier(command_buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+}
+
+void mesh_renderer_set_targets(MeshRenderer* renderer, VkImageView depth, VkImage hiz, VkImageView hiz_view, u32 hiz_mip_levels) {
+    VkDevice device = renderer->graphics->device;
+
+    /* the graph is only rebuilt with the device idle */
+    mesh_renderer_destroy_hiz_views(renderer);
+
+    renderer->hiz = hiz;
+    renderer->hiz_mip_levels = hiz_mip_levels < MESH_HIZ_MAX_LEVELS ? hiz_mip_levels : MESH_HIZ_MAX_LEVELS;
+
+    for (u32 i = 0; i < renderer->hiz_mip_levels; ++i) {
+        VkImageViewCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = hiz,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = VK_FORMAT_R32_SFLOAT,
+            .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 },
+        };
+
+        ERR_CHECK(vkCreateImageView(device, &info, NULL, &renderer->hiz_views[i]), "hiz level view");
+    }
+
+    VkDescriptorImageInfo depth_info = { renderer->sampler, depth, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkDescriptorImageInfo pyramid_info = { renderer->sampler, hiz_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = renderer->cull_sets[i],
+            .dstBinding = 6,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &pyramid_info,
+        };
+
+        vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    }
+
+    /* the first level reads the depth buffer; its "level before" is never read but must be valid */
+    for (u32 i = 0; i < renderer->hiz_mip_levels; ++i) {
+        VkDescriptorImageInfo src_info = { VK_NULL_HANDLE, renderer->hiz_views[i > 0 ? i - 1 : 0], VK_IMAGE_LAYOUT_GENERAL };
+        VkDescriptorImageInfo dst_info = { VK_NULL_HANDLE, renderer->hiz_views[i], VK_IMAGE_LAYOUT_GENERAL };
+
+        VkWriteDescriptorSet writes[] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = renderer->hiz_sets[i],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &depth_info,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = renderer->hiz_sets[i],
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo = &src_info,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = renderer->hiz_sets[i],
+                .dstBinding = 2,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo = &dst_info,
+            },
+        };
+
+        vkUpdateDescriptorSets(device, ZARRSIZ(writes), writes, 0, NULL);
+    }
+}
+
+void mesh_renderer_cull(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame, enum MeshCullPhase phase) {
+    const VkPipelineStageFlags2 compute = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    const VkPipelineStageFlags2 transfer = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    const VkAccessFlags2 storage = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+    if (phase == MESH_CULL_OCCLUDERS) {
+        /* last frame still reads the draws and writes the visibility; then every draw count starts at zero */
+        mesh_barrier(command_buffer, compute | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | transfer, compute | transfer, storage | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+        vkCmdFillBuffer(command_buffer, renderer->cull_counts, 0, VK_WHOLE_SIZE, 0);
+        if (!renderer->visibility_cleared) {
+            vkCmdFillBuffer(command_buffer, renderer->visibility, 0, VK_WHOLE_SIZE, 0);
+            renderer->visibility_cleared = true;
+        }
+
+        mesh_barrier(command_buffer, transfer, compute | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, storage | VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+    }
+
+    if (renderer->chunk_count > 0) {
+        u32 push = phase;
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->cull_pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->cull_layout, 0, 1, &renderer->cull_sets[frame], 0, NULL);
+        vkCmdPushConstants(command_buffer, renderer->cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        vkCmdDispatch(command_buffer, renderer->chunk_count, 1, 1);
+    }
+
+    if (phase == MESH_CULL_MAIN) {
+        mesh_barrier(command_buffer, compute, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | transfer, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+
+        /* the triangle count, for mesh_renderer_prepare() once this frame's fence has been waited on */
+        VkBufferCopy region = { (VkDeviceSize)sizeof(u32) * MESH_MAX_MESHES * 2, (VkDeviceSize)sizeof(u32) * frame, sizeof(u32) };
+        vkCmdCopyBuffer(command_buffer, renderer->cull_counts, renderer->readback, 1, &region);
+        mesh_barrier(command_buffer, transfer, VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+    } else {
+        mesh_barrier(command_buffer, compute, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+    }
+}
+
+/* the draws of one phase, one draw call per mesh with its count read from the GPU. */
+static void mesh_renderer_draw_culled(MeshRenderer* renderer, VkCommandBuffer command_buffer, enum MeshCullPhase phase) {
+    for (u32 m = 0; m < renderer->meshes_count; ++m) {
+        const Mesh* mesh = &renderer->meshes[m];
+        const MeshDrawRange* draws = &renderer->draws[m];
+        if (draws->count == 0)
+            continue;
+
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh->vertices, &(VkDeviceSize) { 0 });
+        vkCmdBindIndexBuffer(command_buffer, mesh->indices, 0, VK_INDEX_TYPE_UINT32);
+
+        VkDeviceSize offset = ((VkDeviceSize)MESH_MAX_CULL_MESHLETS * phase + draws->first) * sizeof(VkDrawIndexedIndirectCommand);
+        VkDeviceSize count_offset = ((VkDeviceSize)MESH_MAX_MESHES * phase + m) * sizeof(u32);
+        vkCmdDrawIndexedIndirectCount(command_buffer, renderer->cull_commands, offset, renderer->cull_counts, count_offset, draws->count, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+void mesh_renderer_draw_occluders(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame) {
+    if (renderer->chunk_count == 0)
+        return;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->depth_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline_layout, 0, 1, &renderer->sets[frame], 0, NULL);
+    vkCmdPushConstants(command_buffer, renderer->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Mat4), &renderer->view_projection);
+
+    mesh_renderer_draw_culled(renderer, command_buffer, MESH_CULL_OCCLUDERS);
+}
+
+void mesh_renderer_build_hiz(MeshRenderer* renderer, VkCommandBuffer command_buffer) {
+    if (renderer->chunk_count == 0)
+        return;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->hiz_pipeline);
+
+    /* every level is half the one before, rounded up, so a texel of level i always covers the 2^(i+1) pixels
+     * squared starting at its coordinates times 2^(i+1); mesh_cull.comp relies on that */
+    s32 src_size[2] = { (s32)renderer->render_extent.width, (s32)renderer->render_extent.height };
+    for (u32 i = 0; i < renderer->hiz_levels; ++i) {
+        MeshHizConstants constants = {
+            .src_size = { src_size[0], src_size[1] },
+            .dst_size = { (src_size[0] + 1) / 2, (src_size[1] + 1) / 2 },
+            .level = i,
+        };
+
+        if (i > 0)
+            mesh_barrier(command_buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->hiz_layout, 0, 1, &renderer->hiz_sets[i], 0, NULL);
+        vkCmdPushConstants(command_buffer, renderer->hiz_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(command_buffer, vk_dispatch_size((u32)constants.dst_size[0], MESH_HIZ_GROUP_SIZE), vk_dispatch_size((u32)constants.dst_size[1], MESH_HIZ_GROUP_SIZE), 1);
+
+        src_size[0] = constants.dst_size[0];
+        src_size[1] = constants.dst_size[1];
+    }
+}
+
+void mesh_renderer_draw(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame) {
+    TRACE_ZONE("mesh_renderer_draw");
+
+    bool any = false;
+    for (u32 m = 0; m < renderer->meshes_count; ++m)
+        any |= renderer->draws[m].count > 0;
+
+    if (!any)
+        return;
+
+    VkDescriptorSet sets[] = { renderer->sets[frame], light_clusters_set(renderer->graphics->lights, frame), shadow_atlas_set(renderer->graphics->shadows, frame) };
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline_layout, 0, ZARRSIZ(sets), sets, 0, NULL);
+    vkCmdPushConstants(command_buffer, renderer->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Mat4), &renderer->view_projection);
+
+    if (renderer->occlusion_culling) {
+        mesh_renderer_draw_culled(renderer, command_buffer, MESH_CULL_MAIN);
+        return;
+    }
+
+    const VkDrawIndexedIndirectCommand* commands = renderer->commands_mapped + (usize)MESH_MAX_DRAWS * frame;
+
+    for (u32 m = 0; m < renderer->meshes_count; ++m) {
+        const Mesh* mesh = &renderer->meshes[m];
+        u32 first = renderer->draws[m].first;
+        u32 count = first + renderer->draws[m].count;
+        if (count == first)
+            continue;
+
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh->vertices, &(VkDeviceSize) { 0 });
+        vkCmdBindIndexBuffer(command_buffer, mesh->indices, 0, VK_INDEX_TYPE_UINT32);
+
+        if (renderer->graphics->multi_draw_indirect) {
+            for (u32 i = first; i < count; i += MESH_MAX_INDIRECT_COUNT) {
+                u32 draws = count - i < MESH_MAX_INDIRECT_COUNT ? count - i : MESH_MAX_INDIRECT_COUNT;
+                VkDeviceSize offset = ((VkDeviceSize)MESH_MAX_DRAWS * frame + i) * sizeof(VkDrawIndexedIndirectCommand);
+                vkCmdDrawIndexedIndirect(command_buffer, renderer->commands, offset, draws, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        } else {
+            /* the commands are on the CPU anyway, direct draws can set firstInstance without the feature */
+            for (u32 i = first; i < count; ++i)
+                vkCmdDrawIndexed(command_buffer, commands[i].indexCount, 1, commands[i].firstIndex, 0, commands[i].firstInstance);
+        }
+    }
+}
+
+const MeshCaster* mesh_renderer_casters(const MeshRenderer* renderer, u32* count) {
+    *count = renderer->casters_count;
+    return renderer->casters;
+}
+
+void mesh_renderer_draw_casters(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame, const Mat4* view_projection, Vec3 eye, float pixels_per_unit, const u32* slots, u32 count) {
+    if (count == 0)
+        return;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->shadow_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline_layout, 0, 1, &renderer->sets[frame], 0, NULL);
+    vkCmdPushConstants(command_buffer, renderer->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Mat4), view_projection);
+
+    GraphicsMesh bound = GRAPHICS_INVALID_MESH;
+    for (u32 i = 0; i < count; ++i) {
+        const MeshCaster* caster = &renderer->casters[slots[i]];
+        const Mesh* mesh = &renderer->meshes[caster->mesh];
+
+        if (caster->mesh != bound) {
+            vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh->vertices, &(VkDeviceSize) { 0 });
+            vkCmdBindIndexBuffer(command_buffer, mesh->indices, 0, VK_INDEX_TYPE_UINT32);
+            bound = caster->mesh;
+        }
+
+        /* shadows don't care which way triangles face, so the whole LOD goes in one draw */
+        float distance = vec3_length(vec3_sub(caster->center, eye)) - caster->radius;
+        const MeshLod* lod = &mesh->header->lods[mesh_select_lod(mesh->header, caster->scale, distance, pixels_per_unit)];
+        vkCmdDrawIndexed(command_buffer, lod->index_count, 1, lod->first_index, 0, slots[i]);
+    }
+}
+
+void mesh_renderer_get_stats(const MeshRenderer* renderer, u64* triangles, u64* triangles_drawn, u32* instances_uploaded) {
+    *triangles = renderer->triangles;
+    *triangles_drawn = renderer->triangles_drawn;
+    *instances_uploaded = renderer->updates_count;
+}
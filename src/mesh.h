@@ -0,0 +1,121 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+#include "recording.h"
+#include "zmath.h"
+
+#include <volk.h>
+
+/*
+ * Meshlet meshes.
+ *
+ * Meshes are cooked offline by tools/mesh_cooker into the format of mesh_format.h, and loaded by memory mapping
+ * the file: the vertices and indices are uploaded straight out of the mapping, and the meshlet bounds are read
+ * from it in place for as long as the mesh is loaded, without ever being copied.
+ *
+ * Every frame, each queued instance picks the coarsest LOD whose error stays under MESH_LOD_PIXEL_ERROR
+ * pixels on screen, and the meshlets of that LOD outside the frustum or facing away from the camera are
+ * skipped. What is left becomes indexed draws in a persistently mapped indirect buffer, and each mesh is drawn
+ * with a single multi-draw indirect call; neighbouring visible meshlets are merged into one draw.
+ *
+ * With occlusion culling (VulkanGraphics.occlusion_culling) only the instance test and the LOD choice stay on
+ * the CPU. The meshlets are culled on the GPU in two phases:
+ *   1. the meshlets that were visible last frame and are still in the frustum are drawn depth only into a
+ *      single sampled depth buffer, and a Hi-Z pyramid keeping the farthest depth of every 2x2 is built from it;
+ *   2. every meshlet is tested against the frustum, its cone and the pyramid, and the survivors become both the
+ *      indirect draws of the main pass and next frame's visible set.
+ * Visibility is remembered per meshlet in the order they were queued, so when the queue changes the first phase
+ * merely draws the wrong occluders for a frame, it never hides anything.
+ *
+ * The transforms live on the GPU, one per slot of the queue, for as long as the same transform is queued into the
+ * same slot: a frame uploads only the (slot, transform) pairs that changed, and mesh_scatter.comp writes them into
+ * place. A world that queues its instances in the same order every frame uploads just the ones that moved.
+ *
+ * The vertex and index buffers are registered with the residency manager (see residency.h), below everything
+ * else: under memory pressure a mesh no recent frame drew loses them, and the first frame that queues it again
+ * copies them back in from the mapping, through staging buffers, at the start of its command buffer.
+ *
+ * The queued instances are also the shadow casters of the shadow atlas (see shadows.h), which draws them depth
+ * only, a whole LOD at a time, with mesh_renderer_draw_casters().
+ */
+
+#define MESH_MAX_MESHES (u32)64
+/* instances queued per frame; more are dropped */
+#define MESH_MAX_INSTANCES (u32)4096
+/* indexed draws per frame; more are dropped */
+#define MESH_MAX_DRAWS (u32)65536
+#define MESH_LOD_PIXEL_ERROR 1.0f
+
+/* meshlets of all loaded meshes together, with occlusion culling */
+#define MESH_MAX_MESHLETS (u32)262144
+/* levels of the Hi-Z pyramid, enough for 65536 pixel wide targets */
+#define MESH_HIZ_MAX_LEVELS (u32)16
+
+enum MeshCullPhase {
+    MESH_CULL_OCCLUDERS,
+    MESH_CULL_MAIN,
+};
+
+/* an instance of the last prepared frame, as a shadow caster. */
+typedef struct MeshCaster {
+    /* bounding sphere */
+    Vec3 center;
+    float radius;
+    float scale;
+    GraphicsMesh mesh;
+    /* of the mesh and transform of static instances, 0 for the others */
+    u32 hash;
+    bool is_static;
+} MeshCaster;
+
+typedef struct MeshRenderer MeshRenderer;
+
+MeshRenderer* mesh_renderer_create(VulkanGraphics* graphics);
+void mesh_renderer_destroy(MeshRenderer* renderer);
+
+GraphicsMesh mesh_renderer_load(MeshRenderer* renderer, const char* path);
+
+/* writes every mesh loaded so far, in order, as RECORDING_CMD_MESH commands. */
+void mesh_renderer_record_meshes(MeshRenderer* renderer, Recorder* recorder);
+
+/* static instances are the ones whose shadows can be cached; they're queued every frame all the same. */
+void mesh_renderer_push(MeshRenderer* renderer, GraphicsMesh mesh, const float transform[16], bool is_static);
+
+/* culls the queued instances into the buffer slices of `frame`, before any of the passes below are recorded.
+ * the queue is empty afterwards. */
+void mesh_renderer_prepare(MeshRenderer* renderer, u32 frame, const Mat4* view, const Mat4* projection, Vec3 camera_position, VkExtent2D render_extent);
+
+/* records the copies of the meshes mesh_renderer_prepare() made resident again, and writes the transforms that
+ * changed since the frames before into the resident ones; outside of any rendering, before anything below is
+ * recorded. */
+void mesh_renderer_upload(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame);
+
+/* records the draws of the visible meshlets into the main pass. */
+void mesh_renderer_draw(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame);
+
+/* occlusion culling only. the images are the graph's and change whenever it is rebuilt: a single sampled
+ * depth buffer the occluders are drawn into, and an R32_SFLOAT image with `hiz_mip_levels` mips, each at least
+ * half as large as the one before, of which the first covers half of the depth buffer. */
+void mesh_renderer_set_targets(MeshRenderer* renderer, VkImageView depth, VkImage hiz, VkImageView hiz_view, u32 hiz_mip_levels);
+
+/* fills the indirect draws of one phase; outside of any rendering. */
+void mesh_renderer_cull(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame, enum MeshCullPhase phase);
+
+/* records the depth only draws of the occluders into the occlusion depth buffer. */
+void mesh_renderer_draw_occluders(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame);
+
+/* reduces the occlusion depth buffer into the Hi-Z pyramid, which is left in GENERAL layout. */
+void mesh_renderer_build_hiz(MeshRenderer* renderer, VkCommandBuffer command_buffer);
+
+/* the instances of the last prepared frame, indexed by their slot. */
+const MeshCaster* mesh_renderer_casters(const MeshRenderer* renderer, u32* count);
+
+/* records depth only draws of the given slots into the shadow atlas tile the viewport is on, each at the LOD
+ * seen from `eye` with `pixels_per_unit` pixels per world unit at distance 1. */
+void mesh_renderer_draw_casters(MeshRenderer* renderer, VkCommandBuffer command_buffer, u32 frame, const Mat4* view_projection, Vec3 eye, float pixels_per_unit, const u32* slots, u32 count);
+
+/* triangles of the instances drawn last, at full detail, and how many of them were actually drawn. with
+ * occlusion culling the latter is read back from the GPU and MAX_FRAMES_IN_FLIGHT frames old. and how many
+ * transforms the last frame uploaded. */
+void mesh_renderer_get_stats(const MeshRenderer* renderer, u64* triangles, u64* triangles_drawn, u32* instances_uploaded);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Cooked mesh format, written by tools/mesh_cooker and memory mapped as is by the renderer (see mesh.c).
+ *
+ * A MeshFileHeader, then the meshlets, vertices and indices at the offsets it gives, each 16 byte aligned.
+ * Every LOD is a range of meshlets, and every meshlet a range of indices into the one vertex buffer shared by
+ * all LODs, so drawing a meshlet is a plain indexed draw. Meshlets hold at most MESH_MESHLET_MAX_VERTICES
+ * vertices and MESH_MESHLET_MAX_TRIANGLES triangles, and are bounded by a sphere and a normal cone for culling.
+ *
+ * Everything is little endian, in the layout of the structs below.
+ */
+
+#define MESH_MAGIC (u32)0x48534d5a /* "ZMSH" */
+#define MESH_VERSION (u32)1
+
+#define MESH_MAX_LODS (u32)8
+#define MESH_MESHLET_MAX_VERTICES (u32)64
+#define MESH_MESHLET_MAX_TRIANGLES (u32)124
+
+typedef struct MeshVertex {
+    float position[3];
+    float normal[3];
+} MeshVertex;
+
+typedef struct MeshMeshlet {
+    /* bounding sphere */
+    float center[3];
+    float radius;
+
+    /* every triangle faces away from a viewer at p when
+     * dot(center - p, cone_axis) >= cone_cutoff * length(center - p) + radius; a cutoff of 1 never culls. */
+    float cone_axis[3];
+    float cone_cutoff;
+
+    u32 first_index;
+    u32 index_count;
+} MeshMeshlet;
+
+typedef struct MeshLod {
+    u32 first_meshlet;
+    u32 meshlet_count;
+    /* the indices of all its meshlets, which are contiguous */
+    u32 first_index;
+    u32 index_count;
+
+    /* how far, in object space, the LOD deviates from the full detail mesh at most */
+    float error;
+    u32 reserved;
+} MeshLod;
+
+typedef struct MeshFileHeader {
+    u32 magic;
+    u32 version;
+
+    /* LOD 0 is the full detail mesh, every next one about half as many triangles */
+    u32 lod_count;
+    u32 meshlet_count;
+    u32 vertex_count;
+    u32 index_count;
+
+    /* bounding sphere of the whole mesh */
+    float center[3];
+    float radius;
+
+    u64 meshlets_offset;
+    u64 vertices_offset;
+    /* u32 indices */
+    u64 indices_offset;
+
+    MeshLod lods[MESH_MAX_LODS];
+} MeshFileHeader;
@@ -0,0 +1,462 @@
+#include "particles.h"
+#include "renderer_internal.h"
+#include "gpu_memory.h"
+#include "arena.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
+#define PARTICLE_GROUP_SIZE (u32)64
+
+/* longer steps are clamped, so a hitch doesn't fling everything away */
+#define PARTICLE_MAX_STEP 0.1f
+
+/* the layouts in shaders/vulkan/particles.glsl */
+typedef struct GpuParticle {
+    float position[3];
+    float life;
+    float velocity[3];
+    u32 color;
+} GpuParticle;
+
+typedef struct ParticleCounters {
+    VkDrawIndirectCommand draws[2];
+    VkDispatchIndirectCommand simulate_groups;
+    s32 dead_count;
+} ParticleCounters;
+
+typedef struct ParticleStepConstants {
+    float emitter_position_spread[4];
+    float emitter_velocity_lifetime[4];
+    float gravity;
+    float dt;
+    u32 emit_count;
+    u32 seed;
+    u32 current;
+    u32 capacity;
+    u32 color;
+} ParticleStepConstants;
+
+typedef struct ParticleDrawConstants {
+    Mat4 view_projection;
+    float right_size[4];
+    float up_lifetime[4];
+    u32 list_offset;
+} ParticleDrawConstants;
+
+enum ParticleBuffer {
+    PARTICLE_BUFFER_PARTICLES,
+    PARTICLE_BUFFER_ALIVE,
+    PARTICLE_BUFFER_DEAD,
+    PARTICLE_BUFFER_COUNTERS,
+
+    PARTICLE_BUFFER_COUNT,
+};
+
+struct ParticleSystem {
+    VulkanGraphics* graphics;
+    u32 capacity;
+
+    VkBuffer buffers[PARTICLE_BUFFER_COUNT];
+    GpuAllocation memory[PARTICLE_BUFFER_COUNT];
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet set;
+
+    VkPipelineLayout step_layout;
+    VkPipeline init_pipeline;
+    VkPipeline emit_pipeline;
+    VkPipeline prepare_pipeline;
+    VkPipeline simulate_pipeline;
+
+    VkPipelineLayout draw_layout;
+    VkPipeline draw_pipeline;
+
+    bool initialized;
+    /* the alive list holding the live particles */
+    u32 current;
+    u32 seed;
+
+    GraphicsParticleEmitter emitter;
+    float pending_dt;
+    /* fractions of a particle left over from earlier steps */
+    float emit_accumulator;
+};
+
+static void particles_create_buffers(ParticleSystem* system) {
+    VulkanGraphics* graphics = system->graphics;
+
+    VkDeviceSize sizes[PARTICLE_BUFFER_COUNT] = {
+        [PARTICLE_BUFFER_PARTICLES] = (VkDeviceSize)sizeof(GpuParticle) * system->capacity,
+        [PARTICLE_BUFFER_ALIVE] = (VkDeviceSize)sizeof(u32) * system->capacity * 2,
+        [PARTICLE_BUFFER_DEAD] = (VkDeviceSize)sizeof(u32) * system->capacity,
+        [PARTICLE_BUFFER_COUNTERS] = sizeof(ParticleCounters),
+    };
+
+    /* written on the compute queue, read on the graphics queue */
+    u32 families[] = { graphics->families.graphics_family, graphics->families.compute_family };
+    bool concurrent = families[0] != families[1];
+
+    for (u32 i = 0; i < PARTICLE_BUFFER_COUNT; ++i) {
+        VkBufferCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = sizes[i],
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = concurrent ? ZARRSIZ(families) : 0,
+            .pQueueFamilyIndices = concurrent ? families : NULL,
+        };
+
+        if (i == PARTICLE_BUFFER_COUNTERS)
+            info.usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        ERR_CHECK(vkCreateBuffer(graphics->device, &info, NULL, &system->buffers[i]), "particle buffer");
+
+        VkMemoryRequirements reqs;
+        vkGetBufferMemoryRequirements(graphics->device, system->buffers[i], &reqs);
+
+        system->memory[i] = gpu_memory_allocate(graphics->device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, GRAPHICS_MEMORY_BUFFERS);
+        if (system->memory[i].memory == VK_NULL_HANDLE) {
+            fprintf(stderr, "couldn't allocate %llu bytes for particles!\n", (unsigned long long)reqs.size);
+            exit(EXIT_FAILURE);
+        }
+
+        ERR_CHECK(vkBindBufferMemory(graphics->device, system->buffers[i], system->memory[i].memory, 0), "particle buffer binding");
+    }
+}
+
+static const char* particle_step_shaders[] = {
+    "shaders/bin/vulkan_particle_init.comp.spv",
+    "shaders/bin/vulkan_particle_emit.comp.spv",
+    "shaders/bin/vulkan_particle_prepare.comp.spv",
+    "shaders/bin/vulkan_particle_simulate.comp.spv",
+};
+
+static const char* particle_draw_shaders[] = {
+    "shaders/bin/vulkan_particle.vert.spv",
+    "shaders/bin/vulkan_particle.frag.spv",
+};
+
+/* the steps and the draw share the one set, so its layout is made from all of their shaders */
+static void particles_create_descriptors(ParticleSystem* system) {
+    VulkanGraphics* graphics = system->graphics;
+    VkDevice device = graphics->device;
+
+    ShaderReflection step, draw, shared = { 0 };
+    vk_reflect_shaders(graphics, particle_step_shaders, ZARRSIZ(particle_step_shaders), &step);
+    vk_reflect_shaders(graphics, particle_draw_shaders, ZARRSIZ(particle_draw_shaders), &draw);
+    if (!shader_reflect_merge(&shared, &step) || !shader_reflect_merge(&shared, &draw)) {
+        fprintf(stderr, "the particle shaders disagree on their descriptor set!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    system->set_layout = pipeline_layouts_set(&graphics->layouts, device, &shared, 0);
+    system->step_layout = pipeline_layouts_get(&graphics->layouts, device, &shared, &step);
+    system->draw_layout = pipeline_layouts_get(&graphics->layouts, device, &shared, &draw);
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = PARTICLE_BUFFER_COUNT,
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+
+    ERR_CHECK(vkCreateDescriptorPool(device, &pool_info, NULL, &system->descriptor_pool), "particle descriptor pool");
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = system->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &system->set_layout,
+    };
+
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, &system->set), "particle descriptor set");
+
+    VkDescriptorBufferInfo buffer_infos[PARTICLE_BUFFER_COUNT];
+    VkWriteDescriptorSet writes[PARTICLE_BUFFER_COUNT];
+    for (u32 i = 0; i < PARTICLE_BUFFER_COUNT; ++i) {
+        buffer_infos[i] = (VkDescriptorBufferInfo) { system->buffers[i], 0, VK_WHOLE_SIZE };
+        writes[i] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = system->set,
+            .dstBinding = i,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &buffer_infos[i],
+        };
+    }
+
+    vkUpdateDescriptorSets(device, ZARRSIZ(writes), writes, 0, NULL);
+}
+
+static void particles_create_draw_pipeline(ParticleSystem* system) {
+    VulkanGraphics* graphics = system->graphics;
+
+    VkShaderModule vertex = vk_load_shader_module(graphics, particle_draw_shaders[0]);
+    VkShaderModule fragment = vk_load_shader_module(graphics, particle_draw_shaders[1]);
+
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertex,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragment,
+            .pName = "main",
+        },
+    };
+
+    VkDynamicState dynamic_states[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = ZARRSIZ(dynamic_states),
+        .pDynamicStates = dynamic_states,
+    };
+
+    /* everything comes out of the storage buffers */
+    VkPipelineVertexInputStateCreateInfo vertex_input = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    };
+
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = graphics->msaa_samples,
+    };
+
+    /* tested against the scene, but additive blending doesn't need them sorted or in the depth buffer */
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_FALSE,
+        .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+    };
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT,
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+    };
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment,
+    };
+
+    VkPipelineRenderingCreateInfo rendering_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &graphics->scene_format,
+        .depthAttachmentFormat = graphics->depth_format,
+    };
+
+    VkGraphicsPipelineCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = &rendering_info,
+        .stageCount = ZARRSIZ(stages),
+        .pStages = stages,
+
+        .pVertexInputState = &vertex_input,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisample,
+        .pDepthStencilState = &depth_stencil,
+        .pColorBlendState = &color_blending,
+        .pDynamicState = &dynamic_state,
+
+        .layout = system->draw_layout,
+    };
+
+    ERR_CHECK(vkCreateGraphicsPipelines(graphics->device, VK_NULL_HANDLE, 1, &info, NULL, &system->draw_pipeline), "particle pipeline");
+
+    vkDestroyShaderModule(graphics->device, vertex, NULL);
+    vkDestroyShaderModule(graphics->device, fragment, NULL);
+}
+
+/* makes compute and transfer writes so far visible to what comes next in the step. */
+static void particles_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access) {
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = dst_stages,
+        .dstAccessMask = dst_access,
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    });
+}
+
+static void particles_record_step(VulkanGraphics* graphics, VkCommandBuffer command_buffer, void* data) {
+    (void)graphics;
+    ParticleSystem* system = data;
+    const GraphicsParticleEmitter* emitter = &system->emitter;
+
+    const VkPipelineStageFlags2 compute = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    const VkAccessFlags2 storage = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+    ParticleStepConstants constants = {
+        .emitter_position_spread = { emitter->position[0], emitter->position[1], emitter->position[2], emitter->spread },
+        .emitter_velocity_lifetime = { emitter->velocity[0], emitter->velocity[1], emitter->velocity[2], emitter->lifetime },
+        .gravity = emitter->gravity,
+        .seed = system->seed++,
+        .current = system->current,
+        .capacity = system->capacity,
+        .color = emitter->color,
+    };
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, system->step_layout, 0, 1, &system->set, 0, NULL);
+
+    if (!system->initialized) {
+        ParticleCounters counters = {
+            .draws = { { 6, 0, 0, 0 }, { 6, 0, 0, 0 } },
+            .simulate_groups = { 0, 1, 1 },
+            .dead_count = (s32)system->capacity,
+        };
+
+        vkCmdUpdateBuffer(command_buffer, system->buffers[PARTICLE_BUFFER_COUNTERS], 0, sizeof(counters), &counters);
+
+        vkCmdPushConstants(command_buffer, system->step_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, system->init_pipeline);
+        vkCmdDispatch(command_buffer, vk_dispatch_size(system->capacity, PARTICLE_GROUP_SIZE), 1, 1);
+
+        particles_barrier(command_buffer, compute, storage);
+        system->initialized = true;
+    }
+
+    if (system->pending_dt <= 0)
+        return;
+
+    float dt = system->pending_dt < PARTICLE_MAX_STEP ? system->pending_dt : PARTICLE_MAX_STEP;
+    system->pending_dt = 0;
+
+    system->emit_accumulator += emitter->rate * dt;
+    float emit_count = floorf(system->emit_accumulator);
+    system->emit_accumulator -= emit_count;
+
+    constants.dt = dt;
+    constants.emit_count = emit_count < (float)system->capacity ? (u32)emit_count : system->capacity;
+    vkCmdPushConstants(command_buffer, system->step_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+    if (constants.emit_count > 0) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, system->emit_pipeline);
+        vkCmdDispatch(command_buffer, vk_dispatch_size(constants.emit_count, PARTICLE_GROUP_SIZE), 1, 1);
+        particles_barrier(command_buffer, compute, storage);
+    }
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, system->prepare_pipeline);
+    vkCmdDispatch(command_buffer, 1, 1, 1);
+    particles_barrier(command_buffer, compute | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, storage | VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, system->simulate_pipeline);
+    vkCmdDispatchIndirect(command_buffer, system->buffers[PARTICLE_BUFFER_COUNTERS], offsetof(ParticleCounters, simulate_groups));
+
+    /* the graphics queue waits for the compute timeline before it reads any of this */
+    system->current = 1 - system->current;
+}
+
+ParticleSystem* particles_create(VulkanGraphics* graphics, u32 capacity) {
+    ParticleSystem* system = heap_calloc(1, sizeof(ParticleSystem));
+    system->graphics = graphics;
+    system->capacity = capacity;
+
+    particles_create_buffers(system);
+    particles_create_descriptors(system);
+    particles_create_draw_pipeline(system);
+
+    system->init_pipeline = vk_create_compute_pipeline(graphics, particle_step_shaders[0], system->step_layout, 0);
+    system->emit_pipeline = vk_create_compute_pipeline(graphics, particle_step_shaders[1], system->step_layout, 0);
+    system->prepare_pipeline = vk_create_compute_pipeline(graphics, particle_step_shaders[2], system->step_layout, 0);
+    system->simulate_pipeline = vk_create_compute_pipeline(graphics, particle_step_shaders[3], system->step_layout, 0);
+
+    vk_add_async_compute(graphics, "particles", particles_record_step, system, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT);
+
+    return system;
+}
+
+void particles_destroy(ParticleSystem* system) {
+    VkDevice device = system->graphics->device;
+
+    vkDestroyPipeline(device, system->init_pipeline, NULL);
+    vkDestroyPipeline(device, system->emit_pipeline, NULL);
+    vkDestroyPipeline(device, system->prepare_pipeline, NULL);
+    vkDestroyPipeline(device, system->simulate_pipeline, NULL);
+    vkDestroyPipeline(device, system->draw_pipeline, NULL);
+    vkDestroyDescriptorPool(device, system->descriptor_pool, NULL);
+
+    for (u32 i = 0; i < PARTICLE_BUFFER_COUNT; ++i) {
+        vkDestroyBuffer(device, system->buffers[i], NULL);
+        gpu_memory_free(device, &system->memory[i]);
+    }
+
+    heap_free(system);
+}
+
+void particles_update(ParticleSystem* system, const GraphicsParticleEmitter* emitter, float dt) {
+    system->emitter = *emitter;
+    system->pending_dt += dt;
+}
+
+void particles_draw(ParticleSystem* system, VkCommandBuffer command_buffer, const Mat4* view_projection, Vec3 camera_right, Vec3 camera_up) {
+    if (!system->initialized)
+        return;
+
+    ParticleDrawConstants constants = {
+        .view_projection = *view_projection,
+        .right_size = { camera_right.x, camera_right.y, camera_right.z, system->emitter.size },
+        .up_lifetime = { camera_up.x, camera_up.y, camera_up.z, system->emitter.lifetime > 0 ? system->emitter.lifetime : 1.0f },
+        .list_offset = system->current * system->capacity,
+    };
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system->draw_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system->draw_layout, 0, 1, &system->set, 0, NULL);
+    vkCmdPushConstants(command_buffer, system->draw_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+
+    /* the instance count is the alive count the simulation left behind */
+    vkCmdDrawIndirect(command_buffer, system->buffers[PARTICLE_BUFFER_COUNTERS], sizeof(VkDrawIndirectCommand) * system->current, 1, sizeof(VkDrawIndirectCommand));
+}
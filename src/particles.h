@@ -0,0 +1,31 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+#include "zmath.h"
+
+#include <volk.h>
+
+/*
+ * GPU particle system.
+ *
+ * Particles live in device local storage buffers and the CPU never touches one: every simulation step is an
+ * async compute job (see vk_add_async_compute()) that
+ *   - emits: pops indices off a dead list and appends them to the current alive list,
+ *   - prepares: sizes the simulation dispatch to the current alive count,
+ *   - simulates: integrates the live particles, appending survivors to the other alive list and returning
+ *     the dead to the dead list, which keeps the alive lists compacted.
+ * The alive counts double as the instance counts of two VkDrawIndirectCommands, so the main pass draws the
+ * survivors with a single indirect instanced draw, without any readback.
+ */
+
+typedef struct ParticleSystem ParticleSystem;
+
+ParticleSystem* particles_create(VulkanGraphics* graphics, u32 capacity);
+void particles_destroy(ParticleSystem* system);
+
+/* the emitter applies to the next step; `dt` adds up until the step is recorded. */
+void particles_update(ParticleSystem* system, const GraphicsParticleEmitter* emitter, float dt);
+
+/* draws into the main pass; its pipeline renders with the scene's color, depth and sample count. */
+void particles_draw(ParticleSystem* system, VkCommandBuffer command_buffer, const Mat4* view_projection, Vec3 camera_right, Vec3 camera_up);
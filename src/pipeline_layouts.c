@@ -0,0 +1,92 @@
+#include "pipeline_layouts.h"
+#include "renderer_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+VkDescriptorSetLayout pipeline_layouts_set(PipelineLayoutCache* cache, VkDevice device, const ShaderReflection* reflection, u32 set) {
+    /* zeroed past binding_count too, so layouts compare with memcmp() */
+    CachedSetLayout key = { 0 };
+    for (u32 i = 0; i < reflection->binding_count; ++i) {
+        const ReflectedBinding* binding = &reflection->bindings[i];
+        if (binding->set != set)
+            continue;
+
+        key.bindings[key.binding_count++] = (VkDescriptorSetLayoutBinding) {
+            .binding = binding->binding,
+            .descriptorType = binding->type,
+            .descriptorCount = binding->count,
+            .stageFlags = binding->stages,
+        };
+    }
+
+    for (u32 i = 0; i < cache->set_layout_count; ++i) {
+        const CachedSetLayout* cached = &cache->set_layouts[i];
+        if (cached->binding_count == key.binding_count && memcmp(cached->bindings, key.bindings, sizeof(key.bindings)) == 0)
+            return cached->layout;
+    }
+
+    if (cache->set_layout_count >= PIPELINE_LAYOUTS_MAX_SET_LAYOUTS) {
+        fprintf(stderr, "too many descriptor set layouts (max %u)\n", PIPELINE_LAYOUTS_MAX_SET_LAYOUTS);
+        exit(EXIT_FAILURE);
+    }
+
+    VkDescriptorSetLayoutCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = key.binding_count,
+        .pBindings = key.bindings,
+    };
+
+    ERR_CHECK(vkCreateDescriptorSetLayout(device, &info, NULL, &key.layout), "reflected descriptor set layout");
+
+    cache->set_layouts[cache->set_layout_count++] = key;
+    return key.layout;
+}
+
+VkPipelineLayout pipeline_layouts_get(PipelineLayoutCache* cache, VkDevice device, const ShaderReflection* sets, const ShaderReflection* pipeline) {
+    CachedPipelineLayout key = {
+        .set_count = shader_reflect_set_count(sets),
+        .push_constants = pipeline->push_constants,
+    };
+
+    for (u32 i = 0; i < key.set_count; ++i)
+        key.sets[i] = pipeline_layouts_set(cache, device, sets, i);
+
+    for (u32 i = 0; i < cache->layout_count; ++i) {
+        const CachedPipelineLayout* cached = &cache->layouts[i];
+        if (cached->set_count == key.set_count && memcmp(cached->sets, key.sets, sizeof(key.sets)) == 0
+            && cached->push_constants.stageFlags == key.push_constants.stageFlags
+            && cached->push_constants.offset == key.push_constants.offset
+            && cached->push_constants.size == key.push_constants.size)
+            return cached->layout;
+    }
+
+    if (cache->layout_count >= PIPELINE_LAYOUTS_MAX_LAYOUTS) {
+        fprintf(stderr, "too many pipeline layouts (max %u)\n", PIPELINE_LAYOUTS_MAX_LAYOUTS);
+        exit(EXIT_FAILURE);
+    }
+
+    VkPipelineLayoutCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = key.set_count,
+        .pSetLayouts = key.sets,
+        .pushConstantRangeCount = key.push_constants.stageFlags ? 1 : 0,
+        .pPushConstantRanges = &key.push_constants,
+    };
+
+    ERR_CHECK(vkCreatePipelineLayout(device, &info, NULL, &key.layout), "reflected pipeline layout");
+
+    cache->layouts[cache->layout_count++] = key;
+    return key.layout;
+}
+
+void pipeline_layouts_destroy(PipelineLayoutCache* cache, VkDevice device) {
+    for (u32 i = 0; i < cache->layout_count; ++i)
+        vkDestroyPipelineLayout(device, cache->layouts[i].layout, NULL);
+    for (u32 i = 0; i < cache->set_layout_count; ++i)
+        vkDestroyDescriptorSetLayout(device, cache->set_layouts[i].layout, NULL);
+
+    cache->layout_count = 0;
+    cache->set_layout_count = 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.h"
+#include "shader_reflect.h"
+
+#include <volk.h>
+
+/*
+ * Descriptor set and pipeline layouts made from shader reflection (shader_reflect.h), created once and shared:
+ * identical set layouts, and identical pipeline layouts, are the same handle, however many pipelines ask for
+ * them. Pipelines whose layouts agree on a set can then keep it bound across each other.
+ */
+
+#define PIPELINE_LAYOUTS_MAX_SET_LAYOUTS (u32)32
+#define PIPELINE_LAYOUTS_MAX_LAYOUTS (u32)32
+
+typedef struct CachedSetLayout {
+    u32 binding_count;
+    VkDescriptorSetLayoutBinding bindings[REFLECT_MAX_BINDINGS];
+    VkDescriptorSetLayout layout;
+} CachedSetLayout;
+
+typedef struct CachedPipelineLayout {
+    u32 set_count;
+    VkDescriptorSetLayout sets[REFLECT_MAX_SETS];
+    VkPushConstantRange push_constants;
+    VkPipelineLayout layout;
+} CachedPipelineLayout;
+
+typedef struct PipelineLayoutCache {
+    u32 set_layout_count;
+    CachedSetLayout set_layouts[PIPELINE_LAYOUTS_MAX_SET_LAYOUTS];
+    u32 layout_count;
+    CachedPipelineLayout layouts[PIPELINE_LAYOUTS_MAX_LAYOUTS];
+} PipelineLayoutCache;
+
+/* the layout of one set of `reflection`, with the bindings it declares and only the stages that use them. */
+VkDescriptorSetLayout pipeline_layouts_set(PipelineLayoutCache* cache, VkDevice device, const ShaderReflection* reflection, u32 set);
+
+/* the sets of `sets` and the push constants of `pipeline`. `sets` is usually the pipeline's reflection too,
+ * or the merge of every shader binding the same descriptor sets when several pipelines share them. */
+VkPipelineLayout pipeline_layouts_get(PipelineLayoutCache* cache, VkDevice device, const ShaderReflection* sets, const ShaderReflection* pipeline);
+
+/* every layout handed out so far. */
+void pipeline_layouts_destroy(PipelineLayoutCache* cache, VkDevice device);
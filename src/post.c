@@ -0,0 +1,280 @@
+#include "post.h"
+#include "renderer_internal.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POST_GROUP_SIZE (u32)8
+/* the blur's workgroups are tiles of this many texels a side; see post_bloom_blur.comp */
+#define POST_BLUR_TILE_SIZE (u32)16
+
+/* the post_composite.comp flags */
+#define POST_FLAG_BGRA (u32)1
+#define POST_FLAG_SHARPEN (u32)2
+
+/* push constants of post_bloom_prefilter.comp */
+typedef struct PostPrefilterConstants {
+    float src_texel[2];
+    /* the last rendered texel center, in uv */
+    float src_max[2];
+    s32 dst_size[2];
+    float threshold;
+    u32 reserved;
+} PostPrefilterConstants;
+
+/* push constants of post_bloom_blur.comp */
+typedef struct PostBlurConstants {
+    s32 size[2];
+} PostBlurConstants;
+
+/* push constants of post_composite.comp: output uv times the scales is scene and bloom uv */
+typedef struct PostCompositeConstants {
+    float scene_scale[2];
+    float scene_texel[2];
+    float scene_max[2];
+    float bloom_scale[2];
+    float bloom_max[2];
+    float reserved[2];
+    /* exposure, bloom intensity, saturation, contrast */
+    float grade[4];
+    /* gain per channel, sharpness */
+    float gain_sharpness[4];
+    s32 output_size[2];
+    u32 flags;
+    u32 reserved2;
+} PostCompositeConstants;
+
+struct PostChain {
+    VulkanGraphics* graphics;
+
+    /* of all three shaders: scene, bloom, blurred bloom as storage and sampled, output */
+    ShaderReflection reflection;
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    /* rewritten every frame with the views of the render graph, once the frame before on them is done */
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+    VkSampler sampler;
+
+    /* the constants of all three shaders fit into the composite's */
+    VkPipelineLayout layout;
+    VkPipeline prefilter_pipeline;
+    VkPipeline blur_pipeline;
+    VkPipeline composite_pipeline;
+
+    GraphicsPostSettings settings;
+};
+
+GraphicsPostSettings post_default_settings(void) {
+    return (GraphicsPostSettings) {
+        .exposure = 1.0f,
+        .bloom_threshold = 1.0f,
+        .bloom_intensity = 0.5f,
+        .saturation = 1.0f,
+        .contrast = 1.0f,
+        .gain = { 1.0f, 1.0f, 1.0f },
+        .sharpness = 0.25f,
+    };
+}
+
+bool post_supports_output_format(VkFormat format) {
+    /* every 32 bit format copies into every other as is; these four hold what the composite writes */
+    return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB
+        || format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+static const char* post_shader_paths[] = {
+    "shaders/bin/vulkan_post_bloom_prefilter.comp.spv",
+    "shaders/bin/vulkan_post_bloom_blur.comp.spv",
+    "shaders/bin/vulkan_post_composite.comp.spv",
+};
+
+static void post_chain_create_descriptors(PostChain* chain) {
+    VulkanGraphics* graphics = chain->graphics;
+    VkDevice device = graphics->device;
+
+    vk_reflect_shaders(graphics, post_shader_paths, ZARRSIZ(post_shader_paths), &chain->reflection);
+    chain->set_layout = pipeline_layouts_set(&graphics->layouts, device, &chain->reflection, 0);
+    chain->layout = pipeline_layouts_get(&graphics->layouts, device, &chain->reflection, &chain->reflection);
+
+    VkDescriptorPoolSize pool_sizes[REFLECT_MAX_BINDINGS];
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = shader_reflect_pool_sizes(&chain->reflection, 0, MAX_FRAMES_IN_FLIGHT, pool_sizes),
+        .pPoolSizes = pool_sizes,
+    };
+
+    ERR_CHECK(vkCreateDescriptorPool(device, &pool_info, NULL, &chain->descriptor_pool), "post descriptor pool");
+
+    VkDescriptorSetLayout set_layouts[MAX_FRAMES_IN_FLIGHT];
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        set_layouts[i] = chain->set_layout;
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = chain->descriptor_pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = set_layouts,
+    };
+
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, chain->sets), "post descriptor sets");
+
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    };
+
+    ERR_CHECK(vkCreateSampler(device, &sampler_info, NULL, &chain->sampler), "post sampler");
+}
+
+PostChain* post_chain_create(VulkanGraphics* graphics) {
+    PostChain* chain = heap_calloc(1, sizeof(PostChain));
+    chain->graphics = graphics;
+    chain->settings = post_default_settings();
+
+    post_chain_create_descriptors(chain);
+
+    chain->prefilter_pipeline = vk_create_compute_pipeline(graphics, post_shader_paths[0], chain->layout, 0);
+    chain->blur_pipeline = vk_create_compute_pipeline(graphics, post_shader_paths[1], chain->layout, 0);
+    chain->composite_pipeline = vk_create_compute_pipeline(graphics, post_shader_paths[2], chain->layout, 0);
+
+    return chain;
+}
+
+void post_chain_destroy(PostChain* chain) {
+    VkDevice device = chain->graphics->device;
+
+    vkDestroyPipeline(device, chain->prefilter_pipeline, NULL);
+    vkDestroyPipeline(device, chain->blur_pipeline, NULL);
+    vkDestroyPipeline(device, chain->composite_pipeline, NULL);
+    vkDestroySampler(device, chain->sampler, NULL);
+    vkDestroyDescriptorPool(device, chain->descriptor_pool, NULL);
+
+    heap_free(chain);
+}
+
+void post_chain_set(PostChain* chain, const GraphicsPostSettings* settings) {
+    chain->settings = *settings;
+}
+
+const GraphicsPostSettings* post_chain_settings(const PostChain* chain) {
+    return &chain->settings;
+}
+
+/* the blur reads what the prefilter wrote. */
+static void post_barrier(VkCommandBuffer command_buffer) {
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &(VkMemoryBarrier2) {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        },
+    });
+}
+
+static void post_chain_write_set(PostChain* chain, VkDescriptorSet set, const PostTargets* targets) {
+    /* the blurred bloom is written by the bloom pass and sampled by the composite one, in the layouts the render
+     * graph moves it between */
+    VkDescriptorImageInfo image_infos[] = {
+        { chain->sampler, targets->scene, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { VK_NULL_HANDLE, targets->bloom, VK_IMAGE_LAYOUT_GENERAL },
+        { VK_NULL_HANDLE, targets->bloom_blurred, VK_IMAGE_LAYOUT_GENERAL },
+        { chain->sampler, targets->bloom_blurred, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { VK_NULL_HANDLE, targets->output, VK_IMAGE_LAYOUT_GENERAL },
+    };
+
+    /* the bindings are 0 to 4, in this order */
+    VkWriteDescriptorSet writes[ZARRSIZ(image_infos)];
+    for (u32 i = 0; i < ZARRSIZ(image_infos); ++i) {
+        writes[i] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = i,
+            .descriptorCount = 1,
+            .descriptorType = chain->reflection.bindings[i].type,
+            .pImageInfo = &image_infos[i],
+        };
+    }
+
+    vkUpdateDescriptorSets(chain->graphics->device, ZARRSIZ(writes), writes, 0, NULL);
+}
+
+/* the bloom of the rendered part of the scene only */
+static void post_bloom_size(const PostTargets* targets, s32 size[2]) {
+    size[0] = (s32)vk_dispatch_size(targets->render_extent.width, POST_BLOOM_DOWNSAMPLE);
+    size[1] = (s32)vk_dispatch_size(targets->render_extent.height, POST_BLOOM_DOWNSAMPLE);
+}
+
+void post_chain_record_bloom(PostChain* chain, VkCommandBuffer command_buffer, u32 frame, const PostTargets* targets) {
+    TRACE_FUNCTION();
+
+    /* the sets are written once a frame, before their first use */
+    VkDescriptorSet set = chain->sets[frame];
+    post_chain_write_set(chain, set, targets);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, chain->layout, 0, 1, &set, 0, NULL);
+
+    float scene_texel[2] = { 1.0f / targets->scene_extent.width, 1.0f / targets->scene_extent.height };
+
+    s32 bloom_size[2];
+    post_bloom_size(targets, bloom_size);
+
+    PostPrefilterConstants prefilter = {
+        .src_texel = { scene_texel[0], scene_texel[1] },
+        .src_max = { (targets->render_extent.width - 0.5f) * scene_texel[0], (targets->render_extent.height - 0.5f) * scene_texel[1] },
+        .dst_size = { bloom_size[0], bloom_size[1] },
+        .threshold = chain->settings.bloom_threshold,
+    };
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, chain->prefilter_pipeline);
+    vkCmdPushConstants(command_buffer, chain->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(prefilter), &prefilter);
+    vkCmdDispatch(command_buffer, vk_dispatch_size((u32)bloom_size[0], POST_GROUP_SIZE), vk_dispatch_size((u32)bloom_size[1], POST_GROUP_SIZE), 1);
+
+    post_barrier(command_buffer);
+
+    PostBlurConstants blur = { .size = { bloom_size[0], bloom_size[1] } };
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, chain->blur_pipeline);
+    vkCmdPushConstants(command_buffer, chain->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(blur), &blur);
+    vkCmdDispatch(command_buffer, vk_dispatch_size((u32)bloom_size[0], POST_BLUR_TILE_SIZE), vk_dispatch_size((u32)bloom_size[1], POST_BLUR_TILE_SIZE), 1);
+}
+
+void post_chain_record_composite(PostChain* chain, VkCommandBuffer command_buffer, u32 frame, const PostTargets* targets) {
+    TRACE_FUNCTION();
+
+    const GraphicsPostSettings* settings = &chain->settings;
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, chain->layout, 0, 1, &chain->sets[frame], 0, NULL);
+
+    float scene_texel[2] = { 1.0f / targets->scene_extent.width, 1.0f / targets->scene_extent.height };
+    float bloom_texel[2] = { 1.0f / targets->bloom_extent.width, 1.0f / targets->bloom_extent.height };
+    float render[2] = { (float)targets->render_extent.width, (float)targets->render_extent.height };
+
+    s32 bloom_size[2];
+    post_bloom_size(targets, bloom_size);
+
+    PostCompositeConstants composite = {
+        .scene_scale = { render[0] * scene_texel[0], render[1] * scene_texel[1] },
+        .scene_texel = { scene_texel[0], scene_texel[1] },
+        .scene_max = { (render[0] - 0.5f) * scene_texel[0], (render[1] - 0.5f) * scene_texel[1] },
+        .bloom_scale = { render[0] / POST_BLOOM_DOWNSAMPLE * bloom_texel[0], render[1] / POST_BLOOM_DOWNSAMPLE * bloom_texel[1] },
+        .bloom_max = { (bloom_size[0] - 0.5f) * bloom_texel[0], (bloom_size[1] - 0.5f) * bloom_texel[1] },
+        .grade = { settings->exposure, settings->bloom_intensity, settings->saturation, settings->contrast },
+        .gain_sharpness = { settings->gain[0], settings->gain[1], settings->gain[2], settings->sharpness },
+        .output_size = { (s32)targets->output_extent.width, (s32)targets->output_extent.height },
+        .flags = (targets->output_bgra ? POST_FLAG_BGRA : 0) | (settings->sharpness > 0.0f ? POST_FLAG_SHARPEN : 0),
+    };
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, chain->composite_pipeline);
+    vkCmdPushConstants(command_buffer, chain->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(composite), &composite);
+    vkCmdDispatch(command_buffer, vk_dispatch_size(targets->output_extent.width, POST_GROUP_SIZE), vk_dispatch_size(targets->output_extent.height, POST_GROUP_SIZE), 1);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+
+#include <stdbool.h>
+#include <volk.h>
+
+/*
+ * Compute post-processing.
+ *
+ * With GraphicsConfiguration.post_processing the scene is rendered into an HDR target (POST_SCENE_FORMAT) and
+ * turned into the frame by three compute dispatches in two render graph passes, where a chain of full-screen
+ * raster passes would write and read back a full resolution image per effect:
+ *   - post_bloom_prefilter.comp keeps what is brighter than the threshold and downsamples it by 4 in one go,
+ *     so the bloom works on a sixteenth of the texels;
+ *   - post_bloom_blur.comp blurs that in both directions in a single dispatch, each workgroup loading its tile
+ *     and the apron around it into shared memory once;
+ *   - post_composite.comp does everything per pixel in one read of the scene and one write of the result:
+ *     upscaling from the render extent, adding the bloom, exposure, tonemapping, sharpening, color grading and
+ *     encoding to sRGB. It writes the swapchain image directly when that can be a storage image, otherwise an
+ *     RGBA8 storage image that is copied into it.
+ */
+
+#define POST_SCENE_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+#define POST_BLOOM_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+/* the output the composite writes when it can't write the swapchain image */
+#define POST_OUTPUT_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+/* the bloom is this many times smaller than the scene on each side */
+#define POST_BLOOM_DOWNSAMPLE (u32)4
+
+typedef struct PostChain PostChain;
+
+/* what one frame is post-processed from and into. the bloom pass samples the scene and writes both bloom
+ * images as storage images; the composite pass samples the scene and the blurred bloom and writes the output
+ * as a storage image. */
+typedef struct PostTargets {
+    VkImageView scene;
+    VkExtent2D scene_extent;
+    /* the part of the scene that was rendered to */
+    VkExtent2D render_extent;
+
+    VkImageView bloom;
+    VkImageView bloom_blurred;
+    VkExtent2D bloom_extent;
+
+    VkImageView output;
+    VkExtent2D output_extent;
+    /* the output is copied into a B8G8R8A8 image, so the composite writes the channels swapped */
+    bool output_bgra;
+} PostTargets;
+
+/* the default settings of graphics_set_post_settings(). */
+GraphicsPostSettings post_default_settings(void);
+
+/* true if the composite can be copied into images of `format`. */
+bool post_supports_output_format(VkFormat format);
+
+PostChain* post_chain_create(VulkanGraphics* graphics);
+void post_chain_destroy(PostChain* chain);
+
+void post_chain_set(PostChain* chain, const GraphicsPostSettings* settings);
+const GraphicsPostSettings* post_chain_settings(const PostChain* chain);
+
+/* the prefilter and the blur, into a compute pass. */
+void post_chain_record_bloom(PostChain* chain, VkCommandBuffer command_buffer, u32 frame, const PostTargets* targets);
+/* the composite, into a compute pass after the bloom one, with the same targets. */
+void post_chain_record_composite(PostChain* chain, VkCommandBuffer command_buffer, u32 frame, const PostTargets* targets);
@@ -0,0 +1,140 @@
+#include "recording.h"
+#include "arena.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define RECORDER_BUFFER_SIZE ((usize)64 << 10)
+
+struct Recorder {
+    FILE* file;
+    /* payload bytes of the command being written, for its padding */
+    u32 command_size;
+    usize length;
+    u8 buffer[RECORDER_BUFFER_SIZE];
+};
+
+static inline u32 recording_padded(u32 size) {
+    return (size + 7) & ~(u32)7;
+}
+
+static void recorder_flush(Recorder* recorder) {
+    if (recorder->length > 0)
+        fwrite(recorder->buffer, 1, recorder->length, recorder->file);
+
+    recorder->length = 0;
+}
+
+void recorder_append(Recorder* recorder, const void* data, usize size) {
+    /* commands are tiny next to the buffer; only oversized payloads skip it */
+    if (recorder->length + size > RECORDER_BUFFER_SIZE) {
+        recorder_flush(recorder);
+
+        if (size > RECORDER_BUFFER_SIZE) {
+            fwrite(data, 1, size, recorder->file);
+            return;
+        }
+    }
+
+    memcpy(recorder->buffer + recorder->length, data, size);
+    recorder->length += size;
+}
+
+Recorder* recorder_create(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "recording: couldn't create %s\n", path);
+        return NULL;
+    }
+
+    Recorder* recorder = heap_alloc(sizeof(Recorder));
+    recorder->file = file;
+    recorder->length = 0;
+
+    RecordingFileHeader header = { RECORDING_MAGIC, RECORDING_VERSION };
+    recorder_append(recorder, &header, sizeof(header));
+
+    return recorder;
+}
+
+void recorder_destroy(Recorder* recorder) {
+    recorder_flush(recorder);
+    fclose(recorder->file);
+
+    heap_free(recorder);
+}
+
+void recorder_begin(Recorder* recorder, enum RecordingCommandType type, u32 size) {
+    RecordingCommand command = { .type = type, .size = size };
+    recorder_append(recorder, &command, sizeof(command));
+    recorder->command_size = size;
+}
+
+void recorder_end(Recorder* recorder) {
+    static const u8 padding[8] = { 0 };
+    recorder_append(recorder, padding, recording_padded(recorder->command_size) - recorder->command_size);
+}
+
+void recorder_write(Recorder* recorder, enum RecordingCommandType type, const void* payload, u32 size) {
+    recorder_begin(recorder, type, size);
+    recorder_append(recorder, payload, size);
+    recorder_end(recorder);
+}
+
+bool recording_open(RecordingReader* reader, const char* path) {
+    reader->view = file_view_open(path);
+    reader->offset = sizeof(RecordingFileHeader);
+
+    if (reader->view.data == NULL) {
+        fprintf(stderr, "recording: couldn't open %s\n", path);
+        return false;
+    }
+
+    const RecordingFileHeader* header = (const RecordingFileHeader*)reader->view.data;
+    if (reader->view.length < sizeof(*header) || header->magic != RECORDING_MAGIC || header->version != RECORDING_VERSION) {
+        fprintf(stderr, "recording: %s isn't a version %u recording\n", path, RECORDING_VERSION);
+        file_view_close(&reader->view);
+        return false;
+    }
+
+    return true;
+}
+
+void recording_close(RecordingReader* reader) {
+    file_view_close(&reader->view);
+}
+
+const RecordingCommand* recording_next(RecordingReader* reader, const void** payload) {
+    if (reader->offset + sizeof(RecordingCommand) > reader->view.length)
+        return NULL;
+
+    const RecordingCommand* command = (const RecordingCommand*)(reader->view.data + reader->offset);
+    if (reader->offset + sizeof(RecordingCommand) + command->size > reader->view.length)
+        return NULL;
+
+    *payload = command + 1;
+    reader->offset += sizeof(RecordingCommand) + recording_padded(command->size);
+
+    return command;
+}
+
+void recording_rewind(RecordingReader* reader) {
+    reader->offset = sizeof(RecordingFileHeader);
+}
+
+GraphicsConfiguration recording_replay_config(const RecordedConfig* config) {
+    return (GraphicsConfiguration) {
+        .app_name = "replay",
+        .power_preference = GRAPHICS_HIGH_PERFORMANCE,
+        .msaa_samples = config->msaa_samples,
+        .dynamic_resolution = config->dynamic_resolution,
+        .frame_budget_ms = config->frame_budget_ms,
+        .shader_features = config->shader_features,
+        .max_particles = config->max_particles,
+        .post_processing = config->post_processing,
+
+        .render_surface = NULL,
+        .headless_width = config->width,
+        .headless_height = config->height,
+    };
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "types.h"
+#include "io.h"
+#include "renderer.h"
+
+#include <stdbool.h>
+
+/*
+ * Command stream recording.
+ *
+ * While recording, the renderer writes everything that decides what a frame renders (the configuration,
+ * state changes made through the public API, and per frame the target size and render scale) into a compact
+ * binary file. Replaying it through graphics_replay_command() reproduces the same GPU workload, frame by
+ * frame, independent of the window, the input or the timing that produced it; see tools/replay.c.
+ *
+ * The file is a RecordingFileHeader followed by commands: a RecordingCommand and `size` bytes of payload,
+ * padded so the next command is 8 byte aligned. Readers skip command types they don't know.
+ */
+
+#define RECORDING_MAGIC (u32)0x4c50525a /* "ZRPL" */
+#define RECORDING_VERSION (u32)4
+
+enum RecordingCommandType {
+    RECORDING_CMD_CONFIG = 1,
+    RECORDING_CMD_SHADER_FEATURES,
+    RECORDING_CMD_FRAME,
+    RECORDING_CMD_SPRITE_IMAGE,
+    RECORDING_CMD_SPRITES,
+    RECORDING_CMD_CAMERA,
+    RECORDING_CMD_PARTICLES,
+    RECORDING_CMD_MESH,
+    RECORDING_CMD_MESH_DRAW,
+    RECORDING_CMD_LIGHTS,
+    RECORDING_CMD_STATIC_MESH_DRAW,
+    RECORDING_CMD_SPRITE_TEXTURE,
+    RECORDING_CMD_POST_SETTINGS,
+};
+
+typedef struct RecordingFileHeader {
+    u32 magic;
+    u32 version;
+} RecordingFileHeader;
+
+typedef struct RecordingCommand {
+    u16 type;
+    u16 reserved;
+    u32 size;
+} RecordingCommand;
+
+/* the state a recording starts from; always the first command. */
+typedef struct RecordedConfig {
+    u32 width;
+    u32 height;
+    u32 msaa_samples;
+    u32 dynamic_resolution;
+    float frame_budget_ms;
+    u32 shader_features;
+    u32 max_particles;
+    u32 post_processing;
+} RecordedConfig;
+
+typedef struct RecordedFrame {
+    u64 frame_index;
+    u32 width;
+    u32 height;
+    float render_scale;
+    u32 reserved;
+} RecordedFrame;
+
+/* followed by width * height RGBA8 pixels. images already in the atlas when recording starts are written
+ * first, so image handles match on replay. */
+typedef struct RecordedSpriteImage {
+    u32 width;
+    u32 height;
+} RecordedSpriteImage;
+
+/* RECORDING_CMD_SPRITES is an array of GraphicsSprite, RECORDING_CMD_LIGHTS of GraphicsLight, RECORDING_CMD_CAMERA
+ * a GraphicsCamera, RECORDING_CMD_POST_SETTINGS a GraphicsPostSettings. */
+
+typedef struct RecordedParticles {
+    GraphicsParticleEmitter emitter;
+    float dt;
+} RecordedParticles;
+
+/* RECORDING_CMD_MESH is the NUL terminated path of a loaded mesh; meshes already loaded when recording starts
+ * are written first, like sprite images. the path is replayed as is, relative to the working directory.
+ * RECORDING_CMD_SPRITE_TEXTURE is the same for a sprite image loaded from a texture. */
+
+/* both RECORDING_CMD_MESH_DRAW and RECORDING_CMD_STATIC_MESH_DRAW */
+typedef struct RecordedMeshDraw {
+    GraphicsMesh mesh;
+    float transform[16];
+} RecordedMeshDraw;
+
+typedef struct Recorder Recorder;
+
+/* returns NULL if the file can't be created. */
+Recorder* recorder_create(const char* path);
+void recorder_destroy(Recorder* recorder);
+
+/* buffered; doesn't allocate. */
+void recorder_write(Recorder* recorder, enum RecordingCommandType type, const void* payload, u32 size);
+
+/* for payloads that aren't in one piece: recorder_begin(), exactly `size` bytes of recorder_append(), recorder_end(). */
+void recorder_begin(Recorder* recorder, enum RecordingCommandType type, u32 size);
+void recorder_append(Recorder* recorder, const void* data, usize size);
+void recorder_end(Recorder* recorder);
+
+/* reads a recording through a memory mapping of the whole file. */
+typedef struct RecordingReader {
+    FileView view;
+    u64 offset;
+} RecordingReader;
+
+bool recording_open(RecordingReader* reader, const char* path);
+void recording_close(RecordingReader* reader);
+
+/* returns NULL at the end of the recording, or where it's truncated. */
+const RecordingCommand* recording_next(RecordingReader* reader, const void** payload);
+void recording_rewind(RecordingReader* reader);
+
+/* the GraphicsConfiguration a headless replay of the recording has to be initialized with. */
+GraphicsConfiguration recording_replay_config(const RecordedConfig* config);
+
+/* applies one recorded command to the renderer; RECORDING_CMD_FRAME draws a frame. */
+void graphics_replay_command(Graphics* graphics, const RecordingCommand* command, const void* payload);
@@ -0,0 +1,812 @@
+#include "render_graph.h"
+#include "renderer_internal.h"
+#include "gpu_memory.h"
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct RenderGraphAccess {
+    RenderGraphResource resource;
+    enum RenderGraphUsage usage;
+    bool write;
+} RenderGraphAccess;
+
+typedef struct RenderGraphPassData {
+    const char* name;
+    enum RenderGraphPassType type;
+
+    RenderGraphExecuteFunc execute;
+    void* data;
+
+    u32 accesses_count;
+    RenderGraphAccess accesses[RG_MAX_PASS_ACCESSES];
+
+    bool keep;
+    bool culled;
+
+    /* range in RenderGraph::barriers */
+    u32 first_barrier;
+    u32 barriers_count;
+} RenderGraphPassData;
+
+typedef struct RenderGraphResourceData {
+    const char* name;
+    bool imported;
+
+    RenderGraphImageInfo info;
+    RenderGraphImportInfo import;
+
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+
+    /* lifetime in live passes, RG_INVALID if no live pass touches it. */
+    u32 first_pass;
+    u32 last_pass;
+    u32 live_passes_count;
+
+    /* backed by lazily allocated memory, see RenderGraphImageInfo::transient */
+    bool lazy;
+
+    /* stage and write access of the last live use; the next frame (or the next alias) waits on these. */
+    VkPipelineStageFlags2 last_stages;
+    VkAccessFlags2 last_writes;
+
+    /* the resource that used the same memory right before this one. */
+    RenderGraphResource alias_predecessor;
+
+    VkImage image;
+    VkImageView view;
+} RenderGraphResourceData;
+
+typedef struct RenderGraphBarrier {
+    RenderGraphResource resource;
+    /* .image is patched in at execution time, imported images change every frame. */
+    VkImageMemoryBarrier2 barrier;
+} RenderGraphBarrier;
+
+typedef struct RenderGraphAliasSlot {
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    u32 type_bits;
+    bool lazy;
+
+    u32 last_pass;
+    RenderGraphResource first_resource;
+    RenderGraphResource last_resource;
+
+    u32 memory_type;
+    VkDeviceSize offset;
+} RenderGraphAliasSlot;
+
+struct RenderGraph {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_props;
+
+    u32 passes_count;
+    RenderGraphPassData passes[RG_MAX_PASSES];
+
+    u32 resources_count;
+    RenderGraphResourceData resources[RG_MAX_RESOURCES];
+
+    u32 barriers_count;
+    RenderGraphBarrier barriers[RG_MAX_PASSES * RG_MAX_PASS_ACCESSES + RG_MAX_RESOURCES];
+
+    /* transitions of imported images into their final layouts */
+    u32 final_first_barrier;
+    u32 final_barriers_count;
+
+    GpuAllocation memory[VK_MAX_MEMORY_TYPES];
+    VkDeviceSize memory_size;
+    VkDeviceSize lazy_memory_size;
+
+    /* see rg_set_timestamps() */
+    VkQueryPool timestamp_pool;
+    u32 first_timestamp;
+    VkPipelineStageFlags2 timestamp_wait_stages;
+    u32 timestamps_count;
+
+    bool compiled;
+};
+
+typedef struct RenderGraphUsageInfo {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    VkAccessFlags2 writes;
+    VkImageLayout layout;
+    VkImageUsageFlags image_usage;
+} RenderGraphUsageInfo;
+
+static RenderGraphUsageInfo rg_usage_info(enum RenderGraphPassType type, enum RenderGraphUsage usage) {
+    VkPipelineStageFlags2 shader_stage = type == RG_PASS_COMPUTE ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+
+    switch (usage) {
+        case RG_USAGE_COLOR_ATTACHMENT:
+            return (RenderGraphUsageInfo) {
+                VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            };
+        case RG_USAGE_DEPTH_ATTACHMENT:
+            return (RenderGraphUsageInfo) {
+                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            };
+        case RG_USAGE_DEPTH_READ:
+            return (RenderGraphUsageInfo) {
+                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                0,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            };
+        case RG_USAGE_SAMPLED:
+            return (RenderGraphUsageInfo) {
+                shader_stage,
+                VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                0,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_SAMPLED_BIT,
+            };
+        case RG_USAGE_STORAGE_READ:
+            return (RenderGraphUsageInfo) {
+                shader_stage,
+                VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                0,
+                VK_IMAGE_LAYOUT_GENERAL,
+                VK_IMAGE_USAGE_STORAGE_BIT,
+            };
+        case RG_USAGE_STORAGE_WRITE:
+            return (RenderGraphUsageInfo) {
+                shader_stage,
+                VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                VK_IMAGE_LAYOUT_GENERAL,
+                VK_IMAGE_USAGE_STORAGE_BIT,
+            };
+        case RG_USAGE_TRANSFER_SRC:
+            return (RenderGraphUsageInfo) {
+                VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                VK_ACCESS_2_TRANSFER_READ_BIT,
+                0,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            };
+        case RG_USAGE_TRANSFER_DST:
+            return (RenderGraphUsageInfo) {
+                VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            };
+        default:
+            fprintf(stderr, "unknown render graph usage %d\n", usage);
+            exit(EXIT_FAILURE);
+    }
+}
+
+static VkImageAspectFlags rg_format_aspect(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+RenderGraph* rg_create(VkDevice device, const VkPhysicalDeviceMemoryProperties* memory_props) {
+    RenderGraph* graph = heap_calloc(1, sizeof(RenderGraph));
+    graph->device = device;
+    graph->memory_props = *memory_props;
+
+    return graph;
+}
+
+void rg_destroy(RenderGraph* graph) {
+    rg_reset(graph);
+    heap_free(graph);
+}
+
+void rg_reset(RenderGraph* graph) {
+    for (u32 i = 0; i < graph->resources_count; ++i) {
+        RenderGraphResourceData* res = &graph->resources[i];
+        if (res->imported)
+            continue;
+
+        if (res->view)
+            vkDestroyImageView(graph->device, res->view, NULL);
+        if (res->image)
+            vkDestroyImage(graph->device, res->image, NULL);
+    }
+
+    for (u32 i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
+        gpu_memory_free(graph->device, &graph->memory[i]);
+    }
+
+    graph->passes_count = 0;
+    graph->resources_count = 0;
+    graph->barriers_count = 0;
+    graph->final_barriers_count = 0;
+    graph->memory_size = 0;
+    graph->lazy_memory_size = 0;
+    graph->compiled = false;
+}
+
+static RenderGraphResourceData* rg_new_resource(RenderGraph* graph, const char* name) {
+    if (graph->resources_count >= RG_MAX_RESOURCES) {
+        fprintf(stderr, "render graph: too many resources (max %d)\n", RG_MAX_RESOURCES);
+        exit(EXIT_FAILURE);
+    }
+
+    RenderGraphResourceData* res = &graph->resources[graph->resources_count++];
+    memset(res, 0, sizeof(*res));
+
+    res->name = name;
+    res->first_pass = RG_INVALID;
+    res->last_pass = RG_INVALID;
+    res->alias_predecessor = RG_INVALID;
+
+    return res;
+}
+
+RenderGraphResource rg_create_image(RenderGraph* graph, const char* name, const RenderGraphImageInfo* info) {
+    RenderGraphResourceData* res = rg_new_resource(graph, name);
+    res->info = *info;
+    res->aspect = rg_format_aspect(info->format);
+
+    if (res->info.mip_levels == 0)
+        res->info.mip_levels = 1;
+    if (res->info.samples == 0)
+        res->info.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    return graph->resources_count - 1;
+}
+
+RenderGraphResource rg_import_image(RenderGraph* graph, const char* name, const RenderGraphImportInfo* info) {
+    RenderGraphResourceData* res = rg_new_resource(graph, name);
+    res->imported = true;
+    res->import = *info;
+    res->info.format = info->format;
+    res->aspect = rg_format_aspect(info->format);
+
+    return graph->resources_count - 1;
+}
+
+RenderGraphPass rg_add_pass(RenderGraph* graph, const char* name, enum RenderGraphPassType type, RenderGraphExecuteFunc execute, void* data) {
+    if (graph->passes_count >= RG_MAX_PASSES) {
+        fprintf(stderr, "render graph: too many passes (max %d)\n", RG_MAX_PASSES);
+        exit(EXIT_FAILURE);
+    }
+
+    RenderGraphPassData* pass = &graph->passes[graph->passes_count++];
+    memset(pass, 0, sizeof(*pass));
+
+    pass->name = name;
+    pass->type = type;
+    pass->execute = execute;
+    pass->data = data;
+
+    return graph->passes_count - 1;
+}
+
+static void rg_add_access(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, enum RenderGraphUsage usage, bool write) {
+    RenderGraphPassData* p = &graph->passes[pass];
+    if (p->accesses_count >= RG_MAX_PASS_ACCESSES) {
+        fprintf(stderr, "render graph: pass %s has too many accesses (max %d)\n", p->name, RG_MAX_PASS_ACCESSES);
+        exit(EXIT_FAILURE);
+    }
+
+    p->accesses[p->accesses_count++] = (RenderGraphAccess) { resource, usage, write };
+}
+
+void rg_read(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, enum RenderGraphUsage usage) {
+    rg_add_access(graph, pass, resource, usage, false);
+}
+
+void rg_write(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, enum RenderGraphUsage usage) {
+    rg_add_access(graph, pass, resource, usage, true);
+}
+
+void rg_pass_keep(RenderGraph* graph, RenderGraphPass pass) {
+    graph->passes[pass].keep = true;
+}
+
+static bool rg_pass_reads(RenderGraphPassData* pass, RenderGraphResource resource) {
+    for (u32 i = 0; i < pass->accesses_count; ++i) {
+        if (pass->accesses[i].resource == resource && !pass->accesses[i].write)
+            return true;
+    }
+
+    return false;
+}
+
+static void rg_cull(RenderGraph* graph) {
+    bool needed[RG_MAX_RESOURCES] = { 0 };
+
+    for (u32 i = 0; i < graph->resources_count; ++i) {
+        if (graph->resources[i].imported && graph->resources[i].import.final_layout != VK_IMAGE_LAYOUT_UNDEFINED)
+            needed[i] = true;
+    }
+
+    /* walking backwards, a pass lives if it writes something a later live pass (or the outside) needs. */
+    for (u32 p = graph->passes_count; p-- > 0;) {
+        RenderGraphPassData* pass = &graph->passes[p];
+
+        bool live = pass->keep;
+        for (u32 i = 0; i < pass->accesses_count; ++i) {
+            if (pass->accesses[i].write && needed[pass->accesses[i].resource])
+                live = true;
+        }
+
+        pass->culled = !live;
+        if (!live)
+            continue;
+
+        /* a pure write overwrites whatever was there, so earlier writers aren't needed for it anymore. */
+        for (u32 i = 0; i < pass->accesses_count; ++i) {
+            if (pass->accesses[i].write && !rg_pass_reads(pass, pass->accesses[i].resource))
+                needed[pass->accesses[i].resource] = false;
+        }
+
+        for (u32 i = 0; i < pass->accesses_count; ++i) {
+            if (!pass->accesses[i].write)
+                needed[pass->accesses[i].resource] = true;
+        }
+    }
+}
+
+static void rg_compute_lifetimes(RenderGraph* graph) {
+    for (u32 p = 0; p < graph->passes_count; ++p) {
+        RenderGraphPassData* pass = &graph->passes[p];
+        if (pass->culled)
+            continue;
+
+        for (u32 i = 0; i < pass->accesses_count; ++i) {
+            RenderGraphResourceData* res = &graph->resources[pass->accesses[i].resource];
+            RenderGraphUsageInfo info = rg_usage_info(pass->type, pass->accesses[i].usage);
+
+            if (res->first_pass == RG_INVALID)
+                res->first_pass = p;
+
+            /* several accesses in the same pass combine */
+            if (res->last_pass != p) {
+                res->last_stages = 0;
+                res->last_writes = 0;
+                res->live_passes_count++;
+            }
+
+            res->last_pass = p;
+            res->last_stages |= info.stages;
+            res->last_writes |= pass->accesses[i].write ? info.writes : 0;
+            res->usage |= info.image_usage;
+        }
+    }
+
+    for (u32 r = 0; r < graph->resources_count; ++r) {
+        RenderGraphResourceData* res = &graph->resources[r];
+
+        VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        res->lazy = !res->imported && res->info.transient && res->live_passes_count == 1 && (res->usage & ~attachment_usage) == 0;
+
+        if (res->lazy)
+            res->usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+}
+
+static void rg_create_transient_images(RenderGraph* graph, VkExtent2D extent) {
+    RenderGraphAliasSlot slots[RG_MAX_RESOURCES];
+    u32 slots_count = 0;
+
+    u32 aliased_resource_slot[RG_MAX_RESOURCES];
+    VkDeviceSize unaliased_size = 0;
+
+    /* resources are visited in order of first use, so a first-fit over the slots' lifetimes works. */
+    for (u32 p = 0; p < graph->passes_count; ++p) {
+        for (u32 r = 0; r < graph->resources_count; ++r) {
+            RenderGraphResourceData* res = &graph->resources[r];
+            if (res->imported || res->first_pass != p)
+                continue;
+
+            if (res->info.extent.width == 0 || res->info.extent.height == 0)
+                res->info.extent = extent;
+
+            VkImageCreateInfo image_info = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = res->info.format,
+                .extent = { res->info.extent.width, res->info.extent.height, 1 },
+                .mipLevels = res->info.mip_levels,
+                .arrayLayers = 1,
+                .samples = res->info.samples,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = res->usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            };
+
+            ERR_CHECK(vkCreateImage(graph->device, &image_info, NULL, &res->image), "render graph image");
+
+            VkMemoryRequirements reqs;
+            vkGetImageMemoryRequirements(graph->device, res->image, &reqs);
+            unaliased_size += reqs.size;
+
+            /* best fit among the slots whose previous occupant is already dead */
+            u32 best = RG_INVALID;
+            for (u32 s = 0; s < slots_count; ++s) {
+                if (slots[s].last_pass >= p || slots[s].lazy != res->lazy || !(slots[s].type_bits & reqs.memoryTypeBits))
+                    continue;
+
+                /* the smallest slot that fits, otherwise the biggest one (it then grows the least) */
+                bool fits = slots[s].size >= reqs.size;
+                bool best_fits = best != RG_INVALID && slots[best].size >= reqs.size;
+
+                if (best == RG_INVALID || (fits && (!best_fits || slots[s].size < slots[best].size)) || (!fits && !best_fits && slots[s].size > slots[best].size))
+                    best = s;
+            }
+
+            if (best == RG_INVALID) {
+                best = slots_count++;
+                slots[best] = (RenderGraphAliasSlot) {
+                    .type_bits = reqs.memoryTypeBits,
+                    .lazy = res->lazy,
+                    .first_resource = r,
+                    .last_resource = RG_INVALID,
+                };
+            }
+
+            RenderGraphAliasSlot* slot = &slots[best];
+            slot->size = slot->size > reqs.size ? slot->size : reqs.size;
+            slot->alignment = slot->alignment > reqs.alignment ? slot->alignment : reqs.alignment;
+            slot->type_bits &= reqs.memoryTypeBits;
+            slot->last_pass = res->last_pass;
+
+            res->alias_predecessor = slot->last_resource;
+            slot->last_resource = r;
+
+            aliased_resource_slot[r] = best;
+        }
+    }
+
+    /* the first occupant of a slot follows the last one of the previous frame. */
+    for (u32 s = 0; s < slots_count; ++s)
+        graph->resources[slots[s].first_resource].alias_predecessor = slots[s].last_resource;
+
+    /* one allocation per memory type, slots are placed at aligned offsets inside it. */
+    VkDeviceSize type_sizes[VK_MAX_MEMORY_TYPES] = { 0 };
+    for (u32 s = 0; s < slots_count; ++s) {
+        RenderGraphAliasSlot* slot = &slots[s];
+
+        VkMemoryPropertyFlags preferred = slot->lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+        slot->memory_type = gpu_memory_find_type(&graph->memory_props, slot->type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, preferred);
+        if (slot->memory_type == UINT32_MAX) {
+            fprintf(stderr, "render graph: no device local memory type for bits 0x%x\n", slot->type_bits);
+            exit(EXIT_FAILURE);
+        }
+
+        VkDeviceSize offset = type_sizes[slot->memory_type];
+        offset = (offset + slot->alignment - 1) / slot->alignment * slot->alignment;
+
+        slot->offset = offset;
+        type_sizes[slot->memory_type] = offset + slot->size;
+    }
+
+    for (u32 t = 0; t < VK_MAX_MEMORY_TYPES; ++t) {
+        if (type_sizes[t] == 0)
+            continue;
+
+        graph->memory[t] = gpu_memory_allocate_type(graph->device, &graph->memory_props, t, type_sizes[t], GRAPHICS_MEMORY_RENDER_TARGETS);
+        if (graph->memory[t].memory == VK_NULL_HANDLE) {
+            fprintf(stderr, "render graph: couldn't allocate %llu bytes of transient memory\n", (unsigned long long)type_sizes[t]);
+            exit(EXIT_FAILURE);
+        }
+        graph->memory_size += type_sizes[t];
+
+        if (graph->memory_props.memoryTypes[t].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+            graph->lazy_memory_size += type_sizes[t];
+    }
+
+    for (u32 r = 0; r < graph->resources_count; ++r) {
+        RenderGraphResourceData* res = &graph->resources[r];
+        if (res->imported || res->image == VK_NULL_HANDLE)
+            continue;
+
+        RenderGraphAliasSlot* slot = &slots[aliased_resource_slot[r]];
+        ERR_CHECK(vkBindImageMemory(graph->device, res->image, graph->memory[slot->memory_type].memory, slot->offset), "render graph image binding");
+
+        VkImageViewCreateInfo view_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = res->image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = res->info.format,
+            .components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, },
+
+            /* views are for sampling and attachments, both only want the depth of depth-stencil images. */
+            .subresourceRange.aspectMask = res->aspect & VK_IMAGE_ASPECT_DEPTH_BIT ? VK_IMAGE_ASPECT_DEPTH_BIT : res->aspect,
+            .subresourceRange.levelCount = res->info.mip_levels,
+            .subresourceRange.layerCount = 1,
+        };
+
+        ERR_CHECK(vkCreateImageView(graph->device, &view_info, NULL, &res->view), "render graph image view");
+    }
+
+#if defined(ZULK_DEBUG)
+    printf("render graph: %llu bytes of transient memory, %llu of it lazily allocated (%llu without aliasing)\n", (unsigned long long)graph->memory_size, (unsigned long long)graph->lazy_memory_size, (unsigned long long)unaliased_size);
+#else
+    (void)unaliased_size;
+#endif
+}
+
+typedef struct RenderGraphState {
+    VkImageLayout layout;
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 writes;
+    bool touched;
+} RenderGraphState;
+
+static void rg_push_barrier(RenderGraph* graph, RenderGraphResource resource, RenderGraphState* state, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access, VkImageLayout new_layout) {
+    RenderGraphResourceData* res = &graph->resources[resource];
+
+    graph->barriers[graph->barriers_count++] = (RenderGraphBarrier) {
+        .resource = resource,
+        .barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = state->stages,
+            .srcAccessMask = state->writes,
+            .dstStageMask = dst_stages,
+            .dstAccessMask = dst_access,
+            .oldLayout = state->layout,
+            .newLayout = new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .subresourceRange = {
+                .aspectMask = res->aspect,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .layerCount = VK_REMAINING_ARRAY_LAYERS,
+            },
+        },
+    };
+}
+
+static void rg_compute_barriers(RenderGraph* graph) {
+    RenderGraphState states[RG_MAX_RESOURCES] = { 0 };
+
+    for (u32 r = 0; r < graph->resources_count; ++r) {
+        RenderGraphResourceData* res = &graph->resources[r];
+
+        if (res->imported) {
+            states[r].layout = res->import.initial_layout;
+            states[r].stages = res->import.initial_stage;
+        } else if (res->alias_predecessor != RG_INVALID) {
+            /* contents are discarded, but whoever used the memory before must be done with it. */
+            RenderGraphResourceData* pred = &graph->resources[res->alias_predecessor];
+            states[r].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            states[r].stages = pred->last_stages;
+            states[r].writes = pred->last_writes;
+        }
+    }
+
+    for (u32 p = 0; p < graph->passes_count; ++p) {
+        RenderGraphPassData* pass = &graph->passes[p];
+        pass->first_barrier = graph->barriers_count;
+        pass->barriers_count = 0;
+
+        if (pass->culled)
+            continue;
+
+        /* combine all accesses to one resource in this pass into one */
+        for (u32 i = 0; i < pass->accesses_count; ++i) {
+            RenderGraphResource resource = pass->accesses[i].resource;
+
+            bool seen = false;
+            for (u32 j = 0; j < i; ++j)
+                seen |= pass->accesses[j].resource == resource;
+            if (seen)
+                continue;
+
+            VkPipelineStageFlags2 stages = 0;
+            VkAccessFlags2 access = 0;
+            VkAccessFlags2 writes = 0;
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            bool write = false;
+
+            for (u32 j = i; j < pass->accesses_count; ++j) {
+                if (pass->accesses[j].resource != resource)
+                    continue;
+
+                RenderGraphUsageInfo info = rg_usage_info(pass->type, pass->accesses[j].usage);
+                stages |= info.stages;
+                access |= info.access;
+
+                /* the written layout wins, e.g. depth that is both tested against and written */
+                if (layout == VK_IMAGE_LAYOUT_UNDEFINED || pass->accesses[j].write)
+                    layout = info.layout;
+
+                if (pass->accesses[j].write) {
+                    writes |= info.writes;
+                    write = true;
+                }
+            }
+
+            RenderGraphState* state = &states[resource];
+            bool first_use = !state->touched;
+
+            /* read-after-read in the same layout needs nothing; remember the stage for a later write-after-read. */
+            if (!first_use && state->layout == layout && state->writes == 0 && !write) {
+                state->stages |= stages;
+                continue;
+            }
+
+            rg_push_barrier(graph, resource, state, stages, access, layout);
+            pass->barriers_count++;
+
+            state->layout = layout;
+            state->stages = stages;
+            state->writes = writes;
+            state->touched = true;
+        }
+    }
+
+    graph->final_first_barrier = graph->barriers_count;
+    graph->final_barriers_count = 0;
+
+    for (u32 r = 0; r < graph->resources_count; ++r) {
+        RenderGraphResourceData* res = &graph->resources[r];
+        if (!res->imported || res->import.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || !states[r].touched)
+            continue;
+
+        if (states[r].layout == res->import.final_layout && states[r].writes == 0)
+            continue;
+
+        rg_push_barrier(graph, r, &states[r], VK_PIPELINE_STAGE_2_NONE, 0, res->import.final_layout);
+        graph->final_barriers_count++;
+    }
+}
+
+void rg_compile(RenderGraph* graph, VkExtent2D extent) {
+    if (graph->compiled) {
+        fprintf(stderr, "render graph: compiled twice without a reset\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (u32 r = 0; r < graph->resources_count; ++r) {
+        if (graph->resources[r].imported && graph->resources[r].info.extent.width == 0)
+            graph->resources[r].info.extent = extent;
+    }
+
+    rg_cull(graph);
+    rg_compute_lifetimes(graph);
+    rg_create_transient_images(graph, extent);
+    rg_compute_barriers(graph);
+
+    graph->compiled = true;
+}
+
+void rg_set_image(RenderGraph* graph, RenderGraphResource resource, VkImage image, VkImageView view) {
+    graph->resources[resource].image = image;
+    graph->resources[resource].view = view;
+}
+
+static void rg_emit_barriers(RenderGraph* graph, VkCommandBuffer command_buffer, u32 first, u32 count) {
+    if (count == 0)
+        return;
+
+    VkImageMemoryBarrier2 barriers[RG_MAX_RESOURCES];
+    for (u32 i = 0; i < count; ++i) {
+        barriers[i] = graph->barriers[first + i].barrier;
+        barriers[i].image = graph->resources[graph->barriers[first + i].resource].image;
+    }
+
+    VkDependencyInfo info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = count,
+        .pImageMemoryBarriers = barriers,
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &info);
+}
+
+/* every stage the pass can do work in, including what isn't a graph resource: indirect arguments and vertices. */
+static VkPipelineStageFlags2 rg_pass_stages(RenderGraphPassData* pass) {
+    VkPipelineStageFlags2 stages;
+    switch (pass->type) {
+        case RG_PASS_GRAPHICS:
+            stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+            break;
+        case RG_PASS_COMPUTE:
+            stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            break;
+        default:
+            stages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+            break;
+    }
+
+    for (u32 i = 0; i < pass->accesses_count; ++i)
+        stages |= rg_usage_info(pass->type, pass->accesses[i].usage).stages;
+
+    return stages;
+}
+
+static void rg_write_begin_timestamp(RenderGraph* graph, VkCommandBuffer command_buffer, RenderGraphPassData* pass) {
+    /* the lowest bit is the earliest stage in the pipeline; a timestamp there is only written once the
+     * semaphore waited on at it has been signaled. */
+    VkPipelineStageFlags2 waited = rg_pass_stages(pass) & graph->timestamp_wait_stages;
+    VkPipelineStageFlags2 stage = waited ? waited & (~waited + 1) : VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
+
+    vkCmdWriteTimestamp2(command_buffer, stage, graph->timestamp_pool, graph->first_timestamp + graph->timestamps_count++);
+}
+
+void rg_execute(RenderGraph* graph, VkCommandBuffer command_buffer) {
+    graph->timestamps_count = 0;
+
+    for (u32 p = 0; p < graph->passes_count; ++p) {
+        RenderGraphPassData* pass = &graph->passes[p];
+        if (pass->culled)
+            continue;
+
+        rg_emit_barriers(graph, command_buffer, pass->first_barrier, pass->barriers_count);
+
+        if (graph->timestamp_pool)
+            rg_write_begin_timestamp(graph, command_buffer, pass);
+
+        /* only loaded when the debug utils extension is enabled; shows up in RenderDoc & co. */
+        if (vkCmdBeginDebugUtilsLabelEXT) {
+            VkDebugUtilsLabelEXT label = { VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, .pLabelName = pass->name };
+            vkCmdBeginDebugUtilsLabelEXT(command_buffer, &label);
+        }
+
+        pass->execute(graph, command_buffer, pass->data);
+
+        if (vkCmdEndDebugUtilsLabelEXT)
+            vkCmdEndDebugUtilsLabelEXT(command_buffer);
+
+        if (graph->timestamp_pool)
+            vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, graph->timestamp_pool, graph->first_timestamp + graph->timestamps_count++);
+    }
+
+    rg_emit_barriers(graph, command_buffer, graph->final_first_barrier, graph->final_barriers_count);
+}
+
+void rg_set_timestamps(RenderGraph* graph, VkQueryPool pool, u32 first_query, VkPipelineStageFlags2 wait_stages) {
+    graph->timestamp_pool = pool;
+    graph->first_timestamp = first_query;
+    graph->timestamp_wait_stages = wait_stages;
+}
+
+u32 rg_timestamps_count(RenderGraph* graph) {
+    return graph->timestamps_count;
+}
+
+VkImage rg_image(RenderGraph* graph, RenderGraphResource resource) {
+    return graph->resources[resource].image;
+}
+
+VkImageView rg_image_view(RenderGraph* graph, RenderGraphResource resource) {
+    return graph->resources[resource].view;
+}
+
+VkExtent2D rg_image_extent(RenderGraph* graph, RenderGraphResource resource) {
+    return graph->resources[resource].info.extent;
+}
+
+bool rg_pass_is_culled(RenderGraph* graph, RenderGraphPass pass) {
+    return graph->passes[pass].culled;
+}
+
+VkDeviceSize rg_transient_memory_size(RenderGraph* graph) {
+    return graph->memory_size;
+}
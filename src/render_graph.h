@@ -0,0 +1,123 @@
+#pragma once
+
+#include "types.h"
+
+#include <stdbool.h>
+#include <volk.h>
+
+/*
+ * Frame graph.
+ *
+ * Passes are added in execution order and declare which resources they read and write; the graph then
+ *   - culls passes whose results nobody consumes (outputs are imported resources with a final layout,
+ *     or passes marked with rg_pass_keep()),
+ *   - computes one batch of VkImageMemoryBarrier2s in front of every pass, only where a layout
+ *     transition or a real hazard requires it,
+ *   - creates the transient images and aliases those whose lifetimes don't overlap onto the same memory.
+ *
+ * The graph is compiled once (and again when the swapchain changes); executing it every frame
+ * only patches imported image handles and replays the precomputed barriers.
+ */
+
+#define RG_MAX_PASSES (u32)32
+#define RG_MAX_RESOURCES (u32)32
+#define RG_MAX_PASS_ACCESSES (u32)8
+
+typedef struct RenderGraph RenderGraph;
+
+/* index of a resource / pass in the graph. */
+typedef u32 RenderGraphResource;
+typedef u32 RenderGraphPass;
+
+#define RG_INVALID (u32)UINT32_MAX
+
+enum RenderGraphPassType {
+    RG_PASS_GRAPHICS,
+    RG_PASS_COMPUTE,
+    RG_PASS_TRANSFER,
+};
+
+enum RenderGraphUsage {
+    RG_USAGE_COLOR_ATTACHMENT,
+    RG_USAGE_DEPTH_ATTACHMENT,
+    RG_USAGE_DEPTH_READ,
+    RG_USAGE_SAMPLED,
+    RG_USAGE_STORAGE_READ,
+    RG_USAGE_STORAGE_WRITE,
+    RG_USAGE_TRANSFER_SRC,
+    RG_USAGE_TRANSFER_DST,
+
+    RG_USAGE_COUNT,
+};
+
+typedef struct RenderGraphImageInfo {
+    VkFormat format;
+
+    /* zero means "the extent the graph was compiled with". */
+    VkExtent2D extent;
+
+    /* zero is treated as one. */
+    u32 mip_levels;
+    VkSampleCountFlagBits samples;
+
+    /* hint that the contents never leave the pass rendering to it (depth, multisampled color, ...).
+     * if only one live pass uses it and only as an attachment, it gets TRANSIENT_ATTACHMENT usage and
+     * LAZILY_ALLOCATED memory where the device has it, so tilers never back it with real memory. */
+    bool transient;
+} RenderGraphImageInfo;
+
+typedef struct RenderGraphImportInfo {
+    VkFormat format;
+
+    /* the layout and stage the image is in when the graph starts; for swapchain images this is
+     * UNDEFINED and the stage the acquire semaphore is waited on. */
+    VkImageLayout initial_layout;
+    VkPipelineStageFlags2 initial_stage;
+
+    /* the layout the image must be left in. anything but UNDEFINED makes the image a graph output. */
+    VkImageLayout final_layout;
+} RenderGraphImportInfo;
+
+typedef void (*RenderGraphExecuteFunc)(RenderGraph* graph, VkCommandBuffer command_buffer, void* data);
+
+RenderGraph* rg_create(VkDevice device, const VkPhysicalDeviceMemoryProperties* memory_props);
+void rg_destroy(RenderGraph* graph);
+
+/* destroys every pass, resource and transient allocation so the graph can be rebuilt. */
+void rg_reset(RenderGraph* graph);
+
+RenderGraphResource rg_create_image(RenderGraph* graph, const char* name, const RenderGraphImageInfo* info);
+RenderGraphResource rg_import_image(RenderGraph* graph, const char* name, const RenderGraphImportInfo* info);
+
+RenderGraphPass rg_add_pass(RenderGraph* graph, const char* name, enum RenderGraphPassType type, RenderGraphExecuteFunc execute, void* data);
+void rg_read(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, enum RenderGraphUsage usage);
+void rg_write(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, enum RenderGraphUsage usage);
+
+/* the pass is never culled, even if nothing reads what it writes. */
+void rg_pass_keep(RenderGraph* graph, RenderGraphPass pass);
+
+/* culls, computes barriers and allocates transient images. `extent` is the default image extent. */
+void rg_compile(RenderGraph* graph, VkExtent2D extent);
+
+/* sets the image used for an imported resource for the next rg_execute(). */
+void rg_set_image(RenderGraph* graph, RenderGraphResource resource, VkImage image, VkImageView view);
+
+void rg_execute(RenderGraph* graph, VkCommandBuffer command_buffer);
+
+/* has rg_execute() bracket every live pass with a begin and an end timestamp, written to `pool` from
+ * `first_query` on (two per pass, up to RG_MAX_PASSES * 2); VK_NULL_HANDLE turns it off. `wait_stages` are
+ * the stages the submission waits on semaphores at: a pass that uses one of them writes its begin timestamp
+ * at that stage rather than at the top of the pipe, so the wait isn't timed as its work. */
+void rg_set_timestamps(RenderGraph* graph, VkQueryPool pool, u32 first_query, VkPipelineStageFlags2 wait_stages);
+/* timestamps the last rg_execute() wrote. */
+u32 rg_timestamps_count(RenderGraph* graph);
+
+/* valid from rg_compile() on; meant for pass callbacks. */
+VkImage rg_image(RenderGraph* graph, RenderGraphResource resource);
+VkImageView rg_image_view(RenderGraph* graph, RenderGraphResource resource);
+VkExtent2D rg_image_extent(RenderGraph* graph, RenderGraphResource resource);
+bool rg_pass_is_culled(RenderGraph* graph, RenderGraphPass pass);
+
+/* total bytes of device memory backing transient images, after aliasing. lazily allocated memory
+ * is included, although the driver may never commit it. */
+VkDeviceSize rg_transient_memory_size(RenderGraph* graph);
@@ -1,6 +1,11 @@
 #include "renderer.h"
+#include "renderer_internal.h"
 #include "surface.h"
 #include "io.h"
+#include "trace.h"
+#include "render_graph.h"
+#include "gpu_memory.h"
+#include "arena.h"
 
 #include <volk.h>
 
@@ -9,15 +14,6 @@
 #include <string.h>
 #include <stdbool.h>
 
-#define ERR_CHECK(x, m) do { VkResult r = x; if  (r != VK_SUCCESS) { fprintf(stderr, "\x1b[31m!!!CRITICAL ERROR!!! couldn't create %s: %d = %s; will crash !!!CRITICAL ERROR!!!\x1b[0m\n", m, r, vk_result_to_str(r)); exit(EXIT_FAILURE); } } while(0);
-
-typedef struct QueueFamilies {
-    u32 graphics_family;
-    u32 present_family;
-
-    u32 found_families;
-} QueueFamilies;
-
 /* this structure can only hold constant string *literals* */
 typedef struct CStrArr {
     u32 size;
@@ -34,56 +30,12 @@ typedef struct SurfaceDetails {
     VkPresentModeKHR* modes;
 } SurfaceDetails;
 
-struct VulkanGraphics {
-    VkInstance instance;
-
-    VkSurfaceKHR surface;
-
-    VkPhysicalDevice gpu;
-    VkDevice device;
-
-    VkQueue graphics_queue;
-    VkQueue present_queue;
-
-    VkSwapchainKHR swapchain;
-    VkExtent2D swapchain_extent;
-    VkSurfaceFormatKHR swapchain_format;
-
-    /* TODO: this could be stored in "stack" (this object is heap allocated anyway) */
-    u32 swapchain_images_count;
-    u32 swapchain_views_count;
-
-    VkImage* swapchain_images;
-    VkImageView* swapchain_views;
-    VkFramebuffer* swapchain_framebuffers;
-
-    VkRenderPass render_pass;
-    VkPipelineLayout pipeline_layout;
-    VkPipeline graphics_pipeline;
-
-    VkCommandPool command_pool;
-    VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT];
-
-    VkSemaphore image_available_semaphores[MAX_FRAMES_IN_FLIGHT];
-    VkSemaphore render_finished_semaphores[MAX_FRAMES_IN_FLIGHT];
-    VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT];
-
-    /* SPACE OPTIMIZATION... */
-    u32 swapchain_framebuffers_count;
-    u32 current_frame;
-
-    Surface* render_surface;
-
-    bool frame_resized_recently;
-
-    /* TODO: don't store this here lol */
-    QueueFamilies families;
-
-#if defined(ZULK_DEBUG)
-    /* TODO: move this into optional structure? */
-    VkDebugUtilsMessengerEXT debug_messenger;
+/* shaders are asked for as shaders/bin/vulkan_<name>.spv, which is also their name in the asset archive; loose
+ * ones are looked for relative to the working directory, like a released binary ships them, and then under this
+ * directory, where shaders/CMakeLists.txt puts them */
+#if !defined(ZULK_SHADER_ROOT)
+#define ZULK_SHADER_ROOT "."
 #endif
-};
 
 #define QUEUE_IS_COMPLETE(x) (x.found_families & 0b1100)
 #define QUEUE_FOUND_SET(x, m, v, b) x.m = v; x.found_families |= b
@@ -120,95 +72,18 @@ static VkBool32 VKAPI_CALL vk_debug_callback(VkDebugUtilsMessageSeverityFlagBits
     return VK_FALSE;
 }
 
-static inline const char* vk_result_to_str(VkResult result) {
-    switch (result) {
-        case VK_SUCCESS:
-            return "Success";
-        case VK_NOT_READY:
-            return "Not ready";
-        case VK_TIMEOUT:
-            return "Timeout";
-        case VK_EVENT_SET:
-            return "Event set";
-        case VK_EVENT_RESET:
-            return "Event reset";
-        case VK_INCOMPLETE:
-            return "Incomplete";
-        case VK_ERROR_OUT_OF_HOST_MEMORY:
-            return "Out of host memory";
-        case VK_ERROR_OUT_OF_DEVICE_MEMORY:
-            return "Out of device memory";
-        case VK_ERROR_INITIALIZATION_FAILED:
-            return "Initialization failed";
-        case VK_ERROR_DEVICE_LOST:
-            return "Device lost";
-        case VK_ERROR_MEMORY_MAP_FAILED:
-            return "Memory map failed";
-        case VK_ERROR_LAYER_NOT_PRESENT:
-            return "Layer not present";
-        case VK_ERROR_EXTENSION_NOT_PRESENT:
-            return "Extension not present";
-        case VK_ERROR_FEATURE_NOT_PRESENT:
-            return "Feature not present";
-        case VK_ERROR_INCOMPATIBLE_DRIVER:
-            return "Incompatible driver";
-        case VK_ERROR_TOO_MANY_OBJECTS:
-            return "Too many objects";
-        case VK_ERROR_FORMAT_NOT_SUPPORTED:
-            return "Format not supported";
-        case VK_ERROR_FRAGMENTED_POOL:
-            return "Fragmented pool";
-        case VK_ERROR_UNKNOWN:
-            return "Unknown error";
-        case VK_ERROR_OUT_OF_POOL_MEMORY:
-            return "Out of pool memory";
-        case VK_ERROR_INVALID_EXTERNAL_HANDLE:
-            return "Invalid external handle";
-        case VK_ERROR_FRAGMENTATION:
-            return "Fragmentation";
-        case VK_ERROR_INVALID_OPAQUE_CAPTURE_ADDRESS:
-            return "Invalid opaque capture address";
-        case VK_ERROR_SURFACE_LOST_KHR:
-            return "Surface lost";
-        case VK_ERROR_NATIVE_WINDOW_IN_USE_KHR:
-            return "Native window in use";
-        case VK_SUBOPTIMAL_KHR:
-            return "Suboptimal";
-        case VK_ERROR_OUT_OF_DATE_KHR:
-            return "Out of date";
-        case VK_ERROR_INCOMPATIBLE_DISPLAY_KHR:
-            return "Incompatible display";
-        case VK_ERROR_VALIDATION_FAILED_EXT:
-            return "Validation failed";
-        case VK_ERROR_INVALID_SHADER_NV:
-            return "Invalid shader";
-        case VK_ERROR_NOT_PERMITTED_EXT:
-            return "Not permitted";
-        case VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT:
-            return "Full screen exclusive mode lost";
-        case VK_THREAD_IDLE_KHR:
-            return "Thread idle";
-        case VK_THREAD_DONE_KHR:
-            return "Thread done";
-        case VK_OPERATION_DEFERRED_KHR:
-            return "Operation deferred";
-        case VK_OPERATION_NOT_DEFERRED_KHR:
-            return "Operation not deferred";
-        case VK_PIPELINE_COMPILE_REQUIRED_EXT:
-            return "Pipeline compile required";
-        default:
-            return "Unknown error code";
-    }
-}
-
-CStrArr vk_required_instance_extensions(GraphicsConfiguration* config) {
-    u32 surface_exts_count;
-    const char* const* surface_exts = surface_vk_get_required_extensions(config->render_surface, &surface_exts_count);
+CStrArr vk_required_instance_extensions(GraphicsConfiguration* config, Arena* scratch) {
+    /* headless needs no surface extensions */
+    u32 surface_exts_count = 0;
+    const char* const* surface_exts = NULL;
+    if (config->render_surface)
+        surface_exts = surface_vk_get_required_extensions(config->render_surface, &surface_exts_count);
 
     u32 avail;
     ERR_CHECK(vkEnumerateInstanceExtensionProperties(NULL, &avail, NULL), "VkInstanceExtensionProperties phase #1");
 
-    VkExtensionProperties* available_extensions = malloc(sizeof(VkExtensionProperties) * avail);
+    usize scratch_mark = arena_mark(scratch);
+    VkExtensionProperties* available_extensions = ARENA_PUSH(scratch, VkExtensionProperties, avail);
     ERR_CHECK(vkEnumerateInstanceExtensionProperties(NULL, &avail, available_extensions), "VkInstanceExtensionProperties phase #2");
 
     CStrArr enabled_extensions;
@@ -250,16 +125,17 @@ CStrArr vk_required_instance_extensions(GraphicsConfiguration* config) {
         exit(EXIT_FAILURE);
     }
 
-    free(available_extensions);
+    arena_rewind(scratch, scratch_mark);
     return enabled_extensions;
 }
 
-static int vk_check_required_instance_layers(VkInstanceCreateInfo* info) {
+static int vk_check_required_instance_layers(VkInstanceCreateInfo* info, Arena* scratch) {
 #if defined(ZULK_DEBUG)
     u32 avail;
     ERR_CHECK(vkEnumerateInstanceLayerProperties(&avail, NULL), "VkInstanceLayerProperties phase #1");
 
-    VkLayerProperties* available_layers = malloc(sizeof(VkLayerProperties) * avail);
+    usize scratch_mark = arena_mark(scratch);
+    VkLayerProperties* available_layers = ARENA_PUSH(scratch, VkLayerProperties, avail);
     ERR_CHECK(vkEnumerateInstanceLayerProperties(&avail, available_layers), "VkInstanceLayerProperties phase #2");
 
     static const char* enabled_layers[] = {
@@ -271,12 +147,12 @@ static int vk_check_required_instance_layers(VkInstanceCreateInfo* info) {
         if (strcmp(available_layers[i].layerName, "VK_LAYER_KHRONOS_validation") == 0) {
             info->enabledLayerCount = 1;
             info->ppEnabledLayerNames = &enabled_layers[0];
-            free(available_layers);
+            arena_rewind(scratch, scratch_mark);
             return true;
         }
     }
 
-    free(available_layers);
+    arena_rewind(scratch, scratch_mark);
     return false;
 #else
     return false;
@@ -305,7 +181,7 @@ static void vk_create_instance(VulkanGraphics* graphics, GraphicsConfiguration*
         .apiVersion = VK_API_VERSION_1_3,
     };
 
-    CStrArr extensions = vk_required_instance_extensions(config);
+    CStrArr extensions = vk_required_instance_extensions(config, &graphics->persistent_arena);
     VkDebugUtilsMessengerCreateInfoEXT debug_messenger = vk_init_debug_messenger_info();
 
     VkInstanceCreateInfo create_info = {
@@ -318,7 +194,7 @@ static void vk_create_instance(VulkanGraphics* graphics, GraphicsConfiguration*
         .ppEnabledExtensionNames = extensions.values,
     };
 
-    int res = vk_check_required_instance_layers(&create_info);
+    int res = vk_check_required_instance_layers(&create_info, &graphics->persistent_arena);
 
     ERR_CHECK(vkCreateInstance(&create_info, NULL, &graphics->instance), "VkInstance");
     volkLoadInstance(graphics->instance);
@@ -335,7 +211,12 @@ static void vk_create_instance(VulkanGraphics* graphics, GraphicsConfiguration*
 }
 
 static void vk_create_surface(VulkanGraphics* graphics, GraphicsConfiguration* config) {
-    graphics->surface = surface_vk_create(config->render_surface, graphics->instance);
+    VulkanWindow* window = vk_main_window(graphics);
+    window->attached = true;
+    window->graphics = graphics;
+    window->render_surface = config->render_surface;
+    window->surface = config->render_surface ? surface_vk_create(config->render_surface, graphics->instance) : VK_NULL_HANDLE;
+    window->frame_resized_recently = false;
 }
 
 static void vk_select_physical_dev(VulkanGraphics* graphics, GraphicsConfiguration* config) {
@@ -401,23 +282,34 @@ static void vk_select_physical_dev(VulkanGraphics* graphics, GraphicsConfigurati
 
     // printf("Selected GPU at index %d to be the rendering GPU.\n", best_device);
     graphics->gpu = devices[best_device];
+    vkGetPhysicalDeviceMemoryProperties(graphics->gpu, &graphics->memory_props);
+
+    /* cooked textures are sampled block compressed wherever the GPU can; see texture.h. queried once, here,
+     * and the logical device enables what the target needs. */
+    VkPhysicalDeviceFeatures gpu_features;
+    vkGetPhysicalDeviceFeatures(graphics->gpu, &gpu_features);
+    graphics->texture_target = texture_select_target(graphics->gpu, &gpu_features);
 
     /* TODO: move to device selection, perhaps own function */
     count = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(graphics->gpu, &count, NULL);
 
-    VkQueueFamilyProperties* queue_families = malloc(sizeof(VkQueueFamilyProperties) * count);
+    usize scratch_mark = arena_mark(&graphics->persistent_arena);
+    VkQueueFamilyProperties* queue_families = ARENA_PUSH(&graphics->persistent_arena, VkQueueFamilyProperties, count);
     vkGetPhysicalDeviceQueueFamilyProperties(graphics->gpu, &count, queue_families);
 
 
-    QueueFamilies families;
+    QueueFamilies families = { 0 };
     for (u32 i = 0; i < count; ++i) {
         if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             QUEUE_FOUND_SET(families, graphics_family, i, 0b1000);
         }
 
-        VkBool32 present_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(graphics->gpu, i, graphics->surface, &present_support);
+        /* headless, nothing is presented; any family will do. windows attached later must share this one. */
+        VkSurfaceKHR surface = vk_main_window(graphics)->surface;
+        VkBool32 present_support = surface == VK_NULL_HANDLE;
+        if (surface)
+            vkGetPhysicalDeviceSurfaceSupportKHR(graphics->gpu, i, surface, &present_support);
 
         if (present_support) {
             QUEUE_FOUND_SET(families, present_family, i, 0b0100);
@@ -428,8 +320,65 @@ static void vk_select_physical_dev(VulkanGraphics* graphics, GraphicsConfigurati
         }
     }
 
+    /* a family without graphics runs compute alongside the graphics queue instead of interleaved with it. */
+    families.compute_family = families.graphics_family;
+    for (u32 i = 0; i < count; ++i) {
+        if ((queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            families.compute_family = i;
+            break;
+        }
+    }
+
     graphics->families = families;
-    free(queue_families);
+
+    /* nanoseconds per timestamp tick; GPU frame timing (and with it dynamic resolution) needs this. */
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(graphics->gpu, &props);
+    graphics->timestamp_period = queue_families[families.graphics_family].timestampValidBits ? props.limits.timestampPeriod : 0;
+
+    arena_rewind(&graphics->persistent_arena, scratch_mark);
+}
+
+static void vk_select_attachment_formats(VulkanGraphics* graphics, GraphicsConfiguration* config) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(graphics->gpu, &props);
+
+    /* highest supported sample count that isn't above the requested one */
+    VkSampleCountFlags supported = props.limits.framebufferColorSampleCounts & props.limits.framebufferDepthSampleCounts;
+    graphics->msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+
+    for (u32 samples = VK_SAMPLE_COUNT_64_BIT; samples > VK_SAMPLE_COUNT_1_BIT; samples >>= 1) {
+        if (samples <= config->msaa_samples && (supported & samples)) {
+            graphics->msaa_samples = samples;
+            break;
+        }
+    }
+
+    if (config->msaa_samples > 1 && graphics->msaa_samples != config->msaa_samples)
+        printf("%dx MSAA isn't supported, using %dx.\n", config->msaa_samples, graphics->msaa_samples);
+
+    static const VkFormat depth_formats[] = {
+        VK_FORMAT_D32_SFLOAT,
+        VK_FORMAT_X8_D24_UNORM_PACK32,
+        VK_FORMAT_D24_UNORM_S8_UINT,
+        VK_FORMAT_D16_UNORM,
+    };
+
+    graphics->depth_format = VK_FORMAT_UNDEFINED;
+    for (u32 i = 0; i < ZARRSIZ(depth_formats); ++i) {
+        VkFormatProperties format_props;
+        vkGetPhysicalDeviceFormatProperties(graphics->gpu, depth_formats[i], &format_props);
+
+        if (format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            graphics->depth_format = depth_formats[i];
+            break;
+        }
+    }
+
+    if (graphics->depth_format == VK_FORMAT_UNDEFINED) {
+        fprintf(stderr, "no usable depth format!\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
 /* TODO: these functions do not need to take in the full details */
@@ -467,84 +416,187 @@ static VkExtent2D vk_select_best_swapchain_extent(Surface* render_surface, Surfa
     return extent;
 }
 
+static bool vk_device_has_extension(VkPhysicalDevice gpu, const char* name, Arena* scratch) {
+    u32 count = 0;
+    vkEnumerateDeviceExtensionProperties(gpu, NULL, &count, NULL);
+
+    usize scratch_mark = arena_mark(scratch);
+    VkExtensionProperties* props = ARENA_PUSH(scratch, VkExtensionProperties, count);
+    vkEnumerateDeviceExtensionProperties(gpu, NULL, &count, props);
+
+    bool found = false;
+    for (u32 i = 0; i < count && !found; ++i)
+        found = strcmp(props[i].extensionName, name) == 0;
+
+    arena_rewind(scratch, scratch_mark);
+    return found;
+}
+
 static void vk_create_logical_dev(VulkanGraphics* graphics, GraphicsConfiguration* config) {
-    VkPhysicalDeviceFeatures enabled_features = {};
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(graphics->gpu, &supported_features);
 
-    /* TODO: check for extension support */
-    const char* extensions[] = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    /* meshes draw all their visible meshlets with one indirect draw; see mesh.c */
+    VkPhysicalDeviceFeatures enabled_features = {
+        .multiDrawIndirect = supported_features.multiDrawIndirect,
+        .drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance,
+    };
+    graphics->multi_draw_indirect = supported_features.multiDrawIndirect && supported_features.drawIndirectFirstInstance;
+
+    /* the texture target was picked with the GPU */
+    enabled_features.textureCompressionBC = graphics->texture_target == TEXTURE_TARGET_BC;
+    enabled_features.textureCompressionETC2 = graphics->texture_target == TEXTURE_TARGET_ETC2;
+
+    /* occlusion culling takes the draw counts from the GPU and samples a single sampled depth buffer */
+    VkPhysicalDeviceVulkan12Features supported_features_12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+    vkGetPhysicalDeviceFeatures2(graphics->gpu, &(VkPhysicalDeviceFeatures2) {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported_features_12,
+    });
+
+    VkFormatProperties depth_props;
+    vkGetPhysicalDeviceFormatProperties(graphics->gpu, graphics->depth_format, &depth_props);
+    graphics->occlusion_culling = graphics->multi_draw_indirect && supported_features_12.drawIndirectCount
+        && (depth_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+    /* the render graph records barriers with sync2 and passes render without VkRenderPass objects. */
+    VkPhysicalDeviceVulkan13Features enabled_features_13 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .synchronization2 = VK_TRUE,
+        .dynamicRendering = VK_TRUE,
+    };
+
+    /* the graphics and compute queues wait on each other's timelines. */
+    VkPhysicalDeviceVulkan12Features enabled_features_12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = &enabled_features_13,
+        .timelineSemaphore = VK_TRUE,
+        .drawIndirectCount = supported_features_12.drawIndirectCount,
     };
 
+    /* TODO: check for extension support */
+    const char* extensions[2];
+    u32 extensions_count = 0;
+
+    if (!graphics->headless)
+        extensions[extensions_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+
+    graphics->memory_budget_supported = vk_device_has_extension(graphics->gpu, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, &graphics->persistent_arena);
+    if (graphics->memory_budget_supported)
+        extensions[extensions_count++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+
     VkDeviceCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = &enabled_features_12,
         
         .pEnabledFeatures = &enabled_features,
 
-        .enabledExtensionCount = ZARRSIZ(extensions),
+        .enabledExtensionCount = extensions_count,
         .ppEnabledExtensionNames = extensions,
     };
 
-    if (graphics->families.graphics_family == graphics->families.present_family) {
-        VkDeviceQueueCreateInfo queue_info = {
+    /* one queue from every distinct family */
+    u32 wanted_families[] = { graphics->families.graphics_family, graphics->families.present_family, graphics->families.compute_family };
+    VkDeviceQueueCreateInfo queue_infos[ZARRSIZ(wanted_families)];
+    u32 queue_infos_count = 0;
+
+    for (u32 i = 0; i < ZARRSIZ(wanted_families); ++i) {
+        bool duplicate = false;
+        for (u32 j = 0; j < queue_infos_count; ++j)
+            duplicate |= queue_infos[j].queueFamilyIndex == wanted_families[i];
+
+        if (duplicate)
+            continue;
+
+        queue_infos[queue_infos_count++] = (VkDeviceQueueCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
             .queueCount = 1,
-            .queueFamilyIndex = graphics->families.graphics_family,
-            /* i have no idea will this work... */
+            .queueFamilyIndex = wanted_families[i],
             .pQueuePriorities = &(float){1.0f},
         };
-
-        create_info.queueCreateInfoCount = 1;
-        create_info.pQueueCreateInfos = &queue_info;
-    } else {
-        VkDeviceQueueCreateInfo queue_infos[] = {
-            (VkDeviceQueueCreateInfo) {
-                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueCount = 1,
-                .queueFamilyIndex = graphics->families.graphics_family,
-                /* i have no idea will this work... */
-                .pQueuePriorities = (float[]){1.0f},
-            },
-            (VkDeviceQueueCreateInfo) {
-                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueCount = 1,
-                .queueFamilyIndex = graphics->families.present_family,
-                /* i have no idea will this work... */
-                .pQueuePriorities = (float[]){1.0f, 1.0f},
-            },
-        };
-
-        create_info.queueCreateInfoCount = 2;
-        create_info.pQueueCreateInfos = queue_infos;
     }
 
+    create_info.queueCreateInfoCount = queue_infos_count;
+    create_info.pQueueCreateInfos = queue_infos;
+
     ERR_CHECK(vkCreateDevice(graphics->gpu, &create_info, NULL, &graphics->device), "VkDevice");
     volkLoadDevice(graphics->device);
 
     vkGetDeviceQueue(graphics->device, graphics->families.graphics_family, 0, &graphics->graphics_queue);
     vkGetDeviceQueue(graphics->device, graphics->families.present_family, 0, &graphics->present_queue);
+    vkGetDeviceQueue(graphics->device, graphics->families.compute_family, 0, &graphics->compute_queue);
 }
 
-static void vk_create_swapchain(VulkanGraphics* graphics) {
+/* for a window other than the main one, returns false if the main window's frame can't be blitted into it. */
+static bool vk_create_swapchain(VulkanGraphics* graphics, VulkanWindow* window) {
+    /* also runs from inside the frame loop, so the temporaries go to the frame arena */
+    Arena* scratch = vk_frame_arena(graphics);
+    usize scratch_mark = arena_mark(scratch);
+
     /* TODO: verify does device have these... */
     SurfaceDetails details = {};
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(graphics->gpu, graphics->surface, &details.caps);
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(graphics->gpu, window->surface, &details.caps);
 
-    vkGetPhysicalDeviceSurfaceFormatsKHR(graphics->gpu, graphics->surface, &details.formats_count, NULL);
-    details.formats = malloc(sizeof(*details.formats) * details.formats_count);
-    vkGetPhysicalDeviceSurfaceFormatsKHR(graphics->gpu, graphics->surface, &details.formats_count, details.formats);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(graphics->gpu, window->surface, &details.formats_count, NULL);
+    details.formats = ARENA_PUSH(scratch, VkSurfaceFormatKHR, details.formats_count);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(graphics->gpu, window->surface, &details.formats_count, details.formats);
 
 
-    vkGetPhysicalDeviceSurfacePresentModesKHR(graphics->gpu, graphics->surface, &details.modes_count, NULL);
-    details.modes = malloc(sizeof(*details.modes) * details.modes_count);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(graphics->gpu, graphics->surface, &details.modes_count, details.modes);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(graphics->gpu, window->surface, &details.modes_count, NULL);
+    details.modes = ARENA_PUSH(scratch, VkPresentModeKHR, details.modes_count);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(graphics->gpu, window->surface, &details.modes_count, details.modes);
 
     VkSurfaceFormatKHR format = vk_select_best_surface_format(&details);
     VkPresentModeKHR mode = vk_select_best_present_mode(&details);
-    VkExtent2D extent = vk_select_best_swapchain_extent(graphics->render_surface, &details);
+    VkExtent2D extent = vk_select_best_swapchain_extent(window->render_surface, &details);
+
+    VkFormatProperties format_props;
+    vkGetPhysicalDeviceFormatProperties(graphics->gpu, format.format, &format_props);
+
+    VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    bool blittable = (details.caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && (format_props.optimalTilingFeatures & blit) == blit;
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (window == vk_main_window(graphics)) {
+        /* the composite writes the swapchain image as a storage image if it can, otherwise it's copied in */
+        bool can_copy = details.caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        graphics->post_direct = format.format == POST_OUTPUT_FORMAT && (details.caps.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT)
+            && (format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+        if (graphics->post_processing && (!post_supports_output_format(format.format) || !(graphics->post_direct || can_copy))) {
+            printf("the composite can't write the swapchain images, disabling post-processing.\n");
+            graphics->post_processing = false;
+        }
+
+        /* the upscale pass blits into the swapchain image; with post-processing, the composite upscales */
+        if (graphics->dynamic_resolution && !graphics->post_processing && !blittable) {
+            printf("swapchain images can't be blitted to, disabling dynamic resolution.\n");
+            graphics->dynamic_resolution = false;
+        }
+
+        graphics->upscale_filter = format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+        /* frame capture, and the other windows, copy out of the swapchain image */
+        graphics->capture_supported = details.caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+        usage |= (graphics->dynamic_resolution ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0)
+            | (graphics->capture_supported ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+        if (graphics->post_processing)
+            usage |= graphics->post_direct ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    } else {
+        /* the mirror pass clears the image and blits the main window's one into it */
+        if (!blittable) {
+            arena_rewind(scratch, scratch_mark);
+            return false;
+        }
+
+        usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
 
     u32 image_count = details.caps.minImageCount + 1;
     if (details.caps.maxImageCount > 0 && image_count > details.caps.maxImageCount)
         image_count = details.caps.maxImageCount;
+    if (image_count > MAX_SWAPCHAIN_IMAGES)
+        image_count = MAX_SWAPCHAIN_IMAGES;
 
     int exclusive = graphics->families.graphics_family == graphics->families.present_family;
     u32 queue_families[] = { graphics->families.graphics_family, graphics->families.present_family };
@@ -552,14 +604,14 @@ static void vk_create_swapchain(VulkanGraphics* graphics) {
     VkSwapchainCreateInfoKHR swapchain_info = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         
-        .surface = graphics->surface,
+        .surface = window->surface,
         .minImageCount = image_count,
         
         .imageFormat = format.format,
         .imageColorSpace = format.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage = usage,
         
         .imageSharingMode = exclusive ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT,
         .queueFamilyIndexCount = exclusive ? 0 : 2,
@@ -573,31 +625,73 @@ static void vk_create_swapchain(VulkanGraphics* graphics) {
         .oldSwapchain = VK_NULL_HANDLE,
     };
 
-    ERR_CHECK(vkCreateSwapchainKHR(graphics->device, &swapchain_info, NULL, &graphics->swapchain), "couldn't create swapchain");
+    ERR_CHECK(vkCreateSwapchainKHR(graphics->device, &swapchain_info, NULL, &window->swapchain), "couldn't create swapchain");
+
+    arena_rewind(scratch, scratch_mark);
+
+    /* the driver may create a few more images than asked for, MAX_SWAPCHAIN_IMAGES leaves room for that. */
+    window->swapchain_images_count = MAX_SWAPCHAIN_IMAGES;
+    ERR_CHECK(vkGetSwapchainImagesKHR(graphics->device, window->swapchain, &window->swapchain_images_count, window->swapchain_images), "swapchain images (too many?)");
+
+    window->swapchain_extent = extent;
+    window->swapchain_format = format;
+    return true;
+}
+
+/* headless stand-in for the swapchain: one offscreen image per frame in flight */
+static void vk_create_offscreen_targets(VulkanGraphics* graphics, VulkanWindow* window) {
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+
+    /* blitting, linear filtering and copying are all mandatory for this format */
+    graphics->capture_supported = true;
+    graphics->upscale_filter = VK_FILTER_LINEAR;
+    graphics->post_direct = false;
+
+    window->swapchain_format = (VkSurfaceFormatKHR) { format, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+    window->swapchain_extent = graphics->headless_extent;
+    window->swapchain_images_count = MAX_FRAMES_IN_FLIGHT;
+
+    for (u32 i = 0; i < window->swapchain_images_count; ++i) {
+        VkImageCreateInfo info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = format,
+            .extent = { graphics->headless_extent.width, graphics->headless_extent.height, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+
+        ERR_CHECK(vkCreateImage(graphics->device, &info, NULL, &window->swapchain_images[i]), "offscreen target");
 
-    free(details.formats);
-    free(details.modes);
+        VkMemoryRequirements reqs;
+        vkGetImageMemoryRequirements(graphics->device, window->swapchain_images[i], &reqs);
 
-    vkGetSwapchainImagesKHR(graphics->device, graphics->swapchain, &graphics->swapchain_images_count, NULL);
-    graphics->swapchain_images = malloc(sizeof(VkImage) * graphics->swapchain_images_count);
-    vkGetSwapchainImagesKHR(graphics->device, graphics->swapchain, &graphics->swapchain_images_count, graphics->swapchain_images);
+        window->offscreen_memory[i] = gpu_memory_allocate(graphics->device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, GRAPHICS_MEMORY_RENDER_TARGETS);
+        if (window->offscreen_memory[i].memory == VK_NULL_HANDLE) {
+            fprintf(stderr, "couldn't allocate offscreen target memory!\n");
+            exit(EXIT_FAILURE);
+        }
 
-    graphics->swapchain_extent = extent;
-    graphics->swapchain_format = format;
+        ERR_CHECK(vkBindImageMemory(graphics->device, window->swapchain_images[i], window->offscreen_memory[i].memory, 0), "offscreen target binding");
+    }
 }
 
-static void vk_create_image_views(VulkanGraphics* graphics) {
-    graphics->swapchain_views_count = graphics->swapchain_images_count;
-    graphics->swapchain_views = malloc(sizeof(VkImageView) * graphics->swapchain_views_count);
+static void vk_create_image_views(VulkanGraphics* graphics, VulkanWindow* window) {
+    window->swapchain_views_count = window->swapchain_images_count;
 
-    for (u32 i = 0; i < graphics->swapchain_views_count; ++i) {
+    for (u32 i = 0; i < window->swapchain_views_count; ++i) {
         VkImageViewCreateInfo info = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
 
-            .image = graphics->swapchain_images[i],
+            .image = window->swapchain_images[i],
             .viewType = VK_IMAGE_VIEW_TYPE_2D,
 
-            .format = graphics->swapchain_format.format,
+            .format = window->swapchain_format.format,
             .components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, },
 
             .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -607,100 +701,109 @@ static void vk_create_image_views(VulkanGraphics* graphics) {
             .subresourceRange.layerCount = 1,
         };
 
-        ERR_CHECK(vkCreateImageView(graphics->device, &info, NULL, &graphics->swapchain_views[i]), "image view creation");
+        ERR_CHECK(vkCreateImageView(graphics->device, &info, NULL, &window->swapchain_views[i]), "image view creation");
     }
 }
 
-static void vk_create_render_pass(VulkanGraphics* graphics) {
-    VkAttachmentDescription color_attachment = {
-        .format = graphics->swapchain_format.format,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+static VkShaderModule vk_create_shader_module(VulkanGraphics* graphics, const byte* code, u64 size) {
+    VkShaderModuleCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = size,
+        .pCode = (const u32*)code,
     };
 
-    VkAttachmentReference color_attachment_ref = {
-        .attachment = 0,
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-    };
+    VkShaderModule module;
+    ERR_CHECK(vkCreateShaderModule(graphics->device, &info, NULL, &module), "shader module creation");
 
-    VkSubpassDescription subpass = {
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &color_attachment_ref,
-    };
+    return module;
+}
 
-    VkSubpassDependency dep = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
+/* the SPIR-V of `path` in the asset archive, or in a file `view` keeps open, relative to the working directory or
+ * else under ZULK_SHADER_ROOT; failing to find it is fatal. */
+static const byte* vk_shader_code(VulkanGraphics* graphics, const char* path, u64* size, FileView* view) {
+    *view = (FileView) { 0 };
 
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .srcAccessMask = 0,
+    u32 entry = graphics->assets_open ? archive_find(&graphics->assets, path) : UINT32_MAX;
+    if (entry != UINT32_MAX)
+        return archive_entry_data(&graphics->assets, entry, size);
 
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-    };
+    *view = file_view_open(path);
+    if (view->data == NULL) {
+        char loose[512];
+        snprintf(loose, sizeof(loose), "%s/%s", ZULK_SHADER_ROOT, path);
 
-    VkRenderPassCreateInfo info = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .attachmentCount = 1,
-        .pAttachments = &color_attachment,
-        .subpassCount = 1,
-        .pSubpasses = &subpass,
-        .dependencyCount = 1,
-        .pDependencies = &dep,
-    };
+        *view = file_view_open(loose);
+        if (view->data == NULL) {
+            fprintf(stderr, "couldn't load shader %s (nor %s)!\n", path, loose);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    ERR_CHECK(vkCreateRenderPass(graphics->device, &info, NULL, &graphics->render_pass), "render pass");
+    *size = view->length;
+    return view->data;
 }
 
-static VkShaderModule vk_create_shader_module(VulkanGraphics* graphics, FileView* view) {
-    VkShaderModuleCreateInfo info = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = view->length,
-        .pCode = (const u32*)view->data,
-    };
+VkShaderModule vk_load_shader_module(VulkanGraphics* graphics, const char* path) {
+    u64 size;
+    FileView view;
+    const byte* code = vk_shader_code(graphics, path, &size, &view);
 
-    VkShaderModule module;
-    ERR_CHECK(vkCreateShaderModule(graphics->device, &info, NULL, &module), "shader module creation");
+    VkShaderModule module = vk_create_shader_module(graphics, code, size);
+    if (view.data)
+        file_view_close(&view);
 
     return module;
 }
 
-static void vk_create_graphics_pipeline(VulkanGraphics* graphics) {
-    FileView vertex = file_view_open("shaders/bin/vulkan_triangle_pos.vert.spv");
-    FileView fragment = file_view_open("shaders/bin/vulkan_triangle_pos.frag.spv");
+void vk_reflect_shaders(VulkanGraphics* graphics, const char* const* paths, u32 count, ShaderReflection* reflection) {
+    *reflection = (ShaderReflection) { 0 };
 
-    if (vertex.data == NULL || fragment.data == NULL) {
-        fprintf(stderr, "couldn't load shaders!");
-        exit(EXIT_FAILURE);
+    for (u32 i = 0; i < count; ++i) {
+        u64 size;
+        FileView view;
+        const byte* code = vk_shader_code(graphics, paths[i], &size, &view);
+
+        ShaderReflection stage;
+        bool reflected = shader_reflect(code, size, &stage);
+        if (view.data)
+            file_view_close(&view);
+
+        if (!reflected || !shader_reflect_merge(reflection, &stage)) {
+            fprintf(stderr, "couldn't reflect shader %s!\n", paths[i]);
+            exit(EXIT_FAILURE);
+        }
     }
+}
+
+/* the shader modules stay alive, so variants can be built whenever they're first asked for. */
+static void vk_create_main_shaders(VulkanGraphics* graphics) {
+    const char* paths[] = { "shaders/bin/vulkan_triangle_pos.vert.spv", "shaders/bin/vulkan_triangle_pos.frag.spv" };
+    graphics->main_vertex = vk_load_shader_module(graphics, paths[0]);
+    graphics->main_fragment = vk_load_shader_module(graphics, paths[1]);
 
-    VkShaderModule vertex_mod = vk_create_shader_module(graphics, &vertex);
-    VkShaderModule fragment_mod = vk_create_shader_module(graphics, &fragment);
+    ShaderReflection reflection;
+    vk_reflect_shaders(graphics, paths, ZARRSIZ(paths), &reflection);
+    graphics->pipeline_layout = pipeline_layouts_get(&graphics->layouts, graphics->device, &reflection, &reflection);
+}
 
-    file_view_close(&vertex);
-    file_view_close(&fragment);
+static VkPipeline vk_create_graphics_pipeline(VulkanGraphics* graphics, u32 features) {
+    ShaderSpecialization spec;
+    shader_specialize(&spec, features);
 
     VkPipelineShaderStageCreateInfo vert_shader_stage = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .stage = VK_SHADER_STAGE_VERTEX_BIT,
-        .module = vertex_mod,
-        .pName = "main"
+        .module = graphics->main_vertex,
+        .pName = "main",
+        .pSpecializationInfo = &spec.info,
     };
 
     VkPipelineShaderStageCreateInfo frag_shader_stage = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .module = fragment_mod,
-        .pName = "main"
+        .module = graphics->main_fragment,
+        .pName = "main",
+        .pSpecializationInfo = &spec.info,
     };
 
     VkPipelineShaderStageCreateInfo stages[] = { vert_shader_stage, frag_shader_stage };
@@ -760,7 +863,14 @@ static void vk_create_graphics_pipeline(VulkanGraphics* graphics) {
     VkPipelineMultisampleStateCreateInfo multisample = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
         .sampleShadingEnable = VK_FALSE,
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .rasterizationSamples = graphics->msaa_samples,
+    };
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
     };
 
     VkPipelineColorBlendAttachmentState color_blend_attachment = {
@@ -775,14 +885,16 @@ static void vk_create_graphics_pipeline(VulkanGraphics* graphics) {
         .pAttachments = &color_blend_attachment,
     };
 
-    VkPipelineLayoutCreateInfo layout_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    VkPipelineRenderingCreateInfo rendering_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &graphics->scene_format,
+        .depthAttachmentFormat = graphics->depth_format,
     };
 
-    ERR_CHECK(vkCreatePipelineLayout(graphics->device, &layout_info, NULL, &graphics->pipeline_layout), "pipeline layout creation");
-
     VkGraphicsPipelineCreateInfo info = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = &rendering_info,
         .stageCount = ZARRSIZ(stages),
         .pStages = stages,
 
@@ -791,41 +903,192 @@ static void vk_create_graphics_pipeline(VulkanGraphics* graphics) {
         .pViewportState = &viewport_state,
         .pRasterizationState = &rasterizer,
         .pMultisampleState = &multisample,
+        .pDepthStencilState = &depth_stencil,
         .pColorBlendState = &color_blending,
         .pDynamicState = &dynamic_state,
 
         .layout = graphics->pipeline_layout,
-        .renderPass = graphics->render_pass,
-        .subpass = 0,
     };
 
-    ERR_CHECK(vkCreateGraphicsPipelines(graphics->device, VK_NULL_HANDLE, 1, &info, NULL, &graphics->graphics_pipeline), "graphics pipeline");
+    VkPipeline pipeline;
+    ERR_CHECK(vkCreateGraphicsPipelines(graphics->device, VK_NULL_HANDLE, 1, &info, NULL, &pipeline), "graphics pipeline");
 
-    vkDestroyShaderModule(graphics->device, vertex_mod, NULL);
-    vkDestroyShaderModule(graphics->device, fragment_mod, NULL);
+    return pipeline;
 }
 
-static void vk_create_framebuffers(VulkanGraphics* graphics) {
-    graphics->swapchain_framebuffers_count = graphics->swapchain_images_count;
-    graphics->swapchain_framebuffers = malloc(sizeof(VkFramebuffer) * graphics->swapchain_framebuffers_count);
+/* builds the variant the first time it's asked for. */
+static VkPipeline vk_main_pipeline(VulkanGraphics* graphics, u32 features) {
+    VkPipeline pipeline = pipeline_variants_find(&graphics->main_pipelines, features);
+    if (pipeline == VK_NULL_HANDLE) {
+        TRACE_ZONE("vk_create_graphics_pipeline");
 
-    for (u32 i = 0; i < graphics->swapchain_framebuffers_count; ++i) {
-        VkImageView attachments[] = {
-            graphics->swapchain_views[i],
-        };
+        pipeline = vk_create_graphics_pipeline(graphics, features);
+        pipeline_variants_add(&graphics->main_pipelines, features, pipeline);
+    }
 
-        VkFramebufferCreateInfo info = {
-            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .renderPass = graphics->render_pass,
-            .attachmentCount = 1,
-            .pAttachments = attachments,
-            .width = graphics->swapchain_extent.width,
-            .height = graphics->swapchain_extent.height,
-            .layers = 1,
-        };
+    return pipeline;
+}
+
+VkPipeline vk_create_compute_pipeline(VulkanGraphics* graphics, const char* path, VkPipelineLayout layout, u32 features) {
+    VkShaderModule module = vk_load_shader_module(graphics, path);
+
+    ShaderSpecialization spec;
+    shader_specialize(&spec, features);
+
+    VkComputePipelineCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main",
+            .pSpecializationInfo = &spec.info,
+        },
+        .layout = layout,
+    };
+
+    VkPipeline pipeline;
+    ERR_CHECK(vkCreateComputePipelines(graphics->device, VK_NULL_HANDLE, 1, &info, NULL, &pipeline), "compute pipeline");
+
+    vkDestroyShaderModule(graphics->device, module, NULL);
+    return pipeline;
+}
+
+void vk_add_async_compute(VulkanGraphics* graphics, const char* name, AsyncComputeRecordFunc record, void* data, VkPipelineStageFlags2 consumer_stages) {
+    if (graphics->async_compute_jobs_count >= MAX_ASYNC_COMPUTE_JOBS) {
+        fprintf(stderr, "too many async compute jobs (max %u)\n", MAX_ASYNC_COMPUTE_JOBS);
+        exit(EXIT_FAILURE);
+    }
+
+    /* the graphics submit waits for the compute one at these stages, and that wait is what puts the compute work
+     * under the in flight fence; without it, the compute command buffer could be reset while still pending. */
+    if (consumer_stages == VK_PIPELINE_STAGE_2_NONE) {
+        fprintf(stderr, "async compute job %s has no consumer stages\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    graphics->async_compute_jobs[graphics->async_compute_jobs_count++] = (AsyncComputeJob) {
+        .name = name,
+        .record = record,
+        .data = data,
+        .consumer_stages = consumer_stages,
+    };
+}
+
+VkBuffer vk_create_staging_buffer(VulkanGraphics* graphics, const void* data, VkDeviceSize size, GpuAllocation* memory) {
+    VkDevice device = graphics->device;
+
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    VkBuffer staging;
+    ERR_CHECK(vkCreateBuffer(device, &info, NULL, &staging), "staging buffer");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(device, staging, &reqs);
+
+    *memory = gpu_memory_allocate(device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, GRAPHICS_MEMORY_STAGING);
+    if (memory->memory == VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, staging, NULL);
+        return VK_NULL_HANDLE;
+    }
+
+    ERR_CHECK(vkBindBufferMemory(device, staging, memory->memory, 0), "staging buffer binding");
+
+    void* mapped;
+    ERR_CHECK(vkMapMemory(device, memory->memory, 0, VK_WHOLE_SIZE, 0, &mapped), "staging buffer mapping");
+    memcpy(mapped, data, size);
+    vkUnmapMemory(device, memory->memory);
+
+    return staging;
+}
+
+bool vk_upload_buffer(VulkanGraphics* graphics, VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+    VkDevice device = graphics->device;
+
+    GpuAllocation staging_memory;
+    VkBuffer staging = vk_create_staging_buffer(graphics, data, size, &staging_memory);
+    if (staging == VK_NULL_HANDLE)
+        return false;
+
+    VkCommandBufferAllocateInfo command_buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = graphics->command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer command_buffer;
+    ERR_CHECK(vkAllocateCommandBuffers(device, &command_buffer_info, &command_buffer), "upload command buffer");
+
+    VkCommandBufferBeginInfo begin = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+
+    ERR_CHECK(vkBeginCommandBuffer(command_buffer, &begin), "upload command buffer (begin)");
+    vkCmdCopyBuffer(command_buffer, staging, buffer, 1, &(VkBufferCopy) { 0, offset, size });
+    ERR_CHECK(vkEndCommandBuffer(command_buffer), "upload command buffer (end)");
+
+    VkSubmitInfo submit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+    };
+
+    /* the submission boundary makes the copy visible to everything submitted after it */
+    ERR_CHECK(vkQueueSubmit(graphics->graphics_queue, 1, &submit, VK_NULL_HANDLE), "upload submission");
+    vkQueueWaitIdle(graphics->graphics_queue);
+
+    vkFreeCommandBuffers(device, graphics->command_pool, 1, &command_buffer);
+    vkDestroyBuffer(device, staging, NULL);
+    gpu_memory_free(device, &staging_memory);
+
+    return true;
+}
 
-        ERR_CHECK(vkCreateFramebuffer(graphics->device, &info, NULL, &graphics->swapchain_framebuffers[i]), "framebuffer creation");
+VkBuffer vk_create_buffer(VulkanGraphics* graphics, VkBufferUsageFlags usage, VkDeviceSize size, GpuAllocation* memory) {
+    VkDevice device = graphics->device;
+
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    VkBuffer buffer;
+    ERR_CHECK(vkCreateBuffer(device, &info, NULL, &buffer), "buffer");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(device, buffer, &reqs);
+
+    *memory = gpu_memory_allocate(device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, GRAPHICS_MEMORY_BUFFERS);
+    if (memory->memory == VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, buffer, NULL);
+        return VK_NULL_HANDLE;
+    }
+
+    ERR_CHECK(vkBindBufferMemory(device, buffer, memory->memory, 0), "buffer binding");
+    return buffer;
+}
+
+VkBuffer vk_create_buffer_with_data(VulkanGraphics* graphics, VkBufferUsageFlags usage, const void* data, VkDeviceSize size, GpuAllocation* memory) {
+    VkBuffer buffer = vk_create_buffer(graphics, usage, size, memory);
+    if (buffer == VK_NULL_HANDLE)
+        return VK_NULL_HANDLE;
+
+    if (!vk_upload_buffer(graphics, buffer, 0, data, size)) {
+        vkDestroyBuffer(graphics->device, buffer, NULL);
+        gpu_memory_free(graphics->device, memory);
+        return VK_NULL_HANDLE;
     }
+
+    return buffer;
 }
 
 static void vk_create_command_pool(VulkanGraphics* graphics) {
@@ -836,6 +1099,9 @@ static void vk_create_command_pool(VulkanGraphics* graphics) {
     };
 
     ERR_CHECK(vkCreateCommandPool(graphics->device, &info, NULL, &graphics->command_pool), "command pool");
+
+    info.queueFamilyIndex = graphics->families.compute_family;
+    ERR_CHECK(vkCreateCommandPool(graphics->device, &info, NULL, &graphics->compute_command_pool), "compute command pool");
 }
 
 static void vk_create_command_buffers(VulkanGraphics* graphics) {
@@ -847,6 +1113,10 @@ static void vk_create_command_buffers(VulkanGraphics* graphics) {
     };
 
     ERR_CHECK(vkAllocateCommandBuffers(graphics->device, &info, graphics->command_buffers), "command buffer");
+
+    info.commandPool = graphics->compute_command_pool;
+    info.commandBufferCount = ZARRSIZ(graphics->compute_command_buffers);
+    ERR_CHECK(vkAllocateCommandBuffers(graphics->device, &info, graphics->compute_command_buffers), "compute command buffer");
 }
 
 static void vk_create_sync_objects(VulkanGraphics* graphics) {
@@ -854,199 +1124,1806 @@ static void vk_create_sync_objects(VulkanGraphics* graphics) {
     VkFenceCreateInfo fence_info = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = VK_FENCE_CREATE_SIGNALED_BIT };
 
     for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        ERR_CHECK(vkCreateSemaphore(graphics->device, &sem_info, NULL, &graphics->image_available_semaphores[i]), "img sem");
+        ERR_CHECK(vkCreateSemaphore(graphics->device, &sem_info, NULL, &vk_main_window(graphics)->image_available_semaphores[i]), "img sem");
         ERR_CHECK(vkCreateSemaphore(graphics->device, &sem_info, NULL, &graphics->render_finished_semaphores[i]), "rfinish sem");
         ERR_CHECK(vkCreateFence(graphics->device, &fence_info, NULL, &graphics->in_flight_fences[i]), "infly fence");
     }
+
+    VkSemaphoreTypeCreateInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    sem_info.pNext = &timeline_info;
+
+    ERR_CHECK(vkCreateSemaphore(graphics->device, &sem_info, NULL, &graphics->graphics_timeline), "graphics timeline");
+    ERR_CHECK(vkCreateSemaphore(graphics->device, &sem_info, NULL, &graphics->compute_timeline), "compute timeline");
 }
 
-static void vk_cleanup_swapchain(VulkanGraphics* graphics) {
-    for (u32 i = 0; i < graphics->swapchain_framebuffers_count; ++i) {
-        vkDestroyFramebuffer(graphics->device, graphics->swapchain_framebuffers[i], NULL);
+/* the budget is refreshed this often; the query isn't free on every driver. */
+#define MEMORY_BUDGET_INTERVAL (u64)16
+
+/* past this fraction of the budget the residency manager starts evicting, down to the second one. */
+#define MEMORY_PRESSURE_HIGH 0.95
+#define MEMORY_PRESSURE_TARGET 0.85
+
+static void vk_update_memory_budget(VulkanGraphics* graphics) {
+    VkDeviceSize allocated[VK_MAX_MEMORY_HEAPS];
+    gpu_memory_get_usage(allocated, NULL);
+
+    if (graphics->memory_budget_supported) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+        VkPhysicalDeviceMemoryProperties2 props = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, .pNext = &budget };
+        vkGetPhysicalDeviceMemoryProperties2(graphics->gpu, &props);
+
+        memcpy(graphics->heap_budget, budget.heapBudget, sizeof(graphics->heap_budget));
+        memcpy(graphics->heap_usage, budget.heapUsage, sizeof(graphics->heap_usage));
+    } else {
+        /* the rest of the system wants its share too */
+        for (u32 i = 0; i < graphics->memory_props.memoryHeapCount; ++i) {
+            graphics->heap_budget[i] = graphics->memory_props.memoryHeaps[i].size / 10 * 8;
+            graphics->heap_usage[i] = allocated[i];
+        }
     }
 
-    for (u32 i = 0; i < graphics->swapchain_views_count; ++i) {
-        vkDestroyImageView(graphics->device, graphics->swapchain_views[i], NULL);
+    for (u32 i = 0; i < graphics->memory_props.memoryHeapCount; ++i) {
+        if (!(graphics->memory_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+            continue;
+
+        VkDeviceSize budget = graphics->heap_budget[i];
+        VkDeviceSize usage = graphics->heap_usage[i];
+
+        if (usage > budget * MEMORY_PRESSURE_HIGH) {
+            VkDeviceSize freed = residency_free_up(&graphics->residency, i, usage - (VkDeviceSize)(budget * MEMORY_PRESSURE_TARGET));
+
+            /* report only when a heap starts being oversubscribed, not every time it's checked */
+            if (usage - freed > budget && !(graphics->heaps_over_budget & (1u << i))) {
+                fprintf(stderr, "heap %u is over its budget: %llu of %llu MiB used, the driver may start paging\n",
+                    i, (unsigned long long)(usage >> 20), (unsigned long long)(budget >> 20));
+                graphics->heaps_over_budget |= 1u << i;
+            }
+        } else {
+            graphics->heaps_over_budget &= ~(1u << i);
+        }
     }
+}
+
+static void vk_create_query_pool(VulkanGraphics* graphics) {
+    graphics->timestamp_pool = VK_NULL_HANDLE;
+    if (graphics->timestamp_period == 0)
+        return;
 
-    free(graphics->swapchain_views);
-    free(graphics->swapchain_images);
+    VkQueryPoolCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = MAX_FRAMES_IN_FLIGHT * GPU_TIMESTAMPS_PER_FRAME,
+    };
 
-    vkDestroySwapchainKHR(graphics->device, graphics->swapchain, NULL);
+    ERR_CHECK(vkCreateQueryPool(graphics->device, &info, NULL, &graphics->timestamp_pool), "timestamp query pool");
 }
 
-static void vk_recreate_swapchain(VulkanGraphics* graphics) {
-    int width = 0, height = 0;
-    surface_get_size(graphics->render_surface, &width, &height);
-    
-    while (width == 0 || height == 0) {
-        surface_get_size(graphics->render_surface, &width, &height);
-        surface_wait_event(graphics->render_surface);
+static void vk_update_render_extent(VulkanGraphics* graphics) {
+    VkExtent2D extent = vk_main_window(graphics)->swapchain_extent;
+    if (!graphics->dynamic_resolution) {
+        graphics->render_extent = extent;
+        return;
     }
 
-    vkDeviceWaitIdle(graphics->device);
+    float scale = graphics->drs.scale;
+    u32 width = (u32)(extent.width * scale + 0.5f);
+    u32 height = (u32)(extent.height * scale + 0.5f);
 
-    vk_cleanup_swapchain(graphics);
+    graphics->render_extent.width = width < 1 ? 1 : (width > extent.width ? extent.width : width);
+    graphics->render_extent.height = height < 1 ? 1 : (height > extent.height ? extent.height : height);
+}
+
+/* view and projection for this frame, from the camera and the current render extent. */
+static void vk_update_camera(VulkanGraphics* graphics) {
+    const GraphicsCamera* camera = &graphics->camera;
+    float aspect = (float)graphics->render_extent.width / (float)graphics->render_extent.height;
 
-    vk_create_swapchain(graphics);
-    vk_create_image_views(graphics);
-    vk_create_framebuffers(graphics);
+    graphics->view = mat4_look_at(vec3(camera->position[0], camera->position[1], camera->position[2]), vec3(camera->target[0], camera->target[1], camera->target[2]), vec3(0, 1, 0));
+    graphics->projection = mat4_perspective(camera->fov_y, aspect, camera->near_plane, camera->far_plane);
+    graphics->view_projection = mat4_mul(graphics->projection, graphics->view);
 }
 
+/* reads back the timestamps of the frame whose fence was just waited on; never stalls. */
+static void vk_read_gpu_timings(VulkanGraphics* graphics) {
+    u32 frame = graphics->current_frame;
+    if (!graphics->timestamps_pending[frame])
+        return;
 
-static void vk_record_command_buffer(VulkanGraphics* graphics, VkCommandBuffer command_buffer, u32 image_index) {
-    VkCommandBufferBeginInfo begin = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    ERR_CHECK(vkBeginCommandBuffer(command_buffer, &begin), "failed to (begin) record command buffer");
+    u32 count = graphics->timestamps_count[frame];
+    u64 ticks[GPU_TIMESTAMPS_PER_FRAME];
+    if (vkGetQueryPoolResults(graphics->device, graphics->timestamp_pool, frame * GPU_TIMESTAMPS_PER_FRAME, count, sizeof(ticks), ticks, sizeof(u64), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
 
-    VkRenderPassBeginInfo render_pass = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = graphics->render_pass,
-        .framebuffer = graphics->swapchain_framebuffers[image_index],
+    /* the passes add up, each from the later of its begin and the end of the pass before, so that
+     * overlapping passes aren't counted twice and a pass held up by the acquire or async compute
+     * semaphores (its begin is only written after the wait) doesn't count the time spent waiting. */
+    u64 busy = 0;
+    u64 previous_end = ticks[0];
+    for (u32 i = 1; i + 1 < count; i += 2) {
+        u64 begin = ticks[i] > previous_end ? ticks[i] : previous_end;
+        if (ticks[i + 1] > begin)
+            busy += ticks[i + 1] - begin;
+        if (ticks[i + 1] > previous_end)
+            previous_end = ticks[i + 1];
+    }
 
-        .renderArea.offset = { 0, 0 },
-        .renderArea.extent = graphics->swapchain_extent,
+    graphics->timestamps_pending[frame] = false;
+    graphics->gpu_frame_ms = (float)((double)busy * graphics->timestamp_period / 1000000.0);
+    graphics->gpu_frame_index = graphics->timestamp_frame_index[frame];
+
+    if (graphics->dynamic_resolution && !graphics->replaying) {
+        drs_update(&graphics->drs, graphics->gpu_frame_ms);
+        vk_update_render_extent(graphics);
+    }
+}
+
+static void vk_pass_main(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanGraphics* graphics = data;
 
-        .clearValueCount = 1,
-        .pClearValues = (VkClearValue[]){ { { { 0, 0, 0, 1 } } } }
+    VkRenderingAttachmentInfo color_attachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = rg_image_view(graph, graphics->rg_scene),
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = { { { 0, 0, 0, 1 } } },
+    };
+
+    /* render into the multisampled image, only the resolved result is ever stored */
+    if (graphics->rg_color_msaa != RG_INVALID) {
+        color_attachment.imageView = rg_image_view(graph, graphics->rg_color_msaa);
+        color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        color_attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+        color_attachment.resolveImageView = rg_image_view(graph, graphics->rg_scene);
+        color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    VkRenderingAttachmentInfo depth_attachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = rg_image_view(graph, graphics->rg_depth),
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .clearValue.depthStencil = { 1, 0 },
+    };
+
+    VkRenderingInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea.offset = { 0, 0 },
+        .renderArea.extent = graphics->render_extent,
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment,
+        .pDepthAttachment = &depth_attachment,
     };
 
-    vkCmdBeginRenderPass(command_buffer, &render_pass, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics->graphics_pipeline);
+    vkCmdBeginRendering(command_buffer, &rendering);
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_main_pipeline(graphics, graphics->shader_features));
 
     VkViewport viewport = {
-        .width = (float)graphics->swapchain_extent.width,
-        .height = (float)graphics->swapchain_extent.height,
+        .width = (float)graphics->render_extent.width,
+        .height = (float)graphics->render_extent.height,
         .minDepth = 0,
         .maxDepth = 1,
     };
     vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
     VkRect2D scissor = {
-        .extent = graphics->swapchain_extent
+        .extent = graphics->render_extent
     };
     vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
     vkCmdDraw(command_buffer, 3, 1, 0, 0);
 
-    vkCmdEndRenderPass(command_buffer);
-    ERR_CHECK(vkEndCommandBuffer(command_buffer), "failed to (end) record command buffer");
-}
-
-static void vk_surface_on_resize(Surface* surface, int width, int height) {
-    Graphics* graphics = surface_get_data(surface);
-    graphics->frame_resized_recently = true;
-}
+    /* opaque, before anything that blends over it */
+    mesh_renderer_draw(graphics->meshes, command_buffer, graphics->current_frame);
 
-VulkanGraphics* graphics_initialize(GraphicsConfiguration* config) {
-    if (!load_vulkan()) {
-        return NULL;
+    if (graphics->particles) {
+        /* the rows of the view matrix are the camera axes in world space */
+        Vec3 right = vec3(graphics->view.m[0], graphics->view.m[4], graphics->view.m[8]);
+        Vec3 up = vec3(graphics->view.m[1], graphics->view.m[5], graphics->view.m[9]);
+        particles_draw(graphics->particles, command_buffer, &graphics->view_projection, right, up);
     }
 
-    VulkanGraphics* graphics = malloc(sizeof(VulkanGraphics));
-    graphics->current_frame = 0;
-    graphics->render_surface = config->render_surface;
-    graphics->frame_resized_recently = false;
+    vkCmdEndRendering(command_buffer);
+}
 
-    vk_create_instance(graphics, config);
-    vk_create_surface(graphics, config);
-    vk_select_physical_dev(graphics, config);
-    vk_create_logical_dev(graphics, config);
+/* culls last frame's visible meshlets and draws them into the occlusion depth buffer. */
+static void vk_pass_occluders(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanGraphics* graphics = data;
 
-    vk_create_swapchain(graphics);
-    vk_create_image_views(graphics);
-    vk_create_render_pass(graphics);
+    mesh_renderer_cull(graphics->meshes, command_buffer, graphics->current_frame, MESH_CULL_OCCLUDERS);
 
-    vk_create_graphics_pipeline(graphics);
-    vk_create_framebuffers(graphics);
-    vk_create_command_pool(graphics);
-    vk_create_command_buffers(graphics);
-    vk_create_sync_objects(graphics);
+    VkRenderingAttachmentInfo depth_attachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = rg_image_view(graph, graphics->rg_occlusion_depth),
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue.depthStencil = { 1, 0 },
+    };
 
-    surface_set_data(graphics->render_surface, graphics);
-    surface_on_resize(graphics->render_surface, vk_surface_on_resize);
+    VkRenderingInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea.extent = graphics->render_extent,
+        .layerCount = 1,
+        .pDepthAttachment = &depth_attachment,
+    };
 
-    return graphics;
-}
+    vkCmdBeginRendering(command_buffer, &rendering);
+
+    VkViewport viewport = {
+        .width = (float)graphics->render_extent.width,
+        .height = (float)graphics->render_extent.height,
+        .minDepth = 0,
+        .maxDepth = 1,
+    };
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {
+        .extent = graphics->render_extent
+    };
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    mesh_renderer_draw_occluders(graphics->meshes, command_buffer, graphics->current_frame);
+
+    vkCmdEndRendering(command_buffer);
+}
+
+static void vk_pass_hiz(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    (void)graph;
+    VulkanGraphics* graphics = data;
+    mesh_renderer_build_hiz(graphics->meshes, command_buffer);
+}
+
+static void vk_pass_shadows(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    (void)graph;
+    VulkanGraphics* graphics = data;
+    shadow_atlas_record(graphics->shadows, command_buffer, graphics->current_frame);
+}
+
+static void vk_pass_light_clusters(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    (void)graph;
+    VulkanGraphics* graphics = data;
+    light_clusters_record(graphics->lights, command_buffer, graphics->current_frame);
+}
+
+/* tests every queued meshlet against the pyramid, for the main pass. */
+static void vk_pass_mesh_cull(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    (void)graph;
+    VulkanGraphics* graphics = data;
+    mesh_renderer_cull(graphics->meshes, command_buffer, graphics->current_frame, MESH_CULL_MAIN);
+}
+
+/* stretches the rendered part of the scene target over the whole swapchain image. */
+static void vk_pass_upscale(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanGraphics* graphics = data;
+    VulkanWindow* window = vk_main_window(graphics);
+
+    VkImageBlit region = {
+        .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .srcOffsets = { { 0, 0, 0 }, { (s32)graphics->render_extent.width, (s32)graphics->render_extent.height, 1 } },
+        .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .dstOffsets = { { 0, 0, 0 }, { (s32)window->swapchain_extent.width, (s32)window->swapchain_extent.height, 1 } },
+    };
+
+    vkCmdBlitImage(command_buffer,
+        rg_image(graph, graphics->rg_scene), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        rg_image(graph, window->rg_backbuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region, graphics->upscale_filter);
+}
+
+static PostTargets vk_post_targets(VulkanGraphics* graphics, RenderGraph* graph) {
+    VulkanWindow* window = vk_main_window(graphics);
+    RenderGraphResource output = graphics->post_direct ? window->rg_backbuffer : graphics->rg_post_output;
+    VkFormat format = window->swapchain_format.format;
+
+    return (PostTargets) {
+        .scene = rg_image_view(graph, graphics->rg_scene),
+        .scene_extent = rg_image_extent(graph, graphics->rg_scene),
+        .render_extent = graphics->render_extent,
+        .bloom = rg_image_view(graph, graphics->rg_bloom),
+        .bloom_blurred = rg_image_view(graph, graphics->rg_bloom_blurred),
+        .bloom_extent = rg_image_extent(graph, graphics->rg_bloom),
+        .output = rg_image_view(graph, output),
+        .output_extent = window->swapchain_extent,
+        .output_bgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB,
+    };
+}
+
+/* the prefilter and blur of the bloom, see post.h. */
+static void vk_pass_bloom(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanGraphics* graphics = data;
+    PostTargets targets = vk_post_targets(graphics, graph);
+    post_chain_record_bloom(graphics->post, command_buffer, graphics->current_frame, &targets);
+}
+
+/* the scene and the bloom into the swapchain image, or the post output copied into it. */
+static void vk_pass_composite(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanGraphics* graphics = data;
+    PostTargets targets = vk_post_targets(graphics, graph);
+    post_chain_record_composite(graphics->post, command_buffer, graphics->current_frame, &targets);
+}
+
+/* both are 32 bits a texel, which is all a copy needs; the composite already encoded sRGB and swapped the
+ * channels of a BGRA swapchain. */
+static void vk_pass_post_copy(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanGraphics* graphics = data;
+    VulkanWindow* window = vk_main_window(graphics);
+
+    VkImageCopy region = {
+        .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .extent = { window->swapchain_extent.width, window->swapchain_extent.height, 1 },
+    };
+
+    vkCmdCopyImage(command_buffer,
+        rg_image(graph, graphics->rg_post_output), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        rg_image(graph, window->rg_backbuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region);
+}
+
+/* sprites go over the finished scene, at window resolution. */
+static void vk_pass_sprites(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanGraphics* graphics = data;
+    if (sprite_batch_is_empty(graphics->sprites))
+        return;
+
+    VulkanWindow* window = vk_main_window(graphics);
+
+    sprite_batch_upload(graphics->sprites, command_buffer);
+
+    VkRenderingAttachmentInfo color_attachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = rg_image_view(graph, window->rg_backbuffer),
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+    };
+
+    VkRenderingInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea.extent = window->swapchain_extent,
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment,
+    };
+
+    vkCmdBeginRendering(command_buffer, &rendering);
+
+    VkViewport viewport = {
+        .width = (float)window->swapchain_extent.width,
+        .height = (float)window->swapchain_extent.height,
+        .minDepth = 0,
+        .maxDepth = 1,
+    };
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {
+        .extent = window->swapchain_extent
+    };
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    sprite_batch_draw(graphics->sprites, command_buffer, window->swapchain_extent, graphics->current_frame);
+
+    vkCmdEndRendering(command_buffer);
+}
+
+static void vk_pass_capture(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanGraphics* graphics = data;
+    capture_record(graphics->capture, command_buffer, rg_image(graph, vk_main_window(graphics)->rg_backbuffer), graphics->current_frame);
+}
+
+/* shows the main window's frame in another window, as large as it fits without stretching. */
+static void vk_pass_mirror(RenderGraph* graph, VkCommandBuffer command_buffer, void* data) {
+    VulkanWindow* window = data;
+    VulkanWindow* source = vk_main_window(window->graphics);
+
+    VkExtent2D from = source->swapchain_extent;
+    VkExtent2D to = window->swapchain_extent;
+
+    u32 width = to.width;
+    u32 height = (u32)((u64)from.height * to.width / from.width);
+    if (height > to.height) {
+        width = (u32)((u64)from.width * to.height / from.height);
+        height = to.height;
+    }
+
+    width = width < 1 ? 1 : width;
+    height = height < 1 ? 1 : height;
+
+    s32 x = (s32)(to.width - width) / 2;
+    s32 y = (s32)(to.height - height) / 2;
+
+    VkImage image = rg_image(graph, window->rg_backbuffer);
+
+    /* the bars around it; the blit writes over the clear, so it waits for it */
+    VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdClearColorImage(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &(VkClearColorValue) { { 0, 0, 0, 1 } }, 1, &range);
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &(VkMemoryBarrier2) {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        },
+    });
+
+    VkImageBlit region = {
+        .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .srcOffsets = { { 0, 0, 0 }, { (s32)from.width, (s32)from.height, 1 } },
+        .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .dstOffsets = { { x, y, 0 }, { x + (s32)width, y + (s32)height, 1 } },
+    };
+
+    vkCmdBlitImage(command_buffer,
+        rg_image(graph, source->rg_backbuffer), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region, window->graphics->upscale_filter);
+}
+
+/* declares the frame's passes; called on init and whenever a swapchain is recreated or a window attached. */
+static void vk_build_render_graph(VulkanGraphics* graphics) {
+    if (graphics->render_graph == NULL)
+        graphics->render_graph = rg_create(graphics->device, &graphics->memory_props);
+    else
+        rg_reset(graphics->render_graph);
+
+    RenderGraph* graph = graphics->render_graph;
+    VulkanWindow* window = vk_main_window(graphics);
+
+    window->rg_backbuffer = rg_import_image(graph, "backbuffer", &(RenderGraphImportInfo) {
+        .format = window->swapchain_format.format,
+        .initial_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        /* matches the stage the image available semaphore is waited on in graphics_draw_frame() */
+        .initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        /* headless frames end ready to be copied out */
+        .final_layout = graphics->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    });
+
+    graphics->rg_depth = rg_create_image(graph, "depth", &(RenderGraphImageInfo) {
+        .format = graphics->depth_format,
+        .samples = graphics->msaa_samples,
+        .transient = true,
+    });
+
+    graphics->rg_color_msaa = RG_INVALID;
+    if (graphics->msaa_samples > VK_SAMPLE_COUNT_1_BIT) {
+        graphics->rg_color_msaa = rg_create_image(graph, "color msaa", &(RenderGraphImageInfo) {
+            .format = graphics->scene_format,
+            .samples = graphics->msaa_samples,
+            .transient = true,
+        });
+    }
+
+    /* with dynamic resolution the scene goes to a full size target of which only render_extent is used,
+     * so changing the scale never reallocates anything. */
+    graphics->rg_scene = window->rg_backbuffer;
+    if (graphics->dynamic_resolution || graphics->post) {
+        graphics->rg_scene = rg_create_image(graph, "scene", &(RenderGraphImageInfo) {
+            .format = graphics->scene_format,
+        });
+    }
+
+    /* the pyramid starts at half the size of the depth buffer, rounded up to powers of two so every level of it
+     * covers the level before it at any render extent; see mesh.h */
+    graphics->rg_occlusion_depth = RG_INVALID;
+    graphics->rg_hiz = RG_INVALID;
+    u32 hiz_mip_levels = 0;
+    if (graphics->occlusion_culling) {
+        graphics->rg_occlusion_depth = rg_create_image(graph, "occlusion depth", &(RenderGraphImageInfo) {
+            .format = graphics->depth_format,
+        });
+
+        VkExtent2D hiz_extent = { 1, 1 };
+        while (hiz_extent.width * 2 < window->swapchain_extent.width)
+            hiz_extent.width *= 2;
+        while (hiz_extent.height * 2 < window->swapchain_extent.height)
+            hiz_extent.height *= 2;
+
+        u32 largest = hiz_extent.width > hiz_extent.height ? hiz_extent.width : hiz_extent.height;
+        while (hiz_mip_levels < MESH_HIZ_MAX_LEVELS && (1u << hiz_mip_levels) <= largest)
+            ++hiz_mip_levels;
+
+        graphics->rg_hiz = rg_create_image(graph, "hiz", &(RenderGraphImageInfo) {
+            .format = VK_FORMAT_R32_SFLOAT,
+            .extent = hiz_extent,
+            .mip_levels = hiz_mip_levels,
+        });
+
+        RenderGraphPass occluders = rg_add_pass(graph, "occluders", RG_PASS_GRAPHICS, vk_pass_occluders, graphics);
+        rg_write(graph, occluders, graphics->rg_occlusion_depth, RG_USAGE_DEPTH_ATTACHMENT);
+
+        RenderGraphPass hiz = rg_add_pass(graph, "hiz", RG_PASS_COMPUTE, vk_pass_hiz, graphics);
+        rg_read(graph, hiz, graphics->rg_occlusion_depth, RG_USAGE_SAMPLED);
+        rg_write(graph, hiz, graphics->rg_hiz, RG_USAGE_STORAGE_WRITE);
+
+        /* its results are buffers, which the graph doesn't track */
+        RenderGraphPass mesh_cull = rg_add_pass(graph, "mesh cull", RG_PASS_COMPUTE, vk_pass_mesh_cull, graphics);
+        rg_read(graph, mesh_cull, graphics->rg_hiz, RG_USAGE_SAMPLED);
+        rg_pass_keep(graph, mesh_cull);
+    }
+
+    /* the atlas is cached across frames, so it isn't the graph's; the pass keeps its layouts itself */
+    RenderGraphPass shadows = rg_add_pass(graph, "shadows", RG_PASS_GRAPHICS, vk_pass_shadows, graphics);
+    rg_pass_keep(graph, shadows);
+
+    /* like the culling, it only writes buffers */
+    RenderGraphPass light_clusters = rg_add_pass(graph, "light clusters", RG_PASS_COMPUTE, vk_pass_light_clusters, graphics);
+    rg_pass_keep(graph, light_clusters);
+
+    RenderGraphPass main = rg_add_pass(graph, "main", RG_PASS_GRAPHICS, vk_pass_main, graphics);
+    rg_write(graph, main, graphics->rg_scene, RG_USAGE_COLOR_ATTACHMENT);
+    rg_write(graph, main, graphics->rg_depth, RG_USAGE_DEPTH_ATTACHMENT);
+    if (graphics->rg_color_msaa != RG_INVALID)
+        rg_write(graph, main, graphics->rg_color_msaa, RG_USAGE_COLOR_ATTACHMENT);
+
+    graphics->rg_bloom = RG_INVALID;
+    graphics->rg_bloom_blurred = RG_INVALID;
+    graphics->rg_post_output = RG_INVALID;
+    if (graphics->post) {
+        /* sized for the whole scene target, like it, so dynamic resolution never reallocates them */
+        VkExtent2D bloom_extent = {
+            vk_dispatch_size(window->swapchain_extent.width, POST_BLOOM_DOWNSAMPLE),
+            vk_dispatch_size(window->swapchain_extent.height, POST_BLOOM_DOWNSAMPLE),
+        };
+
+        graphics->rg_bloom = rg_create_image(graph, "bloom", &(RenderGraphImageInfo) {
+            .format = POST_BLOOM_FORMAT,
+            .extent = bloom_extent,
+        });
+        graphics->rg_bloom_blurred = rg_create_image(graph, "bloom blurred", &(RenderGraphImageInfo) {
+            .format = POST_BLOOM_FORMAT,
+            .extent = bloom_extent,
+        });
+
+        RenderGraphResource output = window->rg_backbuffer;
+        if (!graphics->post_direct) {
+            graphics->rg_post_output = rg_create_image(graph, "post output", &(RenderGraphImageInfo) {
+                .format = POST_OUTPUT_FORMAT,
+            });
+            output = graphics->rg_post_output;
+        }
+
+        RenderGraphPass bloom = rg_add_pass(graph, "bloom", RG_PASS_COMPUTE, vk_pass_bloom, graphics);
+        rg_read(graph, bloom, graphics->rg_scene, RG_USAGE_SAMPLED);
+        rg_write(graph, bloom, graphics->rg_bloom, RG_USAGE_STORAGE_WRITE);
+        rg_write(graph, bloom, graphics->rg_bloom_blurred, RG_USAGE_STORAGE_WRITE);
+
+        RenderGraphPass composite = rg_add_pass(graph, "composite", RG_PASS_COMPUTE, vk_pass_composite, graphics);
+        rg_read(graph, composite, graphics->rg_scene, RG_USAGE_SAMPLED);
+        rg_read(graph, composite, graphics->rg_bloom_blurred, RG_USAGE_SAMPLED);
+        rg_write(graph, composite, output, RG_USAGE_STORAGE_WRITE);
+
+        if (!graphics->post_direct) {
+            RenderGraphPass copy = rg_add_pass(graph, "post copy", RG_PASS_TRANSFER, vk_pass_post_copy, graphics);
+            rg_read(graph, copy, graphics->rg_post_output, RG_USAGE_TRANSFER_SRC);
+            rg_write(graph, copy, window->rg_backbuffer, RG_USAGE_TRANSFER_DST);
+        }
+    } else if (graphics->dynamic_resolution) {
+        RenderGraphPass upscale = rg_add_pass(graph, "upscale", RG_PASS_TRANSFER, vk_pass_upscale, graphics);
+        rg_read(graph, upscale, graphics->rg_scene, RG_USAGE_TRANSFER_SRC);
+        rg_write(graph, upscale, window->rg_backbuffer, RG_USAGE_TRANSFER_DST);
+    }
+
+    RenderGraphPass sprites = rg_add_pass(graph, "sprites", RG_PASS_GRAPHICS, vk_pass_sprites, graphics);
+    rg_write(graph, sprites, window->rg_backbuffer, RG_USAGE_COLOR_ATTACHMENT);
+
+    if (graphics->capture) {
+        RenderGraphPass capture = rg_add_pass(graph, "capture", RG_PASS_TRANSFER, vk_pass_capture, graphics);
+        rg_read(graph, capture, window->rg_backbuffer, RG_USAGE_TRANSFER_SRC);
+        rg_pass_keep(graph, capture);
+    }
+
+    /* the other windows get the finished frame, sprites and all */
+    for (u32 i = 1; i < GRAPHICS_MAX_WINDOWS; ++i) {
+        VulkanWindow* other = &graphics->windows[i];
+        if (!other->attached)
+            continue;
+
+        other->rg_backbuffer = rg_import_image(graph, "window backbuffer", &(RenderGraphImportInfo) {
+            .format = other->swapchain_format.format,
+            .initial_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        });
+
+        RenderGraphPass mirror = rg_add_pass(graph, "mirror", RG_PASS_TRANSFER, vk_pass_mirror, other);
+        rg_read(graph, mirror, window->rg_backbuffer, RG_USAGE_TRANSFER_SRC);
+        rg_write(graph, mirror, other->rg_backbuffer, RG_USAGE_TRANSFER_DST);
+    }
+
+    rg_compile(graph, window->swapchain_extent);
+    vk_update_render_extent(graphics);
+
+    if (graphics->occlusion_culling)
+        mesh_renderer_set_targets(graphics->meshes, rg_image_view(graph, graphics->rg_occlusion_depth), rg_image(graph, graphics->rg_hiz), rg_image_view(graph, graphics->rg_hiz), hiz_mip_levels);
+}
+
+static void vk_cleanup_swapchain(VulkanGraphics* graphics, VulkanWindow* window) {
+    for (u32 i = 0; i < window->swapchain_views_count; ++i) {
+        vkDestroyImageView(graphics->device, window->swapchain_views[i], NULL);
+    }
+
+    if (window->surface == VK_NULL_HANDLE) {
+        for (u32 i = 0; i < window->swapchain_images_count; ++i) {
+            vkDestroyImage(graphics->device, window->swapchain_images[i], NULL);
+            gpu_memory_free(graphics->device, &window->offscreen_memory[i]);
+        }
+    } else {
+        vkDestroySwapchainKHR(graphics->device, window->swapchain, NULL);
+    }
+
+    /* so a window whose swapchain couldn't be recreated can still be destroyed */
+    window->swapchain = VK_NULL_HANDLE;
+    window->swapchain_views_count = 0;
+    window->swapchain_images_count = 0;
+}
+
+/* false if the window can't be blitted to, see vk_create_swapchain(); nothing is left created then. */
+static bool vk_create_backbuffers(VulkanGraphics* graphics, VulkanWindow* window) {
+    if (window->surface == VK_NULL_HANDLE)
+        vk_create_offscreen_targets(graphics, window);
+    else if (!vk_create_swapchain(graphics, window))
+        return false;
+
+    vk_create_image_views(graphics, window);
+    return true;
+}
+
+/* asks the surface rather than the Surface, whose size is only updated by the thread handling its events. */
+static bool vk_window_minimized(VulkanGraphics* graphics, VulkanWindow* window) {
+    if (window->surface == VK_NULL_HANDLE)
+        return false;
+
+    VkSurfaceCapabilitiesKHR caps;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(graphics->gpu, window->surface, &caps);
+    return caps.currentExtent.width == 0 || caps.currentExtent.height == 0;
+}
+
+/* the swapchain and everything else of a window; the surface itself is the caller's. */
+static void vk_destroy_window(VulkanGraphics* graphics, VulkanWindow* window) {
+    vk_cleanup_swapchain(graphics, window);
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        vkDestroySemaphore(graphics->device, window->image_available_semaphores[i], NULL);
+
+    if (window->surface)
+        vkDestroySurfaceKHR(graphics->instance, window->surface, NULL);
+
+    window->attached = false;
+}
+
+/* false if the window was detached instead, because the main window's frame can't be blitted into its new
+ * swapchain; the render graph is rebuilt either way. */
+static bool vk_recreate_swapchain(VulkanGraphics* graphics, VulkanWindow* window) {
+    TRACE_FUNCTION();
+
+    /* the render thread can't handle events, and the thread that does may be waiting for it */
+    if (graphics->commands) {
+        while (vk_window_minimized(graphics, window))
+            thread_yield();
+    }
+
+    int width = 0, height = 0;
+    while (!graphics->commands && window->render_surface && (width == 0 || height == 0)) {
+        surface_get_size(window->render_surface, &width, &height);
+        if (width == 0 || height == 0)
+            surface_wait_event(window->render_surface);
+    }
 
-void graphics_deinitialize(Graphics* graphics) {
     vkDeviceWaitIdle(graphics->device);
 
-    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        vkDestroySemaphore(graphics->device, graphics->image_available_semaphores[i], NULL);
-        vkDestroySemaphore(graphics->device, graphics->render_finished_semaphores[i], NULL);
-        vkDestroyFence(graphics->device, graphics->in_flight_fences[i], NULL);
+    vk_cleanup_swapchain(graphics, window);
+    if (!vk_create_backbuffers(graphics, window)) {
+        fprintf(stderr, "the GPU can't blit to the window's new swapchain, detaching it.\n");
+        surface_set_data(window->render_surface, NULL);
+        vk_destroy_window(graphics, window);
+
+        vk_build_render_graph(graphics);
+        return false;
+    }
+
+    if (window == vk_main_window(graphics) && graphics->capture
+        && !(graphics->capture_supported && capture_resize(graphics->capture, window->swapchain_extent, window->swapchain_format.format))) {
+        capture_destroy(graphics->capture);
+        graphics->capture = NULL;
+    }
+
+    vk_build_render_graph(graphics);
+    return true;
+}
+
+
+/* `wait_stages` are the stages the submit waits on semaphores at, which the pass timestamps leave out. */
+static void vk_record_command_buffer(VulkanGraphics* graphics, VkCommandBuffer command_buffer, VkPipelineStageFlags2 wait_stages) {
+    TRACE_FUNCTION();
+
+    VkCommandBufferBeginInfo begin = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    ERR_CHECK(vkBeginCommandBuffer(command_buffer, &begin), "failed to (begin) record command buffer");
+
+    u32 query = graphics->current_frame * GPU_TIMESTAMPS_PER_FRAME;
+    if (graphics->timestamp_pool) {
+        vkCmdResetQueryPool(command_buffer, graphics->timestamp_pool, query, GPU_TIMESTAMPS_PER_FRAME);
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, graphics->timestamp_pool, query);
+        rg_set_timestamps(graphics->render_graph, graphics->timestamp_pool, query + 1, wait_stages);
+    }
+
+    /* the culling passes and the main pass all draw what this leaves queued */
+    Vec3 camera_position = vec3(graphics->camera.position[0], graphics->camera.position[1], graphics->camera.position[2]);
+    mesh_renderer_prepare(graphics->meshes, graphics->current_frame, &graphics->view, &graphics->projection, camera_position, graphics->render_extent);
+
+    /* the shadows go by the casters left above, and the lights carry the index of theirs */
+    u32 lights_count;
+    const GraphicsLight* lights = light_clusters_queued(graphics->lights, &lights_count);
+    shadow_atlas_prepare(graphics->shadows, graphics->current_frame, lights, lights_count, &graphics->view, &graphics->projection, camera_position, graphics->render_extent);
+    light_clusters_prepare(graphics->lights, graphics->current_frame, &graphics->view, &graphics->projection, graphics->camera.near_plane, graphics->camera.far_plane, graphics->render_extent);
+
+    for (u32 i = 0; i < GRAPHICS_MAX_WINDOWS; ++i) {
+        VulkanWindow* window = &graphics->windows[i];
+        if (window->attached)
+            rg_set_image(graphics->render_graph, window->rg_backbuffer, window->swapchain_images[window->image_index], window->swapchain_views[window->image_index]);
+    }
+
+    /* every pass drawing meshes reads the transforms, the shadows' and the culling ones included */
+    mesh_renderer_upload(graphics->meshes, command_buffer, graphics->current_frame);
+
+    rg_execute(graphics->render_graph, command_buffer);
+
+    if (graphics->timestamp_pool) {
+        graphics->timestamps_count[graphics->current_frame] = 1 + rg_timestamps_count(graphics->render_graph);
+        graphics->timestamps_pending[graphics->current_frame] = true;
+        graphics->timestamp_frame_index[graphics->current_frame] = graphics->frame_index;
+    }
+
+    ERR_CHECK(vkEndCommandBuffer(command_buffer), "failed to (end) record command buffer");
+}
+
+/* records and submits this frame's async compute jobs; returns the graphics stages that must wait for them. */
+static VkPipelineStageFlags2 vk_submit_async_compute(VulkanGraphics* graphics) {
+    TRACE_FUNCTION();
+
+    if (graphics->async_compute_jobs_count == 0)
+        return VK_PIPELINE_STAGE_2_NONE;
+
+    VkCommandBuffer command_buffer = graphics->compute_command_buffers[graphics->current_frame];
+    vkResetCommandBuffer(command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    ERR_CHECK(vkBeginCommandBuffer(command_buffer, &begin), "failed to (begin) record compute command buffer");
+
+    VkPipelineStageFlags2 consumer_stages = VK_PIPELINE_STAGE_2_NONE;
+    for (u32 i = 0; i < graphics->async_compute_jobs_count; ++i) {
+        AsyncComputeJob* job = &graphics->async_compute_jobs[i];
+
+        if (vkCmdBeginDebugUtilsLabelEXT)
+            vkCmdBeginDebugUtilsLabelEXT(command_buffer, &(VkDebugUtilsLabelEXT) { VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, .pLabelName = job->name });
+
+        job->record(graphics, command_buffer, job->data);
+        consumer_stages |= job->consumer_stages;
+
+        if (vkCmdEndDebugUtilsLabelEXT)
+            vkCmdEndDebugUtilsLabelEXT(command_buffer);
+    }
+
+    ERR_CHECK(vkEndCommandBuffer(command_buffer), "failed to (end) record compute command buffer");
+
+    /* the previous frame's graphics work must be done with whatever this frame's jobs overwrite. */
+    VkSemaphoreSubmitInfo wait = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = graphics->graphics_timeline,
+        .value = graphics->frame_index - 1,
+        .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    };
+
+    VkSemaphoreSubmitInfo signal = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = graphics->compute_timeline,
+        .value = graphics->frame_index,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+
+    VkSubmitInfo2 submit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .waitSemaphoreInfoCount = 1,
+        .pWaitSemaphoreInfos = &wait,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &(VkCommandBufferSubmitInfo) { VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO, .commandBuffer = command_buffer },
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &signal,
+    };
+
+    ERR_CHECK(vkQueueSubmit2(graphics->compute_queue, 1, &submit, VK_NULL_HANDLE), "subm async compute");
+
+    return consumer_stages;
+}
+
+static void vk_surface_on_resize(Surface* surface, int width, int height) {
+    /* NULL once the window is detached */
+    VulkanWindow* window = surface_get_data(surface);
+    if (window)
+        window->frame_resized_recently = true;
+}
+
+/* true on the render thread, and on a thread that holds it off with vk_lock_renderer() */
+static _Thread_local bool vk_owns_renderer = false;
+
+/* with a render thread, queues a call of the API for it to make instead; returns false if the caller has to make
+ * it itself. */
+static bool vk_defer(VulkanGraphics* graphics, enum RecordingCommandType type, const void* payload, u32 size) {
+    if (graphics->commands == NULL || vk_owns_renderer)
+        return false;
+
+    command_stream_write(graphics->commands, type, payload, size);
+    return true;
+}
+
+/* with a render thread, waits for the frame it's rendering and keeps it from starting the next one, for the calls
+ * that can't be queued; returns true if it did, and the caller has to call itself again and vk_unlock_renderer(). */
+static bool vk_lock_renderer(VulkanGraphics* graphics) {
+    if (graphics->commands == NULL || vk_owns_renderer)
+        return false;
+
+    mutex_lock(&graphics->render_mutex);
+    vk_owns_renderer = true;
+    return true;
+}
+
+static void vk_unlock_renderer(VulkanGraphics* graphics) {
+    vk_owns_renderer = false;
+    mutex_unlock(&graphics->render_mutex);
+}
+
+/* the commands that only make sense for the frame they're in */
+static bool vk_is_frame_command(u16 type) {
+    return type == RECORDING_CMD_SPRITES || type == RECORDING_CMD_MESH_DRAW || type == RECORDING_CMD_STATIC_MESH_DRAW || type == RECORDING_CMD_LIGHTS;
+}
+
+/* plays back each frame the calling thread submits and renders it, while that thread writes the next one. */
+static void vk_render_thread_main(void* data) {
+    VulkanGraphics* graphics = data;
+
+    TRACE_THREAD_NAME("render");
+    vk_owns_renderer = true;
+
+    const byte* commands;
+    usize size;
+    while (command_stream_acquire(graphics->commands, &commands, &size)) {
+        mutex_lock(&graphics->render_mutex);
+
+        /* there is nothing to render into; the draws are dropped rather than piling up until it's restored */
+        bool minimized = vk_window_minimized(graphics, vk_main_window(graphics));
+
+        usize offset = 0;
+        const void* payload;
+        const RecordingCommand* command;
+        while ((command = command_stream_next(commands, size, &offset, &payload)) != NULL) {
+            if (!minimized || !vk_is_frame_command(command->type))
+                graphics_replay_command(graphics, command, payload);
+        }
+
+        /* the subsystems copied what they keep; the buffer can take the frame after next already */
+        command_stream_release(graphics->commands);
+
+        if (!minimized)
+            graphics_draw_frame(graphics);
+
+        mutex_unlock(&graphics->render_mutex);
+    }
+}
+
+VulkanGraphics* graphics_initialize(GraphicsConfiguration* config) {
+    TRACE_FUNCTION();
+
+    if (!load_vulkan()) {
+        return NULL;
+    }
+
+    /* the renderer state is the first thing in the persistent arena, which then moves into it */
+    Arena persistent_arena;
+    arena_init(&persistent_arena, "persistent", PERSISTENT_ARENA_SIZE);
+
+    VulkanGraphics* graphics = ARENA_PUSH(&persistent_arena, VulkanGraphics, 1);
+    graphics->persistent_arena = persistent_arena;
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        arena_init(&graphics->frame_arenas[i], "frame", FRAME_ARENA_SIZE);
+
+    graphics->current_frame = 0;
+    graphics->headless = config->render_surface == NULL;
+    graphics->headless_extent = (VkExtent2D) { config->headless_width, config->headless_height };
+    memset(graphics->windows, 0, sizeof(graphics->windows));
+    graphics->render_graph = NULL;
+    graphics->gpu_frame_ms = 0;
+    graphics->frame_index = 0;
+    graphics->async_compute_jobs_count = 0;
+    graphics->heaps_over_budget = 0;
+    graphics->layouts.set_layout_count = 0;
+    graphics->layouts.layout_count = 0;
+
+    graphics->jobs = jobs_create(0);
+
+    graphics->assets_open = false;
+    if (config->asset_archive) {
+        TRACE_ZONE("archive_unpack");
+
+        if (!archive_open(&graphics->assets, config->asset_archive)) {
+            printf("couldn't open the asset archive %s, loading loose files.\n", config->asset_archive);
+        } else if (!archive_unpack(&graphics->assets, graphics->jobs)) {
+            printf("the asset archive %s is corrupt, loading loose files.\n", config->asset_archive);
+            archive_close(&graphics->assets);
+        } else {
+            graphics->assets_open = true;
+        }
+    }
+    graphics->capture = NULL;
+    graphics->recorder = NULL;
+    graphics->replaying = false;
+    graphics->gpu_frame_index = 0;
+    residency_init(&graphics->residency);
+    memset(graphics->timestamps_pending, 0, sizeof(graphics->timestamps_pending));
+
+    {
+        TRACE_ZONE("vk_create_instance");
+        vk_create_instance(graphics, config);
+    }
+
+    vk_create_surface(graphics, config);
+
+    {
+        TRACE_ZONE("vk_select_physical_dev");
+        vk_select_physical_dev(graphics, config);
+        vk_select_attachment_formats(graphics, config);
+    }
+
+    graphics->post_processing = config->post_processing;
+    graphics->dynamic_resolution = config->dynamic_resolution;
+    if (graphics->dynamic_resolution && graphics->timestamp_period == 0) {
+        printf("the GPU can't measure frame times, disabling dynamic resolution.\n");
+        graphics->dynamic_resolution = false;
+    }
+
+    drs_init(&graphics->drs, config->frame_budget_ms > 0 ? config->frame_budget_ms : 1000.0f / 60.0f, 0.5f, 1.0f);
+
+    {
+        TRACE_ZONE("vk_create_logical_dev");
+        vk_create_logical_dev(graphics, config);
+    }
+
+    vk_create_backbuffers(graphics, vk_main_window(graphics));
+    graphics->scene_format = graphics->post_processing ? POST_SCENE_FORMAT : vk_main_window(graphics)->swapchain_format.format;
+
+    {
+        TRACE_ZONE("vk_create_main_shaders");
+        vk_create_main_shaders(graphics);
+
+        /* only the requested variant is built up front; others are built when switched to. */
+        graphics->main_pipelines.count = 0;
+        graphics->shader_features = config->shader_features;
+        vk_main_pipeline(graphics, graphics->shader_features);
+    }
+
+    graphics->sprites = sprite_batch_create(graphics);
+
+    graphics->particles = NULL;
+    graphics->max_particles = config->max_particles;
+    if (config->max_particles > 0)
+        graphics->particles = particles_create(graphics, config->max_particles);
+
+    graphics->lights = light_clusters_create(graphics);
+    graphics->shadows = shadow_atlas_create(graphics);
+    graphics->meshes = mesh_renderer_create(graphics);
+
+    graphics->post = NULL;
+    if (graphics->post_processing)
+        graphics->post = post_chain_create(graphics);
+
+    graphics->camera = (GraphicsCamera) {
+        .position = { 0, 1.5f, 4 },
+        .target = { 0, 1, 0 },
+        .fov_y = 1.0f,
+        .near_plane = 0.1f,
+        .far_plane = 100.0f,
+    };
+
+    vk_build_render_graph(graphics);
+    vk_create_command_pool(graphics);
+    vk_create_command_buffers(graphics);
+    vk_create_sync_objects(graphics);
+    vk_create_query_pool(graphics);
+    vk_update_memory_budget(graphics);
+
+    if (!graphics->headless) {
+        surface_set_data(config->render_surface, vk_main_window(graphics));
+        surface_on_resize(config->render_surface, vk_surface_on_resize);
+    }
+
+    graphics->commands = NULL;
+    if (config->render_thread) {
+        graphics->commands = command_stream_create();
+        mutex_init(&graphics->render_mutex);
+
+        if (!thread_create(&graphics->render_thread, vk_render_thread_main, graphics)) {
+            printf("couldn't start the render thread, rendering on the calling one.\n");
+            mutex_destroy(&graphics->render_mutex);
+            command_stream_destroy(graphics->commands);
+            graphics->commands = NULL;
+        }
+    }
+
+    return graphics;
+}
+
+void graphics_deinitialize(Graphics* graphics) {
+    if (graphics->commands) {
+        command_stream_close(graphics->commands);
+        thread_join(graphics->render_thread);
+
+        mutex_destroy(&graphics->render_mutex);
+        command_stream_destroy(graphics->commands);
+        graphics->commands = NULL;
+    }
+
+    vkDeviceWaitIdle(graphics->device);
+
+    if (graphics->capture)
+        capture_destroy(graphics->capture);
+
+    graphics_stop_recording(graphics);
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroySemaphore(graphics->device, graphics->render_finished_semaphores[i], NULL);
+        vkDestroyFence(graphics->device, graphics->in_flight_fences[i], NULL);
+    }
+
+    vkDestroySemaphore(graphics->device, graphics->graphics_timeline, NULL);
+    vkDestroySemaphore(graphics->device, graphics->compute_timeline, NULL);
+
+    vkDestroyCommandPool(graphics->device, graphics->command_pool, NULL);
+    vkDestroyCommandPool(graphics->device, graphics->compute_command_pool, NULL);
+
+    if (graphics->timestamp_pool)
+        vkDestroyQueryPool(graphics->device, graphics->timestamp_pool, NULL);
+
+    sprite_batch_destroy(graphics->sprites);
+    if (graphics->particles)
+        particles_destroy(graphics->particles);
+    mesh_renderer_destroy(graphics->meshes);
+    shadow_atlas_destroy(graphics->shadows);
+    light_clusters_destroy(graphics->lights);
+    if (graphics->post)
+        post_chain_destroy(graphics->post);
+
+    pipeline_variants_destroy(&graphics->main_pipelines, graphics->device);
+    vkDestroyShaderModule(graphics->device, graphics->main_vertex, NULL);
+    vkDestroyShaderModule(graphics->device, graphics->main_fragment, NULL);
+    pipeline_layouts_destroy(&graphics->layouts, graphics->device);
+    rg_destroy(graphics->render_graph);
+
+    for (u32 i = 0; i < GRAPHICS_MAX_WINDOWS; ++i) {
+        if (graphics->windows[i].attached)
+            vk_destroy_window(graphics, &graphics->windows[i]);
+    }
+    
+    vkDestroyDevice(graphics->device, NULL);
+
+#if defined(ZULK_DEBUG)
+    if (graphics->debug_messenger && vkDestroyDebugUtilsMessengerEXT)
+        vkDestroyDebugUtilsMessengerEXT(graphics->instance, graphics->debug_messenger, NULL);
+#endif
+
+    vkDestroyInstance(graphics->instance, NULL);
+
+    if (graphics->assets_open)
+        archive_close(&graphics->assets);
+
+    jobs_destroy(graphics->jobs);
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        arena_destroy(&graphics->frame_arenas[i]);
+
+    /* graphics itself lives in there */
+    Arena persistent_arena = graphics->persistent_arena;
+    arena_destroy(&persistent_arena);
+}
+
+void graphics_set_shader_features(Graphics* graphics, u32 features) {
+    if (vk_defer(graphics, RECORDING_CMD_SHADER_FEATURES, &features, sizeof(features)))
+        return;
+
+    graphics->shader_features = features;
+
+    if (graphics->recorder)
+        recorder_write(graphics->recorder, RECORDING_CMD_SHADER_FEATURES, &features, sizeof(features));
+}
+
+void graphics_set_camera(Graphics* graphics, const GraphicsCamera* camera) {
+    if (vk_defer(graphics, RECORDING_CMD_CAMERA, camera, sizeof(*camera)))
+        return;
+
+    graphics->camera = *camera;
+
+    if (graphics->recorder)
+        recorder_write(graphics->recorder, RECORDING_CMD_CAMERA, camera, sizeof(*camera));
+}
+
+void graphics_set_post_settings(Graphics* graphics, const GraphicsPostSettings* settings) {
+    if (graphics->post == NULL)
+        return;
+
+    if (vk_defer(graphics, RECORDING_CMD_POST_SETTINGS, settings, sizeof(*settings)))
+        return;
+
+    post_chain_set(graphics->post, settings);
+
+    if (graphics->recorder)
+        recorder_write(graphics->recorder, RECORDING_CMD_POST_SETTINGS, settings, sizeof(*settings));
+}
+
+void graphics_update_particles(Graphics* graphics, const GraphicsParticleEmitter* emitter, float dt) {
+    if (graphics->particles == NULL)
+        return;
+
+    RecordedParticles particles = { *emitter, dt };
+    if (vk_defer(graphics, RECORDING_CMD_PARTICLES, &particles, sizeof(particles)))
+        return;
+
+    particles_update(graphics->particles, emitter, dt);
+
+    if (graphics->recorder)
+        recorder_write(graphics->recorder, RECORDING_CMD_PARTICLES, &particles, sizeof(particles));
+}
+
+GraphicsSpriteImage graphics_add_sprite_image(Graphics* graphics, const u8* pixels, u32 width, u32 height) {
+    if (vk_lock_renderer(graphics)) {
+        GraphicsSpriteImage image = graphics_add_sprite_image(graphics, pixels, width, height);
+        vk_unlock_renderer(graphics);
+        return image;
     }
 
-    vkDestroyCommandPool(graphics->device, graphics->command_pool, NULL);
+    GraphicsSpriteImage image = sprite_batch_add_image(graphics->sprites, pixels, width, height);
 
-    vkDestroyPipeline(graphics->device, graphics->graphics_pipeline, NULL);
-    vkDestroyPipelineLayout(graphics->device, graphics->pipeline_layout, NULL);
-    vkDestroyRenderPass(graphics->device, graphics->render_pass, NULL);
+    if (graphics->recorder && image != GRAPHICS_INVALID_SPRITE_IMAGE) {
+        RecordedSpriteImage header = { width, height };
+        recorder_begin(graphics->recorder, RECORDING_CMD_SPRITE_IMAGE, sizeof(header) + width * height * 4);
+        recorder_append(graphics->recorder, &header, sizeof(header));
+        recorder_append(graphics->recorder, pixels, (usize)width * height * 4);
+        recorder_end(graphics->recorder);
+    }
 
-    vk_cleanup_swapchain(graphics);
-    
-    vkDestroyDevice(graphics->device, NULL);
-    vkDestroySurfaceKHR(graphics->instance, graphics->surface, NULL);
+    return image;
+}
 
-#if defined(ZULK_DEBUG)
-    if (graphics->debug_messenger && vkDestroyDebugUtilsMessengerEXT)
-        vkDestroyDebugUtilsMessengerEXT(graphics->instance, graphics->debug_messenger, NULL);
-#endif
+GraphicsSpriteImage graphics_load_sprite_image(Graphics* graphics, const char* path) {
+    if (vk_lock_renderer(graphics)) {
+        GraphicsSpriteImage image = graphics_load_sprite_image(graphics, path);
+        vk_unlock_renderer(graphics);
+        return image;
+    }
 
-    vkDestroyInstance(graphics->instance, NULL);
+    GraphicsSpriteImage image = sprite_batch_load_image(graphics->sprites, path);
 
-    free(graphics);
+    if (graphics->recorder && image != GRAPHICS_INVALID_SPRITE_IMAGE)
+        recorder_write(graphics->recorder, RECORDING_CMD_SPRITE_TEXTURE, path, (u32)strlen(path) + 1);
+
+    return image;
 }
 
-void graphics_draw_frame(Graphics* graphics) {
-    vkWaitForFences(graphics->device, 1, &graphics->in_flight_fences[graphics->current_frame], VK_TRUE, UINT64_MAX);
+void graphics_draw_sprites(Graphics* graphics, const GraphicsSprite* sprites, u32 count) {
+    if (vk_defer(graphics, RECORDING_CMD_SPRITES, sprites, count * sizeof(GraphicsSprite)))
+        return;
+
+    sprite_batch_push(graphics->sprites, sprites, count);
+
+    if (graphics->recorder)
+        recorder_write(graphics->recorder, RECORDING_CMD_SPRITES, sprites, count * sizeof(GraphicsSprite));
+}
+
+GraphicsMesh graphics_load_mesh(Graphics* graphics, const char* path) {
+    if (vk_lock_renderer(graphics)) {
+        GraphicsMesh mesh = graphics_load_mesh(graphics, path);
+        vk_unlock_renderer(graphics);
+        return mesh;
+    }
+
+    GraphicsMesh mesh = mesh_renderer_load(graphics->meshes, path);
+
+    if (graphics->recorder && mesh != GRAPHICS_INVALID_MESH)
+        recorder_write(graphics->recorder, RECORDING_CMD_MESH, path, (u32)strlen(path) + 1);
+
+    return mesh;
+}
+
+void graphics_draw_mesh(Graphics* graphics, GraphicsMesh mesh, const float transform[16]) {
+    RecordedMeshDraw draw = { .mesh = mesh };
+    memcpy(draw.transform, transform, sizeof(draw.transform));
+
+    if (vk_defer(graphics, RECORDING_CMD_MESH_DRAW, &draw, sizeof(draw)))
+        return;
+
+    mesh_renderer_push(graphics->meshes, mesh, transform, false);
+
+    if (graphics->recorder)
+        recorder_write(graphics->recorder, RECORDING_CMD_MESH_DRAW, &draw, sizeof(draw));
+}
+
+void graphics_draw_static_mesh(Graphics* graphics, GraphicsMesh mesh, const float transform[16]) {
+    RecordedMeshDraw draw = { .mesh = mesh };
+    memcpy(draw.transform, transform, sizeof(draw.transform));
+
+    if (vk_defer(graphics, RECORDING_CMD_STATIC_MESH_DRAW, &draw, sizeof(draw)))
+        return;
+
+    mesh_renderer_push(graphics->meshes, mesh, transform, true);
+
+    if (graphics->recorder)
+        recorder_write(graphics->recorder, RECORDING_CMD_STATIC_MESH_DRAW, &draw, sizeof(draw));
+}
+
+void graphics_add_lights(Graphics* graphics, const GraphicsLight* lights, u32 count) {
+    if (vk_defer(graphics, RECORDING_CMD_LIGHTS, lights, count * sizeof(GraphicsLight)))
+        return;
+
+    light_clusters_push(graphics->lights, lights, count);
+
+    if (graphics->recorder)
+        recorder_write(graphics->recorder, RECORDING_CMD_LIGHTS, lights, count * sizeof(GraphicsLight));
+}
+
+bool graphics_start_recording(Graphics* graphics, const char* path) {
+    if (vk_lock_renderer(graphics)) {
+        bool result = graphics_start_recording(graphics, path);
+        vk_unlock_renderer(graphics);
+        return result;
+    }
+
+    graphics_stop_recording(graphics);
+
+    graphics->recorder = recorder_create(path);
+    if (graphics->recorder == NULL)
+        return false;
+
+    RecordedConfig config = {
+        .width = vk_main_window(graphics)->swapchain_extent.width,
+        .height = vk_main_window(graphics)->swapchain_extent.height,
+        .msaa_samples = graphics->msaa_samples,
+        .dynamic_resolution = graphics->dynamic_resolution,
+        .frame_budget_ms = graphics->drs.target_ms,
+        .shader_features = graphics->shader_features,
+        .max_particles = graphics->max_particles,
+        .post_processing = graphics->post != NULL,
+    };
+
+    recorder_write(graphics->recorder, RECORDING_CMD_CONFIG, &config, sizeof(config));
+    recorder_write(graphics->recorder, RECORDING_CMD_CAMERA, &graphics->camera, sizeof(graphics->camera));
+    if (graphics->post)
+        recorder_write(graphics->recorder, RECORDING_CMD_POST_SETTINGS, post_chain_settings(graphics->post), sizeof(GraphicsPostSettings));
+    sprite_batch_record_images(graphics->sprites, graphics->recorder);
+    mesh_renderer_record_meshes(graphics->meshes, graphics->recorder);
+    return true;
+}
+
+void graphics_stop_recording(Graphics* graphics) {
+    if (vk_lock_renderer(graphics)) {
+        graphics_stop_recording(graphics);
+        vk_unlock_renderer(graphics);
+        return;
+    }
+
+    if (graphics->recorder == NULL)
+        return;
+
+    recorder_destroy(graphics->recorder);
+    graphics->recorder = NULL;
+}
+
+/* recordings come from files, so a payload is only used if it's as large as its type needs and, for paths,
+ * NUL terminated. */
+static bool vk_replay_payload_valid(const RecordingCommand* command, const void* payload) {
+    switch (command->type) {
+        case RECORDING_CMD_SHADER_FEATURES:
+            return command->size >= sizeof(u32);
+
+        case RECORDING_CMD_SPRITE_IMAGE: {
+            if (command->size < sizeof(RecordedSpriteImage))
+                return false;
+
+            const RecordedSpriteImage* image = payload;
+            return (u64)image->width * image->height * 4 <= command->size - sizeof(RecordedSpriteImage);
+        }
+
+        case RECORDING_CMD_SPRITE_TEXTURE:
+        case RECORDING_CMD_MESH:
+            return command->size > 0 && ((const char*)payload)[command->size - 1] == '\0';
+
+        case RECORDING_CMD_CAMERA:
+            return command->size >= sizeof(GraphicsCamera);
+        case RECORDING_CMD_POST_SETTINGS:
+            return command->size >= sizeof(GraphicsPostSettings);
+        case RECORDING_CMD_PARTICLES:
+            return command->size >= sizeof(RecordedParticles);
+        case RECORDING_CMD_MESH_DRAW:
+        case RECORDING_CMD_STATIC_MESH_DRAW:
+            return command->size >= sizeof(RecordedMeshDraw);
+        case RECORDING_CMD_FRAME:
+            return command->size >= sizeof(RecordedFrame);
+
+        default:
+            return true;
+    }
+}
+
+void graphics_replay_command(Graphics* graphics, const RecordingCommand* command, const void* payload) {
+    if (!vk_replay_payload_valid(command, payload)) {
+        fprintf(stderr, "replay: skipping command %u with a malformed payload (%u bytes)\n", command->type, command->size);
+        return;
+    }
+
+    switch (command->type) {
+        case RECORDING_CMD_SHADER_FEATURES:
+            graphics_set_shader_features(graphics, *(const u32*)payload);
+            break;
+
+        case RECORDING_CMD_SPRITE_IMAGE: {
+            const RecordedSpriteImage* image = payload;
+            graphics_add_sprite_image(graphics, (const u8*)(image + 1), image->width, image->height);
+            break;
+        }
+
+        case RECORDING_CMD_SPRITE_TEXTURE:
+            graphics_load_sprite_image(graphics, payload);
+            break;
+
+        case RECORDING_CMD_CAMERA:
+            graphics_set_camera(graphics, payload);
+            break;
+
+        case RECORDING_CMD_POST_SETTINGS:
+            graphics_set_post_settings(graphics, payload);
+            break;
+
+        case RECORDING_CMD_PARTICLES: {
+            const RecordedParticles* particles = payload;
+            graphics_update_particles(graphics, &particles->emitter, particles->dt);
+            break;
+        }
+
+        case RECORDING_CMD_MESH:
+            graphics_load_mesh(graphics, payload);
+            break;
+
+        case RECORDING_CMD_MESH_DRAW: {
+            const RecordedMeshDraw* draw = payload;
+            graphics_draw_mesh(graphics, draw->mesh, draw->transform);
+            break;
+        }
+
+        case RECORDING_CMD_STATIC_MESH_DRAW: {
+            const RecordedMeshDraw* draw = payload;
+            graphics_draw_static_mesh(graphics, draw->mesh, draw->transform);
+            break;
+        }
+
+        case RECORDING_CMD_SPRITES:
+            graphics_draw_sprites(graphics, payload, command->size / sizeof(GraphicsSprite));
+            break;
+
+        case RECORDING_CMD_LIGHTS:
+            graphics_add_lights(graphics, payload, command->size / sizeof(GraphicsLight));
+            break;
+
+        case RECORDING_CMD_FRAME: {
+            const RecordedFrame* frame = payload;
+            graphics->replaying = true;
+
+            VulkanWindow* window = vk_main_window(graphics);
+            if (graphics->headless && (frame->width != window->swapchain_extent.width || frame->height != window->swapchain_extent.height)) {
+                graphics->headless_extent = (VkExtent2D) { frame->width, frame->height };
+                vk_recreate_swapchain(graphics, window);
+            }
+
+            if (graphics->dynamic_resolution) {
+                graphics->drs.scale = frame->render_scale;
+                vk_update_render_extent(graphics);
+            }
+
+            graphics_draw_frame(graphics);
+            break;
+        }
+
+        /* CONFIG was applied by initializing with recording_replay_config() */
+        default:
+            break;
+    }
+}
+
+void graphics_get_frame_stats(Graphics* graphics, GraphicsFrameStats* stats) {
+    if (vk_lock_renderer(graphics)) {
+        graphics_get_frame_stats(graphics, stats);
+        vk_unlock_renderer(graphics);
+        return;
+    }
 
-    u32 img_index;
-    VkResult res = vkAcquireNextImageKHR(graphics->device, graphics->swapchain, UINT64_MAX, graphics->image_available_semaphores[graphics->current_frame], VK_NULL_HANDLE, &img_index);
+    stats->frame_index = graphics->frame_index;
+    stats->gpu_ms = graphics->gpu_frame_ms;
+    stats->gpu_frame_index = graphics->gpu_frame_index;
 
-    if (res == VK_ERROR_OUT_OF_DATE_KHR) {
-        vk_recreate_swapchain(graphics);
+    stats->render_scale = graphics->dynamic_resolution ? graphics->drs.scale : 1.0f;
+    stats->render_width = graphics->render_extent.width;
+    stats->render_height = graphics->render_extent.height;
+
+    mesh_renderer_get_stats(graphics->meshes, &stats->mesh_triangles, &stats->mesh_triangles_drawn, &stats->mesh_instances_uploaded);
+    stats->lights = light_clusters_count(graphics->lights);
+    shadow_atlas_get_stats(graphics->shadows, &stats->shadows, &stats->shadow_faces_rendered);
+}
+
+void graphics_get_job_stats(Graphics* graphics, GraphicsJobStats* stats) {
+    jobs_get_stats(graphics->jobs, stats);
+}
+
+void graphics_get_memory_stats(Graphics* graphics, GraphicsMemoryStats* stats) {
+    if (vk_lock_renderer(graphics)) {
+        graphics_get_memory_stats(graphics, stats);
+        vk_unlock_renderer(graphics);
+        return;
+    }
+
+    VkDeviceSize allocated[VK_MAX_MEMORY_HEAPS];
+    gpu_memory_get_usage(allocated, stats->categories);
+
+    stats->heaps_count = graphics->memory_props.memoryHeapCount;
+    for (u32 i = 0; i < stats->heaps_count; ++i) {
+        stats->heaps[i].size = graphics->memory_props.memoryHeaps[i].size;
+        stats->heaps[i].budget = graphics->heap_budget[i];
+        stats->heaps[i].usage = graphics->heap_usage[i];
+        stats->heaps[i].allocated = allocated[i];
+        stats->heaps[i].device_local = graphics->memory_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    }
+
+    stats->evictions = graphics->residency.evictions;
+}
+
+bool graphics_start_capture(Graphics* graphics, const char* path, enum GraphicsCaptureFormat format, u32 frames) {
+    if (vk_lock_renderer(graphics)) {
+        bool result = graphics_start_capture(graphics, path, format, frames);
+        vk_unlock_renderer(graphics);
+        return result;
+    }
+
+    if (!graphics->capture_supported) {
+        fprintf(stderr, "the swapchain images can't be copied from, can't capture.\n");
+        return false;
+    }
+
+    graphics_stop_capture(graphics);
+
+    Capture* capture = capture_create(graphics->device, &graphics->memory_props, path, format, frames);
+    if (capture == NULL)
+        return false;
+
+    VulkanWindow* window = vk_main_window(graphics);
+    if (!capture_resize(capture, window->swapchain_extent, window->swapchain_format.format)) {
+        capture_destroy(capture);
+        return false;
+    }
+
+    /* the capture pass is only in the graph while capturing */
+    vkDeviceWaitIdle(graphics->device);
+    graphics->capture = capture;
+    vk_build_render_graph(graphics);
+
+    return true;
+}
+
+void graphics_stop_capture(Graphics* graphics) {
+    if (vk_lock_renderer(graphics)) {
+        graphics_stop_capture(graphics);
+        vk_unlock_renderer(graphics);
+        return;
+    }
+
+    if (graphics->capture == NULL)
+        return;
+
+    vkDeviceWaitIdle(graphics->device);
+    capture_destroy(graphics->capture);
+    graphics->capture = NULL;
+
+    vk_build_render_graph(graphics);
+}
+
+GraphicsWindow graphics_attach_surface(Graphics* graphics, Surface* surface) {
+    if (vk_lock_renderer(graphics)) {
+        GraphicsWindow result = graphics_attach_surface(graphics, surface);
+        vk_unlock_renderer(graphics);
+        return result;
+    }
+
+    /* without a main window the device has no swapchain support, and there is nothing to mirror */
+    if (graphics->headless)
+        return GRAPHICS_INVALID_WINDOW;
+
+    VulkanWindow* source = vk_main_window(graphics);
+    VkFormatProperties source_props;
+    vkGetPhysicalDeviceFormatProperties(graphics->gpu, source->swapchain_format.format, &source_props);
+
+    if (!graphics->capture_supported || !(source_props.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT)) {
+        fprintf(stderr, "the main window's swapchain images can't be blitted from, can't attach windows.\n");
+        return GRAPHICS_INVALID_WINDOW;
+    }
+
+    GraphicsWindow handle = GRAPHICS_INVALID_WINDOW;
+    for (u32 i = 1; i < GRAPHICS_MAX_WINDOWS && handle == GRAPHICS_INVALID_WINDOW; ++i) {
+        if (!graphics->windows[i].attached)
+            handle = i;
+    }
+
+    if (handle == GRAPHICS_INVALID_WINDOW) {
+        fprintf(stderr, "too many windows, at most %u can be presented to.\n", GRAPHICS_MAX_WINDOWS);
+        return GRAPHICS_INVALID_WINDOW;
+    }
+
+    VulkanWindow* window = &graphics->windows[handle];
+    *window = (VulkanWindow) {
+        .graphics = graphics,
+        .render_surface = surface,
+        .surface = surface_vk_create(surface, graphics->instance),
+    };
+
+    if (window->surface == VK_NULL_HANDLE)
+        return GRAPHICS_INVALID_WINDOW;
+
+    /* all windows are presented with one present, from the queue picked for the main window */
+    VkBool32 present_support = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(graphics->gpu, graphics->families.present_family, window->surface, &present_support);
+
+    vkDeviceWaitIdle(graphics->device);
+
+    if (!present_support || !vk_create_backbuffers(graphics, window)) {
+        fprintf(stderr, "the GPU can't present or blit to the surface, can't attach it.\n");
+        vkDestroySurfaceKHR(graphics->instance, window->surface, NULL);
+        return GRAPHICS_INVALID_WINDOW;
+    }
+
+    VkSemaphoreCreateInfo sem_info = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        ERR_CHECK(vkCreateSemaphore(graphics->device, &sem_info, NULL, &window->image_available_semaphores[i]), "img sem");
+
+    window->attached = true;
+    surface_set_data(surface, window);
+    surface_on_resize(surface, vk_surface_on_resize);
+
+    vk_build_render_graph(graphics);
+    return handle;
+}
+
+void graphics_detach_surface(Graphics* graphics, GraphicsWindow handle) {
+    if (vk_lock_renderer(graphics)) {
+        graphics_detach_surface(graphics, handle);
+        vk_unlock_renderer(graphics);
+        return;
+    }
+
+    if (handle == 0 || handle >= GRAPHICS_MAX_WINDOWS || !graphics->windows[handle].attached)
         return;
-    } else if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
-        ERR_CHECK(res, "swapchain acquirement failure");
+
+    VulkanWindow* window = &graphics->windows[handle];
+
+    vkDeviceWaitIdle(graphics->device);
+    surface_set_data(window->render_surface, NULL);
+    vk_destroy_window(graphics, window);
+
+    vk_build_render_graph(graphics);
+}
+
+static void vk_draw_frame(VulkanGraphics* graphics) {
+    {
+        TRACE_ZONE("vkWaitForFences");
+        vkWaitForFences(graphics->device, 1, &graphics->in_flight_fences[graphics->current_frame], VK_TRUE, UINT64_MAX);
+    }
+
+    /* nothing the GPU still reads was allocated from this frame's arena anymore */
+    arena_reset(vk_frame_arena(graphics));
+
+    if (graphics->capture) {
+        capture_frame_done(graphics->capture, graphics->current_frame);
+        if (capture_is_complete(graphics->capture))
+            graphics_stop_capture(graphics);
+    }
+
+    vk_read_gpu_timings(graphics);
+
+    /* before the residency frame moves on, so what the last frame used stays resident for this one */
+    if (graphics->frame_index % MEMORY_BUDGET_INTERVAL == 0)
+        vk_update_memory_budget(graphics);
+    residency_next_frame(&graphics->residency);
+
+    /* every window's image goes into the one submit below, so they're all acquired first */
+    VkSemaphoreSubmitInfo waits[GRAPHICS_MAX_WINDOWS + 1];
+    u32 waits_count = 0;
+
+    VkSwapchainKHR swapchains[GRAPHICS_MAX_WINDOWS];
+    u32 image_indices[GRAPHICS_MAX_WINDOWS];
+    VulkanWindow* presented[GRAPHICS_MAX_WINDOWS];
+    u32 presented_count = 0;
+
+    for (u32 i = 0; i < GRAPHICS_MAX_WINDOWS; ++i) {
+        VulkanWindow* window = &graphics->windows[i];
+        if (!window->attached)
+            continue;
+
+        /* headless, every frame in flight has its own target */
+        if (window->surface == VK_NULL_HANDLE) {
+            window->image_index = graphics->current_frame;
+            continue;
+        }
+
+        /* the windows before may already hold their images, so rather than skipping the frame the swapchain
+         * is recreated right away; that rebuilds the graph, which hasn't been recorded from yet. */
+        VkResult res;
+        {
+            TRACE_ZONE("vkAcquireNextImageKHR");
+            while ((res = vkAcquireNextImageKHR(graphics->device, window->swapchain, UINT64_MAX, window->image_available_semaphores[graphics->current_frame], VK_NULL_HANDLE, &window->image_index)) == VK_ERROR_OUT_OF_DATE_KHR) {
+                if (!vk_recreate_swapchain(graphics, window))
+                    break;
+            }
+        }
+
+        if (!window->attached)
+            continue;
+
+        if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
+            ERR_CHECK(res, "swapchain acquirement failure");
+        }
+
+        waits[waits_count++] = (VkSemaphoreSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = window->image_available_semaphores[graphics->current_frame],
+            .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        };
+
+        swapchains[presented_count] = window->swapchain;
+        image_indices[presented_count] = window->image_index;
+        presented[presented_count++] = window;
     }
 
     vkResetFences(graphics->device, 1, &graphics->in_flight_fences[graphics->current_frame]);
+
+    /* the in flight fence covers the compute work too: the graphics submit it guards waits for it whenever there
+     * was any, since every job has consumer stages. */
+    graphics->frame_index += 1;
+    VkPipelineStageFlags2 compute_consumers = vk_submit_async_compute(graphics);
+
+    if (graphics->recorder) {
+        RecordedFrame frame = {
+            .frame_index = graphics->frame_index,
+            .width = vk_main_window(graphics)->swapchain_extent.width,
+            .height = vk_main_window(graphics)->swapchain_extent.height,
+            .render_scale = graphics->dynamic_resolution ? graphics->drs.scale : 1.0f,
+        };
+
+        recorder_write(graphics->recorder, RECORDING_CMD_FRAME, &frame, sizeof(frame));
+    }
+
+    vk_update_camera(graphics);
+
+    VkPipelineStageFlags2 wait_stages = compute_consumers | (presented_count > 0 ? VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_2_NONE);
+
     vkResetCommandBuffer(graphics->command_buffers[graphics->current_frame], 0);
-    vk_record_command_buffer(graphics, graphics->command_buffers[graphics->current_frame], img_index);
+    vk_record_command_buffer(graphics, graphics->command_buffers[graphics->current_frame], wait_stages);
 
-    VkSubmitInfo submit = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = (VkSemaphore[]){ graphics->image_available_semaphores[graphics->current_frame] },
-        .pWaitDstStageMask = (VkPipelineStageFlags[]){ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT },
-        .commandBufferCount = 1,
-        .pCommandBuffers = &graphics->command_buffers[graphics->current_frame],
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = (VkSemaphore[]){ graphics->render_finished_semaphores[graphics->current_frame] },
+    VkSemaphoreSubmitInfo signals[2];
+    u32 signals_count = 0;
+
+    if (presented_count > 0) {
+        signals[signals_count++] = (VkSemaphoreSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = graphics->render_finished_semaphores[graphics->current_frame],
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        };
+    }
+
+    if (compute_consumers) {
+        waits[waits_count++] = (VkSemaphoreSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = graphics->compute_timeline,
+            .value = graphics->frame_index,
+            .stageMask = compute_consumers,
+        };
+    }
+
+    signals[signals_count++] = (VkSemaphoreSubmitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = graphics->graphics_timeline,
+        .value = graphics->frame_index,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+
+    VkSubmitInfo2 submit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .waitSemaphoreInfoCount = waits_count,
+        .pWaitSemaphoreInfos = waits,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &(VkCommandBufferSubmitInfo) { VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO, .commandBuffer = graphics->command_buffers[graphics->current_frame] },
+        .signalSemaphoreInfoCount = signals_count,
+        .pSignalSemaphoreInfos = signals,
     };
 
-    ERR_CHECK(vkQueueSubmit(graphics->graphics_queue, 1, &submit, graphics->in_flight_fences[graphics->current_frame]), "subm draw cmd buf");
+    {
+        TRACE_ZONE("vkQueueSubmit");
+        ERR_CHECK(vkQueueSubmit2(graphics->graphics_queue, 1, &submit, graphics->in_flight_fences[graphics->current_frame]), "subm draw cmd buf");
+    }
+
+    if (presented_count == 0) {
+        graphics->current_frame += 1;
+        graphics->current_frame %= MAX_FRAMES_IN_FLIGHT;
+        return;
+    }
 
+    VkResult results[GRAPHICS_MAX_WINDOWS];
     VkPresentInfoKHR present = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .waitSemaphoreCount = 1,
         .pWaitSemaphores = (VkSemaphore[]){ graphics->render_finished_semaphores[graphics->current_frame] },
 
-        .swapchainCount = 1,
-        .pSwapchains = (VkSwapchainKHR[]){ graphics->swapchain },
-        .pImageIndices = &img_index,
+        .swapchainCount = presented_count,
+        .pSwapchains = swapchains,
+        .pImageIndices = image_indices,
+        .pResults = results,
     };
 
-    res = vkQueuePresentKHR(graphics->present_queue, &present);
+    VkResult res;
+    {
+        TRACE_ZONE("vkQueuePresentKHR");
+        res = vkQueuePresentKHR(graphics->present_queue, &present);
+    }
 
-    if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || graphics->frame_resized_recently) {
-        graphics->frame_resized_recently = false;
-        vk_recreate_swapchain(graphics);
-    } else if (res != VK_SUCCESS) {
+    if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR && res != VK_ERROR_OUT_OF_DATE_KHR) {
         ERR_CHECK(res, "swapchain presentation failure");
     }
 
+    /* each window's own result tells which of them went out of date */
+    for (u32 i = 0; i < presented_count; ++i) {
+        VulkanWindow* window = presented[i];
+
+        if (results[i] == VK_ERROR_OUT_OF_DATE_KHR || results[i] == VK_SUBOPTIMAL_KHR || window->frame_resized_recently) {
+            window->frame_resized_recently = false;
+            vk_recreate_swapchain(graphics, window);
+        } else if (results[i] != VK_SUCCESS) {
+            ERR_CHECK(results[i], "swapchain presentation failure");
+        }
+    }
+
     graphics->current_frame += 1;
     graphics->current_frame %= MAX_FRAMES_IN_FLIGHT;
 }
+
+void graphics_draw_frame(Graphics* graphics) {
+    TRACE_FUNCTION();
+
+    /* the frame's commands go to the render thread, which renders them while the next frame is written */
+    if (graphics->commands && !vk_owns_renderer) {
+        command_stream_submit(graphics->commands);
+        return;
+    }
+
+    u64 heap_allocations = heap_allocations_count();
+
+    vk_draw_frame(graphics);
+
+    /* the frame loop allocates from the arenas only; debug builds count every heap allocation. */
+#if defined(ZULK_DEBUG)
+    if (heap_allocations_count() != heap_allocations) {
+        fprintf(stderr, "%llu heap allocations during a frame, use the frame arena\n", (unsigned long long)(heap_allocations_count() - heap_allocations));
+        abort();
+    }
+#endif
+}
@@ -2,10 +2,39 @@
 
 #include "types.h"
 
+#include <stdbool.h>
+
 typedef struct VulkanGraphics VulkanGraphics;
 // In the future possibly more APIs might be supported?
 typedef VulkanGraphics Graphics;
 
+// Toggles specialization constants of the main shaders; bit N sets `constant_id = N`.
+// Each combination gets its own pipeline, built only once it is used.
+enum ShaderFeature {
+    // Ignores the vertex colors and shades with a flat white.
+    SHADER_FEATURE_FLAT_COLOR = 1 << 0,
+    // Outputs the luminance of the color only.
+    SHADER_FEATURE_GRAYSCALE = 1 << 1,
+};
+
+// What device memory is used for; memory stats are broken down by these.
+enum GraphicsMemoryCategory {
+    GRAPHICS_MEMORY_RENDER_TARGETS,
+    GRAPHICS_MEMORY_TEXTURES,
+    GRAPHICS_MEMORY_BUFFERS,
+    GRAPHICS_MEMORY_STAGING,
+
+    GRAPHICS_MEMORY_CATEGORY_COUNT,
+};
+
+enum GraphicsCaptureFormat {
+    // RGBA8 pixels of every frame appended to one file; a named pipe works too,
+    // e.g. into `ffmpeg -f rawvideo -pixel_format rgba -video_size WxH -i pipe`.
+    GRAPHICS_CAPTURE_RAW,
+    // One QOI image per frame.
+    GRAPHICS_CAPTURE_QOI,
+};
+
 enum GPUPowerPreference {
     GRAPHICS_LOW_POWER,
     GRAPHICS_HIGH_PERFORMANCE,
@@ -29,14 +58,267 @@ typedef struct GraphicsConfiguration {
     // But some systems may only have one GPU, so then this option doesn't do anything.
     enum GPUPowerPreference power_preference;
 
+    // Samples per pixel for multisample anti-aliasing; 0 or 1 disables it.
+    // Clamped down to what the GPU supports.
+    u32 msaa_samples;
+
+    // Renders the scene at a resolution scale that adapts to the measured GPU frame time,
+    // and upscales it into the window.
+    bool dynamic_resolution;
+    // GPU time per frame that dynamic resolution aims for; 0 means 60 fps worth.
+    float frame_budget_ms;
+
+    // Renders the scene in HDR and turns it into the frame with bloom, tonemapping, sharpening and color
+    // grading, see graphics_set_post_settings(). Off on windows whose swapchain format it can't write.
+    bool post_processing;
+
+    // A mask of enum ShaderFeature the main pipeline starts with.
+    u32 shader_features;
+
+    // Capacity of the GPU particle system; 0 leaves it out.
+    u32 max_particles;
+
+    // An archive packed with tools/pack that assets are loaded from, unpacked in parallel at startup.
+    // Assets it doesn't have, or all of them when NULL, are loaded from loose files.
+    const char* asset_archive;
+
+    // NULL renders headless: no window and no presenting, into offscreen images of this size.
     struct Surface* render_surface;
+    u32 headless_width;
+    u32 headless_height;
+
+    // Renders on a thread of its own: the calls of a frame are queued as commands and rendered by that thread
+    // while the calling thread goes on with the next frame. Calls that return something, such as loading a mesh,
+    // wait for the frame being rendered to finish. Replaying a recording needs it off.
+    bool render_thread;
 } GraphicsConfiguration;
 
 #define MAX_ACCEPTED_PHYSICAL_DEVICE_COUNT (u32)32
 #define MAX_INSTANCE_EXTENSIONS_LOADED (u32)4096
 #define MAX_FRAMES_IN_FLIGHT (u32)2
+// The main window included.
+#define GRAPHICS_MAX_WINDOWS (u32)8
+#define GRAPHICS_MAX_MEMORY_HEAPS (u32)16
+
+typedef struct GraphicsCamera {
+    float position[3];
+    float target[3];
+    // Vertical field of view, in radians.
+    float fov_y;
+    float near_plane;
+    float far_plane;
+} GraphicsCamera;
+
+// How GraphicsConfiguration.post_processing turns the HDR scene into the frame.
+typedef struct GraphicsPostSettings {
+    // Multiplies the scene before tonemapping.
+    float exposure;
+    // Luminance above which the scene blooms, and how much of the bloom is added to it.
+    float bloom_threshold;
+    float bloom_intensity;
+    // 1 leaves the tonemapped colors as they are; 0 turns them gray.
+    float saturation;
+    // 1 leaves the tonemapped colors as they are; above 1 spreads them away from middle gray.
+    float contrast;
+    // Multiplies the tonemapped colors per channel.
+    float gain[3];
+    // Between 0 (off) and 1.
+    float sharpness;
+} GraphicsPostSettings;
+
+// Particles are emitted from a point, simulated and drawn entirely on the GPU.
+typedef struct GraphicsParticleEmitter {
+    float position[3];
+    // Particles emitted per second.
+    float rate;
+    float velocity[3];
+    // Random speed added in every direction, relative to the length of velocity.
+    float spread;
+    // Seconds a particle lives.
+    float lifetime;
+    // World units.
+    float size;
+    // Downwards acceleration.
+    float gravity;
+    // RGBA8 with R in the lowest byte; particles blend additively and fade out over their lifetime.
+    u32 color;
+} GraphicsParticleEmitter;
+
+// An image in the sprite atlas.
+typedef u32 GraphicsSpriteImage;
+#define GRAPHICS_INVALID_SPRITE_IMAGE (u32)UINT32_MAX
+
+typedef struct GraphicsSprite {
+    // Top left corner and size, in pixels of the window.
+    float x, y;
+    float width, height;
+    // Radians, clockwise around the center.
+    float rotation;
+    // Multiplied with the image; RGBA8 with R in the lowest byte, so 0xffffffff draws the image as is.
+    u32 color;
+    GraphicsSpriteImage image;
+    // Higher layers are drawn over lower ones. Within a layer, sprites on the same atlas page are
+    // drawn in the order they were submitted.
+    u16 layer;
+} GraphicsSprite;
+
+// A mesh cooked with tools/mesh_cooker.
+typedef u32 GraphicsMesh;
+#define GRAPHICS_INVALID_MESH (u32)UINT32_MAX
+
+// A window presented to besides the main one (GraphicsConfiguration.render_surface).
+typedef u32 GraphicsWindow;
+#define GRAPHICS_INVALID_WINDOW (u32)UINT32_MAX
+
+// A point light for the next frame, lighting the meshes.
+typedef struct GraphicsLight {
+    float position[3];
+    // World units; the light fades out to nothing at this distance.
+    float radius;
+    // Linear RGB.
+    float color[3];
+    float intensity;
+    // Nonzero for a light casting shadows from the meshes. Its shadow map is cached under this id from frame
+    // to frame, so keep it the same for as long as the light exists, and unique among the lights of a frame.
+    u32 shadow_id;
+} GraphicsLight;
+
+typedef struct GraphicsMemoryStats {
+    u32 heaps_count;
+    struct {
+        u64 size;
+        // How much the process can use before the driver starts paging. Without VK_EXT_memory_budget
+        // this is an estimate, and usage only counts the renderer's own allocations.
+        u64 budget;
+        u64 usage;
+        // The part of usage the renderer allocated itself.
+        u64 allocated;
+        bool device_local;
+    } heaps[GRAPHICS_MAX_MEMORY_HEAPS];
+
+    u64 categories[GRAPHICS_MEMORY_CATEGORY_COUNT];
+
+    // Resources downgraded or evicted by the residency manager, since start.
+    u32 evictions;
+} GraphicsMemoryStats;
 
 Graphics* graphics_initialize(GraphicsConfiguration* config);
 void graphics_deinitialize(Graphics* graphics);
 
 void graphics_draw_frame(Graphics* graphics);
+
+// Presents to another window from the same device: it shows the frame of the main window, scaled to fit.
+// Every window's swapchain image is rendered by the one submit of a frame and presented by one present.
+// Returns GRAPHICS_INVALID_WINDOW when headless, past GRAPHICS_MAX_WINDOWS, or if the GPU can't present
+// or blit to the surface.
+GraphicsWindow graphics_attach_surface(Graphics* graphics, struct Surface* surface);
+// Waits for the GPU; the surface is left to its owner.
+void graphics_detach_surface(Graphics* graphics, GraphicsWindow window);
+
+// Switches the main pipeline to another enum ShaderFeature mask, from the next frame on.
+// The first use of a mask builds its pipeline.
+void graphics_set_shader_features(Graphics* graphics, u32 features);
+
+void graphics_get_memory_stats(Graphics* graphics, GraphicsMemoryStats* stats);
+
+void graphics_set_camera(Graphics* graphics, const GraphicsCamera* camera);
+
+// From the next frame on; without a call, exposure 1, bloom threshold 1, bloom intensity 0.5, no grading
+// and sharpness 0.25. Does nothing without GraphicsConfiguration.post_processing.
+void graphics_set_post_settings(Graphics* graphics, const GraphicsPostSettings* settings);
+
+// Advances the particle simulation by `dt` seconds with the next frame. Without a call the particles freeze.
+void graphics_update_particles(Graphics* graphics, const GraphicsParticleEmitter* emitter, float dt);
+
+// Packs an RGBA8 (sRGB) image into the sprite atlas; the pixels are copied. Returns
+// GRAPHICS_INVALID_SPRITE_IMAGE if the atlas is full.
+GraphicsSpriteImage graphics_add_sprite_image(Graphics* graphics, const u8* pixels, u32 width, u32 height);
+// Loads a texture cooked by tools/texture_cooker into the sprite atlas, from the asset archive or a loose
+// file, transcoded to the block compression the GPU supports (BC, ETC2, or RGBA8 without either). Returns
+// GRAPHICS_INVALID_SPRITE_IMAGE if it can't be read or the atlas is full.
+GraphicsSpriteImage graphics_load_sprite_image(Graphics* graphics, const char* path);
+// Queues sprites for the next frame, drawn over the scene at window resolution. Sprites are batched into
+// one draw per run of the same atlas page, so drawing many is cheap.
+void graphics_draw_sprites(Graphics* graphics, const GraphicsSprite* sprites, u32 count);
+
+// Maps a cooked mesh file and uploads it; the file stays open while the mesh is loaded.
+// Returns GRAPHICS_INVALID_MESH if it can't be loaded.
+GraphicsMesh graphics_load_mesh(Graphics* graphics, const char* path);
+// Queues an instance of a mesh for the next frame; `transform` is a column major model matrix.
+// Every instance is drawn at the coarsest LOD that looks the same, without its meshlets that face away
+// from the camera or are out of view.
+void graphics_draw_mesh(Graphics* graphics, GraphicsMesh mesh, const float transform[16]);
+// Like graphics_draw_mesh(), for an instance that stays where it is: the shadows it casts are rendered once and
+// cached until it, or anything else static around the light, changes. Queue it every frame all the same.
+void graphics_draw_static_mesh(Graphics* graphics, GraphicsMesh mesh, const float transform[16]);
+
+// Queues point lights for the next frame; past a few thousand per frame (LIGHT_MAX_LIGHTS) they are dropped.
+// Lights are binned into a view space cluster grid on the GPU, so every pixel only pays for the lights near it.
+// Up to SHADOW_MAX_LIGHTS of them can cast shadows, see GraphicsLight.shadow_id.
+void graphics_add_lights(Graphics* graphics, const GraphicsLight* lights, u32 count);
+
+// Captures the next `frames` frames (0 = until graphics_stop_capture()) without stalling the GPU;
+// frames are dropped instead when the writer can't keep up. With QOI, a single frame is written
+// to `path` as is, and sequences to `path` followed by the frame number.
+// Returns false if the swapchain can't be captured or the output can't be opened.
+bool graphics_start_capture(Graphics* graphics, const char* path, enum GraphicsCaptureFormat format, u32 frames);
+// Writes out everything captured so far; waits for the GPU.
+void graphics_stop_capture(Graphics* graphics);
+
+// Records every following frame into a command stream file that tools/replay plays back
+// headless, as a repeatable benchmark. Returns false if the file can't be created.
+bool graphics_start_recording(Graphics* graphics, const char* path);
+void graphics_stop_recording(Graphics* graphics);
+
+typedef struct GraphicsFrameStats {
+    // Frames submitted so far.
+    u64 frame_index;
+
+    // GPU time of frame gpu_frame_index, which lags a few frames behind: the time its passes kept the GPU busy,
+    // without waiting for the swapchain image or async compute. 0 if it can't be measured.
+    float gpu_ms;
+    u64 gpu_frame_index;
+
+    float render_scale;
+    u32 render_width;
+    u32 render_height;
+
+    // Triangles of the meshes drawn in the last frame at full detail, and how many of them were left
+    // to draw after LOD selection and culling.
+    u64 mesh_triangles;
+    u64 mesh_triangles_drawn;
+    // Mesh instances whose transform changed in the last frame, the only ones uploaded to the GPU.
+    u32 mesh_instances_uploaded;
+
+    // Point lights of the last frame.
+    u32 lights;
+
+    // Shadow casting lights in view in the last frame, and the cube faces rendered for them; cached faces
+    // aren't rendered again until something around the light changes.
+    u32 shadows;
+    u32 shadow_faces_rendered;
+} GraphicsFrameStats;
+
+void graphics_get_frame_stats(Graphics* graphics, GraphicsFrameStats* stats);
+
+#define GRAPHICS_MAX_WORKERS (u32)32
+
+// The job system CPU work is spread over, one worker per hardware thread; worker 0 is the thread that
+// initialized the renderer, which only runs jobs while waiting for some.
+typedef struct GraphicsJobStats {
+    u32 workers_count;
+
+    struct {
+        // Jobs on the worker's queue now, and the most there were since the last call.
+        u32 queue_depth;
+        u32 peak_queue_depth;
+
+        // Since the last call: jobs run, how many of them were stolen from other workers' queues, and the
+        // time spent with nothing to run.
+        u64 jobs;
+        u64 steals;
+        float idle_ms;
+    } workers[GRAPHICS_MAX_WORKERS];
+} GraphicsJobStats;
+
+void graphics_get_job_stats(Graphics* graphics, GraphicsJobStats* stats);
@@ -0,0 +1,385 @@
+#pragma once
+
+/* renderer state shared between renderer.c and the subsystems built on top of it; not part of the public API. */
+
+#include "renderer.h"
+#include "surface.h"
+#include "render_graph.h"
+#include "drs.h"
+#include "shader_variants.h"
+#include "pipeline_layouts.h"
+#include "residency.h"
+#include "arena.h"
+#include "capture.h"
+#include "gpu_memory.h"
+#include "recording.h"
+#include "sprite_batch.h"
+#include "particles.h"
+#include "mesh.h"
+#include "lights.h"
+#include "shadows.h"
+#include "archive.h"
+#include "texture.h"
+#include "post.h"
+#include "jobs.h"
+#include "command_stream.h"
+#include "thread.h"
+#include "zmath.h"
+
+#include <volk.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define ERR_CHECK(x, m) do { VkResult r = x; if  (r != VK_SUCCESS) { fprintf(stderr, "\x1b[31m!!!CRITICAL ERROR!!! couldn't create %s: %d = %s; will crash !!!CRITICAL ERROR!!!\x1b[0m\n", m, r, vk_result_to_str(r)); exit(EXIT_FAILURE); } } while(0);
+
+static inline const char* vk_result_to_str(VkResult result) {
+    switch (result) {
+        case VK_SUCCESS:
+            return "Success";
+        case VK_NOT_READY:
+            return "Not ready";
+        case VK_TIMEOUT:
+            return "Timeout";
+        case VK_EVENT_SET:
+            return "Event set";
+        case VK_EVENT_RESET:
+            return "Event reset";
+        case VK_INCOMPLETE:
+            return "Incomplete";
+        case VK_ERROR_OUT_OF_HOST_MEMORY:
+            return "Out of host memory";
+        case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+            return "Out of device memory";
+        case VK_ERROR_INITIALIZATION_FAILED:
+            return "Initialization failed";
+        case VK_ERROR_DEVICE_LOST:
+            return "Device lost";
+        case VK_ERROR_MEMORY_MAP_FAILED:
+            return "Memory map failed";
+        case VK_ERROR_LAYER_NOT_PRESENT:
+            return "Layer not present";
+        case VK_ERROR_EXTENSION_NOT_PRESENT:
+            return "Extension not present";
+        case VK_ERROR_FEATURE_NOT_PRESENT:
+            return "Feature not present";
+        case VK_ERROR_INCOMPATIBLE_DRIVER:
+            return "Incompatible driver";
+        case VK_ERROR_TOO_MANY_OBJECTS:
+            return "Too many objects";
+        case VK_ERROR_FORMAT_NOT_SUPPORTED:
+            return "Format not supported";
+        case VK_ERROR_FRAGMENTED_POOL:
+            return "Fragmented pool";
+        case VK_ERROR_UNKNOWN:
+            return "Unknown error";
+        case VK_ERROR_OUT_OF_POOL_MEMORY:
+            return "Out of pool memory";
+        case VK_ERROR_INVALID_EXTERNAL_HANDLE:
+            return "Invalid external handle";
+        case VK_ERROR_FRAGMENTATION:
+            return "Fragmentation";
+        case VK_ERROR_INVALID_OPAQUE_CAPTURE_ADDRESS:
+            return "Invalid opaque capture address";
+        case VK_ERROR_SURFACE_LOST_KHR:
+            return "Surface lost";
+        case VK_ERROR_NATIVE_WINDOW_IN_USE_KHR:
+            return "Native window in use";
+        case VK_SUBOPTIMAL_KHR:
+            return "Suboptimal";
+        case VK_ERROR_OUT_OF_DATE_KHR:
+            return "Out of date";
+        case VK_ERROR_INCOMPATIBLE_DISPLAY_KHR:
+            return "Incompatible display";
+        case VK_ERROR_VALIDATION_FAILED_EXT:
+            return "Validation failed";
+        case VK_ERROR_INVALID_SHADER_NV:
+            return "Invalid shader";
+        case VK_ERROR_NOT_PERMITTED_EXT:
+            return "Not permitted";
+        case VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT:
+            return "Full screen exclusive mode lost";
+        case VK_THREAD_IDLE_KHR:
+            return "Thread idle";
+        case VK_THREAD_DONE_KHR:
+            return "Thread done";
+        case VK_OPERATION_DEFERRED_KHR:
+            return "Operation deferred";
+        case VK_OPERATION_NOT_DEFERRED_KHR:
+            return "Operation not deferred";
+        case VK_PIPELINE_COMPILE_REQUIRED_EXT:
+            return "Pipeline compile required";
+        default:
+            return "Unknown error code";
+    }
+}
+
+typedef struct QueueFamilies {
+    u32 graphics_family;
+    u32 present_family;
+    /* a compute-only family if the GPU has one, graphics_family otherwise */
+    u32 compute_family;
+
+    u32 found_families;
+} QueueFamilies;
+
+#define MAX_ASYNC_COMPUTE_JOBS (u32)8
+
+typedef void (*AsyncComputeRecordFunc)(VulkanGraphics* graphics, VkCommandBuffer command_buffer, void* data);
+
+/* compute work recorded every frame into the compute queue's command buffer. */
+typedef struct AsyncComputeJob {
+    const char* name;
+    AsyncComputeRecordFunc record;
+    void* data;
+
+    /* the graphics stages that consume what the job writes; the graphics queue waits for the compute
+     * queue only there, so everything before it overlaps with the compute work. */
+    VkPipelineStageFlags2 consumer_stages;
+} AsyncComputeJob;
+
+#define MAX_SWAPCHAIN_IMAGES (u32)8
+
+/* one at the start of the frame, then a begin and end per render graph pass */
+#define GPU_TIMESTAMPS_PER_FRAME (u32)(1 + RG_MAX_PASSES * 2)
+
+/* a surface frames are presented to. the first one is the main window, which the scene is rendered for
+ * (or, headless, its offscreen stand-in); the others get the main window's frame blitted into them. */
+typedef struct VulkanWindow {
+    bool attached;
+    VulkanGraphics* graphics;
+
+    /* NULL and VK_NULL_HANDLE headless */
+    Surface* render_surface;
+    VkSurfaceKHR surface;
+
+    VkSwapchainKHR swapchain;
+    VkExtent2D swapchain_extent;
+    VkSurfaceFormatKHR swapchain_format;
+
+    u32 swapchain_images_count;
+    u32 swapchain_views_count;
+
+    VkImage swapchain_images[MAX_SWAPCHAIN_IMAGES];
+    VkImageView swapchain_views[MAX_SWAPCHAIN_IMAGES];
+    /* headless only: the offscreen images in swapchain_images */
+    GpuAllocation offscreen_memory[MAX_SWAPCHAIN_IMAGES];
+
+    VkSemaphore image_available_semaphores[MAX_FRAMES_IN_FLIGHT];
+    /* the image acquired for the frame being recorded */
+    u32 image_index;
+
+    RenderGraphResource rg_backbuffer;
+
+    bool frame_resized_recently;
+} VulkanWindow;
+
+#define PERSISTENT_ARENA_SIZE ((usize)1 << 20)
+#define FRAME_ARENA_SIZE ((usize)1 << 20)
+
+struct VulkanGraphics {
+    /* holds this struct itself and whatever lives until deinit; init-time temporaries are rewound off it. */
+    Arena persistent_arena;
+    /* temporaries of a frame in flight, reset once its fence has signaled; see vk_frame_arena(). */
+    Arena frame_arenas[MAX_FRAMES_IN_FLIGHT];
+
+    /* the CPU work that scales with the scene, unpacking assets and culling, is spread over this */
+    JobSystem* jobs;
+
+    /* with a render thread, the calls of the API are written into this and played back by that thread, which
+     * holds render_mutex while it renders a frame; NULL without one. */
+    CommandStream* commands;
+    Thread render_thread;
+    Mutex render_mutex;
+
+    /* assets are looked up in here first, and loaded from loose files when it doesn't have them */
+    bool assets_open;
+    Archive assets;
+
+    VkInstance instance;
+
+    VkPhysicalDevice gpu;
+    VkPhysicalDeviceMemoryProperties memory_props;
+    VkDevice device;
+
+    /* refreshed every few frames by vk_update_memory_budget(). without VK_EXT_memory_budget the budget is
+     * estimated from the heap size and the usage only counts our own allocations. */
+    bool memory_budget_supported;
+    VkDeviceSize heap_budget[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heap_usage[VK_MAX_MEMORY_HEAPS];
+    u32 heaps_over_budget;
+    ResidencyManager residency;
+
+    VkQueue graphics_queue;
+    VkQueue present_queue;
+    /* the same queue as graphics_queue when there is no separate compute family */
+    VkQueue compute_queue;
+
+    /* without a render surface: no swapchain, frames go to offscreen images of the main window */
+    bool headless;
+    VkExtent2D headless_extent;
+
+    /* slots of GraphicsWindow handles; see vk_main_window() */
+    VulkanWindow windows[GRAPHICS_MAX_WINDOWS];
+
+    VkSampleCountFlagBits msaa_samples;
+    VkFormat depth_format;
+
+    /* the main window's swapchain images can be copied from; NULL capture when not capturing. the other
+     * windows are blitted from them too, so they need this as well. */
+    bool capture_supported;
+    Capture* capture;
+
+    /* rebuilt whenever a swapchain is or a window comes or goes; see vk_build_render_graph() */
+    RenderGraph* render_graph;
+    RenderGraphResource rg_depth;
+    /* RG_INVALID without MSAA */
+    RenderGraphResource rg_color_msaa;
+    /* what the scene is rendered into: the backbuffer itself, or the offscreen target with dynamic resolution
+     * or post-processing */
+    RenderGraphResource rg_scene;
+    /* RG_INVALID without post-processing; rg_post_output also when the composite writes the backbuffer */
+    RenderGraphResource rg_bloom;
+    RenderGraphResource rg_bloom_blurred;
+    RenderGraphResource rg_post_output;
+    /* RG_INVALID without occlusion culling, see mesh.h */
+    RenderGraphResource rg_occlusion_depth;
+    RenderGraphResource rg_hiz;
+
+    /* the part of the scene target that is rendered to; equals the main window's swapchain_extent without
+     * dynamic resolution */
+    VkExtent2D render_extent;
+    bool dynamic_resolution;
+    DynamicResolution drs;
+    /* for blits out of the main window's format, upscaling and into the other windows */
+    VkFilter upscale_filter;
+
+    /* NULL without post-processing, see post.h. post_processing is what was asked for, until the main window's
+     * swapchain turns out not to support it; post_direct if its images can be written by the composite. */
+    PostChain* post;
+    bool post_processing;
+    bool post_direct;
+    /* what the scene and every pipeline rendering into it use: POST_SCENE_FORMAT with post-processing,
+     * otherwise the main window's swapchain format */
+    VkFormat scene_format;
+
+    /* GPU_TIMESTAMPS_PER_FRAME per frame in flight; timestamp_period is 0 if the queue can't time. */
+    VkQueryPool timestamp_pool;
+    float timestamp_period;
+    bool timestamps_pending[MAX_FRAMES_IN_FLIGHT];
+    u32 timestamps_count[MAX_FRAMES_IN_FLIGHT];
+    u64 timestamp_frame_index[MAX_FRAMES_IN_FLIGHT];
+    float gpu_frame_ms;
+    /* the frame gpu_frame_ms was measured on */
+    u64 gpu_frame_index;
+
+    /* command stream recording; NULL when not recording. while replaying, the recording decides the
+     * render scale instead of dynamic resolution. */
+    Recorder* recorder;
+    bool replaying;
+
+    /* the reflected layouts, shared by every pipeline that is built from reflection */
+    PipelineLayoutCache layouts;
+
+    VkPipelineLayout pipeline_layout;
+    VkShaderModule main_vertex;
+    VkShaderModule main_fragment;
+    /* every ShaderFeature combination of the main pipeline that has been asked for */
+    PipelineVariants main_pipelines;
+    u32 shader_features;
+
+    SpriteBatch* sprites;
+    /* NULL without GraphicsConfiguration.max_particles */
+    ParticleSystem* particles;
+    u32 max_particles;
+
+    /* light and shadow the meshes, so they're created before them */
+    LightClusters* lights;
+    ShadowAtlas* shadows;
+    MeshRenderer* meshes;
+    /* multiDrawIndirect and drawIndirectFirstInstance, see vk_create_logical_dev() */
+    bool multi_draw_indirect;
+    /* the above, plus drawIndirectCount and a depth format that can be sampled */
+    bool occlusion_culling;
+    /* what cooked textures are transcoded into, see texture_select_target() */
+    enum TextureTarget texture_target;
+
+    /* the matrices are derived from the camera once per frame, see vk_update_camera() */
+    GraphicsCamera camera;
+    Mat4 view;
+    Mat4 projection;
+    Mat4 view_projection;
+
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT];
+
+    /* one for all windows, the single present waits for it */
+    VkSemaphore render_finished_semaphores[MAX_FRAMES_IN_FLIGHT];
+    VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT];
+
+    /* async compute. graphics_timeline reaches frame_index when that frame's graphics work is done and
+     * compute_timeline when its compute work is; buffers shared between the queues must be created
+     * with VK_SHARING_MODE_CONCURRENT if the families differ. */
+    VkCommandPool compute_command_pool;
+    VkCommandBuffer compute_command_buffers[MAX_FRAMES_IN_FLIGHT];
+    VkSemaphore graphics_timeline;
+    VkSemaphore compute_timeline;
+    u64 frame_index;
+
+    u32 async_compute_jobs_count;
+    AsyncComputeJob async_compute_jobs[MAX_ASYNC_COMPUTE_JOBS];
+
+    u32 current_frame;
+
+    /* TODO: don't store this here lol */
+    QueueFamilies families;
+
+#if defined(ZULK_DEBUG)
+    /* TODO: move this into optional structure? */
+    VkDebugUtilsMessengerEXT debug_messenger;
+#endif
+};
+
+/* loads SPIR-V from the asset archive, or from a file; failing to is fatal. */
+VkShaderModule vk_load_shader_module(VulkanGraphics* graphics, const char* path);
+
+/* reflects the SPIR-V of every shader in `paths` into one, see shader_reflect.h; failing to is fatal. the layouts
+ * made from it come from graphics->layouts, which owns them. */
+void vk_reflect_shaders(VulkanGraphics* graphics, const char* const* paths, u32 count, ShaderReflection* reflection);
+
+/* loads a compute shader and builds its pipeline, specialized with a ShaderFeature mask. */
+VkPipeline vk_create_compute_pipeline(VulkanGraphics* graphics, const char* path, VkPipelineLayout layout, u32 features);
+
+/* creates a device local buffer of `size` bytes with TRANSFER_DST usage added, without contents. returns
+ * VK_NULL_HANDLE if the memory can't be allocated. */
+VkBuffer vk_create_buffer(VulkanGraphics* graphics, VkBufferUsageFlags usage, VkDeviceSize size, GpuAllocation* memory);
+
+/* creates a host visible TRANSFER_SRC buffer holding `size` bytes of `data`, for copies recorded into a frame;
+ * the caller frees it once that frame is done. returns VK_NULL_HANDLE if the memory can't be allocated. */
+VkBuffer vk_create_staging_buffer(VulkanGraphics* graphics, const void* data, VkDeviceSize size, GpuAllocation* memory);
+
+/* creates a device local buffer holding `size` bytes of `data`. waits for the upload to finish, so it's for
+ * loading, not for frames. returns VK_NULL_HANDLE if the memory can't be allocated. */
+VkBuffer vk_create_buffer_with_data(VulkanGraphics* graphics, VkBufferUsageFlags usage, const void* data, VkDeviceSize size, GpuAllocation* memory);
+
+/* copies `size` bytes of `data` to `offset` in a buffer with TRANSFER_DST usage, the same way. returns false if
+ * the staging memory can't be allocated. */
+bool vk_upload_buffer(VulkanGraphics* graphics, VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+/* runs `record` on the compute queue every frame, before the graphics work of the same frame.
+ * the job may overwrite anything the previous frame's graphics work read. `consumer_stages` can't be NONE. */
+void vk_add_async_compute(VulkanGraphics* graphics, const char* name, AsyncComputeRecordFunc record, void* data, VkPipelineStageFlags2 consumer_stages);
+
+static inline u32 vk_dispatch_size(u32 items, u32 group_size) {
+    return (items + group_size - 1) / group_size;
+}
+
+static inline Arena* vk_frame_arena(VulkanGraphics* graphics) {
+    return &graphics->frame_arenas[graphics->current_frame];
+}
+
+/* the window the scene is rendered for and the pipelines are built against. */
+static inline VulkanWindow* vk_main_window(VulkanGraphics* graphics) {
+    return &graphics->windows[0];
+}
@@ -0,0 +1,108 @@
+#include "residency.h"
+
+void residency_init(ResidencyManager* manager) {
+    manager->frame = 0;
+    manager->evictions = 0;
+    manager->resources_count = 0;
+}
+
+ResidencyHandle residency_register(ResidencyManager* manager, const char* name, u32 heap, VkDeviceSize size, u32 priority, ResidencyEvictFunc evict, void* data) {
+    ResidencyHandle handle = RESIDENCY_INVALID;
+    for (u32 i = 0; i < manager->resources_count; ++i) {
+        if (!manager->resources[i].registered) {
+            handle = i;
+            break;
+        }
+    }
+
+    if (handle == RESIDENCY_INVALID) {
+        if (manager->resources_count >= RESIDENCY_MAX_RESOURCES)
+            return RESIDENCY_INVALID;
+
+        handle = manager->resources_count++;
+    }
+
+    manager->resources[handle] = (ResidencyResource) {
+        .name = name,
+        .heap = heap,
+        .size = size,
+        .priority = priority,
+        .last_used = manager->frame,
+        .evict = evict,
+        .data = data,
+        .registered = true,
+    };
+
+    return handle;
+}
+
+void residency_unregister(ResidencyManager* manager, ResidencyHandle handle) {
+    if (handle == RESIDENCY_INVALID)
+        return;
+
+    manager->resources[handle].registered = false;
+}
+
+void residency_touch(ResidencyManager* manager, ResidencyHandle handle) {
+    if (handle != RESIDENCY_INVALID)
+        manager->resources[handle].last_used = manager->frame;
+}
+
+void residency_set_size(ResidencyManager* manager, ResidencyHandle handle, VkDeviceSize size) {
+    if (handle != RESIDENCY_INVALID)
+        manager->resources[handle].size = size;
+}
+
+void residency_next_frame(ResidencyManager* manager) {
+    manager->frame++;
+}
+
+VkDeviceSize residency_free_up(ResidencyManager* manager, u32 heap, VkDeviceSize bytes) {
+    /* resources that refused to shrink during this call */
+    bool exhausted[RESIDENCY_MAX_RESOURCES] = { 0 };
+    VkDeviceSize freed = 0;
+
+    while (freed < bytes) {
+        ResidencyResource* victim = NULL;
+        u32 victim_index = 0;
+
+        for (u32 i = 0; i < manager->resources_count; ++i) {
+            ResidencyResource* res = &manager->resources[i];
+            if (!res->registered || exhausted[i] || res->heap != heap || res->size == 0 || res->last_used == manager->frame)
+                continue;
+
+            if (victim == NULL || res->priority < victim->priority || (res->priority == victim->priority && res->last_used < victim->last_used)) {
+                victim = res;
+                victim_index = i;
+            }
+        }
+
+        if (victim == NULL)
+            break;
+
+        VkDeviceSize heap_size = residency_heap_size(manager, heap);
+        VkDeviceSize old_size = victim->size;
+        VkDeviceSize size = victim->evict(victim->data);
+        if (size >= old_size) {
+            exhausted[victim_index] = true;
+            continue;
+        }
+
+        /* measured on the heap, since the eviction may have shrunk other resources of the owner there too */
+        victim->size = size;
+        freed += heap_size - residency_heap_size(manager, heap);
+        manager->evictions++;
+    }
+
+    return freed;
+}
+
+VkDeviceSize residency_heap_size(ResidencyManager* manager, u32 heap) {
+    VkDeviceSize size = 0;
+    for (u32 i = 0; i < manager->resources_count; ++i) {
+        if (manager->resources[i].registered && manager->resources[i].heap == heap)
+            size += manager->resources[i].size;
+    }
+
+    return size;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "types.h"
+
+#include <stdbool.h>
+#include <volk.h>
+
+/*
+ * Residency manager.
+ *
+ * Resources that can give memory back (textures that can drop mips, caches, streamed meshes, ...) register
+ * themselves with a priority. When a heap gets close to its budget, the renderer asks the manager to free
+ * memory there, and it shrinks the lowest priority, least recently used resources first.
+ */
+
+#define RESIDENCY_MAX_RESOURCES (u32)1024
+
+typedef u32 ResidencyHandle;
+
+#define RESIDENCY_INVALID (u32)UINT32_MAX
+
+/* shrinks the resource (drops mip levels, releases it entirely, ...) and returns its new size; returning the
+ * current size means it can't shrink any further. the GPU may still be using the old memory, so freeing it
+ * has to be deferred until the frames in flight are done. resources the owner releases along with it are
+ * resized with residency_set_size() from in here. */
+typedef VkDeviceSize (*ResidencyEvictFunc)(void* data);
+
+typedef struct ResidencyResource {
+    const char* name;
+    u32 heap;
+    VkDeviceSize size;
+
+    /* lower priorities are evicted first */
+    u32 priority;
+    u64 last_used;
+
+    ResidencyEvictFunc evict;
+    void* data;
+
+    bool registered;
+} ResidencyResource;
+
+typedef struct ResidencyManager {
+    u64 frame;
+    u32 evictions;
+
+    /* every slot below this has been used; unregistered ones are reused */
+    u32 resources_count;
+    ResidencyResource resources[RESIDENCY_MAX_RESOURCES];
+} ResidencyManager;
+
+void residency_init(ResidencyManager* manager);
+
+/* returns RESIDENCY_INVALID when full; the resource then just isn't managed. */
+ResidencyHandle residency_register(ResidencyManager* manager, const char* name, u32 heap, VkDeviceSize size, u32 priority, ResidencyEvictFunc evict, void* data);
+void residency_unregister(ResidencyManager* manager, ResidencyHandle handle);
+
+/* marks the resource as used by the frame being prepared. the renderer evicts between frames, before the next
+ * one starts, so what the last frame used is never evicted. */
+void residency_touch(ResidencyManager* manager, ResidencyHandle handle);
+/* for when the owner grows the resource back after the pressure is gone. */
+void residency_set_size(ResidencyManager* manager, ResidencyHandle handle, VkDeviceSize size);
+
+void residency_next_frame(ResidencyManager* manager);
+
+/* evicts resources on `heap` until `bytes` are freed or nothing can shrink any more; returns the bytes freed. */
+VkDeviceSize residency_free_up(ResidencyManager* manager, u32 heap, VkDeviceSize bytes);
+
+/* bytes on `heap` held by managed resources */
+VkDeviceSize residency_heap_size(ResidencyManager* manager, u32 heap);
@@ -0,0 +1,559 @@
+#include "shader_reflect.h"
+#include "arena.h"
+
+#include <string.h>
+
+#define SPIRV_MAGIC (u32)0x07230203
+/* from which the entry point lists every global variable it uses, not just its inputs and outputs */
+#define SPIRV_VERSION_1_4 (u32)0x00010400
+#define SPIRV_HEADER_WORDS (u32)5
+/* the most ids the SPIR-V limits allow */
+#define SPIRV_MAX_BOUND (u32)0x3fffff
+/* how deep types can nest before a module is taken as malformed */
+#define SPIRV_MAX_TYPE_DEPTH (u32)16
+
+enum SpirvOp {
+    SPIRV_OP_ENTRY_POINT = 15,
+    SPIRV_OP_TYPE_INT = 21,
+    SPIRV_OP_TYPE_FLOAT = 22,
+    SPIRV_OP_TYPE_VECTOR = 23,
+    SPIRV_OP_TYPE_MATRIX = 24,
+    SPIRV_OP_TYPE_IMAGE = 25,
+    SPIRV_OP_TYPE_SAMPLER = 26,
+    SPIRV_OP_TYPE_SAMPLED_IMAGE = 27,
+    SPIRV_OP_TYPE_ARRAY = 28,
+    SPIRV_OP_TYPE_RUNTIME_ARRAY = 29,
+    SPIRV_OP_TYPE_STRUCT = 30,
+    SPIRV_OP_TYPE_POINTER = 32,
+    SPIRV_OP_CONSTANT = 43,
+    SPIRV_OP_VARIABLE = 59,
+    SPIRV_OP_DECORATE = 71,
+    SPIRV_OP_MEMBER_DECORATE = 72,
+    SPIRV_OP_TYPE_ACCELERATION_STRUCTURE = 5341,
+};
+
+enum SpirvDecoration {
+    SPIRV_DECORATION_BLOCK = 2,
+    SPIRV_DECORATION_BUFFER_BLOCK = 3,
+    SPIRV_DECORATION_ARRAY_STRIDE = 6,
+    SPIRV_DECORATION_MATRIX_STRIDE = 7,
+    SPIRV_DECORATION_BUILT_IN = 11,
+    SPIRV_DECORATION_LOCATION = 30,
+    SPIRV_DECORATION_BINDING = 33,
+    SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+    SPIRV_DECORATION_OFFSET = 35,
+};
+
+enum SpirvStorageClass {
+    SPIRV_STORAGE_UNIFORM_CONSTANT = 0,
+    SPIRV_STORAGE_INPUT = 1,
+    SPIRV_STORAGE_UNIFORM = 2,
+    SPIRV_STORAGE_PUSH_CONSTANT = 9,
+    SPIRV_STORAGE_STORAGE_BUFFER = 12,
+};
+
+enum SpirvDim {
+    SPIRV_DIM_BUFFER = 5,
+    SPIRV_DIM_SUBPASS_DATA = 6,
+};
+
+#define SPIRV_ID_SET (u32)1
+#define SPIRV_ID_BINDING (u32)2
+#define SPIRV_ID_LOCATION (u32)4
+#define SPIRV_ID_BLOCK (u32)8
+#define SPIRV_ID_BUFFER_BLOCK (u32)16
+#define SPIRV_ID_BUILT_IN (u32)32
+#define SPIRV_ID_INTERFACE (u32)64
+
+/* what reflection needs to know of a result id */
+typedef struct SpirvId {
+    /* the instruction defining it; 0, the header, if none does */
+    u32 word;
+    u32 flags;
+    u32 set;
+    u32 binding;
+    u32 location;
+    u32 array_stride;
+} SpirvId;
+
+typedef struct SpirvModule {
+    const u32* words;
+    u32 word_count;
+    SpirvId* ids;
+    u32 bound;
+} SpirvModule;
+
+static inline u32 spirv_opcode(u32 word) {
+    return word & 0xffff;
+}
+
+/* the instruction defining `id`, or NULL if there is none or it has fewer than `min_words` words. */
+static const u32* spirv_def(const SpirvModule* module, u32 id, u32 min_words) {
+    if (id >= module->bound || module->ids[id].word == 0)
+        return NULL;
+
+    const u32* instruction = &module->words[module->ids[id].word];
+    return instruction[0] >> 16 >= min_words ? instruction : NULL;
+}
+
+static bool spirv_member_decoration(const SpirvModule* module, u32 type, u32 member, u32 decoration, u32* value) {
+    for (u32 i = SPIRV_HEADER_WORDS; i < module->word_count; i += module->words[i] >> 16) {
+        const u32* instruction = &module->words[i];
+        if (spirv_opcode(instruction[0]) == SPIRV_OP_MEMBER_DECORATE && instruction[0] >> 16 >= 5
+            && instruction[1] == type && instruction[2] == member && instruction[3] == decoration) {
+            *value = instruction[4];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* the value of a 32 bit integer constant, 0 if `id` isn't one. */
+static u32 spirv_constant(const SpirvModule* module, u32 id) {
+    const u32* instruction = spirv_def(module, id, 4);
+    return instruction && spirv_opcode(instruction[0]) == SPIRV_OP_CONSTANT ? instruction[3] : 0;
+}
+
+/* bytes a type takes in an explicitly laid out block; matrix_stride is the member's, 0 if it has none. */
+static u32 spirv_type_size(const SpirvModule* module, u32 type, u32 matrix_stride, u32 depth) {
+    const u32* instruction = spirv_def(module, type, 2);
+    if (instruction == NULL || depth > SPIRV_MAX_TYPE_DEPTH)
+        return 0;
+
+    switch (spirv_opcode(instruction[0])) {
+        case SPIRV_OP_TYPE_INT:
+        case SPIRV_OP_TYPE_FLOAT:
+            return instruction[0] >> 16 >= 3 ? instruction[2] / 8 : 0;
+
+        case SPIRV_OP_TYPE_VECTOR:
+            return instruction[0] >> 16 >= 4 ? instruction[3] * spirv_type_size(module, instruction[2], 0, depth + 1) : 0;
+
+        case SPIRV_OP_TYPE_MATRIX:
+            if (instruction[0] >> 16 < 4)
+                return 0;
+            return instruction[3] * (matrix_stride ? matrix_stride : spirv_type_size(module, instruction[2], 0, depth + 1));
+
+        case SPIRV_OP_TYPE_ARRAY: {
+            if (instruction[0] >> 16 < 4)
+                return 0;
+            u32 stride = module->ids[type].array_stride;
+            if (stride == 0)
+                stride = spirv_type_size(module, instruction[2], matrix_stride, depth + 1);
+            return spirv_constant(module, instruction[3]) * stride;
+        }
+
+        case SPIRV_OP_TYPE_STRUCT: {
+            u32 end = 0;
+            for (u32 member = 0; member + 2 < instruction[0] >> 16; ++member) {
+                u32 offset = 0, member_stride = 0;
+                spirv_member_decoration(module, type, member, SPIRV_DECORATION_OFFSET, &offset);
+                spirv_member_decoration(module, type, member, SPIRV_DECORATION_MATRIX_STRIDE, &member_stride);
+
+                u32 member_end = offset + spirv_type_size(module, instruction[2 + member], member_stride, depth + 1);
+                if (member_end > end)
+                    end = member_end;
+            }
+            return end;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+/* the range of a push constant block, from its first member to the end of its last. */
+static bool spirv_push_constants(const SpirvModule* module, u32 type, VkShaderStageFlags stage, VkPushConstantRange* range) {
+    const u32* instruction = spirv_def(module, type, 3);
+    if (instruction == NULL || spirv_opcode(instruction[0]) != SPIRV_OP_TYPE_STRUCT)
+        return false;
+
+    u32 begin = UINT32_MAX;
+    for (u32 member = 0; member + 2 < instruction[0] >> 16; ++member) {
+        u32 offset = 0;
+        spirv_member_decoration(module, type, member, SPIRV_DECORATION_OFFSET, &offset);
+        if (offset < begin)
+            begin = offset;
+    }
+
+    u32 end = spirv_type_size(module, type, 0, 0);
+    if (end <= begin)
+        return false;
+
+    *range = (VkPushConstantRange) { stage, begin, end - begin };
+    return true;
+}
+
+static VkFormat spirv_input_format(const SpirvModule* module, u32 type) {
+    static const VkFormat formats[3][4] = {
+        { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+        { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT },
+        { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT },
+    };
+
+    u32 components = 1;
+    const u32* instruction = spirv_def(module, type, 2);
+    if (instruction && spirv_opcode(instruction[0]) == SPIRV_OP_TYPE_VECTOR && instruction[0] >> 16 >= 4) {
+        components = instruction[3];
+        instruction = spirv_def(module, instruction[2], 2);
+    }
+
+    if (instruction == NULL || components < 1 || components > 4)
+        return VK_FORMAT_UNDEFINED;
+
+    u32 op = spirv_opcode(instruction[0]);
+    if (instruction[0] >> 16 < 3 || instruction[2] != 32)
+        return VK_FORMAT_UNDEFINED;
+
+    if (op == SPIRV_OP_TYPE_FLOAT)
+        return formats[0][components - 1];
+    if (op == SPIRV_OP_TYPE_INT && instruction[0] >> 16 >= 4)
+        return formats[instruction[3] ? 1 : 2][components - 1];
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+/* the descriptor type of a resource variable, with arrays of them counted into `count`; false if it's none. */
+static bool spirv_descriptor(const SpirvModule* module, u32 type, u32 storage, VkDescriptorType* descriptor, u32* count) {
+    *count = 1;
+
+    const u32* instruction = spirv_def(module, type, 2);
+    for (u32 depth = 0; instruction && spirv_opcode(instruction[0]) == SPIRV_OP_TYPE_ARRAY; ++depth) {
+        u32 length = instruction[0] >> 16 >= 4 ? spirv_constant(module, instruction[3]) : 0;
+        if (length == 0 || depth > SPIRV_MAX_TYPE_DEPTH)
+            return false;
+
+        *count *= length;
+        type = instruction[2];
+        instruction = spirv_def(module, type, 2);
+    }
+
+    if (instruction == NULL)
+        return false;
+
+    switch (spirv_opcode(instruction[0])) {
+        case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+            *descriptor = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            return true;
+
+        case SPIRV_OP_TYPE_SAMPLER:
+            *descriptor = VK_DESCRIPTOR_TYPE_SAMPLER;
+            return true;
+
+        case SPIRV_OP_TYPE_ACCELERATION_STRUCTURE:
+            *descriptor = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+            return true;
+
+        case SPIRV_OP_TYPE_IMAGE: {
+            if (instruction[0] >> 16 < 9)
+                return false;
+
+            /* Sampled is 2 for storage images, 1 for sampled ones */
+            u32 dim = instruction[3];
+            bool storage_image = instruction[7] == 2;
+            if (dim == SPIRV_DIM_BUFFER)
+                *descriptor = storage_image ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            else if (dim == SPIRV_DIM_SUBPASS_DATA)
+                *descriptor = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            else
+                *descriptor = storage_image ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            return true;
+        }
+
+        case SPIRV_OP_TYPE_STRUCT:
+            /* before SPIR-V 1.3, storage buffers are uniform BufferBlocks */
+            if (storage == SPIRV_STORAGE_STORAGE_BUFFER || (module->ids[type].flags & SPIRV_ID_BUFFER_BLOCK))
+                *descriptor = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            else
+                *descriptor = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static VkShaderStageFlags spirv_stage(u32 execution_model) {
+    switch (execution_model) {
+        case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+        default: return 0;
+    }
+}
+
+/* records the result ids, decorations and the first entry point's interface; false if the module is malformed. */
+static bool spirv_index(SpirvModule* module, VkShaderStageFlags* stage) {
+    *stage = 0;
+
+    for (u32 i = SPIRV_HEADER_WORDS; i < module->word_count; ) {
+        const u32* instruction = &module->words[i];
+        u32 length = instruction[0] >> 16;
+        if (length == 0 || i + length > module->word_count)
+            return false;
+
+        u32 op = spirv_opcode(instruction[0]);
+        u32 result = UINT32_MAX;
+        switch (op) {
+            case SPIRV_OP_TYPE_INT:
+            case SPIRV_OP_TYPE_FLOAT:
+            case SPIRV_OP_TYPE_VECTOR:
+            case SPIRV_OP_TYPE_MATRIX:
+            case SPIRV_OP_TYPE_IMAGE:
+            case SPIRV_OP_TYPE_SAMPLER:
+            case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+            case SPIRV_OP_TYPE_ARRAY:
+            case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+            case SPIRV_OP_TYPE_STRUCT:
+            case SPIRV_OP_TYPE_POINTER:
+            case SPIRV_OP_TYPE_ACCELERATION_STRUCTURE:
+                result = length >= 2 ? instruction[1] : UINT32_MAX;
+                break;
+
+            case SPIRV_OP_CONSTANT:
+            case SPIRV_OP_VARIABLE:
+                result = length >= 3 ? instruction[2] : UINT32_MAX;
+                break;
+
+            case SPIRV_OP_ENTRY_POINT: {
+                if (*stage != 0 || length < 4)
+                    break;
+
+                *stage = spirv_stage(instruction[1]);
+
+                /* the name is a NUL terminated string padded to whole words; the interface ids follow it */
+                u32 word = 3;
+                while (word < length && (instruction[word] >> 24) != 0)
+                    ++word;
+
+                for (++word; word < length; ++word) {
+                    if (instruction[word] < module->bound)
+                        module->ids[instruction[word]].flags |= SPIRV_ID_INTERFACE;
+                }
+                break;
+            }
+
+            case SPIRV_OP_DECORATE: {
+                if (length < 3 || instruction[1] >= module->bound)
+                    break;
+
+                SpirvId* id = &module->ids[instruction[1]];
+                u32 value = length >= 4 ? instruction[3] : 0;
+                switch (instruction[2]) {
+                    case SPIRV_DECORATION_BLOCK: id->flags |= SPIRV_ID_BLOCK; break;
+                    case SPIRV_DECORATION_BUFFER_BLOCK: id->flags |= SPIRV_ID_BUFFER_BLOCK; break;
+                    case SPIRV_DECORATION_BUILT_IN: id->flags |= SPIRV_ID_BUILT_IN; break;
+                    case SPIRV_DECORATION_ARRAY_STRIDE: id->array_stride = value; break;
+                    case SPIRV_DECORATION_LOCATION: id->flags |= SPIRV_ID_LOCATION; id->location = value; break;
+                    case SPIRV_DECORATION_BINDING: id->flags |= SPIRV_ID_BINDING; id->binding = value; break;
+                    case SPIRV_DECORATION_DESCRIPTOR_SET: id->flags |= SPIRV_ID_SET; id->set = value; break;
+                }
+                break;
+            }
+        }
+
+        if (result != UINT32_MAX) {
+            if (result >= module->bound)
+                return false;
+            module->ids[result].word = i;
+        }
+
+        i += length;
+    }
+
+    return *stage != 0;
+}
+
+static void shader_reflect_sort(ShaderReflection* reflection) {
+    for (u32 i = 1; i < reflection->binding_count; ++i) {
+        ReflectedBinding binding = reflection->bindings[i];
+        u32 j = i;
+        for (; j > 0; --j) {
+            const ReflectedBinding* before = &reflection->bindings[j - 1];
+            if (before->set < binding.set || (before->set == binding.set && before->binding < binding.binding))
+                break;
+            reflection->bindings[j] = *before;
+        }
+        reflection->bindings[j] = binding;
+    }
+
+    for (u32 i = 1; i < reflection->input_count; ++i) {
+        ReflectedInput input = reflection->inputs[i];
+        u32 j = i;
+        for (; j > 0 && reflection->inputs[j - 1].location > input.location; --j)
+            reflection->inputs[j] = reflection->inputs[j - 1];
+        reflection->inputs[j] = input;
+    }
+}
+
+static bool shader_reflect_variable(const SpirvModule* module, const u32* variable, bool all_listed, ShaderReflection* reflection) {
+    u32 id = variable[2];
+    u32 storage = variable[3];
+    const SpirvId* info = &module->ids[id];
+
+    /* before 1.4 only inputs and outputs are listed; resources the entry point doesn't use are reflected too then */
+    if (all_listed && !(info->flags & SPIRV_ID_INTERFACE))
+        return true;
+
+    const u32* pointer = spirv_def(module, variable[1], 4);
+    if (pointer == NULL || spirv_opcode(pointer[0]) != SPIRV_OP_TYPE_POINTER)
+        return false;
+    u32 type = pointer[3];
+
+    switch (storage) {
+        case SPIRV_STORAGE_INPUT: {
+            if (reflection->stages != VK_SHADER_STAGE_VERTEX_BIT || (info->flags & SPIRV_ID_BUILT_IN) || !(info->flags & SPIRV_ID_LOCATION))
+                return true;
+
+            VkFormat format = spirv_input_format(module, type);
+            if (format == VK_FORMAT_UNDEFINED || reflection->input_count >= REFLECT_MAX_INPUTS)
+                return false;
+
+            reflection->inputs[reflection->input_count++] = (ReflectedInput) { info->location, format };
+            return true;
+        }
+
+        case SPIRV_STORAGE_PUSH_CONSTANT:
+            return spirv_push_constants(module, type, reflection->stages, &reflection->push_constants);
+
+        case SPIRV_STORAGE_UNIFORM_CONSTANT:
+        case SPIRV_STORAGE_UNIFORM:
+        case SPIRV_STORAGE_STORAGE_BUFFER: {
+            if (!(info->flags & SPIRV_ID_SET) || !(info->flags & SPIRV_ID_BINDING))
+                return false;
+            if (info->set >= REFLECT_MAX_SETS || reflection->binding_count >= REFLECT_MAX_BINDINGS)
+                return false;
+
+            ReflectedBinding* binding = &reflection->bindings[reflection->binding_count++];
+            binding->set = info->set;
+            binding->binding = info->binding;
+            binding->stages = reflection->stages;
+            return spirv_descriptor(module, type, storage, &binding->type, &binding->count);
+        }
+
+        default:
+            return true;
+    }
+}
+
+bool shader_reflect(const byte* code, usize size, ShaderReflection* reflection) {
+    memset(reflection, 0, sizeof(*reflection));
+
+    if (size % sizeof(u32) != 0 || size < SPIRV_HEADER_WORDS * sizeof(u32))
+        return false;
+
+    /* the code may not be aligned, inside of an archive */
+    SpirvModule module = { .word_count = (u32)(size / sizeof(u32)) };
+    u32* words = heap_alloc(size);
+    memcpy(words, code, size);
+    module.words = words;
+
+    module.bound = words[3];
+    bool ok = words[0] == SPIRV_MAGIC && module.bound > 0 && module.bound <= SPIRV_MAX_BOUND;
+    if (ok) {
+        module.ids = heap_calloc(module.bound, sizeof(SpirvId));
+        ok = spirv_index(&module, &reflection->stages);
+    }
+
+    bool all_listed = words[1] >= SPIRV_VERSION_1_4;
+    for (u32 i = SPIRV_HEADER_WORDS; ok && i < module.word_count; i += words[i] >> 16) {
+        if (spirv_opcode(words[i]) == SPIRV_OP_VARIABLE && words[i] >> 16 >= 4)
+            ok = shader_reflect_variable(&module, &words[i], all_listed, reflection);
+    }
+
+    if (module.ids)
+        heap_free(module.ids);
+    heap_free(words);
+
+    shader_reflect_sort(reflection);
+    return ok;
+}
+
+bool shader_reflect_merge(ShaderReflection* reflection, const ShaderReflection* stage) {
+    for (u32 i = 0; i < stage->binding_count; ++i) {
+        const ReflectedBinding* binding = &stage->bindings[i];
+
+        u32 j = 0;
+        while (j < reflection->binding_count && (reflection->bindings[j].set != binding->set || reflection->bindings[j].binding != binding->binding))
+            ++j;
+
+        if (j < reflection->binding_count) {
+            ReflectedBinding* existing = &reflection->bindings[j];
+            if (existing->type != binding->type || existing->count != binding->count)
+                return false;
+            existing->stages |= binding->stages;
+        } else {
+            if (reflection->binding_count >= REFLECT_MAX_BINDINGS)
+                return false;
+            reflection->bindings[reflection->binding_count++] = *binding;
+        }
+    }
+
+    /* one range over what every stage declares, visible to all of them; this keeps vkCmdPushConstants() simple */
+    if (stage->push_constants.stageFlags) {
+        VkPushConstantRange* range = &reflection->push_constants;
+        if (range->stageFlags == 0) {
+            *range = stage->push_constants;
+        } else {
+            u32 begin = range->offset < stage->push_constants.offset ? range->offset : stage->push_constants.offset;
+            u32 end = range->offset + range->size;
+            if (stage->push_constants.offset + stage->push_constants.size > end)
+                end = stage->push_constants.offset + stage->push_constants.size;
+
+            *range = (VkPushConstantRange) { range->stageFlags | stage->push_constants.stageFlags, begin, end - begin };
+        }
+    }
+
+    if (stage->stages & VK_SHADER_STAGE_VERTEX_BIT) {
+        reflection->input_count = stage->input_count;
+        memcpy(reflection->inputs, stage->inputs, sizeof(stage->inputs));
+    }
+
+    reflection->stages |= stage->stages;
+    shader_reflect_sort(reflection);
+    return true;
+}
+
+u32 shader_reflect_set_count(const ShaderReflection* reflection) {
+    return reflection->binding_count > 0 ? reflection->bindings[reflection->binding_count - 1].set + 1 : 0;
+}
+
+u32 shader_reflect_pool_sizes(const ShaderReflection* reflection, u32 set, u32 sets, VkDescriptorPoolSize* sizes) {
+    u32 count = 0;
+    for (u32 i = 0; i < reflection->binding_count; ++i) {
+        const ReflectedBinding* binding = &reflection->bindings[i];
+        if (binding->set != set)
+            continue;
+
+        u32 j = 0;
+        while (j < count && sizes[j].type != binding->type)
+            ++j;
+
+        if (j == count)
+            sizes[count++] = (VkDescriptorPoolSize) { binding->type, 0 };
+        sizes[j].descriptorCount += binding->count * sets;
+    }
+
+    return count;
+}
+
+u32 shader_reflect_vertex_attributes(const ShaderReflection* reflection, u32 binding, const u32* offsets, u32 offset_count, VkVertexInputAttributeDescription* attributes) {
+    u32 count = 0;
+    for (u32 i = 0; i < reflection->input_count; ++i) {
+        const ReflectedInput* input = &reflection->inputs[i];
+        if (input->location >= offset_count)
+            continue;
+
+        attributes[count++] = (VkVertexInputAttributeDescription) {
+            .location = input->location,
+            .binding = binding,
+            .format = input->format,
+            .offset = offsets[input->location],
+        };
+    }
+
+    return count;
+}
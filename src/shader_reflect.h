@@ -0,0 +1,67 @@
+#pragma once
+
+#include "types.h"
+
+#include <stdbool.h>
+#include <volk.h>
+
+/*
+ * SPIR-V reflection.
+ *
+ * Reads what a shader module declares straight from its SPIR-V when it's loaded: the descriptor bindings, the
+ * push constant block and the vertex inputs. Only what the entry point actually uses is reflected (SPIR-V 1.4
+ * and up list it, which vulkan1.3 targets are), so the layouts made from it are as narrow as the shaders allow:
+ * every binding is only visible to the stages that use it. The stages of a pipeline, or every shader binding
+ * the same descriptor sets, are merged into one reflection; pipeline_layouts.h turns that into layouts.
+ */
+
+#define REFLECT_MAX_SETS (u32)4
+#define REFLECT_MAX_BINDINGS (u32)32
+#define REFLECT_MAX_INPUTS (u32)16
+
+typedef struct ReflectedBinding {
+    u32 set;
+    u32 binding;
+    VkDescriptorType type;
+    /* array length, 1 for a single descriptor */
+    u32 count;
+    VkShaderStageFlags stages;
+} ReflectedBinding;
+
+typedef struct ReflectedInput {
+    u32 location;
+    /* the 32 bit format of the declared type */
+    VkFormat format;
+} ReflectedInput;
+
+typedef struct ShaderReflection {
+    VkShaderStageFlags stages;
+
+    /* sorted by set, then binding */
+    u32 binding_count;
+    ReflectedBinding bindings[REFLECT_MAX_BINDINGS];
+
+    /* from the first to the last byte of the block; stageFlags is 0 without one */
+    VkPushConstantRange push_constants;
+
+    /* the vertex stage's, sorted by location */
+    u32 input_count;
+    ReflectedInput inputs[REFLECT_MAX_INPUTS];
+} ShaderReflection;
+
+/* returns false if `code` isn't SPIR-V, or declares something that can't be reflected (runtime descriptor arrays,
+ * inputs that aren't 32 bit scalars or vectors, more than the REFLECT_MAX_* of something). */
+bool shader_reflect(const byte* code, usize size, ShaderReflection* reflection);
+
+/* adds the stage to `reflection`, which starts zeroed. returns false if both declare a binding differently. */
+bool shader_reflect_merge(ShaderReflection* reflection, const ShaderReflection* stage);
+
+/* one more than the highest set with a binding. */
+u32 shader_reflect_set_count(const ShaderReflection* reflection);
+
+/* the pool sizes for `sets` of one set's layout, a size per descriptor type; returns how many. */
+u32 shader_reflect_pool_sizes(const ShaderReflection* reflection, u32 set, u32 sets, VkDescriptorPoolSize* sizes);
+
+/* the vertex inputs as attributes of one vertex buffer binding, at offsets[location]; returns how many. inputs
+ * at locations past offset_count are left out, which pipeline creation then reports as inputs nothing feeds. */
+u32 shader_reflect_vertex_attributes(const ShaderReflection* reflection, u32 binding, const u32* offsets, u32 offset_count, VkVertexInputAttributeDescription* attributes);
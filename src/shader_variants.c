@@ -0,0 +1,50 @@
+#include "shader_variants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void shader_specialize(ShaderSpecialization* spec, u32 features) {
+    for (u32 i = 0; i < SHADER_MAX_FEATURES; i++) {
+        spec->entries[i] = (VkSpecializationMapEntry) {
+            .constantID = i,
+            .offset = i * sizeof(VkBool32),
+            .size = sizeof(VkBool32),
+        };
+
+        spec->values[i] = (features >> i) & 1 ? VK_TRUE : VK_FALSE;
+    }
+
+    spec->info = (VkSpecializationInfo) {
+        .mapEntryCount = SHADER_MAX_FEATURES,
+        .pMapEntries = spec->entries,
+        .dataSize = sizeof(spec->values),
+        .pData = spec->values,
+    };
+}
+
+VkPipeline pipeline_variants_find(const PipelineVariants* variants, u32 features) {
+    for (u32 i = 0; i < variants->count; i++) {
+        if (variants->features[i] == features)
+            return variants->pipelines[i];
+    }
+
+    return VK_NULL_HANDLE;
+}
+
+void pipeline_variants_add(PipelineVariants* variants, u32 features, VkPipeline pipeline) {
+    if (variants->count >= SHADER_MAX_VARIANTS) {
+        fprintf(stderr, "too many pipeline variants (max %u)\n", SHADER_MAX_VARIANTS);
+        exit(EXIT_FAILURE);
+    }
+
+    variants->features[variants->count] = features;
+    variants->pipelines[variants->count] = pipeline;
+    variants->count++;
+}
+
+void pipeline_variants_destroy(PipelineVariants* variants, VkDevice device) {
+    for (u32 i = 0; i < variants->count; i++)
+        vkDestroyPipeline(device, variants->pipelines[i], NULL);
+
+    variants->count = 0;
+}
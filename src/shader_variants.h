@@ -0,0 +1,38 @@
+#pragma once
+
+#include "types.h"
+
+#include <volk.h>
+
+/*
+ * Shader permutations through specialization constants.
+ *
+ * A feature toggle is a `layout(constant_id = N) const bool` in GLSL, and bit N of a feature mask
+ * (see enum ShaderFeature) sets it. The driver folds the constants when the pipeline is created, so
+ * every variant is branch-free without needing its own SPIR-V. Constant ids a shader doesn't declare
+ * are ignored, so all stages can share one specialization.
+ */
+
+#define SHADER_MAX_FEATURES (u32)32
+#define SHADER_MAX_VARIANTS (u32)64
+
+typedef struct ShaderSpecialization {
+    VkSpecializationMapEntry entries[SHADER_MAX_FEATURES];
+    VkBool32 values[SHADER_MAX_FEATURES];
+    VkSpecializationInfo info;
+} ShaderSpecialization;
+
+/* fills `spec` for the given feature mask; point pSpecializationInfo at spec->info. */
+void shader_specialize(ShaderSpecialization* spec, u32 features);
+
+/* the pipelines built so far, keyed by their feature mask. */
+typedef struct PipelineVariants {
+    u32 count;
+    u32 features[SHADER_MAX_VARIANTS];
+    VkPipeline pipelines[SHADER_MAX_VARIANTS];
+} PipelineVariants;
+
+/* VK_NULL_HANDLE if that variant hasn't been built. */
+VkPipeline pipeline_variants_find(const PipelineVariants* variants, u32 features);
+void pipeline_variants_add(PipelineVariants* variants, u32 features, VkPipeline pipeline);
+void pipeline_variants_destroy(PipelineVariants* variants, VkDevice device);
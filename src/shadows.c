@@ -0,0 +1,762 @@
+#include "shadows.h"
+#include "mesh.h"
+#include "renderer_internal.h"
+#include "gpu_memory.h"
+#include "arena.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHADOW_FACES (u32)6
+#define SHADOW_LAYER_CACHE (u32)0
+#define SHADOW_LAYER_DYNAMIC (u32)1
+/* quadtree levels, from the whole atlas down to SHADOW_MIN_TILE, and their nodes together */
+#define SHADOW_TREE_LEVELS (u32)7
+#define SHADOW_TREE_NODES ((((u32)1 << (2 * SHADOW_TREE_LEVELS)) - 1) / 3)
+/* of the faces, relative to the light's radius, which is their far plane */
+#define SHADOW_NEAR_FRACTION 0.02f
+
+/* the layout of a Shadow in shadows.glsl */
+typedef struct GpuShadow {
+    /* world space to the clip space of each face */
+    Mat4 faces[SHADOW_FACES];
+    /* where each face is in the atlas, as uv offset and scale */
+    float rects[SHADOW_FACES][4];
+    /* world space position and radius of the light */
+    float position[4];
+    u32 layer;
+    u32 reserved[3];
+} GpuShadow;
+
+/* a frame's slice of the stream, padded to any minStorageBufferOffsetAlignment */
+#define SHADOW_FRAME_SIZE ((sizeof(GpuShadow) * SHADOW_MAX_LIGHTS + 255) & ~(VkDeviceSize)255)
+
+/* a node of the quadtree; free and used nodes only have free children */
+enum ShadowNodeState {
+    SHADOW_NODE_FREE,
+    SHADOW_NODE_SPLIT,
+    SHADOW_NODE_USED,
+};
+
+typedef struct ShadowTile {
+    u32 level;
+    /* in tiles of its level, which are SHADOW_ATLAS_SIZE >> level texels large */
+    u32 x, y;
+} ShadowTile;
+
+typedef struct ShadowLight {
+    /* 0 while the slot is free */
+    u32 id;
+    Vec3 position;
+    float radius;
+    Mat4 faces[SHADOW_FACES];
+
+    /* texels per side of every face, 0 without tiles; and the size asked for when they were allocated */
+    u32 tile_size;
+    u32 requested_size;
+    ShadowTile tiles[SHADOW_FACES];
+
+    /* the sum of the hashes of the static casters in range, as they were rendered into the cache */
+    u32 static_hash;
+    bool cached;
+
+    /* queued this frame, and given a shadow */
+    bool seen;
+    bool ready;
+} ShadowLight;
+
+/* a face to render, with its casters as a range of ShadowAtlas.caster_slots */
+typedef struct ShadowFaceDraw {
+    u32 light;
+    u32 face;
+    u32 first;
+    u32 count;
+} ShadowFaceDraw;
+
+struct ShadowAtlas {
+    VulkanGraphics* graphics;
+
+    VkImage image;
+    GpuAllocation memory;
+    /* both layers for sampling, and each on its own to render into */
+    VkImageView view;
+    VkImageView layer_views[2];
+    VkSampler sampler;
+    /* the layers are UNDEFINED until the first frame is recorded */
+    bool initialized;
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+
+    /* a SHADOW_FRAME_SIZE slice per frame in flight */
+    VkBuffer stream;
+    GpuAllocation stream_memory;
+    byte* stream_mapped;
+
+    u8 nodes[SHADOW_TREE_NODES];
+    ShadowLight lights[SHADOW_MAX_LIGHTS];
+
+    /* what shadow_atlas_prepare() left for shadow_atlas_record(). the dynamic faces come six to a light */
+    u32 static_count;
+    ShadowFaceDraw static_faces[SHADOW_MAX_LIGHTS * SHADOW_FACES];
+    u32 dynamic_count;
+    ShadowFaceDraw dynamic_faces[SHADOW_MAX_LIGHTS * SHADOW_FACES];
+    u32 slots_count;
+    u32 caster_slots[SHADOW_MAX_CASTER_DRAWS];
+
+    /* the casters in range of the light being prepared */
+    u32 in_range_count;
+    u32 in_range[MESH_MAX_INSTANCES];
+
+    u32 shadows_count;
+};
+
+/* +x, -x, +y, -y, +z and -z, the order shadows.glsl picks them in */
+static const Vec3 shadow_face_axes[SHADOW_FACES] = {
+    { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+};
+
+static const Vec3 shadow_face_ups[SHADOW_FACES] = {
+    { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 },
+};
+
+static u32 shadow_node_index(u32 level, u32 x, u32 y) {
+    return (((u32)1 << (2 * level)) - 1) / 3 + y * ((u32)1 << level) + x;
+}
+
+/* takes a free node of `target` level under the given one, splitting the free nodes on the way. */
+static bool shadow_tree_allocate(u8* nodes, u32 level, u32 x, u32 y, u32 target, ShadowTile* tile) {
+    u8* node = &nodes[shadow_node_index(level, x, y)];
+    if (*node == SHADOW_NODE_USED)
+        return false;
+
+    if (level == target) {
+        if (*node != SHADOW_NODE_FREE)
+            return false;
+
+        *node = SHADOW_NODE_USED;
+        *tile = (ShadowTile) { level, x, y };
+        return true;
+    }
+
+    /* all of a free node's children are free, so once split the first one takes it */
+    if (*node == SHADOW_NODE_FREE)
+        *node = SHADOW_NODE_SPLIT;
+
+    for (u32 i = 0; i < 4; ++i) {
+        if (shadow_tree_allocate(nodes, level + 1, x * 2 + (i & 1), y * 2 + (i >> 1), target, tile))
+            return true;
+    }
+
+    return false;
+}
+
+/* frees a tile, and merges its parents back up for as long as all four of their children are free. */
+static void shadow_tree_free(u8* nodes, ShadowTile tile) {
+    u32 level = tile.level, x = tile.x, y = tile.y;
+    nodes[shadow_node_index(level, x, y)] = SHADOW_NODE_FREE;
+
+    while (level > 0) {
+        x /= 2;
+        y /= 2;
+
+        for (u32 i = 0; i < 4; ++i) {
+            if (nodes[shadow_node_index(level, x * 2 + (i & 1), y * 2 + (i >> 1))] != SHADOW_NODE_FREE)
+                return;
+        }
+
+        --level;
+        nodes[shadow_node_index(level, x, y)] = SHADOW_NODE_FREE;
+    }
+}
+
+static void shadow_atlas_release(ShadowAtlas* atlas, ShadowLight* shadow) {
+    if (shadow->tile_size > 0) {
+        for (u32 i = 0; i < SHADOW_FACES; ++i)
+            shadow_tree_free(atlas->nodes, shadow->tiles[i]);
+    }
+
+    shadow->tile_size = 0;
+    shadow->cached = false;
+}
+
+/* six tiles of `size`, or of the largest size below it that still fits. */
+static bool shadow_atlas_allocate(ShadowAtlas* atlas, ShadowLight* shadow, u32 size) {
+    shadow->requested_size = size;
+
+    for (; size >= SHADOW_MIN_TILE; size /= 2) {
+        u32 level = 0;
+        while ((SHADOW_ATLAS_SIZE >> level) > size)
+            ++level;
+
+        u32 allocated = 0;
+        while (allocated < SHADOW_FACES && shadow_tree_allocate(atlas->nodes, 0, 0, 0, level, &shadow->tiles[allocated]))
+            ++allocated;
+
+        if (allocated == SHADOW_FACES) {
+            shadow->tile_size = size;
+            return true;
+        }
+
+        for (u32 i = 0; i < allocated; ++i)
+            shadow_tree_free(atlas->nodes, shadow->tiles[i]);
+    }
+
+    return false;
+}
+
+/* a face's texels as large as the pixels on screen at the light: at the radius a face spans the light's diameter,
+ * which covers about that many pixels. */
+static u32 shadow_tile_size(Vec3 position, float radius, Vec3 camera_position, float pixels_per_unit) {
+    float distance = vec3_length(vec3_sub(position, camera_position));
+    float coverage = 2.0f * radius * pixels_per_unit / (distance > radius ? distance : radius);
+
+    u32 size = SHADOW_MIN_TILE;
+    while (size < SHADOW_MAX_TILE && (float)size < coverage)
+        size *= 2;
+
+    return size;
+}
+
+static void shadow_atlas_create_image(ShadowAtlas* atlas) {
+    VulkanGraphics* graphics = atlas->graphics;
+    VkDevice device = graphics->device;
+
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = SHADOW_ATLAS_FORMAT,
+        .extent = { SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 2,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    ERR_CHECK(vkCreateImage(device, &image_info, NULL, &atlas->image), "shadow atlas image");
+
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(device, atlas->image, &reqs);
+
+    atlas->memory = gpu_memory_allocate(device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, GRAPHICS_MEMORY_RENDER_TARGETS);
+    if (atlas->memory.memory == VK_NULL_HANDLE) {
+        fprintf(stderr, "couldn't allocate the shadow atlas!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ERR_CHECK(vkBindImageMemory(device, atlas->image, atlas->memory.memory, 0), "shadow atlas binding");
+
+    VkImageViewCreateInfo view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = atlas->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format = SHADOW_ATLAS_FORMAT,
+        .subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 2 },
+    };
+
+    ERR_CHECK(vkCreateImageView(device, &view_info, NULL, &atlas->view), "shadow atlas view");
+
+    for (u32 i = 0; i < ZARRSIZ(atlas->layer_views); ++i) {
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.subresourceRange = (VkImageSubresourceRange) { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, i, 1 };
+
+        ERR_CHECK(vkCreateImageView(device, &view_info, NULL, &atlas->layer_views[i]), "shadow atlas layer view");
+    }
+
+    /* 2x2 PCF where the format can be filtered */
+    VkFormatProperties format_props;
+    vkGetPhysicalDeviceFormatProperties(graphics->gpu, SHADOW_ATLAS_FORMAT, &format_props);
+    VkFilter filter = (format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = filter,
+        .minFilter = filter,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .compareEnable = VK_TRUE,
+        .compareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+    };
+
+    ERR_CHECK(vkCreateSampler(device, &sampler_info, NULL, &atlas->sampler), "shadow atlas sampler");
+}
+
+static void shadow_atlas_create_descriptors(ShadowAtlas* atlas) {
+    VulkanGraphics* graphics = atlas->graphics;
+    VkDevice device = graphics->device;
+
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = SHADOW_FRAME_SIZE * MAX_FRAMES_IN_FLIGHT,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    ERR_CHECK(vkCreateBuffer(device, &buffer_info, NULL, &atlas->stream), "shadow stream");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(device, atlas->stream, &reqs);
+
+    atlas->stream_memory = gpu_memory_allocate(device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GRAPHICS_MEMORY_BUFFERS);
+    if (atlas->stream_memory.memory == VK_NULL_HANDLE) {
+        fprintf(stderr, "couldn't allocate the shadow stream!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ERR_CHECK(vkBindBufferMemory(device, atlas->stream, atlas->stream_memory.memory, 0), "shadow stream binding");
+
+    void* mapped;
+    ERR_CHECK(vkMapMemory(device, atlas->stream_memory.memory, 0, VK_WHOLE_SIZE, 0, &mapped), "shadow stream mapping");
+    atlas->stream_mapped = mapped;
+
+    /* shadows, atlas */
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+    };
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = ZARRSIZ(bindings),
+        .pBindings = bindings,
+    };
+
+    ERR_CHECK(vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &atlas->set_layout), "shadow descriptor set layout");
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT },
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = ZARRSIZ(pool_sizes),
+        .pPoolSizes = pool_sizes,
+    };
+
+    ERR_CHECK(vkCreateDescriptorPool(device, &pool_info, NULL, &atlas->descriptor_pool), "shadow descriptor pool");
+
+    VkDescriptorSetLayout set_layouts[MAX_FRAMES_IN_FLIGHT];
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        set_layouts[i] = atlas->set_layout;
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = atlas->descriptor_pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = set_layouts,
+    };
+
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, atlas->sets), "shadow descriptor sets");
+
+    VkDescriptorImageInfo image_info = { atlas->sampler, atlas->view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorBufferInfo stream_info = { atlas->stream, SHADOW_FRAME_SIZE * i, SHADOW_FRAME_SIZE };
+
+        VkWriteDescriptorSet writes[] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = atlas->sets[i],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &stream_info,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = atlas->sets[i],
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &image_info,
+            },
+        };
+
+        vkUpdateDescriptorSets(device, ZARRSIZ(writes), writes, 0, NULL);
+    }
+}
+
+ShadowAtlas* shadow_atlas_create(VulkanGraphics* graphics) {
+    ShadowAtlas* atlas = heap_calloc(1, sizeof(ShadowAtlas));
+    atlas->graphics = graphics;
+
+    shadow_atlas_create_image(atlas);
+    shadow_atlas_create_descriptors(atlas);
+
+    return atlas;
+}
+
+void shadow_atlas_destroy(ShadowAtlas* atlas) {
+    VkDevice device = atlas->graphics->device;
+
+    vkDestroyDescriptorPool(device, atlas->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, atlas->set_layout, NULL);
+
+    vkUnmapMemory(device, atlas->stream_memory.memory);
+    vkDestroyBuffer(device, atlas->stream, NULL);
+    gpu_memory_free(device, &atlas->stream_memory);
+
+    vkDestroySampler(device, atlas->sampler, NULL);
+    for (u32 i = 0; i < ZARRSIZ(atlas->layer_views); ++i)
+        vkDestroyImageView(device, atlas->layer_views[i], NULL);
+    vkDestroyImageView(device, atlas->view, NULL);
+    vkDestroyImage(device, atlas->image, NULL);
+    gpu_memory_free(device, &atlas->memory);
+
+    heap_free(atlas);
+}
+
+/* the slot of a shadow id, taking a free one for new ids; -1 when they're all taken. */
+static s32 shadow_atlas_slot(ShadowAtlas* atlas, u32 shadow_id) {
+    s32 free_slot = -1;
+    for (u32 i = 0; i < SHADOW_MAX_LIGHTS; ++i) {
+        if (atlas->lights[i].id == shadow_id)
+            return (s32)i;
+
+        if (atlas->lights[i].id == 0 && free_slot < 0)
+            free_slot = (s32)i;
+    }
+
+    if (free_slot >= 0)
+        atlas->lights[free_slot] = (ShadowLight) { .id = shadow_id };
+
+    return free_slot;
+}
+
+/* queues all faces of a light, each with the casters in range of one kind that are in its frustum. */
+static void shadow_atlas_queue_faces(ShadowAtlas* atlas, u32 index, const MeshCaster* casters, bool statics, ShadowFaceDraw* faces, u32* faces_count) {
+    const ShadowLight* shadow = &atlas->lights[index];
+
+    for (u32 f = 0; f < SHADOW_FACES; ++f) {
+        Vec4 planes[6];
+        frustum_planes(&shadow->faces[f], planes);
+
+        ShadowFaceDraw* face = &faces[(*faces_count)++];
+        *face = (ShadowFaceDraw) { .light = index, .face = f, .first = atlas->slots_count };
+
+        for (u32 i = 0; i < atlas->in_range_count && atlas->slots_count < SHADOW_MAX_CASTER_DRAWS; ++i) {
+            const MeshCaster* caster = &casters[atlas->in_range[i]];
+            if (caster->is_static == statics && frustum_sphere_visible(planes, caster->center, caster->radius))
+                atlas->caster_slots[atlas->slots_count++] = atlas->in_range[i];
+        }
+
+        face->count = atlas->slots_count - face->first;
+    }
+}
+
+static void shadow_atlas_prepare_light(ShadowAtlas* atlas, u32 index, const GraphicsLight* light, const Vec4 planes[6], Vec3 camera_position, float pixels_per_unit, const MeshCaster* casters, u32 casters_count, GpuShadow* gpu_shadows) {
+    ShadowLight* shadow = &atlas->lights[index];
+    Vec3 position = vec3(light->position[0], light->position[1], light->position[2]);
+    float radius = light->radius;
+
+    /* out of view it lights nothing on screen; its tiles stay as they are until it's back */
+    if (radius <= 0 || !frustum_sphere_visible(planes, position, radius))
+        return;
+
+    /* grows right away, but only shrinks to a quarter, so it doesn't go back and forth around a threshold */
+    u32 size = shadow_tile_size(position, radius, camera_position, pixels_per_unit);
+    if (shadow->tile_size == 0 || size > shadow->requested_size || size * 4 <= shadow->requested_size) {
+        shadow_atlas_release(atlas, shadow);
+        if (!shadow_atlas_allocate(atlas, shadow, size))
+            return;
+    }
+
+    if (position.x != shadow->position.x || position.y != shadow->position.y || position.z != shadow->position.z || radius != shadow->radius) {
+        shadow->position = position;
+        shadow->radius = radius;
+        shadow->cached = false;
+
+        /* 90 degrees, so the six faces meet edge to edge */
+        float near_plane = radius * SHADOW_NEAR_FRACTION;
+        Mat4 projection = mat4_perspective(1.57079633f, 1.0f, near_plane, radius);
+        for (u32 f = 0; f < SHADOW_FACES; ++f) {
+            Mat4 view = mat4_look_at(position, vec3_add(position, shadow_face_axes[f]), shadow_face_ups[f]);
+            shadow->faces[f] = mat4_mul(projection, view);
+        }
+    }
+
+    /* the static casters changed when their hashes don't sum up the same anymore */
+    u32 static_hash = 0;
+    bool dynamic = false;
+    atlas->in_range_count = 0;
+
+    for (u32 i = 0; i < casters_count; ++i) {
+        float reach = radius + casters[i].radius;
+        Vec3 offset = vec3_sub(casters[i].center, position);
+        if (vec3_dot(offset, offset) >= reach * reach)
+            continue;
+
+        atlas->in_range[atlas->in_range_count++] = i;
+        if (casters[i].is_static)
+            static_hash += casters[i].hash;
+        else
+            dynamic = true;
+    }
+
+    if (static_hash != shadow->static_hash) {
+        shadow->static_hash = static_hash;
+        shadow->cached = false;
+    }
+
+    if (!shadow->cached) {
+        shadow_atlas_queue_faces(atlas, index, casters, true, atlas->static_faces, &atlas->static_count);
+        shadow->cached = true;
+    }
+
+    if (dynamic)
+        shadow_atlas_queue_faces(atlas, index, casters, false, atlas->dynamic_faces, &atlas->dynamic_count);
+
+    GpuShadow* gpu = &gpu_shadows[index];
+    memcpy(gpu->faces, shadow->faces, sizeof(gpu->faces));
+
+    for (u32 f = 0; f < SHADOW_FACES; ++f) {
+        const ShadowTile* tile = &shadow->tiles[f];
+        gpu->rects[f][0] = (float)(tile->x * shadow->tile_size) / (float)SHADOW_ATLAS_SIZE;
+        gpu->rects[f][1] = (float)(tile->y * shadow->tile_size) / (float)SHADOW_ATLAS_SIZE;
+        gpu->rects[f][2] = (float)shadow->tile_size / (float)SHADOW_ATLAS_SIZE;
+        gpu->rects[f][3] = (float)shadow->tile_size / (float)SHADOW_ATLAS_SIZE;
+    }
+
+    gpu->position[0] = position.x;
+    gpu->position[1] = position.y;
+    gpu->position[2] = position.z;
+    gpu->position[3] = radius;
+    gpu->layer = dynamic ? SHADOW_LAYER_DYNAMIC : SHADOW_LAYER_CACHE;
+
+    shadow->ready = true;
+    ++atlas->shadows_count;
+}
+
+void shadow_atlas_prepare(ShadowAtlas* atlas, u32 frame, const GraphicsLight* lights, u32 count, const Mat4* view, const Mat4* projection, Vec3 camera_position, VkExtent2D render_extent) {
+    TRACE_ZONE("shadow_atlas_prepare");
+
+    atlas->static_count = 0;
+    atlas->dynamic_count = 0;
+    atlas->slots_count = 0;
+    atlas->shadows_count = 0;
+
+    for (u32 i = 0; i < SHADOW_MAX_LIGHTS; ++i) {
+        atlas->lights[i].seen = false;
+        atlas->lights[i].ready = false;
+    }
+
+    Mat4 view_projection = mat4_mul(*projection, *view);
+    Vec4 planes[6];
+    frustum_planes(&view_projection, planes);
+
+    /* how many pixels one world unit covers at distance 1 */
+    float pixels_per_unit = (float)render_extent.height * fabsf(projection->m[5]) * 0.5f;
+
+    u32 casters_count;
+    const MeshCaster* casters = mesh_renderer_casters(atlas->graphics->meshes, &casters_count);
+    GpuShadow* gpu_shadows = (GpuShadow*)(atlas->stream_mapped + SHADOW_FRAME_SIZE * frame);
+
+    for (u32 i = 0; i < count; ++i) {
+        const GraphicsLight* light = &lights[i];
+        if (light->shadow_id == 0)
+            continue;
+
+        s32 index = shadow_atlas_slot(atlas, light->shadow_id);
+        if (index < 0 || atlas->lights[index].seen)
+            continue;
+
+        atlas->lights[index].seen = true;
+        shadow_atlas_prepare_light(atlas, (u32)index, light, planes, camera_position, pixels_per_unit, casters, casters_count, gpu_shadows);
+    }
+
+    /* lights that weren't queued give their tiles back */
+    for (u32 i = 0; i < SHADOW_MAX_LIGHTS; ++i) {
+        ShadowLight* shadow = &atlas->lights[i];
+        if (shadow->id != 0 && !shadow->seen) {
+            shadow_atlas_release(atlas, shadow);
+            shadow->id = 0;
+        }
+    }
+}
+
+s32 shadow_atlas_find(const ShadowAtlas* atlas, u32 shadow_id) {
+    if (shadow_id == 0)
+        return -1;
+
+    for (u32 i = 0; i < SHADOW_MAX_LIGHTS; ++i) {
+        if (atlas->lights[i].id == shadow_id)
+            return atlas->lights[i].ready ? (s32)i : -1;
+    }
+
+    return -1;
+}
+
+static void shadow_atlas_barrier(ShadowAtlas* atlas, VkCommandBuffer command_buffer, u32 layer, VkImageLayout old_layout, VkImageLayout new_layout, VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access) {
+    VkImageMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = src_stages,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stages,
+        .dstAccessMask = dst_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = atlas->image,
+        .subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, layer, 1 },
+    };
+
+    vkCmdPipelineBarrier2(command_buffer, &(VkDependencyInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &barrier,
+    });
+}
+
+/* draws the casters of the given faces into their tiles of one layer; the cache starts every face over, the
+ * dynamic layer draws over the copy of it. */
+static void shadow_atlas_render(ShadowAtlas* atlas, VkCommandBuffer command_buffer, u32 frame, u32 layer, const ShadowFaceDraw* faces, u32 count) {
+    VkRenderingAttachmentInfo depth_attachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = atlas->layer_views[layer],
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+    };
+
+    VkRenderingInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea.extent = { SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE },
+        .layerCount = 1,
+        .pDepthAttachment = &depth_attachment,
+    };
+
+    vkCmdBeginRendering(command_buffer, &rendering);
+
+    for (u32 i = 0; i < count; ++i) {
+        const ShadowFaceDraw* face = &faces[i];
+        const ShadowLight* shadow = &atlas->lights[face->light];
+        const ShadowTile* tile = &shadow->tiles[face->face];
+        if (layer == SHADOW_LAYER_DYNAMIC && face->count == 0)
+            continue;
+
+        VkRect2D rect = {
+            .offset = { (s32)(tile->x * shadow->tile_size), (s32)(tile->y * shadow->tile_size) },
+            .extent = { shadow->tile_size, shadow->tile_size },
+        };
+
+        VkViewport viewport = {
+            .x = (float)rect.offset.x,
+            .y = (float)rect.offset.y,
+            .width = (float)shadow->tile_size,
+            .height = (float)shadow->tile_size,
+            .minDepth = 0,
+            .maxDepth = 1,
+        };
+
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(command_buffer, 0, 1, &rect);
+
+        if (layer == SHADOW_LAYER_CACHE) {
+            VkClearAttachment clear = { .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT, .clearValue.depthStencil = { 1, 0 } };
+            vkCmdClearAttachments(command_buffer, 1, &clear, 1, &(VkClearRect) { rect, 0, 1 });
+        }
+
+        /* a face covers 90 degrees, so a world unit at distance 1 spans half of it */
+        mesh_renderer_draw_casters(atlas->graphics->meshes, command_buffer, frame, &shadow->faces[face->face], shadow->position, (float)shadow->tile_size * 0.5f, atlas->caster_slots + face->first, face->count);
+    }
+
+    vkCmdEndRendering(command_buffer);
+}
+
+void shadow_atlas_record(ShadowAtlas* atlas, VkCommandBuffer command_buffer, u32 frame) {
+    TRACE_ZONE("shadow_atlas_record");
+
+    const VkPipelineStageFlags2 sampling = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    const VkPipelineStageFlags2 tests = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    const VkPipelineStageFlags2 copy = VK_PIPELINE_STAGE_2_COPY_BIT;
+    const VkAccessFlags2 depth_access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    /* both layers can be sampled from the first frame on, so the shadow set is always valid */
+    if (!atlas->initialized) {
+        for (u32 i = 0; i < ZARRSIZ(atlas->layer_views); ++i)
+            shadow_atlas_barrier(atlas, command_buffer, i, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_NONE, 0, sampling, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+        atlas->initialized = true;
+    }
+
+    bool copies = atlas->dynamic_count > 0;
+    VkImageLayout cache_layout = copies ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    /* the last frames are done sampling the faces before they're drawn over */
+    if (atlas->static_count > 0) {
+        shadow_atlas_barrier(atlas, command_buffer, SHADOW_LAYER_CACHE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, sampling, 0, tests, depth_access);
+        shadow_atlas_render(atlas, command_buffer, frame, SHADOW_LAYER_CACHE, atlas->static_faces, atlas->static_count);
+        shadow_atlas_barrier(atlas, command_buffer, SHADOW_LAYER_CACHE, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, cache_layout, tests, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, copies ? copy : sampling, copies ? VK_ACCESS_2_TRANSFER_READ_BIT : VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    } else if (copies) {
+        shadow_atlas_barrier(atlas, command_buffer, SHADOW_LAYER_CACHE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cache_layout, sampling, 0, copy, VK_ACCESS_2_TRANSFER_READ_BIT);
+    }
+
+    if (!copies)
+        return;
+
+    /* only the faces of this frame's dynamic lights are ever read from the second layer, and they're all copied */
+    shadow_atlas_barrier(atlas, command_buffer, SHADOW_LAYER_DYNAMIC, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, sampling, 0, copy, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    for (u32 i = 0; i < atlas->dynamic_count; i += SHADOW_FACES) {
+        const ShadowLight* shadow = &atlas->lights[atlas->dynamic_faces[i].light];
+
+        VkImageCopy regions[SHADOW_FACES];
+        for (u32 f = 0; f < SHADOW_FACES; ++f) {
+            VkOffset3D offset = { (s32)(shadow->tiles[f].x * shadow->tile_size), (s32)(shadow->tiles[f].y * shadow->tile_size), 0 };
+
+            regions[f] = (VkImageCopy) {
+                .srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, SHADOW_LAYER_CACHE, 1 },
+                .srcOffset = offset,
+                .dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, SHADOW_LAYER_DYNAMIC, 1 },
+                .dstOffset = offset,
+                .extent = { shadow->tile_size, shadow->tile_size, 1 },
+            };
+        }
+
+        vkCmdCopyImage(command_buffer, atlas->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, atlas->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, SHADOW_FACES, regions);
+    }
+
+    shadow_atlas_barrier(atlas, command_buffer, SHADOW_LAYER_CACHE, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, copy, 0, sampling, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    shadow_atlas_barrier(atlas, command_buffer, SHADOW_LAYER_DYNAMIC, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, copy, VK_ACCESS_2_TRANSFER_WRITE_BIT, tests, depth_access);
+
+    shadow_atlas_render(atlas, command_buffer, frame, SHADOW_LAYER_DYNAMIC, atlas->dynamic_faces, atlas->dynamic_count);
+
+    shadow_atlas_barrier(atlas, command_buffer, SHADOW_LAYER_DYNAMIC, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, tests, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, sampling, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+}
+
+VkDescriptorSetLayout shadow_atlas_set_layout(const ShadowAtlas* atlas) {
+    return atlas->set_layout;
+}
+
+VkDescriptorSet shadow_atlas_set(const ShadowAtlas* atlas, u32 frame) {
+    return atlas->sets[frame];
+}
+
+void shadow_atlas_get_stats(const ShadowAtlas* atlas, u32* shadows, u32* faces_rendered) {
+    *shadows = atlas->shadows_count;
+    *faces_rendered = atlas->static_count;
+
+    for (u32 i = 0; i < atlas->dynamic_count; ++i)
+        *faces_rendered += atlas->dynamic_faces[i].count > 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+#include "zmath.h"
+
+#include <volk.h>
+
+/*
+ * Cached shadow atlas.
+ *
+ * Point lights with a shadow_id cast shadows into a single depth atlas, as a cube of six square faces each. The
+ * faces of a light are tiles of a quadtree over the atlas, as large as the light's coverage on screen asks for
+ * (SHADOW_MIN_TILE to SHADOW_MAX_TILE texels), and a light keeps its tiles from frame to frame until it grows or
+ * shrinks past twice their size, or isn't queued anymore.
+ *
+ * The atlas has two layers. The first caches what the static mesh instances (graphics_draw_static_mesh()) cast:
+ * a light's faces are rendered into it once, and only again when the light moves, its tiles change, or a static
+ * instance within its radius changes, which the sum of their hashes tells. A light that dynamic instances are
+ * in range of gets its cached faces copied into the second layer and the dynamic instances drawn over them, and
+ * is sampled from there; every other light is sampled straight from the cache. Lights out of view render
+ * nothing. So a frame only renders the faces of lights something moved around, however many lights there are.
+ *
+ * The shadow set (shadow_atlas_set()) is set 2 of the lit shaders; see mesh.frag.
+ */
+
+/* shadowed lights at once; more are left unshadowed */
+#define SHADOW_MAX_LIGHTS (u32)64
+#define SHADOW_ATLAS_SIZE (u32)4096
+#define SHADOW_MIN_TILE (u32)64
+#define SHADOW_MAX_TILE (u32)512
+/* caster draws of all faces rendered in a frame; more are dropped */
+#define SHADOW_MAX_CASTER_DRAWS (u32)65536
+#define SHADOW_ATLAS_FORMAT VK_FORMAT_D16_UNORM
+
+typedef struct ShadowAtlas ShadowAtlas;
+
+ShadowAtlas* shadow_atlas_create(VulkanGraphics* graphics);
+void shadow_atlas_destroy(ShadowAtlas* atlas);
+
+/* gives the shadowed lights among `lights` their tiles and picks the faces to render from the casters
+ * mesh_renderer_prepare() left, writing the shadows into the stream slice of `frame`. shadowed lights that
+ * aren't among them lose their tiles. */
+void shadow_atlas_prepare(ShadowAtlas* atlas, u32 frame, const GraphicsLight* lights, u32 count, const Mat4* view, const Mat4* projection, Vec3 camera_position, VkExtent2D render_extent);
+
+/* the index of a light's shadow in the last prepared frame, -1 if it has none. */
+s32 shadow_atlas_find(const ShadowAtlas* atlas, u32 shadow_id);
+
+/* renders the faces picked by shadow_atlas_prepare(); outside of any rendering, before the passes sampling the
+ * atlas. between frames the atlas stays in SHADER_READ_ONLY_OPTIMAL layout. */
+void shadow_atlas_record(ShadowAtlas* atlas, VkCommandBuffer command_buffer, u32 frame);
+
+/* for the pipeline layouts and draws of lit shaders, which read it from the fragment stage. */
+VkDescriptorSetLayout shadow_atlas_set_layout(const ShadowAtlas* atlas);
+VkDescriptorSet shadow_atlas_set(const ShadowAtlas* atlas, u32 frame);
+
+/* shadowed lights of the last prepared frame, and the faces rendered for them; cached faces aren't counted. */
+void shadow_atlas_get_stats(const ShadowAtlas* atlas, u32* shadows, u32* faces_rendered);
@@ -0,0 +1,826 @@
+#include "sprite_batch.h"
+#include "renderer_internal.h"
+#include "atlas.h"
+#include "texture.h"
+#include "texture_format.h"
+#include "gpu_memory.h"
+#include "arena.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* keeps linear filtering from picking up the neighbours of an image; a whole block on compressed pages, which
+ * keeps every image on them block aligned */
+#define SPRITE_ATLAS_PADDING (u16)2
+#define SPRITE_ATLAS_BLOCK_PADDING (u16)4
+
+#define SPRITE_MAX_PATH (u32)260
+
+/* what the vertex stream holds per sprite; see shaders/vulkan/sprite.vert */
+typedef struct SpriteInstance {
+    float rect[4];
+    /* unorm min u, min v, max u, max v */
+    u16 uv[4];
+    u32 color;
+    float rotation;
+} SpriteInstance;
+
+typedef struct SpriteImage {
+    u32 page;
+    AtlasRect rect;
+    u16 uv[4];
+    /* 1 + the index of the texture it was loaded from, 0 if it was added as pixels */
+    u32 texture;
+} SpriteImage;
+
+typedef struct SpriteAtlasPage {
+    VkImage image;
+    VkImageView view;
+    GpuAllocation memory;
+    VkDescriptorSet set;
+
+    /* RGBA8 texels, or blocks of 4x4 texels block_size bytes each */
+    VkFormat format;
+    u32 block_size;
+
+    /* laid out like the image, a row of texels or blocks after the other; images are written in here and copied
+     * over */
+    VkBuffer staging;
+    GpuAllocation staging_memory;
+    u8* staging_mapped;
+
+    AtlasPacker packer;
+
+    /* the part of the page to upload with the next frame, empty if x0 == x1 */
+    u32 dirty_x0, dirty_y0, dirty_x1, dirty_y1;
+    bool uploaded;
+} SpriteAtlasPage;
+
+struct SpriteBatch {
+    VulkanGraphics* graphics;
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkSampler sampler;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+
+    /* a SPRITE_BATCH_CAPACITY slice per frame in flight */
+    VkBuffer stream;
+    GpuAllocation stream_memory;
+    SpriteInstance* stream_mapped;
+
+    u32 pages_count;
+    SpriteAtlasPage pages[SPRITE_ATLAS_MAX_PAGES];
+
+    u32 images_count;
+    SpriteImage images[SPRITE_MAX_IMAGES];
+
+    /* the paths of the textures images were loaded from, replayed by path */
+    u32 textures_count;
+    char textures[SPRITE_MAX_TEXTURES][SPRITE_MAX_PATH];
+
+    /* queued sprites and their sort keys: layer << 8 | page */
+    u32 count;
+    bool overflowed;
+    SpriteInstance* instances;
+    u32* keys;
+
+    /* radix sort ping-pong */
+    u32* order;
+    u32* scratch;
+};
+
+static void sprite_batch_create_pipeline(SpriteBatch* batch) {
+    VulkanGraphics* graphics = batch->graphics;
+
+    VkShaderModule vertex = vk_load_shader_module(graphics, "shaders/bin/vulkan_sprite.vert.spv");
+    VkShaderModule fragment = vk_load_shader_module(graphics, "shaders/bin/vulkan_sprite.frag.spv");
+
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertex,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragment,
+            .pName = "main",
+        },
+    };
+
+    VkDynamicState dynamic_states[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = ZARRSIZ(dynamic_states),
+        .pDynamicStates = dynamic_states,
+    };
+
+    VkVertexInputBindingDescription binding = {
+        .binding = 0,
+        .stride = sizeof(SpriteInstance),
+        .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+    };
+
+    VkVertexInputAttributeDescription attributes[] = {
+        { .location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(SpriteInstance, rect) },
+        { .location = 1, .binding = 0, .format = VK_FORMAT_R16G16B16A16_UNORM, .offset = offsetof(SpriteInstance, uv) },
+        { .location = 2, .binding = 0, .format = VK_FORMAT_R8G8B8A8_UNORM, .offset = offsetof(SpriteInstance, color) },
+        { .location = 3, .binding = 0, .format = VK_FORMAT_R32_SFLOAT, .offset = offsetof(SpriteInstance, rotation) },
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding,
+        .vertexAttributeDescriptionCount = ZARRSIZ(attributes),
+        .pVertexAttributeDescriptions = attributes,
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    };
+
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    /* sprites can be mirrored with a negative size, so nothing is culled */
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+    };
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+    };
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment,
+    };
+
+    /* drawn straight into the backbuffer, after the scene has been resolved and upscaled */
+    VkPipelineRenderingCreateInfo rendering_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &vk_main_window(graphics)->swapchain_format.format,
+    };
+
+    VkGraphicsPipelineCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = &rendering_info,
+        .stageCount = ZARRSIZ(stages),
+        .pStages = stages,
+
+        .pVertexInputState = &vertex_input,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisample,
+        .pDepthStencilState = &depth_stencil,
+        .pColorBlendState = &color_blending,
+        .pDynamicState = &dynamic_state,
+
+        .layout = batch->pipeline_layout,
+    };
+
+    ERR_CHECK(vkCreateGraphicsPipelines(graphics->device, VK_NULL_HANDLE, 1, &info, NULL, &batch->pipeline), "sprite pipeline");
+
+    vkDestroyShaderModule(graphics->device, vertex, NULL);
+    vkDestroyShaderModule(graphics->device, fragment, NULL);
+}
+
+static void sprite_batch_create_layouts(SpriteBatch* batch) {
+    VkDevice device = batch->graphics->device;
+
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+    };
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+
+    ERR_CHECK(vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &batch->set_layout), "sprite descriptor set layout");
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = SPRITE_ATLAS_MAX_PAGES,
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = SPRITE_ATLAS_MAX_PAGES,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+
+    ERR_CHECK(vkCreateDescriptorPool(device, &pool_info, NULL, &batch->descriptor_pool), "sprite descriptor pool");
+
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    };
+
+    ERR_CHECK(vkCreateSampler(device, &sampler_info, NULL, &batch->sampler), "sprite sampler");
+
+    VkPushConstantRange push_constants = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .size = sizeof(float) * 2,
+    };
+
+    VkPipelineLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &batch->set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constants,
+    };
+
+    ERR_CHECK(vkCreatePipelineLayout(device, &layout_info, NULL, &batch->pipeline_layout), "sprite pipeline layout");
+}
+
+static void sprite_batch_create_stream(SpriteBatch* batch) {
+    VulkanGraphics* graphics = batch->graphics;
+
+    VkBufferCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = (VkDeviceSize)sizeof(SpriteInstance) * SPRITE_BATCH_CAPACITY * MAX_FRAMES_IN_FLIGHT,
+        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    ERR_CHECK(vkCreateBuffer(graphics->device, &info, NULL, &batch->stream), "sprite stream buffer");
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(graphics->device, batch->stream, &reqs);
+
+    /* written once per frame and read once by the GPU; device local host visible memory saves the trip over the bus where there is some */
+    batch->stream_memory = gpu_memory_allocate(graphics->device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GRAPHICS_MEMORY_BUFFERS);
+    if (batch->stream_memory.memory == VK_NULL_HANDLE) {
+        fprintf(stderr, "couldn't allocate the sprite stream!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ERR_CHECK(vkBindBufferMemory(graphics->device, batch->stream, batch->stream_memory.memory, 0), "sprite stream binding");
+
+    void* mapped;
+    ERR_CHECK(vkMapMemory(graphics->device, batch->stream_memory.memory, 0, VK_WHOLE_SIZE, 0, &mapped), "sprite stream mapping");
+    batch->stream_mapped = mapped;
+}
+
+/* bytes from the start of the staging buffer to texel (x, y), which is a block corner on compressed pages. */
+static inline usize sprite_page_offset(const SpriteAtlasPage* page, u32 x, u32 y) {
+    if (page->block_size == 0)
+        return ((usize)y * SPRITE_ATLAS_SIZE + x) * 4;
+
+    return ((usize)(y / 4) * (SPRITE_ATLAS_SIZE / 4) + x / 4) * page->block_size;
+}
+
+/* bytes from one row of texels, or of blocks, to the next. */
+static inline usize sprite_page_pitch(const SpriteAtlasPage* page) {
+    return page->block_size == 0 ? (usize)SPRITE_ATLAS_SIZE * 4 : (usize)(SPRITE_ATLAS_SIZE / 4) * page->block_size;
+}
+
+/* a page of `format`, compressed if `block_size` isn't 0; returns false if the page can't be allocated. */
+static bool sprite_batch_create_page(SpriteBatch* batch, SpriteAtlasPage* page, VkFormat format, u32 block_size) {
+    VulkanGraphics* graphics = batch->graphics;
+    VkDevice device = graphics->device;
+
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = { SPRITE_ATLAS_SIZE, SPRITE_ATLAS_SIZE, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    ERR_CHECK(vkCreateImage(device, &image_info, NULL, &page->image), "sprite atlas image");
+
+    page->format = format;
+    page->block_size = block_size;
+
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(device, page->image, &reqs);
+
+    page->memory = gpu_memory_allocate(device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, GRAPHICS_MEMORY_TEXTURES);
+    if (page->memory.memory == VK_NULL_HANDLE) {
+        vkDestroyImage(device, page->image, NULL);
+        return false;
+    }
+
+    ERR_CHECK(vkBindImageMemory(device, page->image, page->memory.memory, 0), "sprite atlas image binding");
+
+    VkImageViewCreateInfo view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = page->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = image_info.format,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+    };
+
+    ERR_CHECK(vkCreateImageView(device, &view_info, NULL, &page->view), "sprite atlas view");
+
+    VkBufferCreateInfo staging_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = (VkDeviceSize)sprite_page_pitch(page) * (block_size == 0 ? SPRITE_ATLAS_SIZE : SPRITE_ATLAS_SIZE / 4),
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    ERR_CHECK(vkCreateBuffer(device, &staging_info, NULL, &page->staging), "sprite atlas staging buffer");
+    vkGetBufferMemoryRequirements(device, page->staging, &reqs);
+
+    page->staging_memory = gpu_memory_allocate(device, &graphics->memory_props, &reqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, GRAPHICS_MEMORY_STAGING);
+    if (page->staging_memory.memory == VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, page->staging, NULL);
+        vkDestroyImageView(device, page->view, NULL);
+        vkDestroyImage(device, page->image, NULL);
+        gpu_memory_free(device, &page->memory);
+        return false;
+    }
+
+    ERR_CHECK(vkBindBufferMemory(device, page->staging, page->staging_memory.memory, 0), "sprite atlas staging binding");
+
+    void* mapped;
+    ERR_CHECK(vkMapMemory(device, page->staging_memory.memory, 0, VK_WHOLE_SIZE, 0, &mapped), "sprite atlas staging mapping");
+    page->staging_mapped = mapped;
+
+    /* the padding between images is uploaded too, it has to be transparent (or black, for opaque blocks) */
+    memset(page->staging_mapped, 0, staging_info.size);
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = batch->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &batch->set_layout,
+    };
+
+    ERR_CHECK(vkAllocateDescriptorSets(device, &set_info, &page->set), "sprite atlas descriptor set");
+
+    VkDescriptorImageInfo descriptor_image = {
+        .sampler = batch->sampler,
+        .imageView = page->view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = page->set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &descriptor_image,
+    };
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+    atlas_init(&page->packer, SPRITE_ATLAS_SIZE, SPRITE_ATLAS_SIZE, block_size == 0 ? SPRITE_ATLAS_PADDING : SPRITE_ATLAS_BLOCK_PADDING);
+
+    /* the first upload covers the whole page, so no texel is left undefined */
+    page->dirty_x0 = 0;
+    page->dirty_y0 = 0;
+    page->dirty_x1 = SPRITE_ATLAS_SIZE;
+    page->dirty_y1 = SPRITE_ATLAS_SIZE;
+    page->uploaded = false;
+
+    return true;
+}
+
+static void sprite_batch_destroy_page(SpriteBatch* batch, SpriteAtlasPage* page) {
+    VkDevice device = batch->graphics->device;
+
+    vkUnmapMemory(device, page->staging_memory.memory);
+    vkDestroyBuffer(device, page->staging, NULL);
+    gpu_memory_free(device, &page->staging_memory);
+
+    vkDestroyImageView(device, page->view, NULL);
+    vkDestroyImage(device, page->image, NULL);
+    gpu_memory_free(device, &page->memory);
+}
+
+SpriteBatch* sprite_batch_create(VulkanGraphics* graphics) {
+    SpriteBatch* batch = heap_calloc(1, sizeof(SpriteBatch));
+    batch->graphics = graphics;
+
+    batch->instances = heap_alloc(sizeof(SpriteInstance) * SPRITE_BATCH_CAPACITY);
+    batch->keys = heap_alloc(sizeof(u32) * SPRITE_BATCH_CAPACITY);
+    batch->order = heap_alloc(sizeof(u32) * SPRITE_BATCH_CAPACITY);
+    batch->scratch = heap_alloc(sizeof(u32) * SPRITE_BATCH_CAPACITY);
+
+    sprite_batch_create_layouts(batch);
+    sprite_batch_create_pipeline(batch);
+    sprite_batch_create_stream(batch);
+
+    return batch;
+}
+
+void sprite_batch_destroy(SpriteBatch* batch) {
+    VkDevice device = batch->graphics->device;
+
+    for (u32 i = 0; i < batch->pages_count; ++i)
+        sprite_batch_destroy_page(batch, &batch->pages[i]);
+
+    vkUnmapMemory(device, batch->stream_memory.memory);
+    vkDestroyBuffer(device, batch->stream, NULL);
+    gpu_memory_free(device, &batch->stream_memory);
+
+    vkDestroyPipeline(device, batch->pipeline, NULL);
+    vkDestroyPipelineLayout(device, batch->pipeline_layout, NULL);
+    vkDestroySampler(device, batch->sampler, NULL);
+    vkDestroyDescriptorPool(device, batch->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, batch->set_layout, NULL);
+
+    heap_free(batch->instances);
+    heap_free(batch->keys);
+    heap_free(batch->order);
+    heap_free(batch->scratch);
+    heap_free(batch);
+}
+
+static inline u16 sprite_uv(u32 texel) {
+    return (u16)((texel * 65535u + SPRITE_ATLAS_SIZE / 2) / SPRITE_ATLAS_SIZE);
+}
+
+/* packs a `width` x `height` rectangle onto a page of `format`, opening one if none has room; returns false if
+ * there's no room left at all. */
+static bool sprite_batch_place(SpriteBatch* batch, VkFormat format, u32 block_size, u32 width, u32 height, u32* page_index, AtlasRect* rect) {
+    /* earlier pages first, so they fill up before new ones are opened */
+    for (*page_index = 0; *page_index < batch->pages_count; ++*page_index) {
+        SpriteAtlasPage* page = &batch->pages[*page_index];
+        if (page->format == format && atlas_pack(&page->packer, width, height, rect))
+            return true;
+    }
+
+    if (batch->pages_count == SPRITE_ATLAS_MAX_PAGES || !sprite_batch_create_page(batch, &batch->pages[batch->pages_count], format, block_size))
+        return false;
+
+    batch->pages_count++;
+    return atlas_pack(&batch->pages[*page_index].packer, width, height, rect);
+}
+
+/* the page uploads `rect` with the next frame, and the image showing the `width` x `height` texels at its
+ * corner can be drawn. */
+static GraphicsSpriteImage sprite_batch_finish_image(SpriteBatch* batch, u32 page_index, AtlasRect rect, u32 width, u32 height, u32 texture) {
+    SpriteAtlasPage* page = &batch->pages[page_index];
+
+    if (page->dirty_x0 == page->dirty_x1) {
+        page->dirty_x0 = rect.x;
+        page->dirty_y0 = rect.y;
+        page->dirty_x1 = rect.x + rect.width;
+        page->dirty_y1 = rect.y + rect.height;
+    } else {
+        page->dirty_x0 = page->dirty_x0 < rect.x ? page->dirty_x0 : rect.x;
+        page->dirty_y0 = page->dirty_y0 < rect.y ? page->dirty_y0 : rect.y;
+        page->dirty_x1 = page->dirty_x1 > (u32)rect.x + rect.width ? page->dirty_x1 : (u32)rect.x + rect.width;
+        page->dirty_y1 = page->dirty_y1 > (u32)rect.y + rect.height ? page->dirty_y1 : (u32)rect.y + rect.height;
+    }
+
+    batch->images[batch->images_count] = (SpriteImage) {
+        .page = page_index,
+        .rect = rect,
+        .uv = { sprite_uv(rect.x), sprite_uv(rect.y), sprite_uv(rect.x + width), sprite_uv(rect.y + height) },
+        .texture = texture,
+    };
+
+    return batch->images_count++;
+}
+
+GraphicsSpriteImage sprite_batch_add_image(SpriteBatch* batch, const u8* pixels, u32 width, u32 height) {
+    if (batch->images_count >= SPRITE_MAX_IMAGES || width == 0 || height == 0 || width > SPRITE_ATLAS_SIZE || height > SPRITE_ATLAS_SIZE)
+        return GRAPHICS_INVALID_SPRITE_IMAGE;
+
+    u32 page_index;
+    AtlasRect rect;
+    if (!sprite_batch_place(batch, VK_FORMAT_R8G8B8A8_SRGB, 0, width, height, &page_index, &rect))
+        return GRAPHICS_INVALID_SPRITE_IMAGE;
+
+    SpriteAtlasPage* page = &batch->pages[page_index];
+
+    /* the GPU may still be copying an older dirty area out of the staging buffer, but packed rectangles never
+     * overlap, so it only ever sees bytes that are unused or already uploaded. */
+    for (u32 y = 0; y < height; ++y)
+        memcpy(page->staging_mapped + sprite_page_offset(page, rect.x, rect.y + y), pixels + (usize)y * width * 4, (usize)width * 4);
+
+    return sprite_batch_finish_image(batch, page_index, rect, width, height, 0);
+}
+
+/* transcodes a texture that passed texture_read_info() onto a page of the format the GPU samples it in. */
+static GraphicsSpriteImage sprite_batch_place_texture(SpriteBatch* batch, const char* path, const byte* data, const TextureInfo* info) {
+    VulkanGraphics* graphics = batch->graphics;
+    enum TextureTarget target = graphics->texture_target;
+
+    if (info->width > SPRITE_ATLAS_SIZE || info->height > SPRITE_ATLAS_SIZE) {
+        fprintf(stderr, "texture %s is larger than a sprite atlas page (%u texels)\n", path, SPRITE_ATLAS_SIZE);
+        return GRAPHICS_INVALID_SPRITE_IMAGE;
+    }
+
+    /* compressed images take whole blocks, the padded ones past their edges included */
+    u32 block_size = target == TEXTURE_TARGET_RGBA8 ? 0 : texture_target_block_size(target, info->alpha);
+    u32 width = block_size == 0 ? info->width : (info->width + 3) & ~(u32)3;
+    u32 height = block_size == 0 ? info->height : (info->height + 3) & ~(u32)3;
+
+    u32 page_index;
+    AtlasRect rect;
+    if (!sprite_batch_place(batch, texture_target_format(target, info->alpha), block_size, width, height, &page_index, &rect)) {
+        fprintf(stderr, "no room left in the sprite atlas for %s\n", path);
+        return GRAPHICS_INVALID_SPRITE_IMAGE;
+    }
+
+    /* straight into the staging buffer; like sprite_batch_add_image(), nothing the GPU reads is overwritten */
+    SpriteAtlasPage* page = &batch->pages[page_index];
+    if (!texture_transcode(graphics->jobs, data, target, page->staging_mapped + sprite_page_offset(page, rect.x, rect.y), sprite_page_pitch(page))) {
+        /* the rectangle stays packed; the atlas never frees one */
+        fprintf(stderr, "texture %s is corrupt\n", path);
+        return GRAPHICS_INVALID_SPRITE_IMAGE;
+    }
+
+    strcpy(batch->textures[batch->textures_count], path);
+    return sprite_batch_finish_image(batch, page_index, rect, info->width, info->height, ++batch->textures_count);
+}
+
+GraphicsSpriteImage sprite_batch_load_image(SpriteBatch* batch, const char* path) {
+    TRACE_ZONE("sprite_batch_load_image");
+
+    VulkanGraphics* graphics = batch->graphics;
+
+    if (batch->images_count >= SPRITE_MAX_IMAGES || batch->textures_count >= SPRITE_MAX_TEXTURES) {
+        fprintf(stderr, "too many sprite images (max %u, %u of them loaded), can't load %s\n", SPRITE_MAX_IMAGES, SPRITE_MAX_TEXTURES, path);
+        return GRAPHICS_INVALID_SPRITE_IMAGE;
+    }
+
+    if (strlen(path) >= SPRITE_MAX_PATH) {
+        fprintf(stderr, "texture path too long: %s\n", path);
+        return GRAPHICS_INVALID_SPRITE_IMAGE;
+    }
+
+    FileView view = { 0 };
+    const byte* data;
+    u64 size;
+
+    u32 entry = graphics->assets_open ? archive_find(&graphics->assets, path) : UINT32_MAX;
+    if (entry != UINT32_MAX) {
+        data = archive_entry_data(&graphics->assets, entry, &size);
+    } else {
+        view = file_view_open(path);
+        data = view.data;
+        size = view.length;
+    }
+
+    if (data == NULL) {
+        fprintf(stderr, "couldn't open texture %s\n", path);
+        return GRAPHICS_INVALID_SPRITE_IMAGE;
+    }
+
+    GraphicsSpriteImage image = GRAPHICS_INVALID_SPRITE_IMAGE;
+
+    TextureInfo info;
+    if (texture_read_info(data, size, &info))
+        image = sprite_batch_place_texture(batch, path, data, &info);
+    else
+        fprintf(stderr, "%s isn't a valid texture (version %u expected)\n", path, TEXTURE_VERSION);
+
+    if (view.data)
+        file_view_close(&view);
+
+    return image;
+}
+
+void sprite_batch_record_images(SpriteBatch* batch, Recorder* recorder) {
+    for (u32 i = 0; i < batch->images_count; ++i) {
+        const SpriteImage* image = &batch->images[i];
+        const SpriteAtlasPage* page = &batch->pages[image->page];
+
+        if (image->texture) {
+            const char* path = batch->textures[image->texture - 1];
+            recorder_write(recorder, RECORDING_CMD_SPRITE_TEXTURE, path, (u32)strlen(path) + 1);
+            continue;
+        }
+
+        RecordedSpriteImage header = { image->rect.width, image->rect.height };
+        recorder_begin(recorder, RECORDING_CMD_SPRITE_IMAGE, sizeof(header) + header.width * header.height * 4);
+        recorder_append(recorder, &header, sizeof(header));
+
+        /* the staging buffer still holds every image; reading it may be slow, but this happens once */
+        for (u32 y = 0; y < header.height; ++y)
+            recorder_append(recorder, page->staging_mapped + sprite_page_offset(page, image->rect.x, image->rect.y + y), (usize)header.width * 4);
+
+        recorder_end(recorder);
+    }
+}
+
+void sprite_batch_push(SpriteBatch* batch, const GraphicsSprite* sprites, u32 count) {
+    if (batch->count + count > SPRITE_BATCH_CAPACITY) {
+        if (!batch->overflowed)
+            fprintf(stderr, "sprite batch: more than %u sprites in a frame, dropping the rest\n", SPRITE_BATCH_CAPACITY);
+
+        batch->overflowed = true;
+        count = SPRITE_BATCH_CAPACITY - batch->count;
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        const GraphicsSprite* sprite = &sprites[i];
+        if (sprite->image >= batch->images_count)
+            continue;
+
+        const SpriteImage* image = &batch->images[sprite->image];
+
+        batch->instances[batch->count] = (SpriteInstance) {
+            .rect = { sprite->x, sprite->y, sprite->width, sprite->height },
+            .uv = { image->uv[0], image->uv[1], image->uv[2], image->uv[3] },
+            .color = sprite->color,
+            .rotation = sprite->rotation,
+        };
+        batch->keys[batch->count] = (u32)sprite->layer << 8 | image->page;
+        batch->count++;
+    }
+}
+
+bool sprite_batch_is_empty(const SpriteBatch* batch) {
+    return batch->count == 0;
+}
+
+void sprite_batch_upload(SpriteBatch* batch, VkCommandBuffer command_buffer) {
+    for (u32 i = 0; i < batch->pages_count; ++i) {
+        SpriteAtlasPage* page = &batch->pages[i];
+        if (page->dirty_x0 == page->dirty_x1)
+            continue;
+
+        VkImageMemoryBarrier2 barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            /* earlier frames may still be sampling the page */
+            .srcStageMask = page->uploaded ? VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_2_NONE,
+            .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .oldLayout = page->uploaded ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = page->image,
+            .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+        };
+
+        VkDependencyInfo dependency = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = &barrier,
+        };
+
+        vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+        VkBufferImageCopy region = {
+            /* in texels, even on compressed pages, where the dirty area is block aligned */
+            .bufferOffset = sprite_page_offset(page, page->dirty_x0, page->dirty_y0),
+            .bufferRowLength = SPRITE_ATLAS_SIZE,
+            .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .imageOffset = { (s32)page->dirty_x0, (s32)page->dirty_y0, 0 },
+            .imageExtent = { page->dirty_x1 - page->dirty_x0, page->dirty_y1 - page->dirty_y0, 1 },
+        };
+
+        vkCmdCopyBufferToImage(command_buffer, page->staging, page->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+        page->dirty_x0 = page->dirty_x1 = 0;
+        page->dirty_y0 = page->dirty_y1 = 0;
+        page->uploaded = true;
+    }
+}
+
+/* stable LSD radix sort of the queued sprites by key, a byte per pass; returns the sorted indices. */
+static const u32* sprite_batch_sort(SpriteBatch* batch) {
+    TRACE_FUNCTION();
+
+    u32* order = batch->order;
+    u32* scratch = batch->scratch;
+    const u32* keys = batch->keys;
+    u32 count = batch->count;
+
+    for (u32 i = 0; i < count; ++i)
+        order[i] = i;
+
+    /* keys are 24 bits: page, then the layer */
+    for (u32 shift = 0; shift < 24; shift += 8) {
+        u32 histogram[256] = { 0 };
+        for (u32 i = 0; i < count; ++i)
+            histogram[(keys[i] >> shift) & 0xff]++;
+
+        /* typically every sprite is on the same page and in a handful of layers; those passes are no-ops */
+        if (histogram[(keys[0] >> shift) & 0xff] == count)
+            continue;
+
+        u32 offset = 0;
+        for (u32 digit = 0; digit < 256; ++digit) {
+            u32 digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+
+        for (u32 i = 0; i < count; ++i) {
+            u32 index = order[i];
+            scratch[histogram[(keys[index] >> shift) & 0xff]++] = index;
+        }
+
+        u32* swap = order;
+        order = scratch;
+        scratch = swap;
+    }
+
+    return order;
+}
+
+void sprite_batch_draw(SpriteBatch* batch, VkCommandBuffer command_buffer, VkExtent2D target, u32 frame) {
+    TRACE_FUNCTION();
+
+    u32 count = batch->count;
+    if (count == 0)
+        return;
+
+    const u32* order = sprite_batch_sort(batch);
+
+    /* sequential writes only; the stream may well be write-combined */
+    SpriteInstance* stream = batch->stream_mapped + (usize)frame * SPRITE_BATCH_CAPACITY;
+    for (u32 i = 0; i < count; ++i)
+        stream[i] = batch->instances[order[i]];
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch->pipeline);
+
+    VkDeviceSize offset = (VkDeviceSize)frame * SPRITE_BATCH_CAPACITY * sizeof(SpriteInstance);
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &batch->stream, &offset);
+
+    float pixel_to_ndc[2] = { 2.0f / (float)target.width, 2.0f / (float)target.height };
+    vkCmdPushConstants(command_buffer, batch->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pixel_to_ndc), pixel_to_ndc);
+
+    /* layers only order the runs; consecutive layers on the same page go into one draw */
+    u32 first = 0;
+    while (first < count) {
+        u32 page = batch->keys[order[first]] & 0xff;
+
+        u32 last = first + 1;
+        while (last < count && (batch->keys[order[last]] & 0xff) == page)
+            last++;
+
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch->pipeline_layout, 0, 1, &batch->pages[page].set, 0, NULL);
+        vkCmdDraw(command_buffer, 6, last - first, 0, first);
+        first = last;
+    }
+
+    batch->count = 0;
+    batch->overflowed = false;
+}
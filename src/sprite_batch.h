@@ -0,0 +1,52 @@
+#pragma once
+
+#include "types.h"
+#include "renderer.h"
+#include "recording.h"
+
+#include <stdbool.h>
+#include <volk.h>
+
+/*
+ * Sprite batcher.
+ *
+ * Sprites are queued on the CPU, then once per frame sorted by layer and atlas page and written as one
+ * instance each into a persistently mapped vertex stream, a slice of it per frame in flight. Every run of
+ * sprites on the same atlas page becomes a single instanced draw, so a frame of sprites costs one draw per
+ * atlas page touched in each layer, however many sprites there are.
+ *
+ * The atlas is a few shelf packed pages (see atlas.h). Added images are copied into a host visible mirror
+ * of their page and uploaded with the next frame, one copy of the dirty area per page. Images loaded from
+ * cooked textures are transcoded into that mirror (see texture.h) and go onto pages of the block compressed
+ * format the GPU samples, a page per format.
+ */
+
+#define SPRITE_BATCH_CAPACITY (u32)131072
+#define SPRITE_ATLAS_SIZE (u32)2048
+#define SPRITE_ATLAS_MAX_PAGES (u32)8
+#define SPRITE_MAX_IMAGES (u32)4096
+#define SPRITE_MAX_TEXTURES (u32)1024
+
+typedef struct SpriteBatch SpriteBatch;
+
+SpriteBatch* sprite_batch_create(VulkanGraphics* graphics);
+void sprite_batch_destroy(SpriteBatch* batch);
+
+GraphicsSpriteImage sprite_batch_add_image(SpriteBatch* batch, const u8* pixels, u32 width, u32 height);
+/* loads a cooked texture from the asset archive, or from a loose file. */
+GraphicsSpriteImage sprite_batch_load_image(SpriteBatch* batch, const char* path);
+
+/* writes every image added or loaded so far, in order, as RECORDING_CMD_SPRITE_IMAGE and
+ * RECORDING_CMD_SPRITE_TEXTURE commands. */
+void sprite_batch_record_images(SpriteBatch* batch, Recorder* recorder);
+
+/* sprites past SPRITE_BATCH_CAPACITY in one frame are dropped. */
+void sprite_batch_push(SpriteBatch* batch, const GraphicsSprite* sprites, u32 count);
+bool sprite_batch_is_empty(const SpriteBatch* batch);
+
+/* records pending atlas uploads; must be outside of a render pass. */
+void sprite_batch_upload(SpriteBatch* batch, VkCommandBuffer command_buffer);
+
+/* writes the queued sprites into the stream slice of `frame` and records their draws into the current
+ * rendering, which must cover `target`. the queue is empty afterwards. */
+void sprite_batch_draw(SpriteBatch* batch, VkCommandBuffer command_buffer, VkExtent2D target, u32 frame);
@@ -3,6 +3,7 @@
 #include "SDL_init.h"
 #include "SDL_video.h"
 #include "types.h"
+#include "trace.h"
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
@@ -25,7 +26,6 @@ void sdl_wayland_titlebar_workaround() {
 
 struct Surface {
     SDL_Window* window;
-    SDL_Event event;
 
     int has_received_close;
     int width, height;
@@ -35,6 +35,10 @@ struct Surface {
     void* data;
 };
 
+/* SDL has one event queue for every window; events are handed to the surface of the window they're for. */
+#define MAX_SURFACES (u32)16
+static Surface* surfaces[MAX_SURFACES];
+
 Surface* surface_create(int width, int height, const char* title) {
     sdl_wayland_titlebar_workaround();
 
@@ -45,12 +49,26 @@ Surface* surface_create(int width, int height, const char* title) {
     memset(surface, 0, sizeof(Surface));
 
     surface->window = SDL_CreateWindow(title, width, height, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+    surface->width = width;
+    surface->height = height;
     surface->data = NULL;
 
+    for (u32 i = 0; i < ZARRSIZ(surfaces); ++i) {
+        if (surfaces[i] == NULL) {
+            surfaces[i] = surface;
+            break;
+        }
+    }
+
     return surface;
 }
 
 void surface_destroy(Surface* surface) {
+    for (u32 i = 0; i < ZARRSIZ(surfaces); ++i) {
+        if (surfaces[i] == surface)
+            surfaces[i] = NULL;
+    }
+
     SDL_DestroyWindow(surface->window);
     free(surface);
 }
@@ -64,16 +82,16 @@ void surface_get_size(Surface* surface, int* width, int* height) {
     *height = surface->height;
 }
 
-static inline void surface_event_handler(Surface* surface) {
-    switch (surface->event.type) {
+static inline void surface_event_handler(Surface* surface, const SDL_Event* event) {
+    switch (event->type) {
         case SDL_EVENT_QUIT:
         case SDL_EVENT_WINDOW_CLOSE_REQUESTED:
             surface->has_received_close = true;
             break;
 
         case SDL_EVENT_WINDOW_RESIZED:
-            surface->width = surface->event.window.data1;
-            surface->height = surface->event.window.data2;
+            surface->width = event->window.data1;
+            surface->height = event->window.data2;
             CALL_LISTENERS(surface->on_resize_callbacks, surface, surface->width, surface->height);
             break;
 
@@ -83,14 +101,30 @@ static inline void surface_event_handler(Surface* surface) {
     }
 }
 
+/* quitting closes every surface, window events only their own one */
+static void surface_dispatch_event(const SDL_Event* event) {
+    for (u32 i = 0; i < ZARRSIZ(surfaces); ++i) {
+        if (surfaces[i] == NULL)
+            continue;
+
+        if (event->type == SDL_EVENT_QUIT || event->window.windowID == SDL_GetWindowID(surfaces[i]->window))
+            surface_event_handler(surfaces[i], event);
+    }
+}
+
+/* handles the events of all surfaces, not only this one's */
 void surface_poll_events(Surface* surface) {
-    while (SDL_PollEvent(&surface->event))
-        surface_event_handler(surface);
+    TRACE_FUNCTION();
+
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+        surface_dispatch_event(&event);
 }
 
 void surface_wait_event(Surface* surface) {
-    SDL_WaitEvent(&surface->event);
-    surface_event_handler(surface);
+    SDL_Event event;
+    SDL_WaitEvent(&event);
+    surface_dispatch_event(&event);
 }
 
 /* used internally by renderer.c */
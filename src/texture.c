@@ -0,0 +1,418 @@
+#include "texture.h"
+#include "texture_format.h"
+#include "lz4.h"
+#include "trace.h"
+
+#include <string.h>
+#include <stdatomic.h>
+
+/* the blocks of the largest chunk, decompressed; on the stack of the job transcoding it */
+#define TEXTURE_MAX_CHUNK_SIZE ((TEXTURE_MAX_SIZE / 4) * TEXTURE_CHUNK_BLOCK_ROWS * TEXTURE_BLOCK_SIZE)
+
+/* half the spread of the ETC1 intensity tables, the other half being the same negated */
+static const s32 texture_etc1_modifiers[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+static const s32 texture_eac_modifiers[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5, -8, -13, 1, 4, 7, 12 },
+    { -2, -4, -6, -13, 1, 3, 5, 12 },
+    { -3, -6, -8, -12, 2, 5, 7, 11 },
+    { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 },
+    { -3, -5, -8, -11, 2, 4, 7, 10 },
+    { -2, -6, -8, -10, 1, 5, 7, 9 },
+    { -2, -5, -8, -10, 1, 4, 7, 9 },
+    { -2, -4, -8, -10, 1, 3, 7, 9 },
+    { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 },
+    { -1, -2, -3, -10, 0, 1, 2, 9 },
+    { -4, -6, -8, -9, 3, 5, 7, 8 },
+    { -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+static inline s32 texture_clamp_byte(s32 value) {
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+static bool texture_format_usable(VkPhysicalDevice gpu, VkFormat format) {
+    const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(gpu, format, &props);
+    return (props.optimalTilingFeatures & needed) == needed;
+}
+
+enum TextureTarget texture_select_target(VkPhysicalDevice gpu, const VkPhysicalDeviceFeatures* supported) {
+    /* BC first: it's a copy, where ETC2 has to be encoded */
+    static const enum TextureTarget targets[] = { TEXTURE_TARGET_BC, TEXTURE_TARGET_ETC2 };
+
+    for (u32 i = 0; i < ZARRSIZ(targets); ++i) {
+        bool feature = targets[i] == TEXTURE_TARGET_BC ? supported->textureCompressionBC : supported->textureCompressionETC2;
+        if (feature && texture_format_usable(gpu, texture_target_format(targets[i], false)) && texture_format_usable(gpu, texture_target_format(targets[i], true)))
+            return targets[i];
+    }
+
+    return TEXTURE_TARGET_RGBA8;
+}
+
+VkFormat texture_target_format(enum TextureTarget target, bool alpha) {
+    switch (target) {
+        case TEXTURE_TARGET_BC:
+            return alpha ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        case TEXTURE_TARGET_ETC2:
+            return alpha ? VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK : VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;
+        default:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+    }
+}
+
+u32 texture_target_block_size(enum TextureTarget target, bool alpha) {
+    if (target == TEXTURE_TARGET_RGBA8)
+        return 16 * 4;
+
+    return alpha ? 16 : 8;
+}
+
+bool texture_read_info(const byte* data, u64 size, TextureInfo* info) {
+    const TextureFileHeader* header = (const TextureFileHeader*)data;
+    if (size < sizeof(TextureFileHeader) || header->magic != TEXTURE_MAGIC || header->version != TEXTURE_VERSION)
+        return false;
+
+    if (header->width == 0 || header->height == 0 || header->width > TEXTURE_MAX_SIZE || header->height > TEXTURE_MAX_SIZE)
+        return false;
+
+    u32 block_rows = (header->height + 3) / 4;
+    if (header->chunk_count != (block_rows + TEXTURE_CHUNK_BLOCK_ROWS - 1) / TEXTURE_CHUNK_BLOCK_ROWS)
+        return false;
+
+    if ((u64)header->chunk_count * sizeof(TextureChunk) > size - sizeof(TextureFileHeader))
+        return false;
+
+    const TextureChunk* chunks = (const TextureChunk*)(header + 1);
+    for (u32 i = 0; i < header->chunk_count; ++i) {
+        if ((u64)chunks[i].offset + chunks[i].compressed_size > size)
+            return false;
+    }
+
+    info->width = header->width;
+    info->height = header->height;
+    info->alpha = header->flags & TEXTURE_FLAG_ALPHA;
+    return true;
+}
+
+/* the color half of a stored block, always in four color mode like BC3's. texels are row by row. */
+static void texture_decode_color(const u8* block, u8 texels[16][4]) {
+    u16 endpoints[2] = { (u16)(block[0] | block[1] << 8), (u16)(block[2] | block[3] << 8) };
+
+    s32 palette[4][3];
+    for (u32 i = 0; i < 2; ++i) {
+        s32 r = endpoints[i] >> 11 & 31, g = endpoints[i] >> 5 & 63, b = endpoints[i] & 31;
+        palette[i][0] = r << 3 | r >> 2;
+        palette[i][1] = g << 2 | g >> 4;
+        palette[i][2] = b << 3 | b >> 2;
+    }
+
+    for (u32 c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    u32 selectors = block[4] | block[5] << 8 | block[6] << 16 | (u32)block[7] << 24;
+    for (u32 i = 0; i < 16; ++i) {
+        const s32* color = palette[selectors >> (2 * i) & 3];
+        texels[i][0] = (u8)color[0];
+        texels[i][1] = (u8)color[1];
+        texels[i][2] = (u8)color[2];
+    }
+}
+
+/* the alpha half of a stored block, as BC4 decodes it. */
+static void texture_decode_alpha(const u8* block, u8 texels[16][4]) {
+    s32 a0 = block[0], a1 = block[1];
+
+    s32 palette[8] = { a0, a1 };
+    if (a0 > a1) {
+        for (s32 i = 1; i < 7; ++i)
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+        for (s32 i = 1; i < 5; ++i)
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    u64 selectors = 0;
+    for (u32 i = 0; i < 6; ++i)
+        selectors |= (u64)block[2 + i] << (8 * i);
+
+    for (u32 i = 0; i < 16; ++i)
+        texels[i][3] = (u8)palette[selectors >> (3 * i) & 7];
+}
+
+/* the table and pixel indices of one ETC1 subblock around `base`; returns the squared error. */
+static u32 texture_etc1_fit_subblock(const u8 texels[16][4], bool flip, u32 subblock, const s32 base[3], u32* table, u32 indices[16]) {
+    u32 best_error = UINT32_MAX;
+
+    for (u32 t = 0; t < 8; ++t) {
+        /* index 0 and 1 add the small and the large modifier, 2 and 3 subtract them */
+        s32 modifiers[4] = { texture_etc1_modifiers[t][0], texture_etc1_modifiers[t][1], -texture_etc1_modifiers[t][0], -texture_etc1_modifiers[t][1] };
+
+        u32 error = 0;
+        u32 picks[16];
+        for (u32 i = 0; i < 16 && error < best_error; ++i) {
+            u32 x = i % 4, y = i / 4;
+            if ((flip ? y / 2 : x / 2) != subblock)
+                continue;
+
+            u32 best_pixel = UINT32_MAX;
+            for (u32 m = 0; m < 4; ++m) {
+                u32 pixel = 0;
+                for (u32 c = 0; c < 3; ++c) {
+                    s32 d = texture_clamp_byte(base[c] + modifiers[m]) - texels[i][c];
+                    pixel += (u32)(d * d);
+                }
+
+                if (pixel < best_pixel) {
+                    best_pixel = pixel;
+                    picks[i] = m;
+                }
+            }
+
+            error += best_pixel;
+        }
+
+        if (error < best_error) {
+            best_error = error;
+            *table = t;
+
+            for (u32 i = 0; i < 16; ++i) {
+                if ((flip ? i / 4 / 2 : i % 4 / 2) == subblock)
+                    indices[i] = picks[i];
+            }
+        }
+    }
+
+    return best_error;
+}
+
+/* an ETC1 block, which ETC2 decodes the same: both flips, each subblock around its average color, in
+ * differential mode where the averages are close enough and in individual mode otherwise. */
+static void texture_encode_etc1(const u8 texels[16][4], u8* out) {
+    u64 best_bits = 0;
+    u32 best_error = UINT32_MAX;
+
+    for (u32 flip = 0; flip < 2; ++flip) {
+        float average[2][3] = { { 0 } };
+        for (u32 i = 0; i < 16; ++i) {
+            u32 subblock = flip ? i / 4 / 2 : i % 4 / 2;
+            for (u32 c = 0; c < 3; ++c)
+                average[subblock][c] += texels[i][c] / 8.0f;
+        }
+
+        s32 quantized[2][3];
+        bool differential = true;
+        for (u32 c = 0; c < 3; ++c) {
+            quantized[0][c] = (s32)(average[0][c] * 31.0f / 255.0f + 0.5f);
+            quantized[1][c] = (s32)(average[1][c] * 31.0f / 255.0f + 0.5f);
+
+            s32 delta = quantized[1][c] - quantized[0][c];
+            differential &= delta >= -4 && delta <= 3;
+        }
+
+        s32 base[2][3];
+        for (u32 s = 0; s < 2; ++s) {
+            for (u32 c = 0; c < 3; ++c) {
+                if (!differential)
+                    quantized[s][c] = (s32)(average[s][c] * 15.0f / 255.0f + 0.5f);
+
+                base[s][c] = differential ? quantized[s][c] << 3 | quantized[s][c] >> 2 : quantized[s][c] * 17;
+            }
+        }
+
+        u32 tables[2];
+        u32 indices[16];
+        u32 error = texture_etc1_fit_subblock(texels, flip, 0, base[0], &tables[0], indices);
+        if (error >= best_error)
+            continue;
+
+        error += texture_etc1_fit_subblock(texels, flip, 1, base[1], &tables[1], indices);
+        if (error >= best_error)
+            continue;
+
+        u64 bits = 0;
+        for (u32 c = 0; c < 3; ++c) {
+            /* R at the top, then G and B, a byte each */
+            u32 shift = 59 - 8 * c;
+            if (differential)
+                bits |= (u64)quantized[0][c] << shift | (u64)((quantized[1][c] - quantized[0][c]) & 7) << (shift - 3);
+            else
+                bits |= (u64)quantized[0][c] << (shift + 1) | (u64)quantized[1][c] << (shift - 3);
+        }
+
+        bits |= (u64)tables[0] << 37 | (u64)tables[1] << 34 | (u64)differential << 33 | (u64)flip << 32;
+
+        /* pixels go column by column, the most significant bits of their indices above the least */
+        for (u32 i = 0; i < 16; ++i) {
+            u32 p = i % 4 * 4 + i / 4;
+            bits |= (u64)(indices[i] >> 1) << (16 + p) | (u64)(indices[i] & 1) << p;
+        }
+
+        best_bits = bits;
+        best_error = error;
+    }
+
+    for (u32 i = 0; i < 8; ++i)
+        out[i] = (u8)(best_bits >> (56 - 8 * i));
+}
+
+/* an EAC alpha block: for every table, the multipliers around the one that spans the alpha range, with the base
+ * centering it. */
+static void texture_encode_eac(const u8 texels[16][4], u8* out) {
+    s32 min = 255, max = 0;
+    for (u32 i = 0; i < 16; ++i) {
+        min = texels[i][3] < min ? texels[i][3] : min;
+        max = texels[i][3] > max ? texels[i][3] : max;
+    }
+
+    /* a flat block: table 13 has a zero modifier */
+    u32 best_base = (u32)min, best_multiplier = 1, best_table = 13;
+    u32 best_indices[16] = { 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4 };
+
+    if (min != max) {
+        u32 best_error = UINT32_MAX;
+
+        for (u32 t = 0; t < 16 && best_error > 0; ++t) {
+            const s32* modifiers = texture_eac_modifiers[t];
+            s32 spread = modifiers[7] - modifiers[3];
+            s32 fit = (max - min + spread / 2) / spread;
+
+            for (s32 multiplier = fit - 1; multiplier <= fit + 1; ++multiplier) {
+                if (multiplier < 1 || multiplier > 15)
+                    continue;
+
+                s32 base = texture_clamp_byte((min + max + 1) / 2 - (modifiers[7] + modifiers[3]) * multiplier / 2);
+
+                u32 error = 0;
+                u32 indices[16];
+                for (u32 i = 0; i < 16 && error < best_error; ++i) {
+                    u32 best_pixel = UINT32_MAX;
+                    for (u32 k = 0; k < 8; ++k) {
+                        s32 d = texture_clamp_byte(base + modifiers[k] * multiplier) - texels[i][3];
+                        if ((u32)(d * d) < best_pixel) {
+                            best_pixel = (u32)(d * d);
+                            indices[i] = k;
+                        }
+                    }
+
+                    error += best_pixel;
+                }
+
+                if (error < best_error) {
+                    best_error = error;
+                    best_base = (u32)base;
+                    best_multiplier = (u32)multiplier;
+                    best_table = t;
+                    memcpy(best_indices, indices, sizeof(indices));
+                }
+            }
+        }
+    }
+
+    u64 bits = (u64)best_base << 56 | (u64)best_multiplier << 52 | (u64)best_table << 48;
+    for (u32 i = 0; i < 16; ++i) {
+        u32 p = i % 4 * 4 + i / 4;
+        bits |= (u64)best_indices[i] << (45 - 3 * p);
+    }
+
+    for (u32 i = 0; i < 8; ++i)
+        out[i] = (u8)(bits >> (56 - 8 * i));
+}
+
+typedef struct TextureJob {
+    const TextureFileHeader* header;
+    const byte* data;
+    enum TextureTarget target;
+    bool alpha;
+    u8* dst;
+    usize pitch;
+
+    atomic_bool failed;
+} TextureJob;
+
+static void texture_transcode_block(const TextureJob* job, const u8* block, u32 block_x, u32 block_y) {
+    if (job->target == TEXTURE_TARGET_BC) {
+        /* the color half goes on its own as BC1 */
+        u32 size = texture_target_block_size(job->target, job->alpha);
+        memcpy(job->dst + block_y * job->pitch + (usize)block_x * size, job->alpha ? block : block + 8, size);
+        return;
+    }
+
+    u8 texels[16][4];
+    texture_decode_alpha(block, texels);
+    texture_decode_color(block + 8, texels);
+
+    if (job->target == TEXTURE_TARGET_ETC2) {
+        u8* out = job->dst + block_y * job->pitch + (usize)block_x * texture_target_block_size(job->target, job->alpha);
+        if (job->alpha) {
+            texture_encode_eac(texels, out);
+            out += 8;
+        }
+
+        texture_encode_etc1(texels, out);
+        return;
+    }
+
+    /* RGBA8, which has no blocks to pad */
+    for (u32 y = 0; y < 4 && block_y * 4 + y < job->header->height; ++y) {
+        for (u32 x = 0; x < 4 && block_x * 4 + x < job->header->width; ++x)
+            memcpy(job->dst + (block_y * 4 + y) * job->pitch + (usize)(block_x * 4 + x) * 4, texels[y * 4 + x], 4);
+    }
+}
+
+static void texture_transcode_chunks(void* data, u32 first, u32 count) {
+    TextureJob* job = data;
+    const TextureFileHeader* header = job->header;
+    const TextureChunk* chunks = (const TextureChunk*)(header + 1);
+
+    u32 blocks_x = (header->width + 3) / 4;
+    u32 blocks_y = (header->height + 3) / 4;
+
+    u8 blocks[TEXTURE_MAX_CHUNK_SIZE];
+
+    for (u32 c = first; c < first + count; ++c) {
+        u32 first_row = c * TEXTURE_CHUNK_BLOCK_ROWS;
+        u32 rows = blocks_y - first_row < TEXTURE_CHUNK_BLOCK_ROWS ? blocks_y - first_row : TEXTURE_CHUNK_BLOCK_ROWS;
+
+        if (!lz4_decompress((const u8*)job->data + chunks[c].offset, chunks[c].compressed_size, blocks, (usize)blocks_x * rows * TEXTURE_BLOCK_SIZE)) {
+            atomic_store(&job->failed, true);
+            continue;
+        }
+
+        for (u32 y = 0; y < rows; ++y) {
+            for (u32 x = 0; x < blocks_x; ++x)
+                texture_transcode_block(job, blocks + ((usize)y * blocks_x + x) * TEXTURE_BLOCK_SIZE, x, first_row + y);
+        }
+    }
+}
+
+bool texture_transcode(JobSystem* jobs, const byte* data, enum TextureTarget target, u8* dst, usize pitch) {
+    TRACE_FUNCTION();
+
+    TextureJob job = {
+        .header = (const TextureFileHeader*)data,
+        .data = data,
+        .target = target,
+        .alpha = ((const TextureFileHeader*)data)->flags & TEXTURE_FLAG_ALPHA,
+        .dst = dst,
+        .pitch = pitch,
+    };
+    atomic_init(&job.failed, false);
+
+    /* copying is cheap enough to go a few chunks at a time, encoding ETC2 isn't */
+    jobs_parallel_for(jobs, texture_transcode_chunks, &job, job.header->chunk_count, target == TEXTURE_TARGET_ETC2 ? 1 : 4);
+
+    return !atomic_load(&job.failed);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "types.h"
+#include "jobs.h"
+
+#include <stdbool.h>
+#include <volk.h>
+
+/*
+ * Texture transcoding.
+ *
+ * Cooked textures (texture_format.h) are turned into whatever the GPU samples best when they're loaded, on the
+ * job system, a chunk of block rows per job:
+ *   - BC: the stored blocks are BC3 blocks already, and their color halves BC1 blocks, so they're copied;
+ *   - ETC2: every block is decoded and encoded again, the color as an ETC1 block (which ETC2 decodes the same)
+ *     and the alpha as an EAC block;
+ *   - RGBA8, where neither is supported: every block is decoded.
+ * Opaque textures take the formats without alpha, at 4 bits per texel; the others 8, against RGBA8's 32.
+ */
+
+enum TextureTarget {
+    TEXTURE_TARGET_RGBA8,
+    TEXTURE_TARGET_BC,
+    TEXTURE_TARGET_ETC2,
+};
+
+typedef struct TextureInfo {
+    u32 width;
+    u32 height;
+    bool alpha;
+} TextureInfo;
+
+/* the best target `gpu` can sample and copy into; BC and ETC2 need textureCompressionBC and textureCompressionETC2
+ * enabled on the device. */
+enum TextureTarget texture_select_target(VkPhysicalDevice gpu, const VkPhysicalDeviceFeatures* supported);
+
+/* the sRGB format a texture is transcoded into. */
+VkFormat texture_target_format(enum TextureTarget target, bool alpha);
+
+/* bytes per 4x4 block of texture_target_format(). */
+u32 texture_target_block_size(enum TextureTarget target, bool alpha);
+
+/* returns false unless `data` is a texture whose chunks all lie inside of it. */
+bool texture_read_info(const byte* data, u64 size, TextureInfo* info);
+
+/* transcodes a texture that passed texture_read_info() into `dst`. with a block target, `pitch` bytes apart
+ * are rows of blocks, and the blocks past the edges are written too; with RGBA8 they're rows of texels, and
+ * only the texels of the image are. returns false if a chunk is corrupt. */
+bool texture_transcode(JobSystem* jobs, const byte* data, enum TextureTarget target, u8* dst, usize pitch);
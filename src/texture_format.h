@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Cooked texture format, written by tools/texture_cooker and transcoded by the renderer at load time (see
+ * texture.h) into whatever block compression the GPU samples.
+ *
+ * The image is cut into 4x4 blocks, each stored as 16 bytes laid out like a BC3 block: an alpha block of two
+ * 8 bit endpoints and 3 bit selectors, then a color block of two RGB565 endpoints and 2 bit selectors. The
+ * color endpoints are always ordered c0 > c1 (or are equal with every selector 0), so the color block is a
+ * valid four color BC1 block on its own. Blocks are stored row by row, and TEXTURE_CHUNK_BLOCK_ROWS rows at a
+ * time are LZ4 compressed independently (see lz4.h), so chunks can be decompressed and transcoded in parallel.
+ *
+ * A TextureFileHeader, then a TextureChunk per chunk, then the compressed chunks at the offsets they give.
+ * Colors are sRGB. Everything is little endian, in the layout of the structs below.
+ */
+
+#define TEXTURE_MAGIC (u32)0x5845545a /* "ZTEX" */
+#define TEXTURE_VERSION (u32)1
+
+#define TEXTURE_MAX_SIZE (u32)4096
+#define TEXTURE_BLOCK_SIZE (u32)16
+#define TEXTURE_CHUNK_BLOCK_ROWS (u32)4
+
+/* some texel isn't fully opaque */
+#define TEXTURE_FLAG_ALPHA (u32)1
+
+typedef struct TextureChunk {
+    u32 offset;
+    u32 compressed_size;
+} TextureChunk;
+
+typedef struct TextureFileHeader {
+    u32 magic;
+    u32 version;
+
+    /* in texels; the blocks past the edges are padded by repeating the last texel */
+    u32 width;
+    u32 height;
+    u32 flags;
+    u32 chunk_count;
+} TextureFileHeader;
@@ -0,0 +1,173 @@
+#include "thread.h"
+
+#include "arena.h"
+
+/* the entry point signatures differ per platform, so the user function is called through this. */
+typedef struct ThreadStart {
+    ThreadFunc function;
+    void* data;
+} ThreadStart;
+
+#if defined(ZULK_WIN32)
+static DWORD WINAPI thread_entry(LPVOID param) {
+    ThreadStart start = *(ThreadStart*)param;
+    heap_free(param);
+
+    start.function(start.data);
+    return 0;
+}
+
+bool thread_create(Thread* thread, ThreadFunc function, void* data) {
+    ThreadStart* start = heap_alloc(sizeof(ThreadStart));
+    *start = (ThreadStart) { function, data };
+
+    *thread = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+    if (*thread == NULL) {
+        heap_free(start);
+        return false;
+    }
+
+    return true;
+}
+
+void thread_join(Thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+u32 thread_hardware_concurrency(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+void thread_yield(void) {
+    SwitchToThread();
+}
+
+u64 thread_now_ns(void) {
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (u64)((u128)counter.QuadPart * 1000000000ull / (u64)frequency.QuadPart);
+}
+
+void mutex_init(Mutex* mutex) {
+    InitializeSRWLock(mutex);
+}
+
+void mutex_destroy(Mutex* mutex) {
+}
+
+void mutex_lock(Mutex* mutex) {
+    AcquireSRWLockExclusive(mutex);
+}
+
+void mutex_unlock(Mutex* mutex) {
+    ReleaseSRWLockExclusive(mutex);
+}
+
+void cond_init(CondVar* cond) {
+    InitializeConditionVariable(cond);
+}
+
+void cond_destroy(CondVar* cond) {
+}
+
+void cond_wait(CondVar* cond, Mutex* mutex) {
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+
+void cond_signal(CondVar* cond) {
+    WakeConditionVariable(cond);
+}
+
+void cond_broadcast(CondVar* cond) {
+    WakeAllConditionVariable(cond);
+}
+#else
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+
+static void* thread_entry(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    heap_free(param);
+
+    start.function(start.data);
+    return NULL;
+}
+
+bool thread_create(Thread* thread, ThreadFunc function, void* data) {
+    ThreadStart* start = heap_alloc(sizeof(ThreadStart));
+    *start = (ThreadStart) { function, data };
+
+    if (pthread_create(thread, NULL, thread_entry, start) != 0) {
+        heap_free(start);
+        return false;
+    }
+
+    return true;
+}
+
+void thread_join(Thread thread) {
+    pthread_join(thread, NULL);
+}
+
+u32 thread_hardware_concurrency(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
+
+void thread_yield(void) {
+    sched_yield();
+}
+
+u64 thread_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+void mutex_init(Mutex* mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void mutex_destroy(Mutex* mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void mutex_lock(Mutex* mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void mutex_unlock(Mutex* mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void cond_init(CondVar* cond) {
+    pthread_cond_init(cond, NULL);
+}
+
+void cond_destroy(CondVar* cond) {
+    pthread_cond_destroy(cond);
+}
+
+void cond_wait(CondVar* cond, Mutex* mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+void cond_signal(CondVar* cond) {
+    pthread_cond_signal(cond);
+}
+
+void cond_broadcast(CondVar* cond) {
+    pthread_cond_broadcast(cond);
+}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "types.h"
+
+#include <stdbool.h>
+
+#if defined(ZULK_WIN32)
+#define WIN32_LEAN_AND_MEAN 1
+#include <Windows.h>
+
+typedef HANDLE Thread;
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#else
+#include <pthread.h>
+
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#endif
+
+typedef void (*ThreadFunc)(void* data);
+
+/* returns false if the thread couldn't be started. */
+bool thread_create(Thread* thread, ThreadFunc function, void* data);
+void thread_join(Thread thread);
+
+/* number of hardware threads, at least 1 */
+u32 thread_hardware_concurrency(void);
+
+/* gives the rest of the time slice to another thread. */
+void thread_yield(void);
+
+/* monotonic clock, for measuring waits. */
+u64 thread_now_ns(void);
+
+void mutex_init(Mutex* mutex);
+void mutex_destroy(Mutex* mutex);
+void mutex_lock(Mutex* mutex);
+void mutex_unlock(Mutex* mutex);
+
+void cond_init(CondVar* cond);
+void cond_destroy(CondVar* cond);
+/* `mutex` must be locked; it's locked again when this returns. wakeups may be spurious. */
+void cond_wait(CondVar* cond, Mutex* mutex);
+void cond_signal(CondVar* cond);
+void cond_broadcast(CondVar* cond);
@@ -0,0 +1,170 @@
+#include "trace.h"
+
+#if defined(ZULK_TRACE)
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(ZULK_WIN32)
+#define WIN32_LEAN_AND_MEAN 1
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct TraceThreadBuffer {
+    struct TraceThreadBuffer* next;
+
+    u32 thread_id;
+    const char* thread_name;
+
+    /* total amount of zones ever written by the owning thread; only the owner writes it. */
+    _Atomic u64 head;
+    TraceZone zones[TRACE_RING_CAPACITY];
+} TraceThreadBuffer;
+
+/* every buffer ever created, pushed lock-free. buffers are never freed so a dump can always walk this. */
+static _Atomic(TraceThreadBuffer*) trace_buffers = NULL;
+static _Atomic u32 trace_next_thread_id = 1;
+
+static _Thread_local TraceThreadBuffer* trace_local = NULL;
+
+static const char* trace_dump_path = NULL;
+
+u64 trace_now_ns(void) {
+#if defined(ZULK_WIN32)
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (u64)((u128)counter.QuadPart * 1000000000ull / (u64)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+#endif
+}
+
+static TraceThreadBuffer* trace_thread_buffer(void) {
+    if (trace_local != NULL)
+        return trace_local;
+
+    TraceThreadBuffer* buffer = calloc(1, sizeof(TraceThreadBuffer));
+    if (buffer == NULL)
+        return NULL;
+
+    buffer->thread_id = atomic_fetch_add(&trace_next_thread_id, 1);
+
+    TraceThreadBuffer* head = atomic_load_explicit(&trace_buffers, memory_order_relaxed);
+    do {
+        buffer->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&trace_buffers, &head, buffer, memory_order_release, memory_order_relaxed));
+
+    trace_local = buffer;
+    return buffer;
+}
+
+void trace_record(const char* name, u64 begin_ns, u64 end_ns) {
+    TraceThreadBuffer* buffer = trace_thread_buffer();
+    if (buffer == NULL)
+        return;
+
+    u64 head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+
+    TraceZone* zone = &buffer->zones[head % TRACE_RING_CAPACITY];
+    zone->name = name;
+    zone->begin_ns = begin_ns;
+    zone->end_ns = end_ns;
+
+    /* publishes the zone to trace_dump() */
+    atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+}
+
+void trace_set_thread_name(const char* name) {
+    TraceThreadBuffer* buffer = trace_thread_buffer();
+    if (buffer != NULL)
+        buffer->thread_name = name;
+}
+
+static void trace_write_string(FILE* file, const char* str) {
+    fputc('"', file);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', file);
+
+        if ((u8)*str >= 0x20)
+            fputc(*str, file);
+    }
+    fputc('"', file);
+}
+
+bool trace_dump(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "couldn't open trace file %s\n", path);
+        return false;
+    }
+
+    /* zero point is the earliest zone still in any buffer, so the timeline starts at 0. */
+    u64 origin = UINT64_MAX;
+    for (TraceThreadBuffer* buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        u64 head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        u64 first = head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+
+        for (u64 i = first; i < head; ++i) {
+            if (buffer->zones[i % TRACE_RING_CAPACITY].begin_ns < origin)
+                origin = buffer->zones[i % TRACE_RING_CAPACITY].begin_ns;
+        }
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first_event = true;
+    for (TraceThreadBuffer* buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        if (buffer->thread_name != NULL) {
+            fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first_event ? "" : ",\n", buffer->thread_id);
+            trace_write_string(file, buffer->thread_name);
+            fprintf(file, "}}");
+            first_event = false;
+        }
+
+        u64 head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        /* the owner may still be writing while we read; skip a few of the oldest slots it could be overwriting. */
+        u64 first = head > TRACE_RING_CAPACITY - 64 ? head - (TRACE_RING_CAPACITY - 64) : 0;
+
+        for (u64 i = first; i < head; ++i) {
+            TraceZone zone = buffer->zones[i % TRACE_RING_CAPACITY];
+
+            fprintf(file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", first_event ? "" : ",\n", buffer->thread_id);
+            trace_write_string(file, zone.name);
+            fprintf(file, ",\"ts\":%.3f,\"dur\":%.3f}", (double)(zone.begin_ns - origin) / 1000.0, (double)(zone.end_ns - zone.begin_ns) / 1000.0);
+            first_event = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+
+    return ok;
+}
+
+static void trace_dump_at_exit_handler(void) {
+    if (trace_dump_path != NULL && trace_dump(trace_dump_path))
+        printf("wrote cpu trace to %s\n", trace_dump_path);
+}
+
+void trace_dump_at_exit(const char* path) {
+    if (trace_dump_path == NULL)
+        atexit(trace_dump_at_exit_handler);
+
+    trace_dump_path = path;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ * Lightweight CPU zone tracing.
+ *
+ * Zones are recorded into a per-thread ring buffer (no locks, no allocation after the first zone on
+ * a thread) and can be written out as Chrome trace JSON, which both chrome://tracing and
+ * ui.perfetto.dev open directly.
+ *
+ * Everything here compiles to nothing unless ZULK_TRACE is defined (configure with -DZULK_TRACE=ON).
+ *
+ *     void foo(void) {
+ *         TRACE_FUNCTION();
+ *         ...
+ *         {
+ *             TRACE_ZONE("expensive part");
+ *             ...
+ *         }
+ *     }
+ */
+
+/* per thread; when a thread records more zones than this, the oldest ones are overwritten. */
+#define TRACE_RING_CAPACITY (u32)65536
+
+#if defined(ZULK_TRACE)
+
+/* zone names are stored as pointers, so they must outlive the dump: use string literals or __func__. */
+typedef struct TraceZone {
+    const char* name;
+    u64 begin_ns;
+    u64 end_ns;
+} TraceZone;
+
+u64 trace_now_ns(void);
+void trace_record(const char* name, u64 begin_ns, u64 end_ns);
+void trace_set_thread_name(const char* name);
+
+/* returns false if the file couldn't be written. safe to call at any time, from any thread. */
+bool trace_dump(const char* path);
+void trace_dump_at_exit(const char* path);
+
+struct TraceScope {
+    const char* name;
+    u64 begin_ns;
+};
+
+static inline void trace_scope_end(struct TraceScope* scope) {
+    trace_record(scope->name, scope->begin_ns, trace_now_ns());
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+/* records a zone from this point until the end of the enclosing block. */
+#define TRACE_ZONE(name) struct TraceScope TRACE_CONCAT(trace_scope_, __LINE__) __attribute__((cleanup(trace_scope_end))) = { name, trace_now_ns() }
+#define TRACE_FUNCTION() TRACE_ZONE(__func__)
+
+#define TRACE_THREAD_NAME(name) trace_set_thread_name(name)
+#define TRACE_DUMP(path) trace_dump(path)
+#define TRACE_DUMP_AT_EXIT(path) trace_dump_at_exit(path)
+
+#else
+
+#define TRACE_ZONE(name) do {} while(0)
+#define TRACE_FUNCTION() do {} while(0)
+
+#define TRACE_THREAD_NAME(name) do {} while(0)
+#define TRACE_DUMP(path) (false)
+#define TRACE_DUMP_AT_EXIT(path) do {} while(0)
+
+#endif
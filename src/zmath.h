@@ -0,0 +1,175 @@
+#pragma once
+
+#include "types.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+/*
+ * Just enough vector math for cameras and culling.
+ *
+ * Matrices are column major, like GLSL expects them, and multiply column vectors: m[column * 4 + row].
+ * Projections map depth to [0, 1] and flip y, matching Vulkan's clip space with a y-up world.
+ */
+
+typedef struct Vec3 {
+    float x, y, z;
+} Vec3;
+
+typedef struct Vec4 {
+    float x, y, z, w;
+} Vec4;
+
+typedef struct Mat4 {
+    float m[16];
+} Mat4;
+
+static inline Vec3 vec3(float x, float y, float z) {
+    return (Vec3) { x, y, z };
+}
+
+static inline Vec3 vec3_add(Vec3 a, Vec3 b) {
+    return (Vec3) { a.x + b.x, a.y + b.y, a.z + b.z };
+}
+
+static inline Vec3 vec3_sub(Vec3 a, Vec3 b) {
+    return (Vec3) { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static inline Vec3 vec3_scale(Vec3 a, float s) {
+    return (Vec3) { a.x * s, a.y * s, a.z * s };
+}
+
+static inline float vec3_dot(Vec3 a, Vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline Vec3 vec3_cross(Vec3 a, Vec3 b) {
+    return (Vec3) { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static inline float vec3_length(Vec3 a) {
+    return sqrtf(vec3_dot(a, a));
+}
+
+static inline Vec3 vec3_normalize(Vec3 a) {
+    float length = vec3_length(a);
+    return length > 0 ? vec3_scale(a, 1.0f / length) : a;
+}
+
+static inline Mat4 mat4_identity(void) {
+    return (Mat4) { {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1,
+    } };
+}
+
+static inline Mat4 mat4_mul(Mat4 a, Mat4 b) {
+    Mat4 r;
+    for (u32 column = 0; column < 4; ++column) {
+        for (u32 row = 0; row < 4; ++row) {
+            r.m[column * 4 + row] =
+                a.m[0 * 4 + row] * b.m[column * 4 + 0] +
+                a.m[1 * 4 + row] * b.m[column * 4 + 1] +
+                a.m[2 * 4 + row] * b.m[column * 4 + 2] +
+                a.m[3 * 4 + row] * b.m[column * 4 + 3];
+        }
+    }
+
+    return r;
+}
+
+static inline Vec4 mat4_mul_vec4(Mat4 a, Vec4 v) {
+    return (Vec4) {
+        a.m[0] * v.x + a.m[4] * v.y + a.m[8] * v.z + a.m[12] * v.w,
+        a.m[1] * v.x + a.m[5] * v.y + a.m[9] * v.z + a.m[13] * v.w,
+        a.m[2] * v.x + a.m[6] * v.y + a.m[10] * v.z + a.m[14] * v.w,
+        a.m[3] * v.x + a.m[7] * v.y + a.m[11] * v.z + a.m[15] * v.w,
+    };
+}
+
+/* right handed view looking down -z. */
+static inline Mat4 mat4_look_at(Vec3 eye, Vec3 target, Vec3 up) {
+    Vec3 f = vec3_normalize(vec3_sub(target, eye));
+    Vec3 s = vec3_normalize(vec3_cross(f, up));
+    Vec3 u = vec3_cross(s, f);
+
+    return (Mat4) { {
+        s.x, u.x, -f.x, 0,
+        s.y, u.y, -f.y, 0,
+        s.z, u.z, -f.z, 0,
+        -vec3_dot(s, eye), -vec3_dot(u, eye), vec3_dot(f, eye), 1,
+    } };
+}
+
+/* `fov_y` in radians; depth goes from 0 at `near_plane` to 1 at `far_plane`. */
+static inline Mat4 mat4_perspective(float fov_y, float aspect, float near_plane, float far_plane) {
+    float f = 1.0f / tanf(fov_y * 0.5f);
+    float range = far_plane / (near_plane - far_plane);
+
+    return (Mat4) { {
+        f / aspect, 0, 0, 0,
+        0, -f, 0, 0,
+        0, 0, range, -1,
+        0, 0, range * near_plane, 0,
+    } };
+}
+
+/* the planes bounding what `view_projection` maps into clip space, pointing inwards: xyz is the normal and
+ * w the distance, so a point p is inside all of them when dot(xyz, p) + w >= 0. */
+static inline void frustum_planes(const Mat4* view_projection, Vec4 planes[6]) {
+    const float* m = view_projection->m;
+
+    /* rows of the matrix */
+    Vec4 r0 = { m[0], m[4], m[8], m[12] };
+    Vec4 r1 = { m[1], m[5], m[9], m[13] };
+    Vec4 r2 = { m[2], m[6], m[10], m[14] };
+    Vec4 r3 = { m[3], m[7], m[11], m[15] };
+
+    planes[0] = (Vec4) { r3.x + r0.x, r3.y + r0.y, r3.z + r0.z, r3.w + r0.w };
+    planes[1] = (Vec4) { r3.x - r0.x, r3.y - r0.y, r3.z - r0.z, r3.w - r0.w };
+    planes[2] = (Vec4) { r3.x + r1.x, r3.y + r1.y, r3.z + r1.z, r3.w + r1.w };
+    planes[3] = (Vec4) { r3.x - r1.x, r3.y - r1.y, r3.z - r1.z, r3.w - r1.w };
+    /* depth is [0, 1] */
+    planes[4] = r2;
+    planes[5] = (Vec4) { r3.x - r2.x, r3.y - r2.y, r3.z - r2.z, r3.w - r2.w };
+
+    for (u32 i = 0; i < 6; ++i) {
+        float length = vec3_length(vec3(planes[i].x, planes[i].y, planes[i].z));
+        planes[i] = (Vec4) { planes[i].x / length, planes[i].y / length, planes[i].z / length, planes[i].w / length };
+    }
+}
+
+static inline bool frustum_sphere_visible(const Vec4 planes[6], Vec3 center, float radius) {
+    for (u32 i = 0; i < 6; ++i) {
+        if (planes[i].x * center.x + planes[i].y * center.y + planes[i].z * center.z + planes[i].w < -radius)
+            return false;
+    }
+
+    return true;
+}
+
+/* transforms a point, w = 1. */
+static inline Vec3 mat4_transform_point(const Mat4* a, Vec3 p) {
+    Vec4 r = mat4_mul_vec4(*a, (Vec4) { p.x, p.y, p.z, 1 });
+    return vec3(r.x, r.y, r.z);
+}
+
+/* transforms a direction, w = 0. */
+static inline Vec3 mat4_transform_direction(const Mat4* a, Vec3 d) {
+    Vec4 r = mat4_mul_vec4(*a, (Vec4) { d.x, d.y, d.z, 0 });
+    return vec3(r.x, r.y, r.z);
+}
+
+/* the largest factor the matrix scales any direction by, for transforming bounding spheres. */
+static inline float mat4_max_scale(const Mat4* a) {
+    const float* m = a->m;
+    float x = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+    float y = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+    float z = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+
+    float largest = x > y ? x : y;
+    return sqrtf(largest > z ? largest : z);
+}
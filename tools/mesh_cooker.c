@@ -0,0 +1,506 @@
+#include "mesh_format.h"
+#include "zmath.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+/*
+ * Cooks a Wavefront OBJ into the mesh format of mesh_format.h: smooth normals, a chain of LODs simplified by
+ * vertex clustering, and every LOD split into spatially coherent meshlets with bounding spheres and normal cones.
+ * Only positions and faces are read; polygons are triangulated as fans.
+ *
+ * usage: mesh_cooker <input.obj> <output.zmsh>
+ */
+
+/* simplification stops at LODs this small */
+#define COOKER_MIN_LOD_TRIANGLES (u32)64
+/* the first clustering grid splits the longest side of the bounding box into this many cells */
+#define COOKER_FINEST_GRID (u32)1024
+
+/* cones wider than this (as the cosine of their half angle) can't cull anything worth testing for */
+#define COOKER_CONE_MIN_DOT 0.1f
+
+typedef struct CookerMesh {
+    Vec3* positions;
+    Vec3* normals;
+    u32 vertex_count;
+    u32 vertex_capacity;
+
+    u32* indices;
+    u32 index_count;
+    u32 index_capacity;
+} CookerMesh;
+
+typedef struct CookerOutput {
+    MeshFileHeader header;
+
+    MeshMeshlet* meshlets;
+    u32 meshlet_capacity;
+
+    u32* indices;
+    u32 index_capacity;
+} CookerOutput;
+
+static void* cooker_grow(void* array, u32* capacity, u32 needed, usize element_size) {
+    if (needed <= *capacity)
+        return array;
+
+    u32 new_capacity = *capacity ? *capacity : 1024;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    array = realloc(array, (usize)new_capacity * element_size);
+    if (array == NULL) {
+        fprintf(stderr, "out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *capacity = new_capacity;
+    return array;
+}
+
+static char* cooker_read_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* text = malloc((usize)length + 1);
+    if (text == NULL || fread(text, 1, (usize)length, file) != (usize)length) {
+        free(text);
+        fclose(file);
+        return NULL;
+    }
+
+    text[length] = '\0';
+    fclose(file);
+
+    return text;
+}
+
+/* returns false on a malformed file. */
+static bool cooker_load_obj(CookerMesh* mesh, const char* path) {
+    char* text = cooker_read_file(path);
+    if (text == NULL) {
+        fprintf(stderr, "couldn't read %s!\n", path);
+        return false;
+    }
+
+    u32 line_number = 0;
+    for (char* line = text; *line; ) {
+        char* end = line + strcspn(line, "\r\n");
+        char* next = *end ? end + 1 : end;
+        *end = '\0';
+        ++line_number;
+
+        if (line[0] == 'v' && line[1] == ' ') {
+            mesh->positions = cooker_grow(mesh->positions, &mesh->vertex_capacity, mesh->vertex_count + 1, sizeof(Vec3));
+
+            char* cursor = line + 2;
+            float v[3];
+            for (u32 i = 0; i < 3; ++i)
+                v[i] = strtof(cursor, &cursor);
+
+            mesh->positions[mesh->vertex_count++] = vec3(v[0], v[1], v[2]);
+        } else if (line[0] == 'f' && line[1] == ' ') {
+            /* v, v/vt, v//vn or v/vt/vn; only the position is used */
+            u32 polygon[3];
+            u32 corners = 0;
+
+            for (char* cursor = line + 2; *cursor; ) {
+                while (*cursor == ' ' || *cursor == '\t')
+                    ++cursor;
+                if (*cursor == '\0')
+                    break;
+
+                char* token_end;
+                long index = strtol(cursor, &token_end, 10);
+                if (token_end == cursor)
+                    break;
+
+                index = index < 0 ? (long)mesh->vertex_count + index : index - 1;
+                if (index < 0 || index >= (long)mesh->vertex_count) {
+                    fprintf(stderr, "%s:%u: face refers to a vertex that doesn't exist!\n", path, line_number);
+                    free(text);
+                    return false;
+                }
+
+                cursor = token_end + strcspn(token_end, " \t");
+
+                if (corners < 2) {
+                    polygon[corners++] = (u32)index;
+                    continue;
+                }
+
+                polygon[2] = (u32)index;
+                if (polygon[0] != polygon[1] && polygon[1] != polygon[2] && polygon[0] != polygon[2]) {
+                    mesh->indices = cooker_grow(mesh->indices, &mesh->index_capacity, mesh->index_count + 3, sizeof(u32));
+                    memcpy(&mesh->indices[mesh->index_count], polygon, sizeof(polygon));
+                    mesh->index_count += 3;
+                }
+
+                /* fan around the first corner */
+                polygon[1] = polygon[2];
+            }
+        }
+
+        line = next;
+    }
+
+    free(text);
+
+    if (mesh->index_count == 0) {
+        fprintf(stderr, "%s has no faces!\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+/* area weighted, so small slivers don't bend the normals of the faces around them. */
+static void cooker_compute_normals(CookerMesh* mesh) {
+    mesh->normals = calloc(mesh->vertex_count, sizeof(Vec3));
+
+    for (u32 i = 0; i < mesh->index_count; i += 3) {
+        const u32* t = &mesh->indices[i];
+        Vec3 normal = vec3_cross(vec3_sub(mesh->positions[t[1]], mesh->positions[t[0]]), vec3_sub(mesh->positions[t[2]], mesh->positions[t[0]]));
+
+        for (u32 j = 0; j < 3; ++j)
+            mesh->normals[t[j]] = vec3_add(mesh->normals[t[j]], normal);
+    }
+
+    for (u32 i = 0; i < mesh->vertex_count; ++i)
+        mesh->normals[i] = vec3_normalize(mesh->normals[i]);
+}
+
+static void cooker_bounds(const Vec3* positions, u32 count, Vec3* min, Vec3* max) {
+    *min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    *max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+    for (u32 i = 0; i < count; ++i) {
+        Vec3 p = positions[i];
+        *min = vec3(p.x < min->x ? p.x : min->x, p.y < min->y ? p.y : min->y, p.z < min->z ? p.z : min->z);
+        *max = vec3(p.x > max->x ? p.x : max->x, p.y > max->y ? p.y : max->y, p.z > max->z ? p.z : max->z);
+    }
+}
+
+typedef struct CookerGrid {
+    /* open addressing: the cell of every slot and the vertex that represents it, UINT32_MAX if empty */
+    s32* cells;
+    u32* representatives;
+    u32 mask;
+} CookerGrid;
+
+static u32 cooker_grid_representative(CookerGrid* grid, s32 x, s32 y, s32 z, u32 vertex) {
+    u32 hash = ((u32)x * 73856093u) ^ ((u32)y * 19349663u) ^ ((u32)z * 83492791u);
+
+    for (u32 slot = hash & grid->mask; ; slot = (slot + 1) & grid->mask) {
+        if (grid->representatives[slot] == UINT32_MAX) {
+            grid->cells[slot * 3 + 0] = x;
+            grid->cells[slot * 3 + 1] = y;
+            grid->cells[slot * 3 + 2] = z;
+            grid->representatives[slot] = vertex;
+            return vertex;
+        }
+
+        const s32* cell = &grid->cells[slot * 3];
+        if (cell[0] == x && cell[1] == y && cell[2] == z)
+            return grid->representatives[slot];
+    }
+}
+
+/* collapses every vertex into the first vertex of its grid cell and drops the triangles that degenerate.
+ * the LOD keeps using the original vertices, so all LODs share one vertex buffer. returns the index count. */
+static u32 cooker_simplify(const CookerMesh* mesh, Vec3 origin, float cell_size, CookerGrid* grid, u32* remap, u32* out) {
+    memset(grid->representatives, 0xff, (usize)(grid->mask + 1) * sizeof(u32));
+
+    for (u32 i = 0; i < mesh->vertex_count; ++i) {
+        Vec3 p = vec3_scale(vec3_sub(mesh->positions[i], origin), 1.0f / cell_size);
+        remap[i] = cooker_grid_representative(grid, (s32)floorf(p.x), (s32)floorf(p.y), (s32)floorf(p.z), i);
+    }
+
+    u32 count = 0;
+    for (u32 i = 0; i < mesh->index_count; i += 3) {
+        u32 a = remap[mesh->indices[i + 0]];
+        u32 b = remap[mesh->indices[i + 1]];
+        u32 c = remap[mesh->indices[i + 2]];
+
+        if (a == b || b == c || a == c)
+            continue;
+
+        out[count++] = a;
+        out[count++] = b;
+        out[count++] = c;
+    }
+
+    return count;
+}
+
+static u32 cooker_morton_spread(u32 v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+static int cooker_compare_u64(const void* a, const void* b) {
+    u64 x = *(const u64*)a, y = *(const u64*)b;
+    return (x > y) - (x < y);
+}
+
+static void cooker_meshlet_bounds(const CookerMesh* mesh, const u32* indices, u32 index_count, MeshMeshlet* meshlet) {
+    Vec3 min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vec3 max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (u32 i = 0; i < index_count; ++i) {
+        Vec3 p = mesh->positions[indices[i]];
+        min = vec3(p.x < min.x ? p.x : min.x, p.y < min.y ? p.y : min.y, p.z < min.z ? p.z : min.z);
+        max = vec3(p.x > max.x ? p.x : max.x, p.y > max.y ? p.y : max.y, p.z > max.z ? p.z : max.z);
+    }
+
+    Vec3 center = vec3_scale(vec3_add(min, max), 0.5f);
+    float radius = 0;
+    Vec3 axis = vec3(0, 0, 0);
+
+    for (u32 i = 0; i < index_count; i += 3) {
+        Vec3 a = mesh->positions[indices[i + 0]];
+        Vec3 b = mesh->positions[indices[i + 1]];
+        Vec3 c = mesh->positions[indices[i + 2]];
+
+        for (u32 j = 0; j < 3; ++j) {
+            float distance = vec3_length(vec3_sub(mesh->positions[indices[i + j]], center));
+            radius = distance > radius ? distance : radius;
+        }
+
+        axis = vec3_add(axis, vec3_normalize(vec3_cross(vec3_sub(b, a), vec3_sub(c, a))));
+    }
+
+    axis = vec3_normalize(axis);
+
+    float min_dot = 1;
+    for (u32 i = 0; i < index_count; i += 3) {
+        Vec3 a = mesh->positions[indices[i + 0]];
+        Vec3 b = mesh->positions[indices[i + 1]];
+        Vec3 c = mesh->positions[indices[i + 2]];
+
+        Vec3 normal = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+        if (vec3_length(normal) == 0)
+            continue;
+
+        float d = vec3_dot(vec3_normalize(normal), axis);
+        min_dot = d < min_dot ? d : min_dot;
+    }
+
+    memcpy(meshlet->center, &center, sizeof(meshlet->center));
+    meshlet->radius = radius;
+    memcpy(meshlet->cone_axis, &axis, sizeof(meshlet->cone_axis));
+    /* sin of the cone's half angle, widened by 90 degrees for the test against the view direction */
+    meshlet->cone_cutoff = min_dot <= COOKER_CONE_MIN_DOT ? 1.0f : sqrtf(1 - min_dot * min_dot);
+}
+
+/* splits the triangles of one LOD into meshlets along a Morton curve through their centroids, which keeps
+ * every meshlet compact, so its bounds are tight. */
+static void cooker_build_meshlets(const CookerMesh* mesh, Vec3 min, Vec3 max, const u32* indices, u32 index_count, u32* stamps, u32* next_stamp, CookerOutput* output, MeshLod* lod) {
+    u32 triangle_count = index_count / 3;
+    u64* order = malloc((usize)triangle_count * sizeof(u64));
+
+    Vec3 extent = vec3_sub(max, min);
+    Vec3 scale = vec3(extent.x > 0 ? 1023.0f / extent.x : 0, extent.y > 0 ? 1023.0f / extent.y : 0, extent.z > 0 ? 1023.0f / extent.z : 0);
+
+    for (u32 i = 0; i < triangle_count; ++i) {
+        const u32* t = &indices[i * 3];
+        Vec3 centroid = vec3_scale(vec3_add(vec3_add(mesh->positions[t[0]], mesh->positions[t[1]]), mesh->positions[t[2]]), 1.0f / 3.0f);
+        Vec3 p = vec3_sub(centroid, min);
+
+        u32 code = cooker_morton_spread((u32)(p.x * scale.x)) | cooker_morton_spread((u32)(p.y * scale.y)) << 1 | cooker_morton_spread((u32)(p.z * scale.z)) << 2;
+        order[i] = (u64)code << 32 | i;
+    }
+
+    qsort(order, triangle_count, sizeof(u64), cooker_compare_u64);
+
+    lod->first_meshlet = output->header.meshlet_count;
+    lod->first_index = output->header.index_count;
+
+    u32 meshlet_vertices = 0;
+    u32 meshlet_first_index = output->header.index_count;
+    u32 stamp = (*next_stamp)++;
+
+    for (u32 i = 0; i <= triangle_count; ++i) {
+        const u32* t = i < triangle_count ? &indices[(u32)order[i] * 3] : NULL;
+
+        u32 new_vertices = 0;
+        if (t) {
+            for (u32 j = 0; j < 3; ++j)
+                new_vertices += stamps[t[j]] != stamp;
+        }
+
+        u32 meshlet_indices = output->header.index_count - meshlet_first_index;
+        bool full = meshlet_vertices + new_vertices > MESH_MESHLET_MAX_VERTICES || meshlet_indices / 3 == MESH_MESHLET_MAX_TRIANGLES;
+
+        if (meshlet_indices > 0 && (t == NULL || full)) {
+            output->meshlets = cooker_grow(output->meshlets, &output->meshlet_capacity, output->header.meshlet_count + 1, sizeof(MeshMeshlet));
+
+            MeshMeshlet* meshlet = &output->meshlets[output->header.meshlet_count++];
+            meshlet->first_index = meshlet_first_index;
+            meshlet->index_count = meshlet_indices;
+            cooker_meshlet_bounds(mesh, &output->indices[meshlet_first_index], meshlet_indices, meshlet);
+
+            meshlet_vertices = 0;
+            meshlet_first_index = output->header.index_count;
+            stamp = (*next_stamp)++;
+            new_vertices = 3;
+        }
+
+        if (t == NULL)
+            break;
+
+        output->indices = cooker_grow(output->indices, &output->index_capacity, output->header.index_count + 3, sizeof(u32));
+        for (u32 j = 0; j < 3; ++j) {
+            output->indices[output->header.index_count++] = t[j];
+            stamps[t[j]] = stamp;
+        }
+
+        meshlet_vertices += new_vertices;
+    }
+
+    lod->meshlet_count = output->header.meshlet_count - lod->first_meshlet;
+    lod->index_count = output->header.index_count - lod->first_index;
+
+    free(order);
+}
+
+static bool cooker_write_section(FILE* file, const void* data, usize size) {
+    static const u8 zeros[16] = { 0 };
+
+    if (fwrite(data, 1, size, file) != size)
+        return false;
+
+    usize padding = (16 - size % 16) % 16;
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+static u64 cooker_align(u64 offset) {
+    return (offset + 15) & ~(u64)15;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <input.obj> <output.zmsh>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    CookerMesh mesh = { 0 };
+    if (!cooker_load_obj(&mesh, argv[1]))
+        return EXIT_FAILURE;
+
+    cooker_compute_normals(&mesh);
+
+    Vec3 min, max;
+    cooker_bounds(mesh.positions, mesh.vertex_count, &min, &max);
+    Vec3 extent = vec3_sub(max, min);
+    float longest = extent.x > extent.y ? extent.x : extent.y;
+    longest = longest > extent.z ? longest : extent.z;
+
+    CookerOutput output = { 0 };
+    MeshFileHeader* header = &output.header;
+    header->magic = MESH_MAGIC;
+    header->version = MESH_VERSION;
+    header->vertex_count = mesh.vertex_count;
+
+    Vec3 center = vec3_scale(vec3_add(min, max), 0.5f);
+    memcpy(header->center, &center, sizeof(header->center));
+    header->radius = vec3_length(extent) * 0.5f;
+
+    CookerGrid grid;
+    u32 grid_size = round_to_highest_pow_of_2(mesh.vertex_count * 2);
+    grid.mask = grid_size - 1;
+    grid.cells = malloc((usize)grid_size * 3 * sizeof(s32));
+    grid.representatives = malloc((usize)grid_size * sizeof(u32));
+
+    u32* remap = malloc((usize)mesh.vertex_count * sizeof(u32));
+    u32* stamps = calloc(mesh.vertex_count, sizeof(u32));
+    u32* lod_indices = malloc((usize)mesh.index_count * sizeof(u32));
+    u32 next_stamp = 1;
+
+    /* LOD 0 is the mesh as is */
+    cooker_build_meshlets(&mesh, min, max, mesh.indices, mesh.index_count, stamps, &next_stamp, &output, &header->lods[0]);
+    header->lods[0].error = 0;
+    header->lod_count = 1;
+
+    float cell_size = longest / (float)COOKER_FINEST_GRID;
+    u32 previous_count = mesh.index_count;
+
+    while (header->lod_count < MESH_MAX_LODS && previous_count / 3 >= COOKER_MIN_LOD_TRIANGLES * 2 && longest > 0) {
+        /* the coarsest grid that keeps at least half of the previous LOD's triangles would skip LODs,
+         * so the cells grow until the count halves */
+        u32 count = previous_count;
+        while (count > previous_count / 2 && cell_size <= longest) {
+            count = cooker_simplify(&mesh, min, cell_size, &grid, remap, lod_indices);
+            if (count > previous_count / 2)
+                cell_size *= 2;
+        }
+
+        if (count == 0 || count > previous_count / 2)
+            break;
+
+        MeshLod* lod = &header->lods[header->lod_count++];
+        cooker_build_meshlets(&mesh, min, max, lod_indices, count, stamps, &next_stamp, &output, lod);
+        /* a vertex moves at most across its cell */
+        lod->error = cell_size * sqrtf(3);
+
+        previous_count = count;
+        cell_size *= 2;
+    }
+
+    header->meshlets_offset = cooker_align(sizeof(MeshFileHeader));
+    header->vertices_offset = cooker_align(header->meshlets_offset + (u64)header->meshlet_count * sizeof(MeshMeshlet));
+    header->indices_offset = cooker_align(header->vertices_offset + (u64)header->vertex_count * sizeof(MeshVertex));
+
+    MeshVertex* vertices = malloc((usize)mesh.vertex_count * sizeof(MeshVertex));
+    for (u32 i = 0; i < mesh.vertex_count; ++i) {
+        memcpy(vertices[i].position, &mesh.positions[i], sizeof(vertices[i].position));
+        memcpy(vertices[i].normal, &mesh.normals[i], sizeof(vertices[i].normal));
+    }
+
+    FILE* file = fopen(argv[2], "wb");
+    if (file == NULL) {
+        fprintf(stderr, "couldn't create %s!\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    bool written = cooker_write_section(file, header, sizeof(MeshFileHeader))
+        && cooker_write_section(file, output.meshlets, (usize)header->meshlet_count * sizeof(MeshMeshlet))
+        && cooker_write_section(file, vertices, (usize)header->vertex_count * sizeof(MeshVertex))
+        && cooker_write_section(file, output.indices, (usize)header->index_count * sizeof(u32));
+
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "couldn't write %s!\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %u vertices, %u LODs\n", argv[2], header->vertex_count, header->lod_count);
+    for (u32 i = 0; i < header->lod_count; ++i) {
+        const MeshLod* lod = &header->lods[i];
+        printf("  LOD %u: %u triangles in %u meshlets, error %g\n", i, lod->index_count / 3, lod->meshlet_count, lod->error);
+    }
+
+    free(vertices);
+    free(lod_indices);
+    free(stamps);
+    free(remap);
+    free(grid.cells);
+    free(grid.representatives);
+    free(output.meshlets);
+    free(output.indices);
+    free(mesh.positions);
+    free(mesh.normals);
+    free(mesh.indices);
+
+    return EXIT_SUCCESS;
+}
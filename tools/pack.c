@@ -0,0 +1,175 @@
+#include "archive_format.h"
+#include "async_io.h"
+#include "lz4.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/*
+ * Packs files into an archive of src/archive_format.h. Every file is stored under its path as given on the
+ * command line, which has to be the path the renderer asks for: run it from the directory the renderer runs
+ * in, with the shaders as shaders/bin/vulkan_<name>.spv, which is the build directory for compiled shaders.
+ *
+ * usage: pack <output.zpak> <files...>
+ */
+
+typedef struct PackFile {
+    const char* name;
+    AsyncFile source;
+    ArchiveEntry entry;
+    /* NULL until it's been read */
+    u8* blob;
+} PackFile;
+
+static int pack_compare_hash(const void* a, const void* b) {
+    u64 x = ((const PackFile*)a)->entry.hash, y = ((const PackFile*)b)->entry.hash;
+    return (x > y) - (x < y);
+}
+
+/* compresses each file as soon as it's read, while the rest are still being read */
+static void pack_file_read(void* user, const AsyncRead* read, s64 result) {
+    PackFile* file = user;
+    async_file_close(&file->source);
+
+    u8* data = read->buffer;
+    if (result != (s64)read->size) {
+        free(data);
+        return;
+    }
+
+    u32 size = (u32)read->size;
+    usize capacity = lz4_compress_bound(size);
+    u8* compressed = malloc(capacity);
+    usize compressed_size = lz4_compress(data, size, compressed, capacity);
+
+    file->entry.size = size;
+    if (compressed_size > 0 && compressed_size < size) {
+        file->entry.flags = ARCHIVE_ENTRY_LZ4;
+        file->entry.stored_size = (u32)compressed_size;
+        file->blob = compressed;
+        free(data);
+    } else {
+        file->entry.stored_size = size;
+        file->blob = data;
+        free(compressed);
+    }
+}
+
+static bool pack_pad(FILE* file, u64* offset) {
+    static const u8 zeros[ARCHIVE_ALIGNMENT] = { 0 };
+
+    usize padding = (usize)((ARCHIVE_ALIGNMENT - *offset % ARCHIVE_ALIGNMENT) % ARCHIVE_ALIGNMENT);
+    *offset += padding;
+
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <output.zpak> <files...>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    u32 count = (u32)argc - 2;
+    PackFile* files = calloc(count, sizeof(PackFile));
+    u64 total_size = 0;
+    u64 total_stored = 0;
+
+    /* the files are read a batch at a time, so the reads overlap each other and the compression while only a
+     * couple of batches of them are open */
+    AsyncIo* io = async_io_create(ASYNC_IO_DEFAULT_DEPTH, false);
+    AsyncRead reads[ASYNC_IO_DEFAULT_DEPTH];
+    u32 batched = 0;
+
+    for (u32 i = 0; i < count; ++i) {
+        PackFile* file = &files[i];
+        file->name = argv[i + 2];
+        file->entry.hash = archive_hash(file->name);
+
+        if (!async_file_open(&file->source, file->name) || file->source.length > UINT32_MAX) {
+            fprintf(stderr, "couldn't read %s!\n", file->name);
+            return EXIT_FAILURE;
+        }
+
+        u64 length = file->source.length;
+        reads[batched++] = (AsyncRead) {
+            .file = &file->source,
+            .size = length,
+            .buffer = malloc(length > 0 ? (usize)length : 1),
+            .callback = pack_file_read,
+            .user = file,
+        };
+
+        if (batched == ASYNC_IO_DEFAULT_DEPTH || i + 1 == count) {
+            async_io_submit(io, reads, batched);
+            batched = 0;
+        }
+    }
+
+    async_io_wait(io);
+    async_io_destroy(io);
+
+    for (u32 i = 0; i < count; ++i) {
+        if (files[i].blob == NULL) {
+            fprintf(stderr, "couldn't read %s!\n", files[i].name);
+            return EXIT_FAILURE;
+        }
+
+        total_size += files[i].entry.size;
+        total_stored += files[i].entry.stored_size;
+    }
+
+    qsort(files, count, sizeof(PackFile), pack_compare_hash);
+
+    for (u32 i = 1; i < count; ++i) {
+        if (files[i - 1].entry.hash == files[i].entry.hash) {
+            fprintf(stderr, "%s and %s have the same name hash, rename one!\n", files[i - 1].name, files[i].name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* the blobs follow the table of contents */
+    u64 offset = sizeof(ArchiveHeader) + (u64)count * sizeof(ArchiveEntry);
+    for (u32 i = 0; i < count; ++i) {
+        offset = (offset + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+        files[i].entry.offset = offset;
+        offset += files[i].entry.stored_size;
+    }
+
+    FILE* out = fopen(argv[1], "wb");
+    if (out == NULL) {
+        fprintf(stderr, "couldn't create %s!\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    ArchiveHeader header = {
+        .magic = ARCHIVE_MAGIC,
+        .version = ARCHIVE_VERSION,
+        .entry_count = count,
+    };
+
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (u32 i = 0; i < count && written; ++i)
+        written = fwrite(&files[i].entry, sizeof(ArchiveEntry), 1, out) == 1;
+
+    offset = sizeof(ArchiveHeader) + (u64)count * sizeof(ArchiveEntry);
+    for (u32 i = 0; i < count && written; ++i) {
+        written = pack_pad(out, &offset) && fwrite(files[i].blob, 1, files[i].entry.stored_size, out) == files[i].entry.stored_size;
+        offset += files[i].entry.stored_size;
+    }
+
+    if (fclose(out) != 0 || !written) {
+        fprintf(stderr, "couldn't write %s!\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %u files, %llu bytes stored as %llu\n", argv[1], count, (unsigned long long)total_size, (unsigned long long)total_stored);
+
+    for (u32 i = 0; i < count; ++i)
+        free(files[i].blob);
+    free(files);
+
+    return EXIT_SUCCESS;
+}
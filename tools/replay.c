@@ -0,0 +1,156 @@
+#include "renderer.h"
+#include "recording.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ZULK_WIN32)
+#define WIN32_LEAN_AND_MEAN 1
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+/*
+ * Replays a recording made with graphics_start_recording() headless and as fast as the GPU allows, and reports
+ * CPU and GPU frame times. The same recording on the same machine renders the same frames, so runs can be
+ * compared against each other.
+ *
+ * usage: replay <recording> [--loops N] [--csv]
+ */
+
+static double replay_now_ms(void) {
+#if defined(ZULK_WIN32)
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+#endif
+}
+
+static int replay_compare_float(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+static void replay_print_summary(const char* name, float* samples, u32 count) {
+    if (count == 0) {
+        printf("%s: no samples\n", name);
+        return;
+    }
+
+    double total = 0;
+    for (u32 i = 0; i < count; ++i)
+        total += samples[i];
+
+    qsort(samples, count, sizeof(float), replay_compare_float);
+
+    printf("%s: avg %.3fms, min %.3fms, median %.3fms, p99 %.3fms, max %.3fms (%u frames)\n", name,
+        total / count, samples[0], samples[count / 2], samples[(u32)((count - 1) * 0.99)], samples[count - 1], count);
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    u32 loops = 1;
+    bool csv = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc)
+            loops = (u32)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--csv") == 0)
+            csv = true;
+        else
+            path = argv[i];
+    }
+
+    if (path == NULL || loops == 0) {
+        fprintf(stderr, "usage: %s <recording> [--loops N] [--csv]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    RecordingReader reader;
+    if (!recording_open(&reader, path))
+        return EXIT_FAILURE;
+
+    const void* payload;
+    const RecordingCommand* command = recording_next(&reader, &payload);
+    if (command == NULL || command->type != RECORDING_CMD_CONFIG) {
+        fprintf(stderr, "replay: %s doesn't start with a configuration\n", path);
+        recording_close(&reader);
+        return EXIT_FAILURE;
+    }
+
+    GraphicsConfiguration config = recording_replay_config(payload);
+
+    u32 frames_per_loop = 0;
+    while ((command = recording_next(&reader, &payload)) != NULL)
+        frames_per_loop += command->type == RECORDING_CMD_FRAME;
+
+    u32 frames_count = frames_per_loop * loops;
+    float* cpu_ms = calloc(frames_count, sizeof(float));
+    /* indexed by the renderer's frame index, which starts at 0 and counts every replayed frame; negative until
+     * the frame's timestamps have been read back. */
+    float* gpu_ms = malloc(frames_count * sizeof(float));
+    for (u32 i = 0; i < frames_count; ++i)
+        gpu_ms[i] = -1.0f;
+
+    Graphics* graphics = graphics_initialize(&config);
+
+    if (csv)
+        printf("frame,cpu_ms\n");
+
+    u32 frame = 0;
+    double start = replay_now_ms();
+
+    for (u32 loop = 0; loop < loops; ++loop) {
+        recording_rewind(&reader);
+
+        while ((command = recording_next(&reader, &payload)) != NULL) {
+            if (command->type != RECORDING_CMD_FRAME) {
+                graphics_replay_command(graphics, command, payload);
+                continue;
+            }
+
+            double frame_start = replay_now_ms();
+            graphics_replay_command(graphics, command, payload);
+            cpu_ms[frame] = (float)(replay_now_ms() - frame_start);
+
+            if (csv)
+                printf("%u,%.4f\n", frame, cpu_ms[frame]);
+
+            GraphicsFrameStats stats;
+            graphics_get_frame_stats(graphics, &stats);
+            if (stats.gpu_frame_index < frames_count && stats.gpu_ms > 0)
+                gpu_ms[stats.gpu_frame_index] = stats.gpu_ms;
+
+            frame++;
+        }
+    }
+
+    double total_ms = replay_now_ms() - start;
+    graphics_deinitialize(graphics);
+    recording_close(&reader);
+
+    /* the last frames in flight are never read back */
+    u32 gpu_count = 0;
+    for (u32 i = 0; i < frames_count; ++i)
+        if (gpu_ms[i] >= 0)
+            gpu_ms[gpu_count++] = gpu_ms[i];
+
+    printf("replayed %u frames in %.1fms (%.1f fps)\n", frame, total_ms, frame / (total_ms / 1000.0));
+    replay_print_summary("cpu", cpu_ms, frame);
+    replay_print_summary("gpu", gpu_ms, gpu_count);
+
+    free(cpu_ms);
+    free(gpu_ms);
+}
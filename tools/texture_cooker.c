@@ -0,0 +1,394 @@
+#include "texture_format.h"
+#include "lz4.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+/*
+ * Cooks an image into the texture format of src/texture_format.h: every 4x4 block encoded as a BC3 block (the
+ * color along its principal axis, refined by least squares; the alpha between its extremes), then the blocks
+ * LZ4 compressed a few rows at a time. The renderer copies or transcodes them into what the GPU samples.
+ * Reads binary PAM (RGB or RGB_ALPHA) and PPM, 8 bits per channel, both of which most image tools export.
+ *
+ * usage: texture_cooker <input.pam|input.ppm> <output.ztex>
+ */
+
+/* skips whitespace and # comments, then reads an unsigned number of a PPM header. */
+static bool cooker_read_number(FILE* file, u32* value) {
+    int c = fgetc(file);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        if (c == '#') {
+            while (c != '\n' && c != EOF)
+                c = fgetc(file);
+        }
+
+        c = fgetc(file);
+    }
+
+    if (c < '0' || c > '9')
+        return false;
+
+    *value = 0;
+    while (c >= '0' && c <= '9') {
+        *value = *value * 10 + (u32)(c - '0');
+        c = fgetc(file);
+    }
+
+    /* the single whitespace before the pixels is consumed here */
+    return true;
+}
+
+/* returns `width` * `height` RGBA8 texels, NULL if the file isn't an image this reads. */
+static u8* cooker_load_image(const char* path, u32* width, u32* height) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "couldn't open %s!\n", path);
+        return NULL;
+    }
+
+    char magic[3] = { 0 };
+    u32 channels = 0, max_value = 0;
+    bool header_read = fread(magic, 1, 2, file) == 2;
+
+    if (header_read && strcmp(magic, "P6") == 0) {
+        channels = 3;
+        header_read = cooker_read_number(file, width) && cooker_read_number(file, height) && cooker_read_number(file, &max_value);
+    } else if (header_read && strcmp(magic, "P7") == 0) {
+        char line[128];
+        while (fgets(line, sizeof(line), file) && strncmp(line, "ENDHDR", 6) != 0) {
+            sscanf(line, "WIDTH %u", width);
+            sscanf(line, "HEIGHT %u", height);
+            sscanf(line, "DEPTH %u", &channels);
+            sscanf(line, "MAXVAL %u", &max_value);
+        }
+    } else {
+        header_read = false;
+    }
+
+    if (!header_read || max_value != 255 || (channels != 3 && channels != 4) || *width == 0 || *height == 0 || *width > TEXTURE_MAX_SIZE || *height > TEXTURE_MAX_SIZE) {
+        fprintf(stderr, "%s isn't an 8 bit RGB or RGBA PAM or PPM of at most %u texels a side!\n", path, TEXTURE_MAX_SIZE);
+        fclose(file);
+        return NULL;
+    }
+
+    usize count = (usize)*width * *height;
+    u8* texels = malloc(count * 4);
+    u8* row = malloc((usize)*width * channels);
+
+    bool read = true;
+    for (u32 y = 0; y < *height && read; ++y) {
+        read = fread(row, channels, *width, file) == *width;
+
+        for (u32 x = 0; x < *width; ++x) {
+            u8* texel = texels + ((usize)y * *width + x) * 4;
+            memcpy(texel, row + (usize)x * channels, channels);
+            if (channels == 3)
+                texel[3] = 255;
+        }
+    }
+
+    free(row);
+    fclose(file);
+
+    if (!read) {
+        fprintf(stderr, "%s is truncated!\n", path);
+        free(texels);
+        return NULL;
+    }
+
+    return texels;
+}
+
+static u16 cooker_pack_565(const float color[3]) {
+    s32 r = (s32)(color[0] * 31.0f / 255.0f + 0.5f);
+    s32 g = (s32)(color[1] * 63.0f / 255.0f + 0.5f);
+    s32 b = (s32)(color[2] * 31.0f / 255.0f + 0.5f);
+
+    r = r < 0 ? 0 : r > 31 ? 31 : r;
+    g = g < 0 ? 0 : g > 63 ? 63 : g;
+    b = b < 0 ? 0 : b > 31 ? 31 : b;
+
+    return (u16)(r << 11 | g << 5 | b);
+}
+
+/* the four colors of a BC1 block in four color mode, expanded the way the renderer decodes them. */
+static void cooker_palette(u16 c0, u16 c1, s32 palette[4][3]) {
+    u16 endpoints[2] = { c0, c1 };
+    for (u32 i = 0; i < 2; ++i) {
+        s32 r = endpoints[i] >> 11 & 31, g = endpoints[i] >> 5 & 63, b = endpoints[i] & 31;
+        palette[i][0] = r << 3 | r >> 2;
+        palette[i][1] = g << 2 | g >> 4;
+        palette[i][2] = b << 3 | b >> 2;
+    }
+
+    for (u32 c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+/* picks the nearest palette color for every texel; returns the squared error. */
+static u32 cooker_select_colors(const u8 texels[16][4], u16 c0, u16 c1, u32* selectors) {
+    s32 palette[4][3];
+    cooker_palette(c0, c1, palette);
+
+    u32 error = 0;
+    *selectors = 0;
+    for (u32 i = 0; i < 16; ++i) {
+        u32 best = UINT32_MAX, pick = 0;
+        for (u32 p = 0; p < 4; ++p) {
+            u32 distance = 0;
+            for (u32 c = 0; c < 3; ++c) {
+                s32 d = palette[p][c] - texels[i][c];
+                distance += (u32)(d * d);
+            }
+
+            if (distance < best) {
+                best = distance;
+                pick = p;
+            }
+        }
+
+        *selectors |= pick << (2 * i);
+        error += best;
+    }
+
+    return error;
+}
+
+/* endpoints at the extremes of the principal axis of the colors, then refit by least squares to the selectors
+ * they give; keeps whichever is better. c0 > c1 always, unless the block is flat. */
+static void cooker_encode_color(const u8 texels[16][4], u8* out) {
+    float mean[3] = { 0 };
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 c = 0; c < 3; ++c)
+            mean[c] += texels[i][c] / 16.0f;
+    }
+
+    float covariance[6] = { 0 };
+    for (u32 i = 0; i < 16; ++i) {
+        float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2] };
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+
+    /* power iteration; a handful of steps is plenty for a 3x3 matrix */
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (u32 step = 0; step < 8; ++step) {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2],
+        };
+
+        float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+
+        for (u32 c = 0; c < 3; ++c)
+            axis[c] = next[c] / length;
+    }
+
+    float low = 0.0f, high = 0.0f;
+    for (u32 i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (u32 c = 0; c < 3; ++c)
+            t += (texels[i][c] - mean[c]) * axis[c];
+
+        low = t < low ? t : low;
+        high = t > high ? t : high;
+    }
+
+    float ends[2][3];
+    for (u32 c = 0; c < 3; ++c) {
+        ends[0][c] = mean[c] + axis[c] * high;
+        ends[1][c] = mean[c] + axis[c] * low;
+    }
+
+    u16 c0 = cooker_pack_565(ends[0]), c1 = cooker_pack_565(ends[1]);
+    u32 selectors;
+    u32 error = cooker_select_colors(texels, c0, c1, &selectors);
+
+    /* least squares: every texel is w * c0 + (1 - w) * c1 with the weight of its selector */
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = { 0 }, bx[3] = { 0 };
+    for (u32 i = 0; i < 16; ++i) {
+        float w = weights[selectors >> (2 * i) & 3];
+        aa += w * w;
+        ab += w * (1.0f - w);
+        bb += (1.0f - w) * (1.0f - w);
+
+        for (u32 c = 0; c < 3; ++c) {
+            ax[c] += w * texels[i][c];
+            bx[c] += (1.0f - w) * texels[i][c];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) > 1e-6f) {
+        for (u32 c = 0; c < 3; ++c) {
+            ends[0][c] = (ax[c] * bb - bx[c] * ab) / determinant;
+            ends[1][c] = (bx[c] * aa - ax[c] * ab) / determinant;
+        }
+
+        u16 refit0 = cooker_pack_565(ends[0]), refit1 = cooker_pack_565(ends[1]);
+        u32 refit_selectors;
+        u32 refit_error = cooker_select_colors(texels, refit0, refit1, &refit_selectors);
+
+        if (refit_error < error) {
+            c0 = refit0;
+            c1 = refit1;
+            selectors = refit_selectors;
+        }
+    }
+
+    if (c0 < c1) {
+        /* swapping the endpoints swaps selectors 0 and 1 and 2 and 3 */
+        u16 swap = c0;
+        c0 = c1;
+        c1 = swap;
+        selectors ^= 0x55555555u;
+    } else if (c0 == c1) {
+        selectors = 0;
+    }
+
+    out[0] = (u8)c0;
+    out[1] = (u8)(c0 >> 8);
+    out[2] = (u8)c1;
+    out[3] = (u8)(c1 >> 8);
+    for (u32 i = 0; i < 4; ++i)
+        out[4 + i] = (u8)(selectors >> (8 * i));
+}
+
+/* a0 the largest alpha and a1 the smallest, so the block interpolates eight values between them. */
+static void cooker_encode_alpha(const u8 texels[16][4], u8* out) {
+    s32 a0 = 0, a1 = 255;
+    for (u32 i = 0; i < 16; ++i) {
+        a0 = texels[i][3] > a0 ? texels[i][3] : a0;
+        a1 = texels[i][3] < a1 ? texels[i][3] : a1;
+    }
+
+    s32 palette[8] = { a0, a1 };
+    for (s32 i = 1; i < 7; ++i)
+        palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+
+    u64 selectors = 0;
+    for (u32 i = 0; i < 16 && a0 != a1; ++i) {
+        u32 best = UINT32_MAX, pick = 0;
+        for (u32 p = 0; p < 8; ++p) {
+            u32 distance = (u32)abs(palette[p] - texels[i][3]);
+            if (distance < best) {
+                best = distance;
+                pick = p;
+            }
+        }
+
+        selectors |= (u64)pick << (3 * i);
+    }
+
+    out[0] = (u8)a0;
+    out[1] = (u8)a1;
+    for (u32 i = 0; i < 6; ++i)
+        out[2 + i] = (u8)(selectors >> (8 * i));
+}
+
+static bool cooker_write_section(FILE* file, const void* data, usize size) {
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <input.pam|input.ppm> <output.ztex>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    u32 width = 0, height = 0;
+    u8* image = cooker_load_image(argv[1], &width, &height);
+    if (image == NULL)
+        return EXIT_FAILURE;
+
+    TextureFileHeader header = {
+        .magic = TEXTURE_MAGIC,
+        .version = TEXTURE_VERSION,
+        .width = width,
+        .height = height,
+    };
+
+    for (usize i = 0; i < (usize)width * height; ++i) {
+        if (image[i * 4 + 3] != 255)
+            header.flags |= TEXTURE_FLAG_ALPHA;
+    }
+
+    u32 blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    header.chunk_count = (blocks_y + TEXTURE_CHUNK_BLOCK_ROWS - 1) / TEXTURE_CHUNK_BLOCK_ROWS;
+
+    usize chunk_size = (usize)blocks_x * TEXTURE_CHUNK_BLOCK_ROWS * TEXTURE_BLOCK_SIZE;
+    u8* blocks = malloc(chunk_size);
+    u8* compressed = malloc(lz4_compress_bound(chunk_size) * header.chunk_count);
+    TextureChunk* chunks = calloc(header.chunk_count, sizeof(TextureChunk));
+
+    u32 offset = sizeof(TextureFileHeader) + header.chunk_count * (u32)sizeof(TextureChunk);
+    usize compressed_total = 0;
+
+    for (u32 c = 0; c < header.chunk_count; ++c) {
+        u32 first_row = c * TEXTURE_CHUNK_BLOCK_ROWS;
+        u32 rows = blocks_y - first_row < TEXTURE_CHUNK_BLOCK_ROWS ? blocks_y - first_row : TEXTURE_CHUNK_BLOCK_ROWS;
+
+        for (u32 by = 0; by < rows; ++by) {
+            for (u32 bx = 0; bx < blocks_x; ++bx) {
+                /* the texels past the edges repeat the last row and column */
+                u8 texels[16][4];
+                for (u32 i = 0; i < 16; ++i) {
+                    u32 x = bx * 4 + i % 4, y = (first_row + by) * 4 + i / 4;
+                    x = x < width ? x : width - 1;
+                    y = y < height ? y : height - 1;
+                    memcpy(texels[i], image + ((usize)y * width + x) * 4, 4);
+                }
+
+                u8* block = blocks + ((usize)by * blocks_x + bx) * TEXTURE_BLOCK_SIZE;
+                cooker_encode_alpha(texels, block);
+                cooker_encode_color(texels, block + 8);
+            }
+        }
+
+        usize size = (usize)rows * blocks_x * TEXTURE_BLOCK_SIZE;
+        usize written = lz4_compress(blocks, size, compressed + compressed_total, lz4_compress_bound(size));
+
+        chunks[c].offset = offset;
+        chunks[c].compressed_size = (u32)written;
+        offset += (u32)written;
+        compressed_total += written;
+    }
+
+    FILE* file = fopen(argv[2], "wb");
+    if (file == NULL) {
+        fprintf(stderr, "couldn't create %s!\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    bool written = cooker_write_section(file, &header, sizeof(header))
+        && cooker_write_section(file, chunks, (usize)header.chunk_count * sizeof(TextureChunk))
+        && cooker_write_section(file, compressed, compressed_total);
+
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "couldn't write %s!\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %ux%u%s, %llu bytes of blocks stored as %u\n", argv[2], width, height, header.flags & TEXTURE_FLAG_ALPHA ? " with alpha" : "",
+        (unsigned long long)blocks_x * blocks_y * TEXTURE_BLOCK_SIZE, offset);
+
+    free(chunks);
+    free(compressed);
+    free(blocks);
+    free(image);
+
+    return EXIT_SUCCESS;
+}